@@ -60,6 +60,7 @@ void util::init_locator_functions()
     globals::funcs[ops::SWAP_LABEL] =               &util::swap_label;
     globals::funcs[ops::SWAP_CATEGORY] =            &util::swap_category;
     globals::funcs[ops::KEEP_EACH] =                &util::keep_each;
+    globals::funcs[ops::COUNT_ALL] =                &util::count_all;
     
     globals::INITIALIZED = true;
     
@@ -315,7 +316,7 @@ void util::find_all(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     bool exists;
     uint32_t index_offset = 1u;
     
-    const types::find_all_return_t res = c_locator.find_all(in_cats_entries, 
+    const types::find_all_csr_t res = c_locator.find_all_csr(in_cats_entries, 
             &exists, index_offset);
     
     if (!exists)
@@ -333,18 +334,19 @@ void util::find_all(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         return;
     }
     
-    uint32_t n_indices = res.indices.tail();
+    //  each cell is copied straight from the flat index array
+    uint32_t n_indices = res.offsets.tail() - 1;
     
     mxArray* all_indices = mxCreateCellMatrix(1, n_indices);
     
-    types::entries_t* res_indices_ptr = res.indices.unsafe_get_pointer();
+    const uint32_t* offsets_ptr = res.offsets.unsafe_get_pointer();
     
     for (uint32_t i = 0; i < n_indices; i++)
     {
-        const types::entries_t& one_combination_inds = res_indices_ptr[i];
+        uint32_t n_copy = offsets_ptr[i+1] - offsets_ptr[i];
         
-        mxArray* one_combination_arr = make_entries_into_array(one_combination_inds, 
-                one_combination_inds.tail());
+        mxArray* one_combination_arr = make_entries_into_array(res.indices, 
+                offsets_ptr[i], n_copy);
         
         mxSetCell(all_indices, i, one_combination_arr);
     }
@@ -353,6 +355,47 @@ void util::find_all(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     plhs[1] = make_entries_into_array(res.combinations, n_combs);
 }
 
+void util::count_all(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    using namespace util;
+    
+    const char* func_id = "locator:count_all";
+    
+    assert_nrhs(nrhs, 3, func_id);
+    assert_nlhs(nlhs, 2, func_id);
+    
+    assert_scalar(prhs[1], func_id, "Id must be scalar.");
+    
+    const locator& c_locator = get_locator(mxGetScalar(prhs[1]));
+    
+    const mxArray* in_cats = prhs[2];
+    uint32_t n_in_cats = mxGetNumberOfElements(in_cats);
+    
+    const types::entries_t in_cats_entries = copy_array_into_entries(in_cats, n_in_cats);
+    
+    bool exists;
+    
+    const types::count_all_return_t res = c_locator.count_all(in_cats_entries, &exists);
+    
+    if (!exists)
+    {
+        mexErrMsgIdAndTxt(func_id, "Category does not exist.");
+        return;
+    }
+    
+    const uint32_t n_combs = res.counts.tail();
+    
+    if (n_combs == 0)
+    {
+        plhs[0] = mxCreateUninitNumericMatrix(0, 1, mxUINT32_CLASS, mxREAL);
+        plhs[1] = mxCreateUninitNumericMatrix(0, n_in_cats, mxUINT32_CLASS, mxREAL);
+        return;
+    }
+    
+    plhs[0] = make_entries_into_array(res.counts, n_combs);
+    plhs[1] = make_entries_into_array(res.combinations, res.combinations.tail());
+}
+
 void util::full_category(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
     using namespace util;
@@ -549,12 +592,22 @@ void util::append(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     const mxArray* in_id_b = prhs[2];
     
     assert_scalar(in_id_a, "locator:append", "Id must be scalar.");
-    assert_scalar(in_id_b, "locator:append", "Id must be scalar.");
     
     locator& c_locator_a = get_locator(mxGetScalar(in_id_a));
-    const locator& c_locator_b = get_locator(mxGetScalar(in_id_b));
     
-    uint32_t result = c_locator_a.append(c_locator_b);
+    //  several ids are appended in one pass
+    assert_isa(in_id_b, mxUINT32_CLASS, "locator:append", "Ids must be uint32.");
+    
+    uint32_t n_ids = mxGetNumberOfElements(in_id_b);
+    types::entries_t ids = copy_array_into_entries(in_id_b, n_ids);
+    std::vector<const locator*> others(n_ids);
+    
+    for (uint32_t i = 0; i < n_ids; i++)
+    {
+        others[i] = &get_locator(ids.at(i));
+    }
+    
+    uint32_t result = c_locator_a.append(others);
     
     if (result == locator_status::OK)
     {
@@ -734,7 +787,28 @@ void util::keep(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     
     const int32_t index_offset = -1;
     
-    c_locator.unchecked_keep(to_keep, index_offset);
+    //  without repeats, the indices are a row mask
+    bool is_unique = true;
+    
+    for (uint32_t i = 1; i < n_els; i++)
+    {
+        if (to_keep_ptr[i] == to_keep_ptr[i-1])
+        {
+            is_unique = false;
+            break;
+        }
+    }
+    
+    if (!is_unique)
+    {
+        c_locator.unchecked_keep(to_keep, index_offset);
+        return;
+    }
+    
+    util::bit_array mask(c_locator.size(), false);
+    mask.unchecked_assign_true(to_keep, index_offset);
+    
+    c_locator.unchecked_keep_mask(mask);
 }
 
 void util::instances(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
@@ -1291,6 +1365,10 @@ void util::create(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 
 void util::destroy(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
+    //  finds run on this thread; its scratch may be sized to the locator
+    //  destroyed
+    util::locator::release_find_scratch();
+    
     if (nrhs == 1)
     {
         util::globals::locators.clear();
@@ -60,6 +60,7 @@ namespace util {
     
     void find(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
     void find_all(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+    void count_all(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
     
     void copy(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
     
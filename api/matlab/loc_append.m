@@ -4,14 +4,17 @@ function loca = loc_append(loca, locb)
 %
 %     loca = loc_append( a, b ) appends the contents of `b` to `a`.
 %
+%     loca = loc_append( a, [b, c, ...] ) appends `b`, `c`, ... in order,
+%     copying each label once rather than once per locator.
+%
 %     An error is thrown if the categories of `a` do not match those of
-%     `b`.
+%     each appended locator.
 %
 %     See also loc_keep, loc_create
 %
 %     IN:
 %       - `loca` (uint32) -- Locator id a.
-%       - `locb` (uint32) -- Locator id b.
+%       - `locb` (uint32) -- Locator id(s) to append.
 %     OUT:
 %       - `loca` (uint32) -- Locator id a.
 
@@ -0,0 +1,32 @@
+function [N, C] = loc_countall(loc, categories)
+
+%   LOC_COUNTALL -- Get the number of rows of combinations of labels.
+%
+%     See also loc_findall, loc_count
+%
+%     IN:
+%       - `loc` (uint32) -- Locator id.
+%       - `categories` (uint32) -- Categories from which to draw labels.
+%     OUT:
+%       - `N` (uint32) -- counts.
+%       - `C` (uint32) -- combinations.
+
+if ( numel(categories) == 1 )
+  C = loc_incat( loc, categories )';
+  N = loc_count( loc, C );
+  return;
+end
+
+op_code = loc_opcodes( 'count_all' );
+
+[N, C] = loc_api( op_code, loc, uint32(categories) );
+
+if ( isempty(C) )
+  return;
+end
+
+n_cats = numel( categories );
+
+C = reshape( C, n_cats, numel(C) / n_cats );
+
+end
@@ -41,6 +41,23 @@ mxArray* util::make_entries_into_array(const types::entries_t& src, uint32_t n_c
     return out;
 }
 
+mxArray* util::make_entries_into_array(const types::entries_t& src, uint32_t offset, uint32_t n_copy)
+{
+    mxArray* out = mxCreateUninitNumericMatrix(n_copy, 1, mxUINT32_CLASS, mxREAL);
+    
+    if (n_copy == 0)
+    {
+        return out;
+    }
+    
+    uint32_t* src_ptr = src.unsafe_get_pointer() + offset;
+    uint32_t* dest_ptr = (uint32_t*) mxGetData(out);
+    
+    std::memcpy(dest_ptr, src_ptr, n_copy * sizeof(uint32_t));
+    
+    return out;
+}
+
 std::string util::get_string(const mxArray* in_str, bool* success)
 {    
     int sz = mxGetNumberOfElements(in_str);
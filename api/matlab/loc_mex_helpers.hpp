@@ -21,4 +21,5 @@ namespace util {
     util::types::entries_t copy_array_into_entries(const mxArray* src);
     void copy_entries_into_array(const types::entries_t& src, mxArray* dest, uint32_t n_copy);
     mxArray* make_entries_into_array(const types::entries_t& src, uint32_t n_copy);
+    mxArray* make_entries_into_array(const types::entries_t& src, uint32_t offset, uint32_t n_copy);
 }
\ No newline at end of file
@@ -37,7 +37,8 @@ const util::op_map_t op_map({
     {"get_rand_lab2",     util::ops::GET_RANDOM_LABEL2},
     {"swap_lab",          util::ops::SWAP_LABEL},
     {"swap_cat",          util::ops::SWAP_CATEGORY},
-    {"keep_each",         util::ops::KEEP_EACH}
+    {"keep_each",         util::ops::KEEP_EACH},
+    {"count_all",         util::ops::COUNT_ALL}
 });
 
 void use_std_string(mxArray *plhs[], const mxArray *prhs[]);
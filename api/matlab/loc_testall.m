@@ -10,6 +10,7 @@ addpath( test_dir );
 
 loc_test_run( @loc_test_keepeach );
 loc_test_run( @loc_test_findall );
+loc_test_run( @loc_test_countall );
 loc_test_run( @loc_test_isfullcat );
 loc_test_run( @loc_test_fullcat );
 loc_test_run( @loc_test_resize );
@@ -207,6 +207,36 @@ classdef locator
       [I, C] = loc_findall( obj.id, categories );
     end
     
+    function [N, C] = countall(obj, categories)
+      
+      %   COUNTALL -- Get the number of rows of each combination of labels.
+      %
+      %     N = countall( obj, [1, 3] ) returns a uint32 column vector `N`,
+      %     where N(i) is the number of rows of the i-th combination of
+      %     labels in categories 1 and 3 that findall() would return. The
+      %     rows themselves are not materialized.
+      %
+      %     N = countall( obj ) counts all combinations of labels in all
+      %     categories.
+      %
+      %     [N, C] = ... also returns `C`, the MxN matrix of combinations,
+      %     as for findall().
+      %
+      %     See also locator/findall, locator/count
+      %
+      %     IN:
+      %       - `categories` (uint32)
+      %     OUT:
+      %       - `N` (uint32)
+      %       - `C` (uint32)
+      
+      if ( nargin < 2 )
+        categories = getcats( obj );
+      end
+      
+      [N, C] = loc_countall( obj.id, categories );
+    end
+    
     function [obj, I, C] = keepeach(obj, categories)
       
       %   KEEPEACH -- Retain combinations of labels in categories.
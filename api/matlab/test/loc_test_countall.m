@@ -0,0 +1,36 @@
+function loc_test_countall()
+
+loc_test_assert_depends_present();
+
+sp = get_labels( get_example_container() );
+
+[loc, c] = locator.from( sp );
+
+all_str_cats = keys( c );
+
+% test all categories
+test_some_cats( loc, c, all_str_cats );
+
+% test random subset of categories
+for i = 1:10
+  n = randi( numel(all_str_cats) - 1, 1, 1 );
+  some_str_cats = all_str_cats( randperm(numel(all_str_cats), n) );
+  
+  fprintf( '\n Testing "%s".', strjoin(some_str_cats, ', ') );
+  
+  test_some_cats( loc, c, some_str_cats );
+end
+
+fprintf( '\n' );
+
+end
+
+function test_some_cats(loc, c, str_cats)
+
+[I, C] = findall( loc, c(str_cats) );
+[N, C2] = countall( loc, c(str_cats) );
+
+assert( isequal(C, C2), 'Combinations mismatch.' );
+assert( isequal(N(:), cellfun(@numel, I(:))), 'Counts mismatch.' );
+
+end
\ No newline at end of file
@@ -0,0 +1,562 @@
+#include "bit_array.hpp"
+#include "thread_pool.hpp"
+#include "rank_select.hpp"
+#include "bit_kernels.hpp"
+#include "utilities.hpp"
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <vector>
+
+void bench_dot_kernels();
+void bench_count_kernels();
+void bench_extract_kernels();
+void bench_compress();
+void bench_concat();
+void bench_word_size();
+void bench_parallel();
+void bench_rank_select();
+double bench_binary_op(util::bit_kernels::binary_op_t op, uint64_t n_bits, uint32_t n_iters);
+double bench_count_op(util::bit_kernels::binary_count_op_t op, uint64_t n_bits, uint32_t n_iters);
+
+int main(int argc, char* argv[])
+{
+    std::cout << "BEGIN BIT_ARRAY BENCH" << std::endl;
+    
+    bench_dot_kernels();
+    bench_count_kernels();
+    bench_extract_kernels();
+    bench_compress();
+    bench_concat();
+    bench_word_size();
+    bench_parallel();
+    bench_rank_select();
+    
+    std::cout << "END BIT_ARRAY BENCH" << std::endl;
+    
+    return 0;
+}
+
+//  bench_dot_kernels: Mean time per call of each dot kernel, for each
+//      simd level supported by this machine, on 1e3 to 1e8 bits.
+
+void bench_dot_kernels()
+{
+    using namespace util;
+    
+    const char* op_names[4] = { "dot_or", "dot_and", "dot_and_not", "dot_eq" };
+    
+    std::cout << "detected: " << bit_kernels::get().name << std::endl;
+    std::cout << "--" << std::endl;
+    
+    for (uint64_t n_bits = 1000; n_bits <= 100000000; n_bits *= 10)
+    {
+        //  touch roughly 1 GB per measurement
+        uint64_t bytes_per_call = (n_bits / 8) * 3;
+        uint32_t n_iters = uint32_t(std::max(uint64_t(5), uint64_t(1e9) / std::max(bytes_per_call, uint64_t(1))));
+        
+        for (uint32_t op = 0; op < 4; op++)
+        {
+            std::cout << std::setw(12) << op_names[op] << " " << std::setw(10) << n_bits << " (bits)";
+            
+            for (uint32_t level = 0; level < simd_level::N_LEVELS; level++)
+            {
+                if (!bit_kernels::is_supported(level))
+                {
+                    continue;
+                }
+                
+                const bit_kernels::table_t& kernels = bit_kernels::get(level);
+                bit_kernels::binary_op_t ops[4] = {
+                    kernels.dot_or, kernels.dot_and, kernels.dot_and_not, kernels.dot_eq
+                };
+                
+                double t = bench_binary_op(ops[op], n_bits, n_iters);
+                
+                std::cout << " | " << kernels.name << ": " << std::setw(10) << (t * 1000.0) << " (ms)";
+            }
+            
+            std::cout << std::endl;
+        }
+        
+        std::cout << "--" << std::endl;
+    }
+}
+
+double bench_binary_op(util::bit_kernels::binary_op_t op, uint64_t n_bits, uint32_t n_iters)
+{
+    using namespace util;
+    
+    size_t n_words = size_t((n_bits + 63) / 64);
+    
+    std::vector<uint64_t> a(n_words, 0x5555555555555555ull);
+    std::vector<uint64_t> b(n_words, 0x3333333333333333ull);
+    std::vector<uint64_t> out(n_words, 0u);
+    
+    //  warm up
+    op(out.data(), a.data(), b.data(), n_words);
+    
+    profile::time_point_t t1 = profile::clock_t::now();
+    
+    for (uint32_t i = 0; i < n_iters; i++)
+    {
+        op(out.data(), a.data(), b.data(), n_words);
+    }
+    
+    profile::time_point_t t2 = profile::clock_t::now();
+    
+    return profile::ellapsed_time_s(t1, t2) / double(n_iters);
+}
+
+//  bench_count_kernels: Mean time per call of the fused and / and-not
+//      count kernels.
+
+void bench_count_kernels()
+{
+    using namespace util;
+    
+    const char* op_names[2] = { "and_count", "and_not_count" };
+    
+    for (uint64_t n_bits = 1000; n_bits <= 100000000; n_bits *= 10)
+    {
+        uint64_t bytes_per_call = (n_bits / 8) * 2;
+        uint32_t n_iters = uint32_t(std::max(uint64_t(5), uint64_t(1e9) / std::max(bytes_per_call, uint64_t(1))));
+        
+        for (uint32_t op = 0; op < 2; op++)
+        {
+            std::cout << std::setw(14) << op_names[op] << " " << std::setw(10) << n_bits << " (bits)";
+            
+            for (uint32_t level = 0; level < simd_level::N_LEVELS; level++)
+            {
+                if (!bit_kernels::is_supported(level))
+                {
+                    continue;
+                }
+                
+                const bit_kernels::table_t& kernels = bit_kernels::get(level);
+                bit_kernels::binary_count_op_t ops[2] = { kernels.and_count, kernels.and_not_count };
+                
+                double t = bench_count_op(ops[op], n_bits, n_iters);
+                
+                std::cout << " | " << kernels.name << ": " << std::setw(10) << (t * 1000.0) << " (ms)";
+            }
+            
+            std::cout << std::endl;
+        }
+        
+        std::cout << "--" << std::endl;
+    }
+}
+
+double bench_count_op(util::bit_kernels::binary_count_op_t op, uint64_t n_bits, uint32_t n_iters)
+{
+    using namespace util;
+    
+    size_t n_words = size_t((n_bits + 63) / 64);
+    
+    std::vector<uint64_t> a(n_words, 0x5555555555555555ull);
+    std::vector<uint64_t> b(n_words, 0x3333333333333333ull);
+    
+    //  accumulate into a volatile so the calls are not elided
+    volatile uint64_t sink = op(a.data(), b.data(), n_words);
+    
+    profile::time_point_t t1 = profile::clock_t::now();
+    
+    for (uint32_t i = 0; i < n_iters; i++)
+    {
+        sink = sink + op(a.data(), b.data(), n_words);
+    }
+    
+    profile::time_point_t t2 = profile::clock_t::now();
+    
+    return profile::ellapsed_time_s(t1, t2) / double(n_iters);
+}
+
+//  bench_extract_kernels: Mean time per call of each set-bit extraction
+//      kernel on 1e6 bits, from sparse to dense.
+
+void bench_extract_kernels()
+{
+    using namespace util;
+    
+    const uint32_t n_bits = 1000000;
+    const uint32_t n_iters = 200;
+    const uint32_t percents[6] = { 1, 5, 10, 25, 50, 90 };
+    
+    size_t n_words = (n_bits + 63) / 64;
+    
+    for (uint32_t p = 0; p < 6; p++)
+    {
+        std::vector<uint64_t> a(n_words, 0u);
+        
+        for (uint32_t i = 0; i < n_bits; i++)
+        {
+            if (uint32_t(rand() % 100) < percents[p])
+            {
+                a[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+        
+        std::vector<uint32_t> out(n_bits + bit_kernels::EXTRACT_SLACK);
+        
+        std::cout << std::setw(14) << "extract" << " " << std::setw(10) << percents[p] << " (%)   ";
+        
+        for (uint32_t level = 0; level < simd_level::N_LEVELS; level++)
+        {
+            if (!bit_kernels::is_supported(level))
+            {
+                continue;
+            }
+            
+            const bit_kernels::table_t& kernels = bit_kernels::get(level);
+            
+            profile::time_point_t t1 = profile::clock_t::now();
+            
+            for (uint32_t i = 0; i < n_iters; i++)
+            {
+                kernels.extract(out.data(), a.data(), n_words, 0u);
+            }
+            
+            profile::time_point_t t2 = profile::clock_t::now();
+            
+            double t = profile::ellapsed_time_s(t1, t2) / double(n_iters);
+            
+            std::cout << " | " << kernels.name << ": " << std::setw(10) << (t * 1000.0) << " (ms)";
+        }
+        
+        std::cout << std::endl;
+    }
+}
+
+//  bench_compress: Mean time per call of each compress kernel on 1e7 bits,
+//      against keep(find(mask)), from sparse to dense masks.
+
+void bench_compress()
+{
+    using namespace util;
+    
+    const uint32_t n_bits = 10000000;
+    const uint32_t n_iters = 20;
+    const uint32_t percents[5] = { 1, 10, 50, 90, 100 };
+    
+    size_t n_words = (n_bits + 63) / 64;
+    
+    bit_array barray(n_bits, false);
+    
+    for (uint32_t i = 0; i < n_bits; i++)
+    {
+        barray.unchecked_place(rand() % 2 == 0, i);
+    }
+    
+    for (uint32_t p = 0; p < 5; p++)
+    {
+        bit_array mask(n_bits, false);
+        
+        for (uint32_t i = 0; i < n_bits; i++)
+        {
+            mask.unchecked_place(uint32_t(rand() % 100) < percents[p], i);
+        }
+        
+        std::vector<uint64_t> a(n_words, 0u);
+        std::vector<uint64_t> m(n_words, 0u);
+        std::vector<uint64_t> out(n_words, 0u);
+        
+        for (uint32_t i = 0; i < n_bits; i++)
+        {
+            a[i / 64] |= uint64_t(barray.at(i)) << (i % 64);
+            m[i / 64] |= uint64_t(mask.at(i)) << (i % 64);
+        }
+        
+        std::cout << std::setw(14) << "compress" << " " << std::setw(10) << percents[p] << " (%)   ";
+        
+        for (uint32_t level = 0; level < simd_level::N_LEVELS; level++)
+        {
+            if (!bit_kernels::is_supported(level))
+            {
+                continue;
+            }
+            
+            const bit_kernels::table_t& kernels = bit_kernels::get(level);
+            
+            profile::time_point_t t1 = profile::clock_t::now();
+            
+            for (uint32_t i = 0; i < n_iters; i++)
+            {
+                kernels.compress(out.data(), a.data(), m.data(), n_words);
+            }
+            
+            profile::time_point_t t2 = profile::clock_t::now();
+            
+            double t = profile::ellapsed_time_s(t1, t2) / double(n_iters);
+            
+            std::cout << " | " << kernels.name << ": " << std::setw(10) << (t * 1000.0) << " (ms)";
+        }
+        
+        profile::time_point_t t1 = profile::clock_t::now();
+        
+        for (uint32_t i = 0; i < n_iters; i++)
+        {
+            bit_array copy = barray;
+            copy.unchecked_keep(bit_array::find(mask));
+        }
+        
+        profile::time_point_t t2 = profile::clock_t::now();
+        
+        double t = profile::ellapsed_time_s(t1, t2) / double(n_iters);
+        
+        std::cout << " | keep(find): " << std::setw(10) << (t * 1000.0) << " (ms)" << std::endl;
+    }
+}
+
+//  bench_concat: Joining 200 arrays of unaligned size by repeated append,
+//      and in a single concat.
+
+void bench_concat()
+{
+    using namespace util;
+    
+    const uint32_t n_arrays = 200;
+    const uint32_t n_iters = 5;
+    
+    std::vector<bit_array> arrays;
+    std::vector<const bit_array*> ptrs;
+    
+    for (uint32_t i = 0; i < n_arrays; i++)
+    {
+        arrays.emplace_back(50000 + rand() % 100, true);
+    }
+    
+    for (const bit_array& arr : arrays)
+    {
+        ptrs.push_back(&arr);
+    }
+    
+    profile::time_point_t t1 = profile::clock_t::now();
+    
+    for (uint32_t i = 0; i < n_iters; i++)
+    {
+        bit_array result;
+        
+        for (const bit_array& arr : arrays)
+        {
+            result.append(arr);
+        }
+    }
+    
+    profile::time_point_t t2 = profile::clock_t::now();
+    
+    double t_append = profile::ellapsed_time_s(t1, t2) / double(n_iters);
+    
+    t1 = profile::clock_t::now();
+    
+    for (uint32_t i = 0; i < n_iters; i++)
+    {
+        bit_array result;
+        bit_array::concat(result, ptrs);
+    }
+    
+    t2 = profile::clock_t::now();
+    
+    double t_concat = profile::ellapsed_time_s(t1, t2) / double(n_iters);
+    
+    std::cout << std::setw(14) << "concat" << " " << std::setw(10) << n_arrays << " (arrays) ";
+    std::cout << " | append: " << std::setw(10) << (t_append * 1000.0) << " (ms)";
+    std::cout << " | concat: " << std::setw(10) << (t_concat * 1000.0) << " (ms)" << std::endl;
+}
+
+//  bench_word_size: Per-bit and bulk operations on 32- vs. 64-bit words.
+
+template<typename W>
+void bench_word_size_impl(const char* name, const std::vector<uint32_t>& indices, uint32_t sz)
+{
+    using namespace util;
+    
+    const uint32_t n_iters = 5;
+    
+    basic_bit_array<W> barray(sz, false);
+    uint32_t n_indices = uint32_t(indices.size());
+    uint32_t n_hits = 0;
+    
+    profile::time_point_t t1 = profile::clock_t::now();
+    
+    for (uint32_t i = 0; i < n_iters; i++)
+    {
+        for (uint32_t j = 0; j < n_indices; j++)
+        {
+            barray.unchecked_place(true, indices[j]);
+        }
+        
+        for (uint32_t j = 0; j < n_indices; j++)
+        {
+            n_hits += barray.at(indices[j]);
+        }
+    }
+    
+    profile::time_point_t t2 = profile::clock_t::now();
+    
+    double t_place = profile::ellapsed_time_s(t1, t2) / double(n_iters);
+    
+    t1 = profile::clock_t::now();
+    
+    for (uint32_t i = 0; i < n_iters; i++)
+    {
+        n_hits += basic_bit_array<W>::find(barray).tail();
+    }
+    
+    t2 = profile::clock_t::now();
+    
+    double t_find = profile::ellapsed_time_s(t1, t2) / double(n_iters);
+    
+    basic_bit_array<W> out(sz, false);
+    
+    t1 = profile::clock_t::now();
+    
+    for (uint32_t i = 0; i < n_iters; i++)
+    {
+        basic_bit_array<W>::dot_and(out, barray, barray);
+    }
+    
+    t2 = profile::clock_t::now();
+    
+    double t_and = profile::ellapsed_time_s(t1, t2) / double(n_iters);
+    
+    std::cout << std::setw(14) << name << " " << std::setw(10) << n_hits << " (hits)   ";
+    std::cout << " | place/at: " << std::setw(10) << (t_place * 1000.0) << " (ms)";
+    std::cout << " | find: " << std::setw(10) << (t_find * 1000.0) << " (ms)";
+    std::cout << " | and: " << std::setw(10) << (t_and * 1000.0) << " (ms)" << std::endl;
+}
+
+void bench_word_size()
+{
+    const uint32_t sz = 10000000;
+    const uint32_t n_indices = 1000000;
+    
+    std::vector<uint32_t> indices(n_indices);
+    
+    for (uint32_t i = 0; i < n_indices; i++)
+    {
+        indices[i] = uint32_t(rand()) % sz;
+    }
+    
+    bench_word_size_impl<uint32_t>("words32", indices, sz);
+    bench_word_size_impl<uint64_t>("words64", indices, sz);
+}
+
+//  bench_parallel: Serial vs. thread-pool dot_or, sum and find on 1e8 bits.
+
+void bench_parallel()
+{
+    using namespace util;
+    
+    const uint32_t sz = 100000000;
+    const uint32_t n_iters = 3;
+    
+    bit_array a(sz, false);
+    bit_array b(sz, false);
+    bit_array out(sz, false);
+    
+    for (uint32_t i = 0; i < sz / 64; i++)
+    {
+        a.place(true, uint32_t(rand()) % sz);
+        b.place(true, uint32_t(rand()) % sz);
+    }
+    
+    uint32_t n_found = 0;
+    
+    profile::time_point_t t1 = profile::clock_t::now();
+    
+    for (uint32_t i = 0; i < n_iters; i++)
+    {
+        bit_array::dot_or(out, a, b);
+        n_found += out.sum();
+        n_found += bit_array::find(out).tail();
+    }
+    
+    profile::time_point_t t2 = profile::clock_t::now();
+    
+    double t_serial = profile::ellapsed_time_s(t1, t2) / double(n_iters);
+    
+    t1 = profile::clock_t::now();
+    
+    for (uint32_t i = 0; i < n_iters; i++)
+    {
+        bit_array::parallel_dot_or(out, a, b);
+        n_found -= out.parallel_sum();
+        n_found -= bit_array::parallel_find(out).tail();
+    }
+    
+    t2 = profile::clock_t::now();
+    
+    double t_parallel = profile::ellapsed_time_s(t1, t2) / double(n_iters);
+    
+    std::cout << std::setw(14) << "parallel" << " " << std::setw(10) << thread_pool::shared().size() << " (threads)";
+    std::cout << " | serial: " << std::setw(10) << (t_serial * 1000.0) << " (ms)";
+    std::cout << " | parallel: " << std::setw(10) << (t_parallel * 1000.0) << " (ms)";
+    std::cout << (n_found == 0 ? "" : " [MISMATCH]") << std::endl;
+}
+
+//  bench_rank_select: Directory build time, and the mean time of a rank or
+//      select query vs. materializing the indices with find, on 1e8 bits.
+
+void bench_rank_select()
+{
+    using namespace util;
+    
+    const uint32_t sz = 100000000;
+    const uint32_t n_queries = 1000000;
+    
+    bit_array a(sz, false);
+    
+    for (uint32_t i = 0; i < sz / 16; i++)
+    {
+        a.place(true, uint32_t(rand()) % sz);
+    }
+    
+    rank_select directory(a);
+    
+    profile::time_point_t t1 = profile::clock_t::now();
+    directory.build();
+    profile::time_point_t t2 = profile::clock_t::now();
+    
+    double t_build = profile::ellapsed_time_s(t1, t2);
+    
+    t1 = profile::clock_t::now();
+    dynamic_array<uint32_t> indices = bit_array::find(a);
+    t2 = profile::clock_t::now();
+    
+    double t_find = profile::ellapsed_time_s(t1, t2);
+    
+    uint32_t n_set = directory.sum();
+    uint64_t checksum = 0;
+    
+    t1 = profile::clock_t::now();
+    
+    for (uint32_t i = 0; i < n_queries; i++)
+    {
+        checksum += directory.unchecked_rank(uint32_t(rand()) % sz);
+    }
+    
+    t2 = profile::clock_t::now();
+    
+    double t_rank = profile::ellapsed_time_s(t1, t2) / double(n_queries);
+    bool is_match = true;
+    
+    t1 = profile::clock_t::now();
+    
+    for (uint32_t i = 0; i < n_queries; i++)
+    {
+        uint32_t k = uint32_t(rand()) % n_set;
+        is_match = is_match && directory.unchecked_select(k) == indices.at(k);
+    }
+    
+    t2 = profile::clock_t::now();
+    
+    double t_select = profile::ellapsed_time_s(t1, t2) / double(n_queries);
+    
+    std::cout << std::setw(14) << "rank_select" << " " << std::setw(10) << (directory.bytes() / 1024) << " (KiB)    ";
+    std::cout << " | build: " << std::setw(10) << (t_build * 1000.0) << " (ms)";
+    std::cout << " | find: " << std::setw(10) << (t_find * 1000.0) << " (ms)";
+    std::cout << " | rank: " << std::setw(10) << (t_rank * 1e9) << " (ns)";
+    std::cout << " | select: " << std::setw(10) << (t_select * 1e9) << " (ns)";
+    std::cout << (is_match && checksum > 0 ? "" : " [MISMATCH]") << std::endl;
+}
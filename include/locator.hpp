@@ -8,7 +8,11 @@
 #pragma once
 
 #include "../src/bit_array.hpp"
+#include "../src/compressed_bit_array.hpp"
+#include "../src/rank_select.hpp"
+#include "../src/label_index.hpp"
 #include "../src/dynamic_array.hpp"
 #include "../src/multimap.hpp"
 #include "../src/utilities.hpp"
+#include "../src/thread_pool.hpp"
 #include "../src/locator.hpp"
@@ -8,7 +8,14 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <new>
+#include <type_traits>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
 
 namespace util {
     template<typename T>
@@ -16,6 +23,9 @@ namespace util {
     
     template<typename T>
     class dynamic_allocator;
+    
+    template<typename T, uint32_t Align = 64u>
+    class aligned_allocator;
 }
 
 //
@@ -172,3 +182,165 @@ void util::dynamic_allocator<T>::copy(T* dest, T* source, uint32_t sz)
         dest[i] = source[i];
     }
 }
+
+//
+//  aligned allocator
+//
+//      As trivial_allocator, but blocks start on an `Align`-byte boundary and
+//      span a whole number of `Align`-byte lines. Elements past the requested
+//      size in the final line are zero on allocation, so vector code may
+//      read and write up to padded_size() elements.
+//
+
+template<typename T, uint32_t Align>
+class util::aligned_allocator
+{
+public:
+    aligned_allocator() = delete;
+    ~aligned_allocator() = delete;
+    
+    aligned_allocator(const aligned_allocator& other) = delete;
+    aligned_allocator& operator=(const aligned_allocator& other) = delete;
+    aligned_allocator(aligned_allocator&& rhs) noexcept = delete;
+    aligned_allocator& operator=(aligned_allocator&& other) noexcept = delete;
+    
+    static T* create(uint32_t with_size);
+    static T* allocate(uint32_t with_size);
+    static T* resize(T* data, uint32_t to_size, uint32_t original_size);
+    static void copy(T* dest, T* source, uint32_t sz);
+    static void dispose(T* data);
+    
+    static uint32_t padded_size(uint32_t with_size);
+    
+    constexpr static bool is_valid_alloc_t = std::is_trivially_copyable<T>::value;
+    constexpr static uint32_t alignment = Align;
+    
+    static_assert((Align & (Align - 1u)) == 0 && Align >= sizeof(void*), "Alignment must be a power of 2.");
+private:
+    static size_t get_padded_bytes(uint32_t with_size);
+    static void zero_padding(T* data, uint32_t with_size);
+};
+
+template<typename T, uint32_t Align>
+T* util::aligned_allocator<T, Align>::create(uint32_t with_size)
+{
+    if (with_size == 0)
+    {
+        return nullptr;
+    }
+    
+    return allocate(with_size);
+}
+
+template<typename T, uint32_t Align>
+T* util::aligned_allocator<T, Align>::allocate(uint32_t with_size)
+{
+    size_t n_bytes = get_padded_bytes(with_size);
+    
+#ifdef _MSC_VER
+    T* data = (T*) _aligned_malloc(n_bytes, Align);
+#else
+    void* ptr = nullptr;
+    T* data = posix_memalign(&ptr, Align, n_bytes) == 0 ? (T*) ptr : nullptr;
+#endif
+    
+    if (data == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    
+    zero_padding(data, with_size);
+    
+    return data;
+}
+
+//  resize: realloc() keeps the contents in place or moves them with
+//      mremap() for large blocks, which usually preserves the alignment;
+//      otherwise, the contents are copied into a new aligned block.
+
+template<typename T, uint32_t Align>
+T* util::aligned_allocator<T, Align>::resize(T* data, uint32_t to_size, uint32_t original_size)
+{
+    if (to_size == 0)
+    {
+        dispose(data);
+        return nullptr;
+    }
+    
+    if (data == nullptr)
+    {
+        return allocate(to_size);
+    }
+    
+    size_t n_bytes = get_padded_bytes(to_size);
+    
+#ifdef _MSC_VER
+    T* new_data = (T*) _aligned_realloc(data, n_bytes, Align);
+    
+    if (new_data == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+#else
+    T* new_data = (T*) std::realloc(data, n_bytes);
+    
+    if (new_data == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    
+    if (uintptr_t(new_data) % Align != 0)
+    {
+        T* aligned_data = allocate(to_size);
+        uint32_t n_copy = to_size > original_size ? original_size : to_size;
+        
+        std::memcpy(aligned_data, new_data, n_copy * sizeof(T));
+        std::free(new_data);
+        
+        return aligned_data;
+    }
+#endif
+    
+    zero_padding(new_data, to_size);
+    
+    return new_data;
+}
+
+template<typename T, uint32_t Align>
+void util::aligned_allocator<T, Align>::copy(T* dest, T* source, uint32_t sz)
+{
+    std::memcpy(dest, source, sz * sizeof(T));
+}
+
+template<typename T, uint32_t Align>
+void util::aligned_allocator<T, Align>::dispose(T* data)
+{
+#ifdef _MSC_VER
+    _aligned_free(data);
+#else
+    std::free(data);
+#endif
+}
+
+template<typename T, uint32_t Align>
+uint32_t util::aligned_allocator<T, Align>::padded_size(uint32_t with_size)
+{
+    return uint32_t(get_padded_bytes(with_size) / sizeof(T));
+}
+
+template<typename T, uint32_t Align>
+size_t util::aligned_allocator<T, Align>::get_padded_bytes(uint32_t with_size)
+{
+    size_t n_bytes = size_t(with_size) * sizeof(T);
+    
+    return ((n_bytes + Align - 1u) / Align) * Align;
+}
+
+template<typename T, uint32_t Align>
+void util::aligned_allocator<T, Align>::zero_padding(T* data, uint32_t with_size)
+{
+    size_t n_bytes = size_t(with_size) * sizeof(T);
+    size_t n_padded = get_padded_bytes(with_size);
+    
+    std::memset((char*) data + n_bytes, 0, n_padded - n_bytes);
+}
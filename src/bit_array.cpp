@@ -6,83 +6,337 @@
 //
 
 #include "bit_array.hpp"
+#include "bit_kernels.hpp"
+#include "thread_pool.hpp"
 #include <stdexcept>
 #include <cstring>
-#include <cmath>
+#include <algorithm>
 
-util::bit_array::bit_array()
+namespace {
+    //  word_kernels: Bulk operations on arrays of words. 64-bit words use the
+    //      dispatched simd kernels; 32-bit words use scalar loops.
+    template<typename W>
+    struct word_kernels
+    {
+        static void dot_or(W* out, const W* a, const W* b, size_t n_words);
+        static void dot_and(W* out, const W* a, const W* b, size_t n_words);
+        static void dot_and_not(W* out, const W* a, const W* b, size_t n_words);
+        static void dot_eq(W* out, const W* a, const W* b, size_t n_words);
+        static uint64_t popcount(const W* a, size_t n_words);
+        static uint64_t and_count(const W* a, const W* b, size_t n_words);
+        static uint64_t and_not_count(const W* a, const W* b, size_t n_words);
+        static uint32_t extract(uint32_t* out, const W* a, size_t n_words, uint32_t base);
+        static uint64_t compress(W* out, const W* a, const W* mask, size_t n_words);
+        static W funnel_shift(W* out, const W* a, size_t n_words, uint32_t shift);
+    };
+    
+    template<>
+    struct word_kernels<uint64_t>
+    {
+        static void dot_or(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words);
+        static void dot_and(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words);
+        static void dot_and_not(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words);
+        static void dot_eq(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words);
+        static uint64_t popcount(const uint64_t* a, size_t n_words);
+        static uint64_t and_count(const uint64_t* a, const uint64_t* b, size_t n_words);
+        static uint64_t and_not_count(const uint64_t* a, const uint64_t* b, size_t n_words);
+        static uint32_t extract(uint32_t* out, const uint64_t* a, size_t n_words, uint32_t base);
+        static uint64_t compress(uint64_t* out, const uint64_t* a, const uint64_t* mask, size_t n_words);
+        static uint64_t funnel_shift(uint64_t* out, const uint64_t* a, size_t n_words, uint32_t shift);
+    };
+    
+    //  scalar
+    
+    template<typename W>
+    void word_kernels<W>::dot_or(W* out, const W* a, const W* b, size_t n_words)
+    {
+        for (size_t i = 0; i < n_words; i++)
+        {
+            out[i] = a[i] | b[i];
+        }
+    }
+    
+    template<typename W>
+    void word_kernels<W>::dot_and(W* out, const W* a, const W* b, size_t n_words)
+    {
+        for (size_t i = 0; i < n_words; i++)
+        {
+            out[i] = a[i] & b[i];
+        }
+    }
+    
+    template<typename W>
+    void word_kernels<W>::dot_and_not(W* out, const W* a, const W* b, size_t n_words)
+    {
+        for (size_t i = 0; i < n_words; i++)
+        {
+            out[i] = a[i] & ~b[i];
+        }
+    }
+    
+    template<typename W>
+    void word_kernels<W>::dot_eq(W* out, const W* a, const W* b, size_t n_words)
+    {
+        for (size_t i = 0; i < n_words; i++)
+        {
+            out[i] = ~(a[i] ^ b[i]);
+        }
+    }
+    
+    template<typename W>
+    uint64_t word_kernels<W>::popcount(const W* a, size_t n_words)
+    {
+        uint64_t c_sum = 0;
+        
+        for (size_t i = 0; i < n_words; i++)
+        {
+            c_sum += util::bit_kernels::popcount64(a[i]);
+        }
+        
+        return c_sum;
+    }
+    
+    template<typename W>
+    uint64_t word_kernels<W>::and_count(const W* a, const W* b, size_t n_words)
+    {
+        uint64_t c_sum = 0;
+        
+        for (size_t i = 0; i < n_words; i++)
+        {
+            c_sum += util::bit_kernels::popcount64(a[i] & b[i]);
+        }
+        
+        return c_sum;
+    }
+    
+    template<typename W>
+    uint64_t word_kernels<W>::and_not_count(const W* a, const W* b, size_t n_words)
+    {
+        uint64_t c_sum = 0;
+        
+        for (size_t i = 0; i < n_words; i++)
+        {
+            c_sum += util::bit_kernels::popcount64(W(a[i] & ~b[i]));
+        }
+        
+        return c_sum;
+    }
+    
+    template<typename W>
+    uint32_t word_kernels<W>::extract(uint32_t* out, const W* a, size_t n_words, uint32_t base)
+    {
+        uint32_t n_found = 0;
+        
+        for (size_t i = 0; i < n_words; i++)
+        {
+            W word = a[i];
+            
+            while (word != 0)
+            {
+                out[n_found++] = base + util::bit_kernels::ctz64(word);
+                word &= word - 1;
+            }
+            
+            base += uint32_t(sizeof(W) * 8u);
+        }
+        
+        return n_found;
+    }
+    
+    //  compress: One bit at a time; a whole word is only written once it is
+    //      complete, so `out` may alias `a`.
+    
+    template<typename W>
+    uint64_t word_kernels<W>::compress(W* out, const W* a, const W* mask, size_t n_words)
+    {
+        const uint32_t bits = uint32_t(sizeof(W) * 8u);
+        
+        W acc = 0;
+        uint32_t n_acc = 0;
+        uint64_t n_packed = 0;
+        
+        for (size_t i = 0; i < n_words; i++)
+        {
+            W datum = a[i];
+            W m = mask[i];
+            
+            while (m != 0)
+            {
+                W bit = (datum >> util::bit_kernels::ctz64(m)) & W(1);
+                
+                acc |= bit << n_acc;
+                m &= m - 1;
+                n_packed++;
+                
+                if (++n_acc == bits)
+                {
+                    *out++ = acc;
+                    acc = 0;
+                    n_acc = 0;
+                }
+            }
+        }
+        
+        if (n_acc != 0)
+        {
+            *out = acc;
+        }
+        
+        return n_packed;
+    }
+    
+    template<typename W>
+    W word_kernels<W>::funnel_shift(W* out, const W* a, size_t n_words, uint32_t shift)
+    {
+        const uint32_t bits = uint32_t(sizeof(W) * 8u);
+        
+        out[0] |= a[0] << shift;
+        
+        for (size_t i = 1; i < n_words; i++)
+        {
+            out[i] = (a[i] << shift) | (a[i-1] >> (bits - shift));
+        }
+        
+        return a[n_words-1] >> (bits - shift);
+    }
+    
+    //  simd
+    
+    void word_kernels<uint64_t>::dot_or(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        util::bit_kernels::get().dot_or(out, a, b, n_words);
+    }
+    
+    void word_kernels<uint64_t>::dot_and(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        util::bit_kernels::get().dot_and(out, a, b, n_words);
+    }
+    
+    void word_kernels<uint64_t>::dot_and_not(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        util::bit_kernels::get().dot_and_not(out, a, b, n_words);
+    }
+    
+    void word_kernels<uint64_t>::dot_eq(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        util::bit_kernels::get().dot_eq(out, a, b, n_words);
+    }
+    
+    uint64_t word_kernels<uint64_t>::popcount(const uint64_t* a, size_t n_words)
+    {
+        return util::bit_kernels::get().popcount(a, n_words);
+    }
+    
+    uint64_t word_kernels<uint64_t>::and_count(const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        return util::bit_kernels::get().and_count(a, b, n_words);
+    }
+    
+    uint64_t word_kernels<uint64_t>::and_not_count(const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        return util::bit_kernels::get().and_not_count(a, b, n_words);
+    }
+    
+    uint32_t word_kernels<uint64_t>::extract(uint32_t* out, const uint64_t* a, size_t n_words, uint32_t base)
+    {
+        return util::bit_kernels::get().extract(out, a, n_words, base);
+    }
+    
+    uint64_t word_kernels<uint64_t>::compress(uint64_t* out, const uint64_t* a, const uint64_t* mask, size_t n_words)
+    {
+        return util::bit_kernels::get().compress(out, a, mask, n_words);
+    }
+    
+    uint64_t word_kernels<uint64_t>::funnel_shift(uint64_t* out, const uint64_t* a, size_t n_words, uint32_t shift)
+    {
+        return util::bit_kernels::get().funnel_shift(out, a, n_words, shift);
+    }
+}
+
+template<typename W>
+util::basic_bit_array<W>::basic_bit_array()
 {
     m_size = 0;
-    m_size_int = get_size_int();
+    m_version = 0;
 }
 
-util::bit_array::bit_array(uint32_t size)
+template<typename W>
+util::basic_bit_array<W>::basic_bit_array(uint32_t size)
 {
     m_size = size;
-    m_size_int = get_size_int();
+    m_version = 0;
     m_data.resize(get_data_size(size));
     m_data.seek_tail_to_end();
 }
 
-util::bit_array::bit_array(uint32_t size, bool fill_with)
+template<typename W>
+util::basic_bit_array<W>::basic_bit_array(uint32_t size, bool fill_with)
 {
     m_size = size;
-    m_size_int = get_size_int();
+    m_version = 0;
     m_data.resize(get_data_size(size));
     m_data.seek_tail_to_end();
     fill(fill_with);
 }
 
-util::bit_array::~bit_array() noexcept
+template<typename W>
+util::basic_bit_array<W>::~basic_bit_array() noexcept
 {
     //
 }
 
 //  copy-construct
-util::bit_array::bit_array(const util::bit_array& other) : m_data(other.m_data)
+template<typename W>
+util::basic_bit_array<W>::basic_bit_array(const util::basic_bit_array<W>& other) : m_data(other.m_data)
 {
     m_size = other.m_size;
-    m_size_int = other.m_size_int;
+    m_version = 0;
 }
 
 //  copy-assign
-util::bit_array& util::bit_array::operator=(const util::bit_array& other)
+template<typename W>
+util::basic_bit_array<W>& util::basic_bit_array<W>::operator=(const util::basic_bit_array<W>& other)
 {
-    util::bit_array tmp(other);
+    util::basic_bit_array<W> tmp(other);
     *this = std::move(tmp);
     return *this;
 }
 
 //  move-construct
-util::bit_array::bit_array(util::bit_array&& rhs) noexcept :
+template<typename W>
+util::basic_bit_array<W>::basic_bit_array(util::basic_bit_array<W>&& rhs) noexcept :
     m_data(std::move(rhs.m_data))
 {
     m_size = rhs.m_size;
-    m_size_int = rhs.m_size_int;
+    m_version = 0;
     
     rhs.m_size = 0;
+    rhs.m_version++;
 }
 
 //  move-assign
-util::bit_array& util::bit_array::operator=(util::bit_array&& rhs) noexcept
+template<typename W>
+util::basic_bit_array<W>& util::basic_bit_array<W>::operator=(util::basic_bit_array<W>&& rhs) noexcept
 {
     m_data = std::move(rhs.m_data);
     m_size = rhs.m_size;
-    m_size_int = rhs.m_size_int;
+    m_version++;
     
     rhs.m_size = 0;
+    rhs.m_version++;
     
     return *this;
 }
 
-void util::bit_array::push(bool value)
+template<typename W>
+void util::basic_bit_array<W>::push(bool value)
 {
     uint32_t bin = get_bin(m_size);
     uint32_t bit = get_bit(m_size);
     
     if (bit == 0)
     {
-        m_data.push(0u);
+        m_data.push(word_t(0));
     }
     
     unchecked_place(value, bin, bit);
@@ -90,7 +344,8 @@ void util::bit_array::push(bool value)
     m_size++;
 }
 
-void util::bit_array::place(bool value, uint32_t at_index)
+template<typename W>
+void util::basic_bit_array<W>::place(bool value, uint32_t at_index)
 {
     if (at_index > m_size-1)
     {
@@ -100,7 +355,8 @@ void util::bit_array::place(bool value, uint32_t at_index)
     unchecked_place(value, at_index);
 }
 
-void util::bit_array::unchecked_place(bool value, uint32_t at_index)
+template<typename W>
+void util::basic_bit_array<W>::unchecked_place(bool value, uint32_t at_index)
 {
     uint32_t bin = get_bin(at_index);
     uint32_t bit = get_bit(at_index);
@@ -108,24 +364,28 @@ void util::bit_array::unchecked_place(bool value, uint32_t at_index)
     unchecked_place(value, bin, bit);
 }
 
-void util::bit_array::unchecked_place(bool value, uint32_t bin, uint32_t bit)
+template<typename W>
+void util::basic_bit_array<W>::unchecked_place(bool value, uint32_t bin, uint32_t bit)
 {
-    uint32_t* data = m_data.unsafe_get_pointer();
-    uint32_t current = data[bin];
+    m_version++;
+    
+    word_t* data = m_data.unsafe_get_pointer();
+    word_t current = data[bin];
     
     if (value)
     {
-        current = current | (1u << bit);
+        current = current | (word_t(1) << bit);
     }
     else
     {
-        current = current & ~(1u << bit);
+        current = current & ~(word_t(1) << bit);
     }
     
     data[bin] = current;
 }
 
-void util::bit_array::keep(const util::dynamic_array<uint32_t>& at_indices)
+template<typename W>
+void util::basic_bit_array<W>::keep(const util::dynamic_array<uint32_t>& at_indices)
 {
     for (uint32_t i = 0; i < at_indices.tail(); i++)
     {
@@ -138,14 +398,20 @@ void util::bit_array::keep(const util::dynamic_array<uint32_t>& at_indices)
     unchecked_keep(at_indices);
 }
 
-void util::bit_array::empty()
+template<typename W>
+void util::basic_bit_array<W>::empty()
 {
+    m_version++;
+    
     m_data.clear();
     m_size = 0;
 }
 
-void util::bit_array::unchecked_keep(const util::dynamic_array<uint32_t> &at_indices, int32_t index_offset)
+template<typename W>
+void util::basic_bit_array<W>::unchecked_keep(const util::dynamic_array<uint32_t> &at_indices, int32_t index_offset)
 {
+    m_version++;
+    
     uint32_t new_size = at_indices.tail();
     
     if (new_size == 0)
@@ -156,27 +422,27 @@ void util::bit_array::unchecked_keep(const util::dynamic_array<uint32_t> &at_ind
     
     uint32_t new_data_size = get_data_size(new_size);
     
-    util::dynamic_array<uint32_t> tmp(new_data_size);
+    util::dynamic_array<word_t> tmp(new_data_size);
     
-    uint32_t* tmp_ptr = tmp.unsafe_get_pointer();
-    uint32_t* data_ptr = m_data.unsafe_get_pointer();
+    word_t* tmp_ptr = tmp.unsafe_get_pointer();
+    word_t* data_ptr = m_data.unsafe_get_pointer();
     uint32_t* at_indices_ptr = at_indices.unsafe_get_pointer();
     
-    std::memset(tmp_ptr, 0u, new_data_size * sizeof(uint32_t));
+    std::memset(tmp_ptr, 0u, new_data_size * sizeof(word_t));
     
     for (uint32_t i = 0; i < new_size; i++)
     {
         uint32_t idx = at_indices_ptr[i] + index_offset;
-        uint32_t datum = data_ptr[get_bin(idx)];
+        word_t datum = data_ptr[get_bin(idx)];
         uint32_t bit = get_bit(idx);
         uint32_t into_bin = get_bin(i);
         uint32_t into_bit = get_bit(i);
         
-        bool res = datum & (1u << bit);
+        bool res = datum & (word_t(1) << bit);
         
         if (res)
         {
-            tmp_ptr[into_bin] |= (1u << into_bit);
+            tmp_ptr[into_bin] |= (word_t(1) << into_bit);
         }
     }
     
@@ -184,10 +450,82 @@ void util::bit_array::unchecked_keep(const util::dynamic_array<uint32_t> &at_ind
     m_size = new_size;
 }
 
-bool util::bit_array::assign_true(const util::dynamic_array<uint32_t> &at_indices, int32_t index_offset)
+template<typename W>
+void util::basic_bit_array<W>::compress(const util::basic_bit_array<W>& mask)
+{
+    if (mask.size() != m_size)
+    {
+        throw std::runtime_error("Dimension mismatch.");
+    }
+    
+    unchecked_compress(mask);
+}
+
+template<typename W>
+void util::basic_bit_array<W>::unchecked_compress(const util::basic_bit_array<W>& mask)
+{
+    m_version++;
+    
+    uint32_t data_size = get_data_size(m_size);
+    
+    if (data_size == 0)
+    {
+        return;
+    }
+    
+    typedef word_kernels<W> kernels;
+    
+    word_t* data = m_data.unsafe_get_pointer();
+    word_t* mask_data = mask.m_data.unsafe_get_pointer();
+    
+    //  bits of the final mask word past the end of the array are not
+    //  guaranteed to be zero, so the final word is packed separately.
+    word_t last_mask = mask.get_final_bin_with_zeros(mask_data, data_size);
+    word_t last_datum = data[data_size-1];
+    word_t last_packed = 0;
+    
+    uint64_t n_packed = kernels::compress(data, data, mask_data, data_size - 1);
+    uint64_t n_last = kernels::compress(&last_packed, &last_datum, &last_mask, 1);
+    
+    uint32_t new_size = uint32_t(n_packed + n_last);
+    
+    if (new_size == 0)
+    {
+        empty();
+        return;
+    }
+    
+    if (n_last > 0)
+    {
+        uint32_t bin = get_bin(uint32_t(n_packed));
+        uint32_t bit = get_bit(uint32_t(n_packed));
+        
+        if (bit == 0)
+        {
+            data[bin] = last_packed;
+        }
+        else
+        {
+            data[bin] |= last_packed << bit;
+            
+            if (bit + n_last > BITS)
+            {
+                data[bin+1] = last_packed >> (BITS - bit);
+            }
+        }
+    }
+    
+    m_size = new_size;
+    m_data.resize(get_data_size(new_size));
+}
+
+template<typename W>
+bool util::basic_bit_array<W>::assign_true(const util::dynamic_array<uint32_t> &at_indices, int32_t index_offset)
 {
+    m_version++;
+    
     uint32_t* at_indices_data = at_indices.unsafe_get_pointer();
-    uint32_t* own_data = m_data.unsafe_get_pointer();
+    word_t* own_data = m_data.unsafe_get_pointer();
     uint32_t indices_size = at_indices.tail();
     
     for (uint32_t i = 0; i < indices_size; i++)
@@ -202,17 +540,20 @@ bool util::bit_array::assign_true(const util::dynamic_array<uint32_t> &at_indice
         uint32_t bin = get_bin(idx);
         uint32_t bit = get_bit(idx);
         
-        own_data[bin] |= (1u << bit);
+        own_data[bin] |= (word_t(1) << bit);
     }
     
     return true;
 }
 
 
-void util::bit_array::unchecked_assign_true(const util::dynamic_array<uint32_t> &at_indices, int32_t index_offset)
+template<typename W>
+void util::basic_bit_array<W>::unchecked_assign_true(const util::dynamic_array<uint32_t> &at_indices, int32_t index_offset)
 {
+    m_version++;
+    
     uint32_t* at_indices_data = at_indices.unsafe_get_pointer();
-    uint32_t* own_data = m_data.unsafe_get_pointer();
+    word_t* own_data = m_data.unsafe_get_pointer();
     uint32_t indices_size = at_indices.tail();
     
     for (uint32_t i = 0; i < indices_size; i++)
@@ -221,12 +562,15 @@ void util::bit_array::unchecked_assign_true(const util::dynamic_array<uint32_t>
         uint32_t bin = get_bin(idx);
         uint32_t bit = get_bit(idx);
         
-        own_data[bin] |= (1u << bit);
+        own_data[bin] |= (word_t(1) << bit);
     }
 }
 
-void util::bit_array::append(const util::bit_array &other)
+template<typename W>
+void util::basic_bit_array<W>::append(const util::basic_bit_array<W> &other)
 {
+    m_version++;
+    
     if (other.m_size == 0)
     {
         return;
@@ -238,63 +582,98 @@ void util::bit_array::append(const util::bit_array &other)
         return;
     }
     
-    uint32_t other_orig_data_size = other.m_data.size();
-    uint32_t orig_data_size = m_data.size();
-    uint32_t new_data_size = orig_data_size + other_orig_data_size;
-    uint32_t orig_size = m_size;
+    //  the funnel shift may not read from the array it writes to
+    if (&other == this)
+    {
+        util::basic_bit_array<W> copy(other);
+        append(copy);
+        return;
+    }
     
-    m_data.resize(new_data_size);
+    uint32_t orig_size = m_size;
+    uint32_t orig_data_size = get_data_size(orig_size);
+    uint32_t new_data_size = get_data_size(orig_size + other.m_size);
     
-    uint32_t* m_data_ptr = m_data.unsafe_get_pointer();
-    uint32_t* other_data_ptr = other.m_data.unsafe_get_pointer();
+    word_t* data = m_data.unsafe_get_pointer();
     
-    uint32_t last_bit = get_bit(orig_size);
+    data[orig_data_size-1] = get_final_bin_with_zeros(data, orig_data_size);
     
-    uint32_t orig_tail = get_data_size(orig_size);
-    uint32_t other_tail = get_data_size(other.m_size);
+    if (m_data.size() < new_data_size)
+    {
+        m_data.resize(new_data_size);
+    }
     
     m_size += other.m_size;
     
-    //  fast copy of elements if they're already aligned.
-    if (last_bit == 0)
+    unchecked_copy_at(orig_size, other);
+}
+
+template<typename W>
+void util::basic_bit_array<W>::concat(util::basic_bit_array<W>& out, const std::vector<const util::basic_bit_array<W>*>& arrays)
+{
+    uint64_t total_size = 0;
+    
+    for (const util::basic_bit_array<W>* arr : arrays)
     {
-        std::memcpy(&m_data_ptr[orig_tail], other_data_ptr, other_tail * sizeof(uint32_t));
-        return;
+        total_size += arr->m_size;
     }
     
-    std::memset(&m_data_ptr[orig_tail], 0u, other_tail * sizeof(uint32_t));
+    if (total_size > uint64_t(~uint32_t(0)))
+    {
+        throw std::runtime_error("Concatenated size exceeds maximum array size.");
+    }
     
-    uint32_t bit_offset = m_size_int - last_bit;
+    unchecked_concat(out, arrays.data(), uint32_t(arrays.size()));
+}
+
+template<typename W>
+void util::basic_bit_array<W>::unchecked_concat(util::basic_bit_array<W>& out, const util::basic_bit_array<W>* const* arrays, uint32_t n_arrays)
+{
+    out.m_version++;
     
-    //  fill remaining elements in final bin with 0
-    uint32_t last_bin0 = ~(0u) >> bit_offset;
+    uint32_t total_size = 0;
     
-    m_data_ptr[orig_tail-1] &= last_bin0;
-
-    for (uint32_t i = 0; i < other_tail; i++)
+    for (uint32_t i = 0; i < n_arrays; i++)
     {
-        uint32_t other0 = other_data_ptr[i];
-        uint32_t other1 = other0;
-
-        other0 = other0 << last_bit;
-        other1 = other1 >> bit_offset;
-
-        m_data_ptr[orig_tail + i - 1] |= other0;
-        m_data_ptr[orig_tail + i] |= other1;
+        total_size += arrays[i]->m_size;
+    }
+    
+    //  every word is written by exactly one input, so the result is not
+    //  zero-filled first.
+    util::basic_bit_array<W> result(total_size);
+    uint32_t offset = 0;
+    
+    for (uint32_t i = 0; i < n_arrays; i++)
+    {
+        if (arrays[i]->m_size == 0)
+        {
+            continue;
+        }
+        
+        result.unchecked_copy_at(offset, *arrays[i]);
+        offset += arrays[i]->m_size;
     }
+    
+    out = std::move(result);
 }
 
-void util::bit_array::fill(bool with)
+template<typename W>
+void util::basic_bit_array<W>::fill(bool with)
 {
-    uint32_t fill_with = with ? ~(0u) : 0u;
+    m_version++;
+    
+    int fill_with = with ? 0xff : 0;
     uint32_t fill_to = get_data_size(m_size);
-    std::memset(m_data.unsafe_get_pointer(), fill_with, fill_to * sizeof(uint32_t));
+    std::memset(m_data.unsafe_get_pointer(), fill_with, fill_to * sizeof(word_t));
 }
 
-void util::bit_array::flip()
+template<typename W>
+void util::basic_bit_array<W>::flip()
 {
+    m_version++;
+    
     uint32_t data_size = get_data_size(m_size);
-    uint32_t* data = m_data.unsafe_get_pointer();
+    word_t* data = m_data.unsafe_get_pointer();
     
     for (uint32_t i = 0; i < data_size; i++)
     {
@@ -302,15 +681,17 @@ void util::bit_array::flip()
     }
 }
 
-bool util::bit_array::at(uint32_t index) const
+template<typename W>
+bool util::basic_bit_array<W>::at(uint32_t index) const
 {
     uint32_t bin = get_bin(index);
     uint32_t bit = get_bit(index);
     
-    return m_data.at(bin) & (1 << bit);
+    return m_data.at(bin) & (word_t(1) << bit);
 }
 
-uint32_t util::bit_array::sum() const
+template<typename W>
+uint32_t util::basic_bit_array<W>::sum() const
 {
     
     if (m_size == 0)
@@ -318,25 +699,24 @@ uint32_t util::bit_array::sum() const
         return 0u;
     }
     
-    uint32_t c_sum = 0;
     uint32_t data_size = get_data_size(m_size);
-    uint32_t* data = m_data.unsafe_get_pointer();
+    word_t* data = m_data.unsafe_get_pointer();
     
-    for (size_t i = 0; i < data_size-1; i++)
-    {
-        c_sum += util::bit_array::bit_sum(data[i]);
-    }
+    uint32_t c_sum = uint32_t(word_kernels<W>::popcount(data, data_size-1));
     
     //  only sum the active values in the final bin
-    uint32_t last_datum = get_final_bin_with_zeros(data, data_size);
+    word_t last_datum = get_final_bin_with_zeros(data, data_size);
     
-    c_sum += util::bit_array::bit_sum(last_datum);
+    c_sum += util::basic_bit_array<W>::bit_sum(last_datum);
     
     return c_sum;
 }
 
-void util::bit_array::resize(uint32_t to_size)
+template<typename W>
+void util::basic_bit_array<W>::resize(uint32_t to_size)
 {
+    m_version++;
+    
     if (to_size == m_size)
     {
         return;
@@ -346,7 +726,7 @@ void util::bit_array::resize(uint32_t to_size)
     uint32_t new_data_size = get_data_size(to_size);
     uint32_t orig_size = m_size;
     
-    uint32_t* data = m_data.unsafe_get_pointer();
+    word_t* data = m_data.unsafe_get_pointer();
     
     if (c_data_size > 0)
     {
@@ -371,167 +751,552 @@ void util::bit_array::resize(uint32_t to_size)
     
     uint32_t n_set = new_data_size - c_data_size;
     
-    std::memset(data + c_data_size, 0u, n_set * sizeof(uint32_t));
+    std::memset(data + c_data_size, 0u, n_set * sizeof(word_t));
+}
+
+//  unchecked_copy_at: Copy the bits of `src` to [at_index, at_index +
+//      src.size()). Bits from `at_index` to the end of its word must be zero;
+//      bits of the final word written past the end of the copy are zeroed.
+
+template<typename W>
+void util::basic_bit_array<W>::unchecked_copy_at(uint32_t at_index, const util::basic_bit_array<W>& src)
+{
+    m_version++;
+    
+    uint32_t n_words = src.get_data_size(src.m_size);
+    
+    if (n_words == 0)
+    {
+        return;
+    }
+    
+    word_t* data = m_data.unsafe_get_pointer();
+    const word_t* src_data = src.m_data.unsafe_get_pointer();
+    
+    uint64_t stop = uint64_t(at_index) + src.m_size;
+    uint32_t bin = get_bin(at_index);
+    uint32_t bit = get_bit(at_index);
+    uint32_t last_bin = uint32_t((stop - 1) >> SHIFT);
+    uint32_t last_bit = uint32_t(stop & MASK);
+    
+    if (bit == 0)
+    {
+        std::memcpy(data + bin, src_data, n_words * sizeof(word_t));
+    }
+    else
+    {
+        word_t carry = word_kernels<W>::funnel_shift(data + bin, src_data, n_words, bit);
+        
+        if (bin + n_words == last_bin)
+        {
+            data[last_bin] = carry;
+        }
+    }
+    
+    if (last_bit != 0)
+    {
+        data[last_bin] &= ~word_t(0) >> (BITS - last_bit);
+    }
 }
 
-uint32_t util::bit_array::size() const
+template<typename W>
+uint32_t util::basic_bit_array<W>::size() const
 {
     return m_size;
 }
 
-uint32_t util::bit_array::get_bin(uint32_t index) const
+template<typename W>
+uint32_t util::basic_bit_array<W>::get_bin(uint32_t index)
 {
-    return index / m_size_int;
+    return index >> SHIFT;
 }
 
-uint32_t util::bit_array::get_bit(uint32_t index) const
+template<typename W>
+uint32_t util::basic_bit_array<W>::get_bit(uint32_t index)
 {
-    return index % m_size_int;
+    return index & MASK;
 }
 
-uint32_t util::bit_array::get_final_bin_with_zeros() const
+template<typename W>
+typename util::basic_bit_array<W>::word_t util::basic_bit_array<W>::get_final_bin_with_zeros() const
 {
     uint32_t data_size = get_data_size(m_size);
-    uint32_t* data = m_data.unsafe_get_pointer();
+    word_t* data = m_data.unsafe_get_pointer();
     
     return get_final_bin_with_zeros(data, data_size);
 }
 
-uint32_t util::bit_array::get_final_bin_with_zeros(uint32_t *data, uint32_t data_size) const
+template<typename W>
+typename util::basic_bit_array<W>::word_t util::basic_bit_array<W>::get_final_bin_with_zeros(word_t *data, uint32_t data_size) const
 {
-    uint32_t bit_offset = m_size_int - get_bit(m_size);
+    uint32_t last_bit = get_bit(m_size);
+    word_t last_datum = data[data_size-1];
+    
+    //  final bin is full
+    if (last_bit == 0)
+    {
+        return last_datum;
+    }
     
-    uint32_t last_bin0 = ~(0u) >> bit_offset;
-    uint32_t last_datum = data[data_size-1];
+    word_t last_bin0 = ~word_t(0) >> (BITS - last_bit);
     
     last_datum &= last_bin0;
     
     return last_datum;
 }
 
-uint32_t util::bit_array::get_data_size(uint32_t n_elements) const
+//  get_last_mask: Bits of the final word that are within the array.
+
+template<typename W>
+typename util::basic_bit_array<W>::word_t util::basic_bit_array<W>::get_last_mask() const
 {
-    double res = double(n_elements) / double(m_size_int);
-    return uint32_t(std::ceil(res));
+    uint32_t last_bit = get_bit(m_size);
+    
+    return last_bit == 0 ? ~word_t(0) : ~word_t(0) >> (BITS - last_bit);
 }
 
-uint32_t util::bit_array::get_size_int() const
+template<typename W>
+uint32_t util::basic_bit_array<W>::get_data_size(uint32_t n_elements)
 {
-    return sizeof(uint32_t) * 8u;
+    return uint32_t((uint64_t(n_elements) + MASK) >> SHIFT);
 }
 
-bool util::bit_array::all_bits_set(uint32_t value, uint32_t n)
+template<typename W>
+bool util::basic_bit_array<W>::all_bits_set(word_t value, uint32_t n)
 {
-    uint32_t mask = (1 << n) - 1;
+    word_t mask = n >= sizeof(word_t) * 8u ? ~word_t(0) : (word_t(1) << n) - 1;
     value &= mask;
     return value == mask;
 }
 
-uint32_t util::bit_array::bit_sum(uint32_t i)
+template<typename W>
+uint32_t util::basic_bit_array<W>::bit_sum(word_t i)
 {
     //  https://stackoverflow.com/questions/109023/how-to-count-the-number-of-set-bits-in-a-32-bit-integer
-    i = i - ((i >> 1) & 0x55555555);
-    i = (i & 0x33333333) + ((i >> 2) & 0x33333333);
-    return (((i + (i >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+    i = i - ((i >> 1) & 0x5555555555555555ull);
+    i = (i & 0x3333333333333333ull) + ((i >> 2) & 0x3333333333333333ull);
+    return uint32_t((((i + (i >> 4)) & 0x0F0F0F0F0F0F0F0Full) * 0x0101010101010101ull) >> 56);
 }
 
-void util::bit_array::unchecked_dot_or(util::bit_array &out,
-                                       const util::bit_array &a,
-                                       const util::bit_array &b,
-                                       uint32_t start,
-                                       uint32_t stop)
+//  get_range_mask: Bits of the `bin_offset`-th bin spanned by [start, stop)
+//      that lie inside the range.
+
+template<typename W>
+typename util::basic_bit_array<W>::word_t util::basic_bit_array<W>::get_range_mask(const util::basic_bit_array<W>& a, uint32_t start,
+                                                                                   uint32_t stop, uint32_t bin_offset)
 {
-    uint32_t first_bin = a.get_bin(start);
-    uint32_t last_bit = a.get_bit(stop);
-    uint32_t last_bin = last_bit == 0u ? a.get_bin(stop-1) : a.get_bin(stop);
+    uint32_t bin = a.get_bin(start) + bin_offset;
+    uint32_t bin_start = bin * BITS;
+    word_t mask = ~word_t(0);
     
-    uint32_t* a_data = a.m_data.unsafe_get_pointer();
-    uint32_t* b_data = b.m_data.unsafe_get_pointer();
-    uint32_t* out_data = out.m_data.unsafe_get_pointer();
+    if (start > bin_start)
+    {
+        mask &= ~word_t(0) << (start - bin_start);
+    }
     
-    for (size_t i = first_bin; i <= last_bin; i++)
+    if (stop < bin_start + BITS)
     {
-        out_data[i] = a_data[i] | b_data[i];
+        mask &= ~(~word_t(0) << (stop - bin_start));
     }
+    
+    return mask;
 }
 
-void util::bit_array::unchecked_dot_and(util::bit_array &out,
-                                        const util::bit_array &a,
-                                        const util::bit_array &b,
-                                        uint32_t start,
-                                        uint32_t stop)
+//  get_bin_range: Bins spanned by bits [start, stop).
+//
+//      Returns false if the range is empty.
+
+template<typename W>
+bool util::basic_bit_array<W>::get_bin_range(const util::basic_bit_array<W>& a, uint32_t start, uint32_t stop,
+                                             uint32_t* first_bin, uint32_t* n_bins)
 {
-    uint32_t first_bin = a.get_bin(start);
-    uint32_t last_bit = a.get_bit(stop);
-    uint32_t last_bin = last_bit == 0u ? a.get_bin(stop-1) : a.get_bin(stop);
-    
-    uint32_t* a_data = a.m_data.unsafe_get_pointer();
-    uint32_t* b_data = b.m_data.unsafe_get_pointer();
-    uint32_t* out_data = out.m_data.unsafe_get_pointer();
-    
-    for (size_t i = first_bin; i <= last_bin; i++)
+    if (stop <= start)
     {
-        out_data[i] = a_data[i] & b_data[i];
+        return false;
     }
+    
+    *first_bin = a.get_bin(start);
+    *n_bins = a.get_bin(stop-1) - *first_bin + 1;
+    
+    return true;
 }
 
-void util::bit_array::unchecked_dot_and_not(util::bit_array &out,
-                                        const util::bit_array &a,
-                                        const util::bit_array &b,
-                                        uint32_t start,
-                                        uint32_t stop)
+//  get_padded_bins: If bins [first_bin, first_bin + n_bins) run to the end
+//      of `out`, extend them into the allocation padding shared by all three
+//      arrays, so that whole-array kernels end on a full vector.
+
+template<typename W>
+uint32_t util::basic_bit_array<W>::get_padded_bins(const util::basic_bit_array<W>& out, const util::basic_bit_array<W>& a,
+                                                   const util::basic_bit_array<W>& b, uint32_t first_bin, uint32_t n_bins)
 {
-    uint32_t first_bin = a.get_bin(start);
-    uint32_t last_bit = a.get_bit(stop);
-    uint32_t last_bin = last_bit == 0u ? a.get_bin(stop-1) : a.get_bin(stop);
-    
-    uint32_t* a_data = a.m_data.unsafe_get_pointer();
-    uint32_t* b_data = b.m_data.unsafe_get_pointer();
-    uint32_t* out_data = out.m_data.unsafe_get_pointer();
+    uint32_t stop_bin = first_bin + n_bins;
     
-    for (size_t i = first_bin; i <= last_bin; i++)
+    if (stop_bin < out.m_data.size())
     {
-        out_data[i] = a_data[i] & ~(b_data[i]);
+        return n_bins;
     }
+    
+    uint32_t padded = allocator_t::padded_size(out.m_data.size());
+    
+    padded = std::min(padded, allocator_t::padded_size(a.m_data.size()));
+    padded = std::min(padded, allocator_t::padded_size(b.m_data.size()));
+    
+    return padded > stop_bin ? padded - first_bin : n_bins;
 }
 
-void util::bit_array::unchecked_dot_eq(util::bit_array &out,
-                                        const util::bit_array &a,
-                                        const util::bit_array &b,
-                                        uint32_t start,
-                                        uint32_t stop)
+template<typename W>
+void util::basic_bit_array<W>::unchecked_dot_or(util::basic_bit_array<W> &out,
+                                                const util::basic_bit_array<W> &a,
+                                                const util::basic_bit_array<W> &b,
+                                                uint32_t start,
+                                                uint32_t stop)
 {
-    uint32_t first_bin = a.get_bin(start);
-    uint32_t last_bit = a.get_bit(stop);
-    uint32_t last_bin = last_bit == 0u ? a.get_bin(stop-1) : a.get_bin(stop);
+    out.m_version++;
     
-    uint32_t* a_data = a.m_data.unsafe_get_pointer();
-    uint32_t* b_data = b.m_data.unsafe_get_pointer();
-    uint32_t* out_data = out.m_data.unsafe_get_pointer();
+    uint32_t first_bin;
+    uint32_t n_bins;
     
-    for (size_t i = first_bin; i <= last_bin; i++)
+    if (!get_bin_range(a, start, stop, &first_bin, &n_bins))
     {
-        out_data[i] = ~(a_data[i] ^ b_data[i]);
+        return;
     }
+    
+    word_t* a_data = a.m_data.unsafe_get_pointer();
+    word_t* b_data = b.m_data.unsafe_get_pointer();
+    word_t* out_data = out.m_data.unsafe_get_pointer();
+    
+    n_bins = get_padded_bins(out, a, b, first_bin, n_bins);
+    
+    word_kernels<W>::dot_or(out_data + first_bin, a_data + first_bin, b_data + first_bin, n_bins);
 }
 
-void util::bit_array::dot_or(util::bit_array &out,
-                             const util::bit_array &a,
-                             const util::bit_array &b)
+template<typename W>
+void util::basic_bit_array<W>::unchecked_dot_and(util::basic_bit_array<W> &out,
+                                                 const util::basic_bit_array<W> &a,
+                                                 const util::basic_bit_array<W> &b,
+                                                 uint32_t start,
+                                                 uint32_t stop)
 {
-    binary_check_dimensions(out, a, b);
-    unchecked_dot_or(out, a, b, 0, a.m_size);
+    out.m_version++;
+    
+    uint32_t first_bin;
+    uint32_t n_bins;
+    
+    if (!get_bin_range(a, start, stop, &first_bin, &n_bins))
+    {
+        return;
+    }
+    
+    word_t* a_data = a.m_data.unsafe_get_pointer();
+    word_t* b_data = b.m_data.unsafe_get_pointer();
+    word_t* out_data = out.m_data.unsafe_get_pointer();
+    
+    n_bins = get_padded_bins(out, a, b, first_bin, n_bins);
+    
+    word_kernels<W>::dot_and(out_data + first_bin, a_data + first_bin, b_data + first_bin, n_bins);
 }
 
-void util::bit_array::dot_and(util::bit_array &out,
-                             const util::bit_array &a,
-                             const util::bit_array &b)
+template<typename W>
+void util::basic_bit_array<W>::unchecked_dot_and_not(util::basic_bit_array<W> &out,
+                                                     const util::basic_bit_array<W> &a,
+                                                     const util::basic_bit_array<W> &b,
+                                                     uint32_t start,
+                                                     uint32_t stop)
 {
-    binary_check_dimensions(out, a, b);
-    unchecked_dot_and(out, a, b, 0, a.m_size);
-}
+    out.m_version++;
+    
+    uint32_t first_bin;
+    uint32_t n_bins;
+    
+    if (!get_bin_range(a, start, stop, &first_bin, &n_bins))
+    {
+        return;
+    }
+    
+    word_t* a_data = a.m_data.unsafe_get_pointer();
+    word_t* b_data = b.m_data.unsafe_get_pointer();
+    word_t* out_data = out.m_data.unsafe_get_pointer();
+    
+    n_bins = get_padded_bins(out, a, b, first_bin, n_bins);
+    
+    word_kernels<W>::dot_and_not(out_data + first_bin, a_data + first_bin, b_data + first_bin, n_bins);
+}
+
+template<typename W>
+void util::basic_bit_array<W>::unchecked_dot_eq(util::basic_bit_array<W> &out,
+                                                const util::basic_bit_array<W> &a,
+                                                const util::basic_bit_array<W> &b,
+                                                uint32_t start,
+                                                uint32_t stop)
+{
+    out.m_version++;
+    
+    uint32_t first_bin;
+    uint32_t n_bins;
+    
+    if (!get_bin_range(a, start, stop, &first_bin, &n_bins))
+    {
+        return;
+    }
+    
+    word_t* a_data = a.m_data.unsafe_get_pointer();
+    word_t* b_data = b.m_data.unsafe_get_pointer();
+    word_t* out_data = out.m_data.unsafe_get_pointer();
+    
+    n_bins = get_padded_bins(out, a, b, first_bin, n_bins);
+    
+    word_kernels<W>::dot_eq(out_data + first_bin, a_data + first_bin, b_data + first_bin, n_bins);
+}
+
+template<typename W>
+uint32_t util::basic_bit_array<W>::unchecked_and_count(const util::basic_bit_array<W> &a,
+                                                       const util::basic_bit_array<W> &b,
+                                                       uint32_t start,
+                                                       uint32_t stop)
+{
+    uint32_t first_bin;
+    uint32_t n_bins;
+    
+    if (!get_bin_range(a, start, stop, &first_bin, &n_bins))
+    {
+        return 0u;
+    }
+    
+    word_t* a_data = a.m_data.unsafe_get_pointer() + first_bin;
+    word_t* b_data = b.m_data.unsafe_get_pointer() + first_bin;
+    
+    uint64_t c_sum = word_kernels<W>::and_count(a_data, b_data, n_bins);
+    
+    //  remove bits of the first and last bins that fall outside [start, stop)
+    word_t outside_first = ~get_range_mask(a, start, stop, 0u);
+    word_t outside_last = ~get_range_mask(a, start, stop, n_bins-1);
+    
+    c_sum -= bit_sum(a_data[0] & b_data[0] & outside_first);
+    
+    if (n_bins > 1)
+    {
+        c_sum -= bit_sum(a_data[n_bins-1] & b_data[n_bins-1] & outside_last);
+    }
+    
+    return uint32_t(c_sum);
+}
+
+template<typename W>
+uint32_t util::basic_bit_array<W>::unchecked_and_not_count(const util::basic_bit_array<W> &a,
+                                                           const util::basic_bit_array<W> &b,
+                                                           uint32_t start,
+                                                           uint32_t stop)
+{
+    uint32_t first_bin;
+    uint32_t n_bins;
+    
+    if (!get_bin_range(a, start, stop, &first_bin, &n_bins))
+    {
+        return 0u;
+    }
+    
+    word_t* a_data = a.m_data.unsafe_get_pointer() + first_bin;
+    word_t* b_data = b.m_data.unsafe_get_pointer() + first_bin;
+    
+    uint64_t c_sum = word_kernels<W>::and_not_count(a_data, b_data, n_bins);
+    
+    word_t outside_first = ~get_range_mask(a, start, stop, 0u);
+    word_t outside_last = ~get_range_mask(a, start, stop, n_bins-1);
+    
+    c_sum -= bit_sum(a_data[0] & ~b_data[0] & outside_first);
+    
+    if (n_bins > 1)
+    {
+        c_sum -= bit_sum(a_data[n_bins-1] & ~b_data[n_bins-1] & outside_last);
+    }
+    
+    return uint32_t(c_sum);
+}
+
+template<typename W>
+uint32_t util::basic_bit_array<W>::and_count(const util::basic_bit_array<W> &a, const util::basic_bit_array<W> &b)
+{
+    if (a.size() != b.size())
+    {
+        throw std::runtime_error("Dimension mismatch.");
+    }
+    
+    return unchecked_and_count(a, b, 0, a.m_size);
+}
+
+template<typename W>
+uint32_t util::basic_bit_array<W>::and_not_count(const util::basic_bit_array<W> &a, const util::basic_bit_array<W> &b)
+{
+    if (a.size() != b.size())
+    {
+        throw std::runtime_error("Dimension mismatch.");
+    }
+    
+    return unchecked_and_not_count(a, b, 0, a.m_size);
+}
+
+template<typename W>
+bool util::basic_bit_array<W>::intersects(const util::basic_bit_array<W>& a, const util::basic_bit_array<W>& b)
+{
+    if (a.size() != b.size())
+    {
+        throw std::runtime_error("Dimension mismatch.");
+    }
+    
+    return unchecked_intersects(a, b);
+}
+
+template<typename W>
+bool util::basic_bit_array<W>::unchecked_intersects(const util::basic_bit_array<W>& a, const util::basic_bit_array<W>& b)
+{
+    uint32_t data_size = get_data_size(a.m_size);
+    
+    if (data_size == 0)
+    {
+        return false;
+    }
+    
+    const word_t* a_data = a.m_data.unsafe_get_pointer();
+    const word_t* b_data = b.m_data.unsafe_get_pointer();
+    
+    uint32_t n_full = data_size - 1;
+    
+    for (uint32_t i = 0; i < n_full; i += INTERSECT_BLOCK_SIZE)
+    {
+        uint32_t n_words = std::min(uint32_t(INTERSECT_BLOCK_SIZE), n_full - i);
+        
+        if (word_kernels<W>::and_count(a_data + i, b_data + i, n_words) > 0)
+        {
+            return true;
+        }
+    }
+    
+    return (a.get_final_bin_with_zeros() & b_data[n_full]) != 0;
+}
+
+template<typename W>
+bool util::basic_bit_array<W>::intersects_not(const util::basic_bit_array<W>& a, const util::basic_bit_array<W>& b)
+{
+    if (a.size() != b.size())
+    {
+        throw std::runtime_error("Dimension mismatch.");
+    }
+    
+    return unchecked_intersects_not(a, b);
+}
+
+template<typename W>
+bool util::basic_bit_array<W>::unchecked_intersects_not(const util::basic_bit_array<W>& a, const util::basic_bit_array<W>& b)
+{
+    uint32_t data_size = get_data_size(a.m_size);
+    
+    if (data_size == 0)
+    {
+        return false;
+    }
+    
+    const word_t* a_data = a.m_data.unsafe_get_pointer();
+    const word_t* b_data = b.m_data.unsafe_get_pointer();
+    
+    uint32_t n_full = data_size - 1;
+    
+    for (uint32_t i = 0; i < n_full; i += INTERSECT_BLOCK_SIZE)
+    {
+        uint32_t n_words = std::min(uint32_t(INTERSECT_BLOCK_SIZE), n_full - i);
+        
+        if (word_kernels<W>::and_not_count(a_data + i, b_data + i, n_words) > 0)
+        {
+            return true;
+        }
+    }
+    
+    return (a.get_final_bin_with_zeros() & ~b_data[n_full]) != 0;
+}
+
+template<typename W>
+bool util::basic_bit_array<W>::intersects_many(const std::vector<const util::basic_bit_array<W>*>& operands)
+{
+    if (operands.empty())
+    {
+        return false;
+    }
+    
+    const basic_bit_array& first = *operands[0];
+    
+    many_check_dimensions(first, operands);
+    
+    if (operands.size() == 1)
+    {
+        return first.any();
+    }
+    
+    if (operands.size() == 2)
+    {
+        return unchecked_intersects(first, *operands[1]);
+    }
+    
+    uint32_t data_size = get_data_size(first.m_size);
+    
+    if (data_size == 0)
+    {
+        return false;
+    }
+    
+    uint32_t n_full = data_size - 1;
+    uint32_t n_operands = uint32_t(operands.size());
+    word_t block[INTERSECT_BLOCK_SIZE];
+    
+    for (uint32_t i = 0; i < n_full; i += INTERSECT_BLOCK_SIZE)
+    {
+        uint32_t n_words = std::min(uint32_t(INTERSECT_BLOCK_SIZE), n_full - i);
+        
+        word_kernels<W>::dot_and(block, first.m_data.unsafe_get_pointer() + i,
+                                 operands[1]->m_data.unsafe_get_pointer() + i, n_words);
+        
+        bool any = !all_zero(block, n_words);
+        
+        for (uint32_t j = 2; j < n_operands && any; j++)
+        {
+            word_kernels<W>::dot_and(block, block, operands[j]->m_data.unsafe_get_pointer() + i, n_words);
+            any = !all_zero(block, n_words);
+        }
+        
+        if (any)
+        {
+            return true;
+        }
+    }
+    
+    word_t last = first.get_final_bin_with_zeros();
+    
+    for (uint32_t j = 1; j < n_operands; j++)
+    {
+        last &= operands[j]->m_data.unsafe_get_pointer()[n_full];
+    }
+    
+    return last != 0;
+}
+
+template<typename W>
+void util::basic_bit_array<W>::dot_or(util::basic_bit_array<W> &out,
+                                      const util::basic_bit_array<W> &a,
+                                      const util::basic_bit_array<W> &b)
+{
+    binary_check_dimensions(out, a, b);
+    unchecked_dot_or(out, a, b, 0, a.m_size);
+}
+
+template<typename W>
+void util::basic_bit_array<W>::dot_and(util::basic_bit_array<W> &out,
+                                       const util::basic_bit_array<W> &a,
+                                       const util::basic_bit_array<W> &b)
+{
+    binary_check_dimensions(out, a, b);
+    unchecked_dot_and(out, a, b, 0, a.m_size);
+}
 
-bool util::bit_array::all() const
+template<typename W>
+bool util::basic_bit_array<W>::all() const
 {
     if (m_size == 0)
     {
@@ -541,11 +1306,11 @@ bool util::bit_array::all() const
     uint32_t last_bin = get_bin(m_size);
     uint32_t last_bit = get_bit(m_size);
 
-    uint32_t* a_data = m_data.unsafe_get_pointer();
+    word_t* a_data = m_data.unsafe_get_pointer();
 
     uint32_t stop_idx = last_bit == 0u ? last_bin-1 : last_bin;
-    uint32_t n_check_last = last_bit == 0u ? m_size_int : last_bit;
-    uint32_t one = ~(0u);
+    uint32_t n_check_last = last_bit == 0u ? BITS : last_bit;
+    word_t one = ~word_t(0);
     
     for (uint32_t i = 0; i < stop_idx; i++)
     {
@@ -555,19 +1320,20 @@ bool util::bit_array::all() const
         }
     }
     
-    uint32_t last_datum = get_final_bin_with_zeros(a_data, get_data_size(m_size));
+    word_t last_datum = get_final_bin_with_zeros(a_data, get_data_size(m_size));
     
-    return util::bit_array::bit_sum(last_datum) == n_check_last;
+    return util::basic_bit_array<W>::bit_sum(last_datum) == n_check_last;
 }
 
-bool util::bit_array::any() const
+template<typename W>
+bool util::basic_bit_array<W>::any() const
 {
     if (m_size == 0)
     {
         return false;
     }
     
-    uint32_t* a_data = m_data.unsafe_get_pointer();
+    word_t* a_data = m_data.unsafe_get_pointer();
     uint32_t data_size = get_data_size(m_size);
     
     for (uint32_t i = 0; i < data_size-1; i++)
@@ -579,14 +1345,15 @@ bool util::bit_array::any() const
     }
     
     //  make sure the bits beyond `m_size` are zeroed
-    uint32_t last_datum = get_final_bin_with_zeros(a_data, data_size);
+    word_t last_datum = get_final_bin_with_zeros(a_data, data_size);
     
     return last_datum != 0u;
 }
 
-void util::bit_array::binary_check_dimensions(const util::bit_array &out,
-                                              const util::bit_array &a,
-                                              const util::bit_array &b)
+template<typename W>
+void util::basic_bit_array<W>::binary_check_dimensions(const util::basic_bit_array<W> &out,
+                                                       const util::basic_bit_array<W> &a,
+                                                       const util::basic_bit_array<W> &b)
 {
     if (a.size() != b.size() || a.size() != out.size())
     {
@@ -594,77 +1361,610 @@ void util::bit_array::binary_check_dimensions(const util::bit_array &out,
     }
 }
 
-util::dynamic_array<uint32_t> util::bit_array::find(const util::bit_array &a, uint32_t index_offset)
+template<typename W>
+void util::basic_bit_array<W>::and_many(util::basic_bit_array<W>& out, const std::vector<const util::basic_bit_array<W>*>& operands)
+{
+    many_check_dimensions(out, operands);
+    
+    std::vector<uint32_t> group_sizes(operands.size(), 1u);
+    
+    unchecked_and_of_or_many(out, operands.data(), group_sizes.data(), uint32_t(group_sizes.size()));
+}
+
+template<typename W>
+void util::basic_bit_array<W>::or_many(util::basic_bit_array<W>& out, const std::vector<const util::basic_bit_array<W>*>& operands)
+{
+    many_check_dimensions(out, operands);
+    
+    uint32_t group_size = uint32_t(operands.size());
+    
+    unchecked_and_of_or_many(out, operands.data(), &group_size, 1u);
+}
+
+template<typename W>
+void util::basic_bit_array<W>::and_of_or_many(util::basic_bit_array<W>& out,
+                                              const std::vector<std::vector<const util::basic_bit_array<W>*>>& groups)
 {
-    uint32_t n_true = a.sum();
+    std::vector<const basic_bit_array*> operands;
+    std::vector<uint32_t> group_sizes;
+    
+    for (const auto& group : groups)
+    {
+        many_check_dimensions(out, group);
+        
+        operands.insert(operands.end(), group.begin(), group.end());
+        group_sizes.push_back(uint32_t(group.size()));
+    }
     
-    util::dynamic_array<uint32_t> result(n_true);
+    unchecked_and_of_or_many(out, operands.data(), group_sizes.data(), uint32_t(group_sizes.size()));
+}
+
+//  unchecked_and_of_or_many: AND of the OR of each group, computed one
+//      block of words at a time so that every operand is streamed once.
+//      Later groups are skipped for a block once its running AND is zero.
+
+template<typename W>
+void util::basic_bit_array<W>::unchecked_and_of_or_many(util::basic_bit_array<W>& out,
+                                                        const util::basic_bit_array<W>* const* operands,
+                                                        const uint32_t* group_sizes,
+                                                        uint32_t n_groups)
+{
+    out.m_version++;
     
-    if (n_true == 0)
+    if (n_groups == 0)
     {
-        return result;
+        out.fill(true);
+        return;
     }
     
-    uint32_t* result_ptr = result.unsafe_get_pointer();
+    and_of_or_words(out, operands, group_sizes, n_groups, 0, out.get_data_size(out.m_size));
+}
+
+//  and_of_or_words: unchecked_and_of_or_many over words [first_word,
+//      first_word + n_words_total) of `out`.
+
+template<typename W>
+void util::basic_bit_array<W>::and_of_or_words(util::basic_bit_array<W>& out,
+                                               const util::basic_bit_array<W>* const* operands,
+                                               const uint32_t* group_sizes,
+                                               uint32_t n_groups,
+                                               uint32_t first_word,
+                                               uint32_t n_words_total)
+{
+    typedef word_kernels<W> kernels;
     
-    uint32_t data_size = a.get_data_size(a.m_size);
-    uint32_t last_bit = a.get_bit(a.m_size);
-    uint32_t* data = a.m_data.unsafe_get_pointer();
-    uint32_t size_int = a.m_size_int;
-    uint32_t result_idx = 0;
+    uint32_t stop_word = first_word + n_words_total;
+    word_t* out_data = out.m_data.unsafe_get_pointer();
+    word_t group_block[MANY_BLOCK_SIZE];
+    
+    for (uint32_t i = first_word; i < stop_word; i += MANY_BLOCK_SIZE)
+    {
+        uint32_t n_words = std::min(uint32_t(MANY_BLOCK_SIZE), stop_word - i);
+        word_t* out_block = out_data + i;
+        const basic_bit_array* const* group = operands;
+        
+        for (uint32_t j = 0; j < n_groups; j++)
+        {
+            uint32_t group_size = group_sizes[j];
+            
+            if (group_size == 0)
+            {
+                std::memset(out_block, 0, n_words * sizeof(word_t));
+                break;
+            }
+            
+            const word_t* first = group[0]->m_data.unsafe_get_pointer() + i;
+            
+            if (j == 0)
+            {
+                //  the first group is or-ed directly into the output
+                std::memcpy(out_block, first, n_words * sizeof(word_t));
+                
+                for (uint32_t k = 1; k < group_size; k++)
+                {
+                    const word_t* operand = group[k]->m_data.unsafe_get_pointer() + i;
+                    kernels::dot_or(out_block, out_block, operand, n_words);
+                }
+            }
+            else if (group_size == 1)
+            {
+                kernels::dot_and(out_block, out_block, first, n_words);
+            }
+            else
+            {
+                std::memcpy(group_block, first, n_words * sizeof(word_t));
+                
+                for (uint32_t k = 1; k < group_size; k++)
+                {
+                    const word_t* operand = group[k]->m_data.unsafe_get_pointer() + i;
+                    kernels::dot_or(group_block, group_block, operand, n_words);
+                }
+                
+                kernels::dot_and(out_block, out_block, group_block, n_words);
+            }
+            
+            group += group_size;
+            
+            if (j + 1 < n_groups && all_zero(out_block, n_words))
+            {
+                break;
+            }
+        }
+    }
+}
+
+template<typename W>
+void util::basic_bit_array<W>::many_check_dimensions(const util::basic_bit_array<W>& out,
+                                                     const std::vector<const util::basic_bit_array<W>*>& operands)
+{
+    for (const basic_bit_array* operand : operands)
+    {
+        if (operand->size() != out.size())
+        {
+            throw std::runtime_error("Dimension mismatch.");
+        }
+    }
+}
+
+template<typename W>
+bool util::basic_bit_array<W>::all_zero(const word_t* data, uint32_t n_words)
+{
+    word_t any = 0u;
+    
+    for (uint32_t i = 0; i < n_words; i++)
+    {
+        any |= data[i];
+    }
+    
+    return any == 0u;
+}
+
+template<typename W>
+std::vector<typename util::basic_bit_array<W>::span> util::basic_bit_array<W>::occupied_spans(const util::basic_bit_array<W>& a)
+{
+    std::vector<span> spans;
+    uint32_t n_words = get_data_size(a.m_size);
+    
+    if (n_words == 0)
+    {
+        return spans;
+    }
+    
+    const word_t* data = a.m_data.unsafe_get_pointer();
+    word_t last = a.get_final_bin_with_zeros();
     
-    for (size_t i = 0; i < data_size; i++)
+    for (uint32_t i = 0; i < n_words; i += CACHE_LINE_WORDS)
     {
-        uint32_t datum = data[i];
+        uint32_t n_line = std::min(uint32_t(CACHE_LINE_WORDS), n_words - i);
+        bool is_final = i + n_line == n_words;
+        
+        //  bits of the final word past the end are not guaranteed to be zero
+        bool is_occupied = is_final ?
+            !all_zero(data + i, n_line - 1) || last != 0u : !all_zero(data + i, n_line);
         
-        if (datum == 0u)
+        if (!is_occupied)
         {
             continue;
         }
         
-        uint32_t stop_bit;
+        uint32_t start = i * BITS;
+        uint32_t stop = is_final ? a.m_size : (i + n_line) * BITS;
+        
+        if (!spans.empty() && spans.back().stop == start)
+        {
+            spans.back().stop = stop;
+        }
+        else
+        {
+            spans.push_back(span{ start, stop });
+        }
+    }
+    
+    return spans;
+}
+
+template<typename W>
+util::dynamic_array<uint32_t> util::basic_bit_array<W>::find(const util::basic_bit_array<W> &a,
+                                                             uint32_t index_offset, uint32_t size_hint)
+{
+    using util::bit_kernels::EXTRACT_SLACK;
+    
+    if (a.m_size == 0)
+    {
+        return util::dynamic_array<uint32_t>();
+    }
+    
+    typedef word_kernels<W> kernels;
+    
+    uint32_t data_size = a.get_data_size(a.m_size);
+    word_t* data = a.m_data.unsafe_get_pointer();
+    
+    //  make sure the bits beyond `m_size` are zeroed
+    word_t last_datum = a.get_final_bin_with_zeros(data, data_size);
+    
+    uint32_t capacity = size_hint > 0 ? size_hint : uint32_t(FIND_INITIAL_CAPACITY);
+    capacity = std::min(capacity, a.m_size);
+    
+    uint32_t n_found = 0;
+    uint32_t i = 0;
+    
+    util::dynamic_array<uint32_t> result(capacity + EXTRACT_SLACK);
+    
+    while (i < data_size)
+    {
+        const word_t* block;
+        uint32_t n_words;
         
         if (i < data_size - 1)
         {
-            stop_bit = a.m_size_int;
+            block = data + i;
+            n_words = std::min(uint32_t(FIND_BLOCK_SIZE), data_size - 1 - i);
         }
         else
         {
-            stop_bit = last_bit == 0 ? a.m_size_int : last_bit;
+            block = &last_datum;
+            n_words = 1;
         }
         
-        for (uint32_t j = 0; j < stop_bit; j++)
+        //  only count the block when its worst case might not fit
+        if (capacity - n_found < n_words * BITS)
         {
-            if (datum & (1u << j))
+            uint32_t required = n_found + uint32_t(kernels::popcount(block, n_words));
+            
+            if (required > capacity)
             {
-                result_ptr[result_idx] = (i * size_int) + j + index_offset;
-                result_idx++;
+                uint64_t grow_to = std::max(uint64_t(capacity) * 2, uint64_t(required));
+                capacity = uint32_t(std::min(grow_to, uint64_t(a.m_size)));
+                result.resize(capacity + EXTRACT_SLACK);
             }
         }
+        
+        uint32_t* dest = result.unsafe_get_pointer() + n_found;
+        n_found += kernels::extract(dest, block, n_words, i * BITS + index_offset);
+        
+        i += n_words;
+    }
+    
+    result.resize(n_found);
+    result.seek_tail_to_end();
+    
+    return result;
+}
+
+//
+//  parallel
+//
+
+template<typename W>
+bool util::basic_bit_array<W>::use_parallel(uint32_t n_elements)
+{
+    if (n_elements == 0 || n_elements < util::thread_pool::get_parallel_threshold())
+    {
+        return false;
+    }
+    
+    return util::thread_pool::shared().size() > 1;
+}
+
+//  get_word_blocks: Split `n_words` words into BLOCKS_PER_THREAD blocks per
+//      pool thread, each a whole number of cache lines. Returns the number
+//      of blocks.
+
+template<typename W>
+uint32_t util::basic_bit_array<W>::get_word_blocks(uint32_t n_words, uint32_t* block_size)
+{
+    uint32_t n_blocks = util::thread_pool::shared().size() * BLOCKS_PER_THREAD;
+    uint32_t n_lines = (n_words + CACHE_LINE_WORDS - 1) / CACHE_LINE_WORDS;
+    uint32_t lines_per_block = std::max(1u, (n_lines + n_blocks - 1) / n_blocks);
+    
+    *block_size = lines_per_block * CACHE_LINE_WORDS;
+    
+    return (n_words + *block_size - 1) / *block_size;
+}
+
+template<typename W>
+void util::basic_bit_array<W>::parallel_binary(util::basic_bit_array<W>& out,
+                                               const util::basic_bit_array<W>& a,
+                                               const util::basic_bit_array<W>& b,
+                                               void (*op)(word_t*, const word_t*, const word_t*, size_t))
+{
+    out.m_version++;
+    
+    binary_check_dimensions(out, a, b);
+    
+    uint32_t n_words = get_data_size(a.m_size);
+    
+    word_t* out_data = out.m_data.unsafe_get_pointer();
+    const word_t* a_data = a.m_data.unsafe_get_pointer();
+    const word_t* b_data = b.m_data.unsafe_get_pointer();
+    
+    if (!use_parallel(a.m_size))
+    {
+        if (n_words > 0)
+        {
+            op(out_data, a_data, b_data, n_words);
+        }
+        
+        return;
+    }
+    
+    uint32_t block_size;
+    uint32_t n_blocks = get_word_blocks(n_words, &block_size);
+    
+    auto task = [&] (uint32_t block) -> void {
+        uint32_t first = block * block_size;
+        uint32_t n = std::min(block_size, n_words - first);
+        
+        op(out_data + first, a_data + first, b_data + first, n);
+    };
+    
+    util::thread_pool::shared().run(n_blocks, task);
+}
+
+template<typename W>
+void util::basic_bit_array<W>::parallel_dot_or(util::basic_bit_array<W>& out,
+                                               const util::basic_bit_array<W>& a,
+                                               const util::basic_bit_array<W>& b)
+{
+    parallel_binary(out, a, b, &word_kernels<W>::dot_or);
+}
+
+template<typename W>
+void util::basic_bit_array<W>::parallel_dot_and(util::basic_bit_array<W>& out,
+                                                const util::basic_bit_array<W>& a,
+                                                const util::basic_bit_array<W>& b)
+{
+    parallel_binary(out, a, b, &word_kernels<W>::dot_and);
+}
+
+template<typename W>
+void util::basic_bit_array<W>::parallel_dot_and_not(util::basic_bit_array<W>& out,
+                                                    const util::basic_bit_array<W>& a,
+                                                    const util::basic_bit_array<W>& b)
+{
+    parallel_binary(out, a, b, &word_kernels<W>::dot_and_not);
+}
+
+template<typename W>
+void util::basic_bit_array<W>::parallel_dot_eq(util::basic_bit_array<W>& out,
+                                               const util::basic_bit_array<W>& a,
+                                               const util::basic_bit_array<W>& b)
+{
+    parallel_binary(out, a, b, &word_kernels<W>::dot_eq);
+}
+
+template<typename W>
+void util::basic_bit_array<W>::parallel_and_of_or_many(util::basic_bit_array<W>& out,
+                                                       const std::vector<std::vector<const util::basic_bit_array<W>*>>& groups)
+{
+    out.m_version++;
+    
+    if (!use_parallel(out.m_size) || groups.empty())
+    {
+        and_of_or_many(out, groups);
+        return;
+    }
+    
+    std::vector<const basic_bit_array*> operands;
+    std::vector<uint32_t> group_sizes;
+    
+    for (const auto& group : groups)
+    {
+        many_check_dimensions(out, group);
+        
+        operands.insert(operands.end(), group.begin(), group.end());
+        group_sizes.push_back(uint32_t(group.size()));
+    }
+    
+    uint32_t n_words = get_data_size(out.m_size);
+    uint32_t n_groups = uint32_t(group_sizes.size());
+    uint32_t block_size;
+    uint32_t n_blocks = get_word_blocks(n_words, &block_size);
+    
+    auto task = [&] (uint32_t block) -> void {
+        uint32_t first = block * block_size;
+        uint32_t n = std::min(block_size, n_words - first);
+        
+        and_of_or_words(out, operands.data(), group_sizes.data(), n_groups, first, n);
+    };
+    
+    util::thread_pool::shared().run(n_blocks, task);
+}
+
+template<typename W>
+uint32_t util::basic_bit_array<W>::parallel_sum() const
+{
+    if (!use_parallel(m_size))
+    {
+        return sum();
+    }
+    
+    //  the final word is masked separately
+    uint32_t n_words = get_data_size(m_size) - 1;
+    const word_t* data = m_data.unsafe_get_pointer();
+    
+    uint32_t block_size;
+    uint32_t n_blocks = get_word_blocks(n_words, &block_size);
+    std::vector<uint64_t> sums(n_blocks);
+    
+    auto task = [&] (uint32_t block) -> void {
+        uint32_t first = block * block_size;
+        uint32_t n = std::min(block_size, n_words - first);
+        
+        sums[block] = word_kernels<W>::popcount(data + first, n);
+    };
+    
+    util::thread_pool::shared().run(n_blocks, task);
+    
+    uint64_t c_sum = bit_sum(get_final_bin_with_zeros());
+    
+    for (uint64_t block_sum : sums)
+    {
+        c_sum += block_sum;
+    }
+    
+    return uint32_t(c_sum);
+}
+
+template<typename W>
+void util::basic_bit_array<W>::parallel_fill(bool value)
+{
+    m_version++;
+    
+    if (!use_parallel(m_size))
+    {
+        fill(value);
+        return;
+    }
+    
+    int fill_with = value ? 0xff : 0;
+    uint32_t n_words = get_data_size(m_size);
+    word_t* data = m_data.unsafe_get_pointer();
+    
+    uint32_t block_size;
+    uint32_t n_blocks = get_word_blocks(n_words, &block_size);
+    
+    auto task = [&] (uint32_t block) -> void {
+        uint32_t first = block * block_size;
+        uint32_t n = std::min(block_size, n_words - first);
+        
+        std::memset(data + first, fill_with, n * sizeof(word_t));
+    };
+    
+    util::thread_pool::shared().run(n_blocks, task);
+}
+
+//  parallel_find: Count the set bits of each block, then extract each block
+//      at its offset in the result. Extract kernels may write past the end
+//      of their output, which would overrun the next block's; so the last
+//      words of a block, holding at least EXTRACT_SLACK set bits, are
+//      extracted one bit at a time after the rest.
+
+template<typename W>
+util::dynamic_array<uint32_t> util::basic_bit_array<W>::parallel_find(const util::basic_bit_array<W>& a,
+                                                                      uint32_t index_offset)
+{
+    using util::bit_kernels::EXTRACT_SLACK;
+    
+    if (!use_parallel(a.m_size))
+    {
+        return find(a, index_offset);
+    }
+    
+    typedef word_kernels<W> kernels;
+    
+    //  the final word is masked and extracted separately
+    uint32_t n_words = get_data_size(a.m_size) - 1;
+    const word_t* data = a.m_data.unsafe_get_pointer();
+    word_t last_datum = a.get_final_bin_with_zeros();
+    
+    uint32_t block_size;
+    uint32_t n_blocks = get_word_blocks(n_words, &block_size);
+    std::vector<uint32_t> offsets(n_blocks + 1, 0u);
+    
+    auto count_task = [&] (uint32_t block) -> void {
+        uint32_t first = block * block_size;
+        uint32_t n = std::min(block_size, n_words - first);
+        
+        offsets[block+1] = uint32_t(kernels::popcount(data + first, n));
+    };
+    
+    util::thread_pool::shared().run(n_blocks, count_task);
+    
+    for (uint32_t i = 0; i < n_blocks; i++)
+    {
+        offsets[i+1] += offsets[i];
     }
     
+    uint32_t n_found = offsets[n_blocks];
+    uint32_t n_last = bit_sum(last_datum);
+    
+    util::dynamic_array<uint32_t> result(n_found + n_last + EXTRACT_SLACK);
+    uint32_t* result_ptr = result.unsafe_get_pointer();
+    
+    auto extract_task = [&] (uint32_t block) -> void {
+        uint32_t first = block * block_size;
+        uint32_t stop = std::min(first + block_size, n_words);
+        uint32_t* dest = result_ptr + offsets[block];
+        
+        //  find where the bitwise tail begins
+        uint32_t split = stop;
+        uint32_t n_tail = 0;
+        
+        while (split > first && n_tail < EXTRACT_SLACK)
+        {
+            split--;
+            n_tail += bit_sum(data[split]);
+        }
+        
+        uint32_t n_head = kernels::extract(dest, data + first, split - first, first * BITS + index_offset);
+        
+        dest += n_head;
+        
+        for (uint32_t i = split; i < stop; i++)
+        {
+            word_t word = data[i];
+            uint32_t base = i * BITS + index_offset;
+            
+            while (word != 0)
+            {
+                *dest++ = base + util::bit_kernels::ctz64(word);
+                word &= word - 1;
+            }
+        }
+    };
+    
+    util::thread_pool::shared().run(n_blocks, extract_task);
+    
+    kernels::extract(result_ptr + n_found, &last_datum, 1, n_words * BITS + index_offset);
+    
+    result.resize(n_found + n_last);
+    result.seek_tail_to_end();
+    
     return result;
 }
 
-util::bit_array::iterator util::bit_array::begin() const
+template<typename W>
+typename util::basic_bit_array<W>::iterator util::basic_bit_array<W>::begin() const
+{
+    return util::basic_bit_array<W>::iterator(this);
+}
+
+template<typename W>
+auto util::basic_bit_array<W>::set_bits() const -> range<set_bit_iterator>
+{
+    uint32_t n_words = get_data_size(m_size);
+    word_t last_mask = get_last_mask();
+    const word_t* data = m_data.unsafe_get_pointer();
+    
+    return { set_bit_iterator(data, n_words, last_mask, 0), set_bit_iterator(data, n_words, last_mask, n_words) };
+}
+
+template<typename W>
+auto util::basic_bit_array<W>::words() const -> range<word_iterator>
 {
-    return util::bit_array::iterator(this);
+    uint32_t n_words = get_data_size(m_size);
+    word_t last_mask = get_last_mask();
+    const word_t* data = m_data.unsafe_get_pointer();
+    
+    return { word_iterator(data, n_words, last_mask, 0), word_iterator(data, n_words, last_mask, n_words) };
 }
 
 //  iterator
 
-util::bit_array::iterator::iterator(const util::bit_array* barray)
+template<typename W>
+util::basic_bit_array<W>::iterator::iterator(const util::basic_bit_array<W>* barray)
 {
     m_idx = 0;
     m_bin = 0;
     m_bit = 0;
-    m_size_int = barray->m_size_int;
     m_data = barray->m_data.unsafe_get_pointer();
 }
 
-void util::bit_array::iterator::next()
+template<typename W>
+void util::basic_bit_array<W>::iterator::next()
 {
-    if (++m_bit == m_size_int)
+    if (++m_bit == BITS)
     {
         m_bit = 0;
         m_bin++;
@@ -673,14 +1973,16 @@ void util::bit_array::iterator::next()
     m_idx++;
 }
 
-bool util::bit_array::iterator::value() const
+template<typename W>
+bool util::basic_bit_array<W>::iterator::value() const
 {
-    return m_data[m_bin] & (1u << m_bit);
+    return m_data[m_bin] & (word_t(1) << m_bit);
 }
 
-void util::bit_array::iterator::set(bool value)
+template<typename W>
+void util::basic_bit_array<W>::iterator::set(bool value)
 {
-    uint32_t val = 1u << m_bit;
+    word_t val = word_t(1) << m_bit;
     
     if (value)
     {
@@ -692,4 +1994,9 @@ void util::bit_array::iterator::set(bool value)
     }
 }
 
+//
+//  instantiations
+//
 
+template class util::basic_bit_array<uint32_t>;
+template class util::basic_bit_array<uint64_t>;
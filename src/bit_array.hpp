@@ -8,40 +8,126 @@
 #pragma once
 
 #include "dynamic_array.hpp"
+#include "bit_kernels.hpp"
 #include <cstdint>
+#include <vector>
+#include <algorithm>
 
 namespace util {
-    class bit_array;
+    template<typename W>
+    class basic_bit_array;
+    
+    typedef basic_bit_array<uint64_t> bit_array;
+    
+    class compressed_bit_array;
+    class rank_select;
+    class bit_matrix;
 }
 
-class util::bit_array
+//  basic_bit_array: Packed array of bits, stored in words of type `W`
+//      (uint32_t or uint64_t). Bulk operations on 64-bit words use the
+//      simd kernels; other word sizes use scalar loops.
+
+template<typename W>
+class util::basic_bit_array
 {
 public:
+    typedef W word_t;
+    typedef util::aligned_allocator<word_t> allocator_t;
+    
+    static_assert(sizeof(word_t) == 4 || sizeof(word_t) == 8, "Word type must be 32 or 64 bits.");
+    
+    //  bits per word; BITS == 1 << SHIFT.
+    static constexpr uint32_t BITS = sizeof(word_t) * 8u;
+    static constexpr uint32_t SHIFT = BITS == 64u ? 6u : 5u;
+    static constexpr uint32_t MASK = BITS - 1u;
+    
     struct iterator
     {
-        iterator(const bit_array* barray);
+        iterator(const basic_bit_array* barray);
         void next();
         bool value() const;
         void set(bool value);
     private:
-        uint32_t* m_data;
+        word_t* m_data;
         uint32_t m_idx;
         uint32_t m_bin;
         uint32_t m_bit;
-        uint32_t m_size_int;
     };
     
-    explicit bit_array();
-    explicit bit_array(uint32_t size);
-    explicit bit_array(uint32_t size, bool fill_with);
-    ~bit_array() noexcept;
+    //  set_bit_iterator: Forward iterator over the indices of set bits, in
+    //      ascending order.
+    struct set_bit_iterator
+    {
+        set_bit_iterator(const word_t* data, uint32_t n_words, word_t last_mask, uint32_t bin);
+        
+        uint32_t operator*() const;
+        set_bit_iterator& operator++();
+        bool operator==(const set_bit_iterator& other) const;
+        bool operator!=(const set_bit_iterator& other) const;
+    private:
+        const word_t* m_data;
+        word_t m_word;
+        word_t m_last_mask;
+        uint32_t m_n_words;
+        uint32_t m_bin;
+        
+        void load();
+    };
     
-    bit_array(const bit_array& other);
-    bit_array& operator=(const bit_array& other);
-    bit_array(bit_array&& rhs) noexcept;
-    bit_array& operator=(bit_array&& other) noexcept;
+    //  word_iterator: Forward iterator over the words of the array; bits of
+    //      the final word past the end of the array read as zero.
+    struct word_iterator
+    {
+        word_iterator(const word_t* data, uint32_t n_words, word_t last_mask, uint32_t bin);
+        
+        word_t operator*() const;
+        word_iterator& operator++();
+        bool operator==(const word_iterator& other) const;
+        bool operator!=(const word_iterator& other) const;
+        
+        //  bin: Index of the current word; its first bit is bin() * BITS.
+        uint32_t bin() const;
+    private:
+        const word_t* m_data;
+        word_t m_last_mask;
+        uint32_t m_n_words;
+        uint32_t m_bin;
+    };
     
-    bit_array::iterator begin() const;
+    //  span: Bits [start, stop).
+    struct span
+    {
+        uint32_t start;
+        uint32_t stop;
+    };
+    
+    template<typename It>
+    struct range
+    {
+        It first;
+        It last;
+        
+        It begin() const { return first; }
+        It end() const { return last; }
+    };
+    
+    explicit basic_bit_array();
+    explicit basic_bit_array(uint32_t size);
+    explicit basic_bit_array(uint32_t size, bool fill_with);
+    ~basic_bit_array() noexcept;
+    
+    basic_bit_array(const basic_bit_array& other);
+    basic_bit_array& operator=(const basic_bit_array& other);
+    basic_bit_array(basic_bit_array&& rhs) noexcept;
+    basic_bit_array& operator=(basic_bit_array&& other) noexcept;
+    
+    basic_bit_array::iterator begin() const;
+    
+    //  set_bits / words: Ranges for range-based for loops, e.g.
+    //      for (uint32_t index : barray.set_bits()) { ... }
+    range<set_bit_iterator> set_bits() const;
+    range<word_iterator> words() const;
     
     uint32_t size() const;
     uint32_t sum() const;
@@ -51,10 +137,15 @@ public:
     void push(bool value);
     void place(bool value, uint32_t at_index);
     void unchecked_place(bool value, uint32_t at_index);
-    void append(const bit_array &other);
+    void append(const basic_bit_array &other);
     void keep(const util::dynamic_array<uint32_t> &at_indices);
     void unchecked_keep(const util::dynamic_array<uint32_t> &at_indices, int32_t index_offset = 0);
     
+    //  compress: Keep the elements at which `mask` is true, in order.
+    //      Equivalent to keep(find(mask)), but packs whole words at a time.
+    void compress(const basic_bit_array& mask);
+    void unchecked_compress(const basic_bit_array& mask);
+    
     bool assign_true(const util::dynamic_array<uint32_t> &at_indices, int32_t index_offset = 0);
     void unchecked_assign_true(const util::dynamic_array<uint32_t> &at_indices, int32_t index_offset = 0);
     
@@ -68,34 +159,385 @@ public:
     bool all() const;
     bool any() const;
     
-    static void dot_or(bit_array& out, const bit_array& a, const bit_array& b);
-    static void dot_and(bit_array& out, const bit_array& a, const bit_array& b);
-    static void unchecked_dot_or(bit_array& out, const bit_array& a,
-                                 const bit_array& b, uint32_t start, uint32_t stop);
-    static void unchecked_dot_and(bit_array& out, const bit_array& a,
-                                  const bit_array& b, uint32_t start, uint32_t stop);
-    static void unchecked_dot_and_not(bit_array& out, const bit_array& a,
-                                  const bit_array& b, uint32_t start, uint32_t stop);
-    static void unchecked_dot_eq(bit_array& out, const bit_array& a,
-                                  const bit_array& b, uint32_t start, uint32_t stop);
-    
-    static util::dynamic_array<uint32_t> find(const bit_array& a, uint32_t index_offset = 0u);
+    static void dot_or(basic_bit_array& out, const basic_bit_array& a, const basic_bit_array& b);
+    static void dot_and(basic_bit_array& out, const basic_bit_array& a, const basic_bit_array& b);
+    static void unchecked_dot_or(basic_bit_array& out, const basic_bit_array& a,
+                                 const basic_bit_array& b, uint32_t start, uint32_t stop);
+    static void unchecked_dot_and(basic_bit_array& out, const basic_bit_array& a,
+                                  const basic_bit_array& b, uint32_t start, uint32_t stop);
+    static void unchecked_dot_and_not(basic_bit_array& out, const basic_bit_array& a,
+                                      const basic_bit_array& b, uint32_t start, uint32_t stop);
+    static void unchecked_dot_eq(basic_bit_array& out, const basic_bit_array& a,
+                                 const basic_bit_array& b, uint32_t start, uint32_t stop);
+    
+    static uint32_t and_count(const basic_bit_array& a, const basic_bit_array& b);
+    static uint32_t and_not_count(const basic_bit_array& a, const basic_bit_array& b);
+    static uint32_t unchecked_and_count(const basic_bit_array& a, const basic_bit_array& b,
+                                        uint32_t start, uint32_t stop);
+    static uint32_t unchecked_and_not_count(const basic_bit_array& a, const basic_bit_array& b,
+                                            uint32_t start, uint32_t stop);
+    
+    //  intersects: Whether a & b has any set bit, without materializing it.
+    //      Words are tested a block at a time, stopping at the first block
+    //      with a set bit.
+    static bool intersects(const basic_bit_array& a, const basic_bit_array& b);
+    static bool unchecked_intersects(const basic_bit_array& a, const basic_bit_array& b);
+    //  intersects_not: Whether a & ~b has any set bit.
+    static bool intersects_not(const basic_bit_array& a, const basic_bit_array& b);
+    static bool unchecked_intersects_not(const basic_bit_array& a, const basic_bit_array& b);
+    //  intersects_many: Whether the and of `operands` has any set bit; false
+    //      if `operands` is empty.
+    static bool intersects_many(const std::vector<const basic_bit_array*>& operands);
+    //  occupied_spans: Spans of the runs of whole cache lines of `a` with
+    //      at least one set bit, in ascending order and clipped to size().
+    //      An update by a sparse array need touch only these.
+    static std::vector<span> occupied_spans(const basic_bit_array& a);
+    
+    //  concat: Join `arrays` end to end; the result is allocated once.
+    static void concat(basic_bit_array& out, const std::vector<const basic_bit_array*>& arrays);
+    static void unchecked_concat(basic_bit_array& out, const basic_bit_array* const* arrays, uint32_t n_arrays);
+    
+    static void and_many(basic_bit_array& out, const std::vector<const basic_bit_array*>& operands);
+    static void or_many(basic_bit_array& out, const std::vector<const basic_bit_array*>& operands);
+    static void and_of_or_many(basic_bit_array& out, const std::vector<std::vector<const basic_bit_array*>>& groups);
+    static void unchecked_and_of_or_many(basic_bit_array& out, const basic_bit_array* const* operands,
+                                         const uint32_t* group_sizes, uint32_t n_groups);
+    //  any_word_of_and_of_or_many: Whether `pred(bin, word)` is true for any
+    //      non-zero word of the and of the or of each of `groups`, without
+    //      writing the and out. It is formed a block of words at a time, and
+    //      `pred` is called in ascending order of `bin`, stopping at the
+    //      first word for which it is true; the bits of the final word past
+    //      size() are cleared. False if `groups` is empty.
+    template<typename F>
+    static bool any_word_of_and_of_or_many(const std::vector<std::vector<const basic_bit_array*>>& groups, F&& pred);
+    
+    //  for_each_set_bit: Call `func(index)` for the index of each set bit of
+    //      `a`, in ascending order, without materializing the indices.
+    template<typename F>
+    static void for_each_set_bit(const basic_bit_array& a, F&& func);
+    //  Only set bits at indices [start, stop); `stop` must not exceed size().
+    template<typename F>
+    static void for_each_set_bit(const basic_bit_array& a, uint32_t start, uint32_t stop, F&& func);
+    
+    //  find: Indices of the set bits of `a`, plus `index_offset`. The
+    //      result is extracted in a single pass; `size_hint`, if non-zero,
+    //      is the initial capacity of the result.
+    static util::dynamic_array<uint32_t> find(const basic_bit_array& a, uint32_t index_offset = 0u,
+                                              uint32_t size_hint = 0u);
+    
+    //  parallel_*: Versions of the above that split the array into blocks of
+    //      whole cache lines and process them on the shared thread_pool, so
+    //      that no two threads write the same word. Arrays smaller than
+    //      thread_pool::get_parallel_threshold() are processed serially.
+    static void parallel_dot_or(basic_bit_array& out, const basic_bit_array& a, const basic_bit_array& b);
+    static void parallel_dot_and(basic_bit_array& out, const basic_bit_array& a, const basic_bit_array& b);
+    static void parallel_dot_and_not(basic_bit_array& out, const basic_bit_array& a, const basic_bit_array& b);
+    static void parallel_dot_eq(basic_bit_array& out, const basic_bit_array& a, const basic_bit_array& b);
+    static void parallel_and_of_or_many(basic_bit_array& out,
+                                        const std::vector<std::vector<const basic_bit_array*>>& groups);
+    static util::dynamic_array<uint32_t> parallel_find(const basic_bit_array& a, uint32_t index_offset = 0u);
+    
+    uint32_t parallel_sum() const;
+    void parallel_fill(bool value);
 private:
-    util::dynamic_array<uint32_t> m_data;
+    friend class util::compressed_bit_array;
+    friend class util::rank_select;
+    friend class util::bit_matrix;
+    
+    static constexpr uint32_t FIND_INITIAL_CAPACITY = 1024u;
+    static constexpr uint32_t FIND_BLOCK_SIZE = 64u;
+    static constexpr uint32_t MANY_BLOCK_SIZE = 256u;
+    static constexpr uint32_t INTERSECT_BLOCK_SIZE = 64u;
+    static constexpr uint32_t BLOCKS_PER_THREAD = 4u;
+    static constexpr uint32_t CACHE_LINE_WORDS = 64u / sizeof(W);
+    
+    util::dynamic_array<word_t, allocator_t> m_data;
     
     uint32_t m_size;
-    uint32_t m_size_int;
+    //  incremented by each operation that may modify the array, so that a
+    //  rank_select directory can tell when it is stale.
+    uint32_t m_version;
     
-    uint32_t get_bin(uint32_t index) const;
-    uint32_t get_bit(uint32_t index) const;
-    uint32_t get_data_size(uint32_t n_elements) const;
-    uint32_t get_final_bin_with_zeros() const;
-    uint32_t get_final_bin_with_zeros(uint32_t* data, uint32_t data_size) const;
-    uint32_t get_size_int() const;
+    static uint32_t get_bin(uint32_t index);
+    static uint32_t get_bit(uint32_t index);
+    static uint32_t get_data_size(uint32_t n_elements);
+    word_t get_final_bin_with_zeros() const;
+    word_t get_final_bin_with_zeros(word_t* data, uint32_t data_size) const;
+    word_t get_last_mask() const;
     
     void unchecked_place(bool value, uint32_t bin, uint32_t bit);
+    void unchecked_copy_at(uint32_t at_index, const basic_bit_array& src);
+    
+    static bool get_bin_range(const basic_bit_array& a, uint32_t start, uint32_t stop,
+                              uint32_t* first_bin, uint32_t* n_bins);
+    static word_t get_range_mask(const basic_bit_array& a, uint32_t start, uint32_t stop, uint32_t bin_offset);
+    static uint32_t get_padded_bins(const basic_bit_array& out, const basic_bit_array& a, const basic_bit_array& b,
+                                    uint32_t first_bin, uint32_t n_bins);
+    
+    static void and_of_or_words(basic_bit_array& out, const basic_bit_array* const* operands,
+                                const uint32_t* group_sizes, uint32_t n_groups,
+                                uint32_t first_word, uint32_t n_words_total);
+    
+    static bool use_parallel(uint32_t n_elements);
+    static uint32_t get_word_blocks(uint32_t n_words, uint32_t* block_size);
+    static void parallel_binary(basic_bit_array& out, const basic_bit_array& a, const basic_bit_array& b,
+                                void (*op)(word_t*, const word_t*, const word_t*, size_t));
     
-    static void binary_check_dimensions(const bit_array& out, const bit_array& a, const bit_array& b);
-    static bool all_bits_set(uint32_t value, uint32_t n);
-    static uint32_t bit_sum(uint32_t i);
+    static void binary_check_dimensions(const basic_bit_array& out, const basic_bit_array& a, const basic_bit_array& b);
+    static void many_check_dimensions(const basic_bit_array& out, const std::vector<const basic_bit_array*>& operands);
+    static bool all_zero(const word_t* data, uint32_t n_words);
+    static bool all_bits_set(word_t value, uint32_t n);
+    static uint32_t bit_sum(word_t i);
 };
+
+//
+//  impl
+//
+
+template<typename W>
+constexpr uint32_t util::basic_bit_array<W>::BITS;
+
+template<typename W>
+constexpr uint32_t util::basic_bit_array<W>::SHIFT;
+
+template<typename W>
+constexpr uint32_t util::basic_bit_array<W>::MASK;
+
+extern template class util::basic_bit_array<uint32_t>;
+extern template class util::basic_bit_array<uint64_t>;
+
+template<typename W>
+template<typename F>
+void util::basic_bit_array<W>::for_each_set_bit(const util::basic_bit_array<W>& a, F&& func)
+{
+    uint32_t n_words = a.get_data_size(a.m_size);
+    
+    if (n_words == 0)
+    {
+        return;
+    }
+    
+    const word_t* data = a.m_data.unsafe_get_pointer();
+    
+    for (uint32_t i = 0; i < n_words; i++)
+    {
+        word_t word = i + 1 == n_words ? a.get_final_bin_with_zeros() : data[i];
+        uint32_t base = i * BITS;
+        
+        while (word != 0)
+        {
+            func(base + util::bit_kernels::ctz64(word));
+            word &= word - 1;
+        }
+    }
+}
+
+template<typename W>
+template<typename F>
+void util::basic_bit_array<W>::for_each_set_bit(const util::basic_bit_array<W>& a, uint32_t start, uint32_t stop, F&& func)
+{
+    if (start >= stop)
+    {
+        return;
+    }
+    
+    uint32_t n_words = a.get_data_size(a.m_size);
+    uint32_t first = get_bin(start);
+    uint32_t last = get_bin(stop - 1);
+    
+    const word_t* data = a.m_data.unsafe_get_pointer();
+    
+    for (uint32_t i = first; i <= last; i++)
+    {
+        word_t word = i + 1 == n_words ? a.get_final_bin_with_zeros() : data[i];
+        uint32_t base = i * BITS;
+        
+        if (i == first)
+        {
+            word &= ~word_t(0) << get_bit(start);
+        }
+        
+        if (i == last && get_bit(stop) != 0)
+        {
+            word &= (word_t(1) << get_bit(stop)) - 1;
+        }
+        
+        while (word != 0)
+        {
+            func(base + util::bit_kernels::ctz64(word));
+            word &= word - 1;
+        }
+    }
+}
+
+template<typename W>
+template<typename F>
+bool util::basic_bit_array<W>::any_word_of_and_of_or_many(const std::vector<std::vector<const util::basic_bit_array<W>*>>& groups,
+                                                           F&& pred)
+{
+    if (groups.empty())
+    {
+        return false;
+    }
+    
+    for (const auto& group : groups)
+    {
+        if (group.empty())
+        {
+            return false;
+        }
+        
+        many_check_dimensions(*groups[0][0], group);
+    }
+    
+    const basic_bit_array& first = *groups[0][0];
+    uint32_t n_words = get_data_size(first.m_size);
+    word_t last_mask = first.get_last_mask();
+    word_t block[INTERSECT_BLOCK_SIZE];
+    
+    for (uint32_t i = 0; i < n_words; i += INTERSECT_BLOCK_SIZE)
+    {
+        uint32_t n_block = std::min(uint32_t(INTERSECT_BLOCK_SIZE), n_words - i);
+        bool any = true;
+        
+        //  later groups are skipped once the block's and is zero
+        for (uint32_t j = 0; j < groups.size() && any; j++)
+        {
+            word_t block_any = 0;
+            
+            for (uint32_t k = 0; k < n_block; k++)
+            {
+                word_t word = 0;
+                
+                for (const basic_bit_array* operand : groups[j])
+                {
+                    word |= operand->m_data.unsafe_get_pointer()[i + k];
+                }
+                
+                block[k] = j == 0 ? word : block[k] & word;
+                block_any |= block[k];
+            }
+            
+            any = block_any != 0;
+        }
+        
+        for (uint32_t k = 0; k < n_block && any; k++)
+        {
+            word_t word = i + k + 1 == n_words ? block[k] & last_mask : block[k];
+            
+            if (word != 0 && pred(i + k, word))
+            {
+                return true;
+            }
+        }
+    }
+    
+    return false;
+}
+
+//  set_bit_iterator
+
+template<typename W>
+inline util::basic_bit_array<W>::set_bit_iterator::set_bit_iterator(const word_t* data, uint32_t n_words,
+                                                                    word_t last_mask, uint32_t bin) :
+    m_data(data), m_word(0), m_last_mask(last_mask), m_n_words(n_words), m_bin(bin)
+{
+    load();
+}
+
+template<typename W>
+inline uint32_t util::basic_bit_array<W>::set_bit_iterator::operator*() const
+{
+    return m_bin * BITS + util::bit_kernels::ctz64(m_word);
+}
+
+template<typename W>
+inline typename util::basic_bit_array<W>::set_bit_iterator& util::basic_bit_array<W>::set_bit_iterator::operator++()
+{
+    m_word &= m_word - 1;
+    
+    if (m_word == 0)
+    {
+        m_bin++;
+        load();
+    }
+    
+    return *this;
+}
+
+template<typename W>
+inline bool util::basic_bit_array<W>::set_bit_iterator::operator==(const set_bit_iterator& other) const
+{
+    return m_bin == other.m_bin && m_word == other.m_word;
+}
+
+template<typename W>
+inline bool util::basic_bit_array<W>::set_bit_iterator::operator!=(const set_bit_iterator& other) const
+{
+    return !(*this == other);
+}
+
+//  load: Advance to the first non-zero word at or after m_bin.
+
+template<typename W>
+inline void util::basic_bit_array<W>::set_bit_iterator::load()
+{
+    for (; m_bin < m_n_words; m_bin++)
+    {
+        m_word = m_data[m_bin];
+        
+        if (m_bin + 1 == m_n_words)
+        {
+            m_word &= m_last_mask;
+        }
+        
+        if (m_word != 0)
+        {
+            return;
+        }
+    }
+    
+    m_word = 0;
+}
+
+//  word_iterator
+
+template<typename W>
+inline util::basic_bit_array<W>::word_iterator::word_iterator(const word_t* data, uint32_t n_words,
+                                                              word_t last_mask, uint32_t bin) :
+    m_data(data), m_last_mask(last_mask), m_n_words(n_words), m_bin(bin)
+{
+    //
+}
+
+template<typename W>
+inline typename util::basic_bit_array<W>::word_t util::basic_bit_array<W>::word_iterator::operator*() const
+{
+    return m_bin + 1 == m_n_words ? m_data[m_bin] & m_last_mask : m_data[m_bin];
+}
+
+template<typename W>
+inline typename util::basic_bit_array<W>::word_iterator& util::basic_bit_array<W>::word_iterator::operator++()
+{
+    m_bin++;
+    
+    return *this;
+}
+
+template<typename W>
+inline bool util::basic_bit_array<W>::word_iterator::operator==(const word_iterator& other) const
+{
+    return m_bin == other.m_bin;
+}
+
+template<typename W>
+inline bool util::basic_bit_array<W>::word_iterator::operator!=(const word_iterator& other) const
+{
+    return m_bin != other.m_bin;
+}
+
+template<typename W>
+inline uint32_t util::basic_bit_array<W>::word_iterator::bin() const
+{
+    return m_bin;
+}
@@ -0,0 +1,894 @@
+//
+//  bit_kernels.cpp
+//  locator
+//
+
+#include "bit_kernels.hpp"
+#include <stdexcept>
+
+//  define LOC_NO_SIMD to build the scalar kernels only.
+#if !defined(LOC_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define LOC_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LOC_TARGET(isa) __attribute__((target(isa)))
+#else
+#define LOC_TARGET(isa)
+#endif
+
+namespace {
+    //
+    //  element-wise operations
+    //
+    
+    struct op_or
+    {
+        static uint64_t apply(uint64_t a, uint64_t b) { return a | b; }
+#ifdef LOC_X86
+        LOC_TARGET("sse2") static __m128i apply128(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+        LOC_TARGET("avx2") static __m256i apply256(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+        LOC_TARGET("avx512f") static __m512i apply512(__m512i a, __m512i b) { return _mm512_or_si512(a, b); }
+#endif
+    };
+    
+    struct op_and
+    {
+        static uint64_t apply(uint64_t a, uint64_t b) { return a & b; }
+#ifdef LOC_X86
+        LOC_TARGET("sse2") static __m128i apply128(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+        LOC_TARGET("avx2") static __m256i apply256(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+        LOC_TARGET("avx512f") static __m512i apply512(__m512i a, __m512i b) { return _mm512_and_si512(a, b); }
+#endif
+    };
+    
+    //  a & ~b
+    struct op_and_not
+    {
+        static uint64_t apply(uint64_t a, uint64_t b) { return a & ~b; }
+#ifdef LOC_X86
+        LOC_TARGET("sse2") static __m128i apply128(__m128i a, __m128i b) { return _mm_andnot_si128(b, a); }
+        LOC_TARGET("avx2") static __m256i apply256(__m256i a, __m256i b) { return _mm256_andnot_si256(b, a); }
+        LOC_TARGET("avx512f") static __m512i apply512(__m512i a, __m512i b) { return _mm512_andnot_si512(b, a); }
+#endif
+    };
+    
+    //  ~(a ^ b)
+    struct op_eq
+    {
+        static uint64_t apply(uint64_t a, uint64_t b) { return ~(a ^ b); }
+#ifdef LOC_X86
+        LOC_TARGET("sse2") static __m128i apply128(__m128i a, __m128i b)
+        {
+            return _mm_xor_si128(_mm_xor_si128(a, b), _mm_set1_epi32(-1));
+        }
+        LOC_TARGET("avx2") static __m256i apply256(__m256i a, __m256i b)
+        {
+            return _mm256_xor_si256(_mm256_xor_si256(a, b), _mm256_set1_epi32(-1));
+        }
+        LOC_TARGET("avx512f") static __m512i apply512(__m512i a, __m512i b)
+        {
+            return _mm512_ternarylogic_epi64(a, b, b, 0xc3);
+        }
+#endif
+    };
+    
+    //
+    //  binary kernels
+    //
+    
+    template<typename Op>
+    void scalar_binary(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        for (size_t i = 0; i < n_words; i++)
+        {
+            out[i] = Op::apply(a[i], b[i]);
+        }
+    }
+    
+#ifdef LOC_X86
+    template<typename Op>
+    LOC_TARGET("sse2") void sse2_binary(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        size_t i = 0;
+        
+        for (; i + 2 <= n_words; i += 2)
+        {
+            __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i*) (b + i));
+            _mm_storeu_si128((__m128i*) (out + i), Op::apply128(va, vb));
+        }
+        
+        for (; i < n_words; i++)
+        {
+            out[i] = Op::apply(a[i], b[i]);
+        }
+    }
+    
+    template<typename Op>
+    LOC_TARGET("avx2") void avx2_binary(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        size_t i = 0;
+        
+        for (; i + 4 <= n_words; i += 4)
+        {
+            __m256i va = _mm256_loadu_si256((const __m256i*) (a + i));
+            __m256i vb = _mm256_loadu_si256((const __m256i*) (b + i));
+            _mm256_storeu_si256((__m256i*) (out + i), Op::apply256(va, vb));
+        }
+        
+        for (; i < n_words; i++)
+        {
+            out[i] = Op::apply(a[i], b[i]);
+        }
+    }
+    
+    template<typename Op>
+    LOC_TARGET("avx512f") void avx512_binary(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        size_t i = 0;
+        
+        for (; i + 8 <= n_words; i += 8)
+        {
+            __m512i va = _mm512_loadu_si512((const void*) (a + i));
+            __m512i vb = _mm512_loadu_si512((const void*) (b + i));
+            _mm512_storeu_si512((void*) (out + i), Op::apply512(va, vb));
+        }
+        
+        //  masked tail rather than a scalar epilogue
+        if (i < n_words)
+        {
+            __mmask8 mask = (__mmask8) ((1u << (n_words - i)) - 1u);
+            __m512i va = _mm512_maskz_loadu_epi64(mask, (const void*) (a + i));
+            __m512i vb = _mm512_maskz_loadu_epi64(mask, (const void*) (b + i));
+            _mm512_mask_storeu_epi64((void*) (out + i), mask, Op::apply512(va, vb));
+        }
+    }
+#endif
+    
+    //
+    //  count kernels
+    //
+    
+    //  operand loaders: the word (or vector) whose bits are counted.
+    struct load_one
+    {
+        static uint64_t get(const uint64_t* a, const uint64_t*, size_t i) { return a[i]; }
+#ifdef LOC_X86
+        LOC_TARGET("avx2") static __m256i get256(const uint64_t* a, const uint64_t*, size_t i)
+        {
+            return _mm256_loadu_si256((const __m256i*) (a + i));
+        }
+#endif
+    };
+    
+    struct load_and
+    {
+        static uint64_t get(const uint64_t* a, const uint64_t* b, size_t i) { return a[i] & b[i]; }
+#ifdef LOC_X86
+        LOC_TARGET("avx2") static __m256i get256(const uint64_t* a, const uint64_t* b, size_t i)
+        {
+            return _mm256_and_si256(_mm256_loadu_si256((const __m256i*) (a + i)),
+                                    _mm256_loadu_si256((const __m256i*) (b + i)));
+        }
+#endif
+    };
+    
+    struct load_and_not
+    {
+        static uint64_t get(const uint64_t* a, const uint64_t* b, size_t i) { return a[i] & ~b[i]; }
+#ifdef LOC_X86
+        LOC_TARGET("avx2") static __m256i get256(const uint64_t* a, const uint64_t* b, size_t i)
+        {
+            return _mm256_andnot_si256(_mm256_loadu_si256((const __m256i*) (b + i)),
+                                       _mm256_loadu_si256((const __m256i*) (a + i)));
+        }
+#endif
+    };
+    
+    template<typename Load>
+    uint64_t scalar_count(const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        uint64_t sum = 0;
+        
+        for (size_t i = 0; i < n_words; i++)
+        {
+            sum += util::bit_kernels::popcount64(Load::get(a, b, i));
+        }
+        
+        return sum;
+    }
+    
+#ifdef LOC_X86
+    template<typename Load>
+    LOC_TARGET("popcnt") uint64_t popcnt_count(const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        //  independent accumulators hide the latency of popcnt
+        uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        size_t i = 0;
+        
+        for (; i + 4 <= n_words; i += 4)
+        {
+            s0 += _mm_popcnt_u64(Load::get(a, b, i));
+            s1 += _mm_popcnt_u64(Load::get(a, b, i+1));
+            s2 += _mm_popcnt_u64(Load::get(a, b, i+2));
+            s3 += _mm_popcnt_u64(Load::get(a, b, i+3));
+        }
+        
+        for (; i < n_words; i++)
+        {
+            s0 += _mm_popcnt_u64(Load::get(a, b, i));
+        }
+        
+        return s0 + s1 + s2 + s3;
+    }
+    
+    //  Harley-Seal carry-save popcount over 256-bit vectors.
+    //
+    //      Mula, Kurz & Lemire, "Faster population counts using AVX2
+    //      instructions" (2016).
+    
+    LOC_TARGET("avx2") __m256i avx2_popcount_bytes(__m256i v)
+    {
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low_mask = _mm256_set1_epi8(0x0f);
+        
+        __m256i lo = _mm256_and_si256(v, low_mask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi32(v, 4), low_mask);
+        __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+        
+        //  horizontal byte sums, one per 64-bit lane
+        return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+    }
+    
+    LOC_TARGET("avx2") void avx2_csa(__m256i* h, __m256i* l, __m256i a, __m256i b, __m256i c)
+    {
+        __m256i u = _mm256_xor_si256(a, b);
+        *h = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+        *l = _mm256_xor_si256(u, c);
+    }
+    
+    template<typename Load>
+    LOC_TARGET("avx2,popcnt") uint64_t avx2_count(const uint64_t* a, const uint64_t* b, size_t n_words)
+    {
+        __m256i total = _mm256_setzero_si256();
+        __m256i ones = _mm256_setzero_si256();
+        __m256i twos = _mm256_setzero_si256();
+        __m256i fours = _mm256_setzero_si256();
+        __m256i eights = _mm256_setzero_si256();
+        __m256i sixteens;
+        __m256i twos_a, twos_b, fours_a, fours_b, eights_a, eights_b;
+        
+        size_t i = 0;
+        
+        //  16 vectors (64 words) per iteration
+        for (; i + 64 <= n_words; i += 64)
+        {
+            avx2_csa(&twos_a, &ones, ones, Load::get256(a, b, i), Load::get256(a, b, i+4));
+            avx2_csa(&twos_b, &ones, ones, Load::get256(a, b, i+8), Load::get256(a, b, i+12));
+            avx2_csa(&fours_a, &twos, twos, twos_a, twos_b);
+            avx2_csa(&twos_a, &ones, ones, Load::get256(a, b, i+16), Load::get256(a, b, i+20));
+            avx2_csa(&twos_b, &ones, ones, Load::get256(a, b, i+24), Load::get256(a, b, i+28));
+            avx2_csa(&fours_b, &twos, twos, twos_a, twos_b);
+            avx2_csa(&eights_a, &fours, fours, fours_a, fours_b);
+            avx2_csa(&twos_a, &ones, ones, Load::get256(a, b, i+32), Load::get256(a, b, i+36));
+            avx2_csa(&twos_b, &ones, ones, Load::get256(a, b, i+40), Load::get256(a, b, i+44));
+            avx2_csa(&fours_a, &twos, twos, twos_a, twos_b);
+            avx2_csa(&twos_a, &ones, ones, Load::get256(a, b, i+48), Load::get256(a, b, i+52));
+            avx2_csa(&twos_b, &ones, ones, Load::get256(a, b, i+56), Load::get256(a, b, i+60));
+            avx2_csa(&fours_b, &twos, twos, twos_a, twos_b);
+            avx2_csa(&eights_b, &fours, fours, fours_a, fours_b);
+            avx2_csa(&sixteens, &eights, eights, eights_a, eights_b);
+            
+            total = _mm256_add_epi64(total, avx2_popcount_bytes(sixteens));
+        }
+        
+        total = _mm256_slli_epi64(total, 4);
+        total = _mm256_add_epi64(total, _mm256_slli_epi64(avx2_popcount_bytes(eights), 3));
+        total = _mm256_add_epi64(total, _mm256_slli_epi64(avx2_popcount_bytes(fours), 2));
+        total = _mm256_add_epi64(total, _mm256_slli_epi64(avx2_popcount_bytes(twos), 1));
+        total = _mm256_add_epi64(total, avx2_popcount_bytes(ones));
+        
+        for (; i + 4 <= n_words; i += 4)
+        {
+            total = _mm256_add_epi64(total, avx2_popcount_bytes(Load::get256(a, b, i)));
+        }
+        
+        uint64_t sum = uint64_t(_mm256_extract_epi64(total, 0)) + uint64_t(_mm256_extract_epi64(total, 1)) +
+            uint64_t(_mm256_extract_epi64(total, 2)) + uint64_t(_mm256_extract_epi64(total, 3));
+        
+        for (; i < n_words; i++)
+        {
+            sum += _mm_popcnt_u64(Load::get(a, b, i));
+        }
+        
+        return sum;
+    }
+#endif
+    
+    uint64_t scalar_popcount(const uint64_t* a, size_t n_words)
+    {
+        return scalar_count<load_one>(a, nullptr, n_words);
+    }
+    
+#ifdef LOC_X86
+    uint64_t popcnt_popcount(const uint64_t* a, size_t n_words)
+    {
+        return popcnt_count<load_one>(a, nullptr, n_words);
+    }
+    
+    uint64_t avx2_popcount(const uint64_t* a, size_t n_words)
+    {
+        return avx2_count<load_one>(a, nullptr, n_words);
+    }
+#endif
+    
+    //
+    //  set-bit extraction
+    //
+    
+    //  extract_sparse: Count-trailing-zeros / clear-lowest-bit loop; one
+    //      iteration per set bit.
+    uint32_t* extract_sparse(uint32_t* dest, uint64_t word, uint32_t offset)
+    {
+        while (word != 0u)
+        {
+            *dest++ = offset + util::bit_kernels::ctz64(word);
+            word &= word - 1u;
+        }
+        
+        return dest;
+    }
+    
+    uint32_t scalar_extract(uint32_t* out, const uint64_t* a, size_t n_words, uint32_t base)
+    {
+        uint32_t* dest = out;
+        
+        for (size_t i = 0; i < n_words; i++)
+        {
+            if (a[i] != 0u)
+            {
+                dest = extract_sparse(dest, a[i], base + uint32_t(i * 64));
+            }
+        }
+        
+        return uint32_t(dest - out);
+    }
+    
+#ifdef LOC_X86
+    //  positions of the set bits of each byte value, zero-padded to 8.
+    struct byte_positions_t
+    {
+        uint8_t index[256][8];
+        uint8_t count[256];
+    };
+    
+    byte_positions_t make_byte_positions()
+    {
+        byte_positions_t table = {};
+        
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t n = 0;
+            
+            for (uint32_t j = 0; j < 8; j++)
+            {
+                if (i & (1u << j))
+                {
+                    table.index[i][n++] = uint8_t(j);
+                }
+            }
+            
+            table.count[i] = uint8_t(n);
+        }
+        
+        return table;
+    }
+    
+    const byte_positions_t& get_byte_positions()
+    {
+        static const byte_positions_t table = make_byte_positions();
+        
+        return table;
+    }
+    
+    //  words with fewer set bits than these go through the ctz loop; denser
+    //  words are decoded a byte (avx2) or 16 bits (avx-512) at a time.
+    constexpr uint32_t AVX2_DENSE_BITS = 12u;
+    constexpr uint32_t AVX512_DENSE_BITS = 6u;
+    
+    LOC_TARGET("avx2,popcnt") uint32_t avx2_extract(uint32_t* out, const uint64_t* a, size_t n_words, uint32_t base)
+    {
+        const byte_positions_t& lut = get_byte_positions();
+        uint32_t* dest = out;
+        
+        for (size_t i = 0; i < n_words; i++)
+        {
+            uint64_t word = a[i];
+            uint32_t offset = base + uint32_t(i * 64);
+            
+            if (_mm_popcnt_u64(word) < AVX2_DENSE_BITS)
+            {
+                dest = extract_sparse(dest, word, offset);
+                continue;
+            }
+            
+            //  each store writes 8 indices, but `dest` only advances by the
+            //  number of set bits in the byte.
+            for (uint32_t j = 0; j < 8; j++)
+            {
+                uint32_t byte = uint32_t(word >> (j * 8)) & 0xffu;
+                __m128i positions = _mm_loadl_epi64((const __m128i*) lut.index[byte]);
+                __m256i indices = _mm256_add_epi32(_mm256_cvtepu8_epi32(positions),
+                                                   _mm256_set1_epi32(int(offset + j * 8)));
+                
+                _mm256_storeu_si256((__m256i*) dest, indices);
+                dest += lut.count[byte];
+            }
+        }
+        
+        return uint32_t(dest - out);
+    }
+    
+    LOC_TARGET("avx512f,popcnt") uint32_t avx512_extract(uint32_t* out, const uint64_t* a, size_t n_words, uint32_t base)
+    {
+        const __m512i iota = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        uint32_t* dest = out;
+        
+        for (size_t i = 0; i < n_words; i++)
+        {
+            uint64_t word = a[i];
+            uint32_t offset = base + uint32_t(i * 64);
+            
+            if (_mm_popcnt_u64(word) < AVX512_DENSE_BITS)
+            {
+                dest = extract_sparse(dest, word, offset);
+                continue;
+            }
+            
+            for (uint32_t j = 0; j < 4; j++)
+            {
+                __mmask16 mask = __mmask16(word >> (j * 16));
+                __m512i indices = _mm512_add_epi32(iota, _mm512_set1_epi32(int(offset + j * 16)));
+                
+                _mm512_storeu_si512((void*) dest, _mm512_maskz_compress_epi32(mask, indices));
+                dest += _mm_popcnt_u32(uint32_t(mask));
+            }
+        }
+        
+        return uint32_t(dest - out);
+    }
+#endif
+    
+    //
+    //  bit compaction
+    //
+    
+    //  bit_packer: Appends variable-width groups of bits to `out`. Whole
+    //      words are only written once complete, so a packer writing into
+    //      its own input never overtakes the word being read.
+    struct bit_packer
+    {
+        uint64_t* out;
+        uint64_t acc;
+        uint64_t n_bits;
+        
+        void push(uint64_t bits, uint32_t n)
+        {
+            uint32_t n_acc = uint32_t(n_bits & 63u);
+            
+            acc |= bits << n_acc;
+            n_bits += n;
+            
+            if (n_acc + n >= 64u)
+            {
+                *out++ = acc;
+                acc = n_acc == 0u ? 0u : bits >> (64u - n_acc);
+            }
+        }
+        
+        uint64_t finish()
+        {
+            if ((n_bits & 63u) != 0u)
+            {
+                *out = acc;
+            }
+            
+            return n_bits;
+        }
+    };
+    
+    //  scalar_pext: Portable parallel bit extract; one iteration per run of
+    //      set bits in `mask`.
+    uint64_t scalar_pext(uint64_t a, uint64_t mask)
+    {
+        uint64_t result = 0u;
+        uint32_t n = 0u;
+        
+        while (mask != 0u)
+        {
+            uint32_t start = util::bit_kernels::ctz64(mask);
+            uint64_t shifted = ~(mask >> start);
+            uint32_t length = shifted == 0u ? 64u - start : util::bit_kernels::ctz64(shifted);
+            uint64_t run = length == 64u ? ~uint64_t(0) : (uint64_t(1) << length) - 1u;
+            
+            result |= ((a >> start) & run) << n;
+            n += length;
+            
+            mask = start + length == 64u ? 0u : mask & (~uint64_t(0) << (start + length));
+        }
+        
+        return result;
+    }
+    
+    uint64_t scalar_compress(uint64_t* out, const uint64_t* a, const uint64_t* mask, size_t n_words)
+    {
+        bit_packer packer = { out, 0u, 0u };
+        
+        for (size_t i = 0; i < n_words; i++)
+        {
+            uint64_t m = mask[i];
+            
+            if (m == 0u)
+            {
+                continue;
+            }
+            
+            if (~m == 0u)
+            {
+                packer.push(a[i], 64u);
+                continue;
+            }
+            
+            packer.push(scalar_pext(a[i], m), util::bit_kernels::popcount64(m));
+        }
+        
+        return packer.finish();
+    }
+    
+#ifdef LOC_X86
+    LOC_TARGET("bmi2,popcnt") uint64_t bmi2_compress(uint64_t* out, const uint64_t* a, const uint64_t* mask, size_t n_words)
+    {
+        bit_packer packer = { out, 0u, 0u };
+        
+        for (size_t i = 0; i < n_words; i++)
+        {
+            uint64_t m = mask[i];
+            
+            if (m == 0u)
+            {
+                continue;
+            }
+            
+            packer.push(_pext_u64(a[i], m), uint32_t(_mm_popcnt_u64(m)));
+        }
+        
+        return packer.finish();
+    }
+#endif
+    
+    //
+    //  funnel shifts
+    //
+    
+    uint64_t funnel_shift_from(uint64_t* out, const uint64_t* a, size_t i, size_t n_words, uint32_t shift)
+    {
+        for (; i < n_words; i++)
+        {
+            out[i] = (a[i] << shift) | (a[i-1] >> (64u - shift));
+        }
+        
+        return a[n_words-1] >> (64u - shift);
+    }
+    
+    uint64_t scalar_funnel_shift(uint64_t* out, const uint64_t* a, size_t n_words, uint32_t shift)
+    {
+        out[0] |= a[0] << shift;
+        
+        return funnel_shift_from(out, a, 1, n_words, shift);
+    }
+    
+#ifdef LOC_X86
+    //  each output vector combines a[i..] shifted left with a[i-1..]
+    //  shifted right; both are unaligned loads of the same input.
+    LOC_TARGET("sse2") uint64_t sse2_funnel_shift(uint64_t* out, const uint64_t* a, size_t n_words, uint32_t shift)
+    {
+        const __m128i left = _mm_cvtsi32_si128(int(shift));
+        const __m128i right = _mm_cvtsi32_si128(int(64u - shift));
+        
+        out[0] |= a[0] << shift;
+        
+        size_t i = 1;
+        
+        for (; i + 2 <= n_words; i += 2)
+        {
+            __m128i hi = _mm_loadu_si128((const __m128i*) (a + i));
+            __m128i lo = _mm_loadu_si128((const __m128i*) (a + i - 1));
+            _mm_storeu_si128((__m128i*) (out + i), _mm_or_si128(_mm_sll_epi64(hi, left), _mm_srl_epi64(lo, right)));
+        }
+        
+        return funnel_shift_from(out, a, i, n_words, shift);
+    }
+    
+    LOC_TARGET("avx2") uint64_t avx2_funnel_shift(uint64_t* out, const uint64_t* a, size_t n_words, uint32_t shift)
+    {
+        const __m128i left = _mm_cvtsi32_si128(int(shift));
+        const __m128i right = _mm_cvtsi32_si128(int(64u - shift));
+        
+        out[0] |= a[0] << shift;
+        
+        size_t i = 1;
+        
+        for (; i + 4 <= n_words; i += 4)
+        {
+            __m256i hi = _mm256_loadu_si256((const __m256i*) (a + i));
+            __m256i lo = _mm256_loadu_si256((const __m256i*) (a + i - 1));
+            _mm256_storeu_si256((__m256i*) (out + i),
+                                _mm256_or_si256(_mm256_sll_epi64(hi, left), _mm256_srl_epi64(lo, right)));
+        }
+        
+        return funnel_shift_from(out, a, i, n_words, shift);
+    }
+    
+    LOC_TARGET("avx512f") uint64_t avx512_funnel_shift(uint64_t* out, const uint64_t* a, size_t n_words, uint32_t shift)
+    {
+        const __m128i left = _mm_cvtsi32_si128(int(shift));
+        const __m128i right = _mm_cvtsi32_si128(int(64u - shift));
+        
+        out[0] |= a[0] << shift;
+        
+        size_t i = 1;
+        
+        for (; i + 8 <= n_words; i += 8)
+        {
+            __m512i hi = _mm512_loadu_si512((const void*) (a + i));
+            __m512i lo = _mm512_loadu_si512((const void*) (a + i - 1));
+            _mm512_storeu_si512((void*) (out + i), _mm512_or_si512(_mm512_sll_epi64(hi, left), _mm512_srl_epi64(lo, right)));
+        }
+        
+        if (i < n_words)
+        {
+            __mmask8 mask = (__mmask8) ((1u << (n_words - i)) - 1u);
+            __m512i hi = _mm512_maskz_loadu_epi64(mask, (const void*) (a + i));
+            __m512i lo = _mm512_maskz_loadu_epi64(mask, (const void*) (a + i - 1));
+            _mm512_mask_storeu_epi64((void*) (out + i), mask,
+                                     _mm512_or_si512(_mm512_sll_epi64(hi, left), _mm512_srl_epi64(lo, right)));
+        }
+        
+        return a[n_words-1] >> (64u - shift);
+    }
+#endif
+    
+    //
+    //  cpu detection
+    //
+    
+#ifdef LOC_X86
+#ifdef _MSC_VER
+    bool cpu_has_avx2()
+    {
+        int info[4];
+        __cpuid(info, 0);
+        
+        if (info[0] < 7)
+        {
+            return false;
+        }
+        
+        __cpuid(info, 1);
+        
+        bool has_osxsave = (info[2] & (1 << 27)) != 0;
+        bool has_avx = (info[2] & (1 << 28)) != 0;
+        
+        if (!has_osxsave || !has_avx || (_xgetbv(0) & 0x6) != 0x6)
+        {
+            return false;
+        }
+        
+        __cpuidex(info, 7, 0);
+        
+        return (info[1] & (1 << 5)) != 0;
+    }
+    
+    bool cpu_has_avx512f()
+    {
+        if (!cpu_has_avx2())
+        {
+            return false;
+        }
+        
+        //  opmask, upper zmm and hi16 zmm state must be enabled by the os.
+        if ((_xgetbv(0) & 0xe6) != 0xe6)
+        {
+            return false;
+        }
+        
+        int info[4];
+        __cpuidex(info, 7, 0);
+        
+        return (info[1] & (1 << 16)) != 0;
+    }
+    
+    bool cpu_has_popcnt()
+    {
+        int info[4];
+        __cpuid(info, 1);
+        
+        return (info[2] & (1 << 23)) != 0;
+    }
+    
+    bool cpu_has_bmi2()
+    {
+        int info[4];
+        __cpuid(info, 0);
+        
+        if (info[0] < 7)
+        {
+            return false;
+        }
+        
+        __cpuidex(info, 7, 0);
+        
+        return (info[1] & (1 << 8)) != 0;
+    }
+#else
+    bool cpu_has_popcnt()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("popcnt");
+    }
+    
+    bool cpu_has_avx2()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+    
+    bool cpu_has_bmi2()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("bmi2");
+    }
+    
+    bool cpu_has_avx512f()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f");
+    }
+#endif
+#endif
+    
+    //
+    //  tables
+    //
+    
+    util::bit_kernels::table_t make_table(uint32_t level)
+    {
+        using util::simd_level;
+        
+        util::bit_kernels::table_t table = {
+            simd_level::SCALAR, "scalar",
+            &scalar_binary<op_or>, &scalar_binary<op_and>,
+            &scalar_binary<op_and_not>, &scalar_binary<op_eq>,
+            &scalar_popcount, &scalar_count<load_and>, &scalar_count<load_and_not>,
+            &scalar_extract, &scalar_compress, &scalar_funnel_shift
+        };
+        
+#ifdef LOC_X86
+        //  popcnt is not part of the x86-64 baseline, so the sse2 level
+        //  only uses it where present.
+        if (level >= simd_level::SSE2 && cpu_has_popcnt())
+        {
+            table.popcount = &popcnt_popcount;
+            table.and_count = &popcnt_count<load_and>;
+            table.and_not_count = &popcnt_count<load_and_not>;
+        }
+        
+        //  bmi2 is likewise detected separately; every avx2 cpu in practice
+        //  has it, but it is not implied.
+        if (level >= simd_level::AVX2 && cpu_has_bmi2() && cpu_has_popcnt())
+        {
+            table.compress = &bmi2_compress;
+        }
+        
+        switch (level)
+        {
+            case simd_level::SSE2:
+                table.level = simd_level::SSE2;
+                table.name = "sse2";
+                table.dot_or = &sse2_binary<op_or>;
+                table.dot_and = &sse2_binary<op_and>;
+                table.dot_and_not = &sse2_binary<op_and_not>;
+                table.dot_eq = &sse2_binary<op_eq>;
+                table.funnel_shift = &sse2_funnel_shift;
+                break;
+            case simd_level::AVX2:
+            case simd_level::AVX512:
+                table.level = simd_level::AVX2;
+                table.name = "avx2";
+                table.dot_or = &avx2_binary<op_or>;
+                table.dot_and = &avx2_binary<op_and>;
+                table.dot_and_not = &avx2_binary<op_and_not>;
+                table.dot_eq = &avx2_binary<op_eq>;
+                table.popcount = &avx2_popcount;
+                table.and_count = &avx2_count<load_and>;
+                table.and_not_count = &avx2_count<load_and_not>;
+                table.extract = &avx2_extract;
+                table.funnel_shift = &avx2_funnel_shift;
+                break;
+        }
+        
+        //  avx-512 counts reuse the avx2 harley-seal kernels; the
+        //  vpopcntq extension is not assumed.
+        if (level == simd_level::AVX512)
+        {
+            table.level = simd_level::AVX512;
+            table.name = "avx512";
+            table.dot_or = &avx512_binary<op_or>;
+            table.dot_and = &avx512_binary<op_and>;
+            table.dot_and_not = &avx512_binary<op_and_not>;
+            table.dot_eq = &avx512_binary<op_eq>;
+            table.extract = &avx512_extract;
+            table.funnel_shift = &avx512_funnel_shift;
+        }
+#endif
+        
+        return table;
+    }
+}
+
+uint32_t util::bit_kernels::detect_simd_level()
+{
+#ifdef LOC_X86
+    if (cpu_has_avx512f())
+    {
+        return util::simd_level::AVX512;
+    }
+    
+    if (cpu_has_avx2())
+    {
+        return util::simd_level::AVX2;
+    }
+    
+    //  sse2 is part of the x86-64 baseline
+    return util::simd_level::SSE2;
+#else
+    return util::simd_level::SCALAR;
+#endif
+}
+
+bool util::bit_kernels::is_supported(uint32_t level)
+{
+    static const uint32_t max_level = detect_simd_level();
+    
+    return level <= max_level;
+}
+
+const util::bit_kernels::table_t& util::bit_kernels::get()
+{
+    static const table_t& table = get(detect_simd_level());
+    
+    return table;
+}
+
+const util::bit_kernels::table_t& util::bit_kernels::get(uint32_t level)
+{
+    if (!is_supported(level))
+    {
+        throw std::runtime_error("Simd level is not supported.");
+    }
+    
+    static const table_t tables[util::simd_level::N_LEVELS] = {
+        make_table(util::simd_level::SCALAR),
+        make_table(util::simd_level::SSE2),
+        make_table(util::simd_level::AVX2),
+        make_table(util::simd_level::AVX512)
+    };
+    
+    return tables[level];
+}
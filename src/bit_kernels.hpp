@@ -0,0 +1,89 @@
+//
+//  bit_kernels.hpp
+//  locator
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace util {
+    struct simd_level {
+        static constexpr uint32_t SCALAR = 0u;
+        static constexpr uint32_t SSE2 = 1u;
+        static constexpr uint32_t AVX2 = 2u;
+        static constexpr uint32_t AVX512 = 3u;
+        static constexpr uint32_t N_LEVELS = 4u;
+    };
+    
+    namespace bit_kernels {
+        typedef void (*binary_op_t)(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n_words);
+        typedef uint64_t (*count_op_t)(const uint64_t* a, size_t n_words);
+        typedef uint64_t (*binary_count_op_t)(const uint64_t* a, const uint64_t* b, size_t n_words);
+        typedef uint32_t (*extract_op_t)(uint32_t* out, const uint64_t* a, size_t n_words, uint32_t base);
+        typedef uint64_t (*compress_op_t)(uint64_t* out, const uint64_t* a, const uint64_t* mask, size_t n_words);
+        typedef uint64_t (*funnel_op_t)(uint64_t* out, const uint64_t* a, size_t n_words, uint32_t shift);
+        
+        //  extract may write up to this many elements past the last index
+        //  it returns.
+        constexpr uint32_t EXTRACT_SLACK = 16u;
+        
+        struct table_t {
+            uint32_t level;
+            const char* name;
+            binary_op_t dot_or;
+            binary_op_t dot_and;
+            binary_op_t dot_and_not;
+            binary_op_t dot_eq;
+            //  number of set bits in a, a & b, and a & ~b
+            count_op_t popcount;
+            binary_count_op_t and_count;
+            binary_count_op_t and_not_count;
+            //  writes base + i for each set bit i of a, in ascending order,
+            //  and returns the number written
+            extract_op_t extract;
+            //  packs the bits of a selected by mask into consecutive bits of
+            //  out, and returns the number packed. out may alias a.
+            compress_op_t compress;
+            //  out[0] |= a[0] << shift, and out[i] = a[i] << shift | a[i-1] >>
+            //  (64 - shift) for i in [1, n_words); returns the bits shifted
+            //  out of a[n_words-1]. shift is in [1, 63], n_words > 0, and
+            //  out may not overlap a.
+            funnel_op_t funnel_shift;
+        };
+        
+        //  ctz64: Index of the lowest set bit; `x` must be non-zero.
+        inline uint32_t ctz64(uint64_t x)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward64(&index, x);
+            return uint32_t(index);
+#else
+            return uint32_t(__builtin_ctzll(x));
+#endif
+        }
+        
+        inline uint32_t popcount64(uint64_t x)
+        {
+            x = x - ((x >> 1) & 0x5555555555555555ull);
+            x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+            return uint32_t((((x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full) * 0x0101010101010101ull) >> 56);
+        }
+        
+        //  detect_simd_level: Highest level supported by both the
+        //      compiler and the current cpu.
+        uint32_t detect_simd_level();
+        bool is_supported(uint32_t level);
+        
+        //  get: Kernels for the highest supported level. Selected once,
+        //      on first use.
+        const table_t& get();
+        const table_t& get(uint32_t level);
+    }
+}
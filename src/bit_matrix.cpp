@@ -0,0 +1,338 @@
+//
+//  bit_matrix.cpp
+//  locator
+//
+
+#include "bit_matrix.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <vector>
+
+constexpr uint32_t util::bit_matrix::LINE_WORDS;
+
+util::bit_matrix::bit_matrix()
+{
+    m_n_rows = 0;
+    m_size = 0;
+    m_stride = 0;
+}
+
+util::bit_matrix::bit_matrix(uint32_t n_rows, uint32_t size) :
+    m_data(get_data_size(n_rows, get_stride(size)))
+{
+    m_n_rows = n_rows;
+    m_size = size;
+    m_stride = get_stride(size);
+    
+    fill(false);
+}
+
+bool util::bit_matrix::operator ==(const util::bit_matrix& other) const
+{
+    if (m_n_rows != other.m_n_rows || m_size != other.m_size)
+    {
+        return false;
+    }
+    
+    //  padding is zero in both
+    size_t n_bytes = size_t(m_n_rows) * m_stride * sizeof(uint64_t);
+    
+    return n_bytes == 0 || std::memcmp(m_data.unsafe_get_pointer(), other.m_data.unsafe_get_pointer(), n_bytes) == 0;
+}
+
+bool util::bit_matrix::operator !=(const util::bit_matrix& other) const
+{
+    return !(*this == other);
+}
+
+uint32_t util::bit_matrix::n_rows() const
+{
+    return m_n_rows;
+}
+
+uint32_t util::bit_matrix::size() const
+{
+    return m_size;
+}
+
+uint32_t util::bit_matrix::stride() const
+{
+    return m_stride;
+}
+
+size_t util::bit_matrix::bytes() const
+{
+    return sizeof(*this) + size_t(m_data.size()) * sizeof(uint64_t);
+}
+
+bool util::bit_matrix::at(uint32_t row, uint32_t index) const
+{
+    if (row >= m_n_rows || index >= m_size)
+    {
+        throw std::runtime_error("Index exceeds matrix dimensions.");
+    }
+    
+    return (row_data(row)[index / 64u] >> (index % 64u)) & 1u;
+}
+
+uint32_t util::bit_matrix::row_sum(uint32_t row) const
+{
+    return uint32_t(util::bit_kernels::get().popcount(row_data(row), m_stride));
+}
+
+bool util::bit_matrix::row_any(uint32_t row) const
+{
+    const uint64_t* data = row_data(row);
+    
+    for (uint32_t i = 0; i < m_stride; i++)
+    {
+        if (data[i] != 0)
+        {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void util::bit_matrix::unchecked_place(bool value, uint32_t row, uint32_t index)
+{
+    uint64_t* word = unsafe_row_data(row) + index / 64u;
+    uint64_t bit = uint64_t(1) << (index % 64u);
+    
+    *word = value ? (*word | bit) : (*word & ~bit);
+}
+
+void util::bit_matrix::fill(bool value)
+{
+    for (uint32_t i = 0; i < m_n_rows; i++)
+    {
+        fill_row(i, value);
+    }
+}
+
+void util::bit_matrix::fill_row(uint32_t row, bool value)
+{
+    //  rows of size 0 have no words, and the slab may be unallocated
+    if (m_stride == 0)
+    {
+        return;
+    }
+    
+    uint64_t* data = unsafe_row_data(row);
+    uint32_t n_words = get_n_words(m_size);
+    
+    std::memset(data, value ? 0xff : 0, n_words * sizeof(uint64_t));
+    std::memset(data + n_words, 0, (m_stride - n_words) * sizeof(uint64_t));
+    
+    if (value && m_size % 64u != 0)
+    {
+        data[n_words-1] &= (uint64_t(1) << (m_size % 64u)) - 1u;
+    }
+}
+
+void util::bit_matrix::set_row(uint32_t row, const util::bit_array& a)
+{
+    if (a.size() != m_size)
+    {
+        throw std::runtime_error("Dimension mismatch.");
+    }
+    
+    uint32_t n_words = get_n_words(m_size);
+    
+    if (n_words == 0)
+    {
+        return;
+    }
+    
+    uint64_t* data = unsafe_row_data(row);
+    
+    std::memcpy(data, a.m_data.unsafe_get_pointer(), (n_words - 1) * sizeof(uint64_t));
+    
+    data[n_words-1] = a.get_final_bin_with_zeros();
+}
+
+util::bit_array util::bit_matrix::to_bit_array(uint32_t row) const
+{
+    util::bit_array result(m_size);
+    uint32_t n_words = get_n_words(m_size);
+    
+    if (n_words > 0)
+    {
+        std::memcpy(result.m_data.unsafe_get_pointer(), row_data(row), n_words * sizeof(uint64_t));
+    }
+    
+    return result;
+}
+
+void util::bit_matrix::resize_rows(uint32_t to_rows)
+{
+    uint32_t orig_rows = m_n_rows;
+    
+    m_data.resize(get_data_size(to_rows, m_stride));
+    m_n_rows = to_rows;
+    
+    for (uint32_t i = orig_rows; i < to_rows; i++)
+    {
+        fill_row(i, false);
+    }
+}
+
+void util::bit_matrix::resize(uint32_t to_size)
+{
+    uint32_t orig_size = m_size;
+    uint32_t orig_stride = m_stride;
+    uint32_t new_stride = get_stride(to_size);
+    
+    if (new_stride > orig_stride)
+    {
+        //  rows move toward the end, so the last row moves first
+        m_data.resize(get_data_size(m_n_rows, new_stride));
+        
+        uint64_t* data = m_data.unsafe_get_pointer();
+        
+        for (uint32_t i = m_n_rows; i-- > 0; )
+        {
+            uint64_t* dest = data + size_t(i) * new_stride;
+            
+            std::memmove(dest, data + size_t(i) * orig_stride, orig_stride * sizeof(uint64_t));
+            std::memset(dest + orig_stride, 0, (new_stride - orig_stride) * sizeof(uint64_t));
+        }
+    }
+    else if (new_stride < orig_stride)
+    {
+        uint64_t* data = m_data.unsafe_get_pointer();
+        
+        for (uint32_t i = 1; i < m_n_rows; i++)
+        {
+            std::memmove(data + size_t(i) * new_stride, data + size_t(i) * orig_stride, new_stride * sizeof(uint64_t));
+        }
+        
+        m_data.resize(get_data_size(m_n_rows, new_stride));
+    }
+    
+    m_stride = new_stride;
+    m_size = to_size;
+    
+    if (to_size < orig_size)
+    {
+        clear_past_size();
+    }
+}
+
+void util::bit_matrix::unchecked_keep(const util::dynamic_array<uint32_t>& at_indices, int32_t index_offset)
+{
+    uint32_t new_size = at_indices.tail();
+    uint32_t* at_indices_ptr = at_indices.unsafe_get_pointer();
+    
+    util::bit_matrix kept(m_n_rows, new_size);
+    
+    for (uint32_t i = 0; i < m_n_rows; i++)
+    {
+        const uint64_t* src = row_data(i);
+        uint64_t* dest = kept.unsafe_row_data(i);
+        
+        for (uint32_t j = 0; j < new_size; j++)
+        {
+            uint32_t idx = at_indices_ptr[j] + index_offset;
+            
+            dest[j / 64u] |= ((src[idx / 64u] >> (idx % 64u)) & 1u) << (j % 64u);
+        }
+    }
+    
+    *this = std::move(kept);
+}
+
+void util::bit_matrix::unchecked_compress(const util::bit_array& mask)
+{
+    uint32_t n_words = get_n_words(m_size);
+    
+    if (n_words == 0)
+    {
+        return;
+    }
+    
+    //  bits of the final mask word past the end are not guaranteed to be
+    //  zero
+    std::vector<uint64_t> mask_words(mask.m_data.unsafe_get_pointer(), mask.m_data.unsafe_get_pointer() + n_words);
+    mask_words[n_words-1] = mask.get_final_bin_with_zeros();
+    
+    uint32_t new_size = 0;
+    
+    //  each row is packed in place, then moved to its new stride
+    for (uint32_t i = 0; i < m_n_rows; i++)
+    {
+        uint64_t* data = unsafe_row_data(i);
+        
+        new_size = uint32_t(util::bit_kernels::get().compress(data, data, mask_words.data(), n_words));
+    }
+    
+    if (m_n_rows == 0)
+    {
+        new_size = uint32_t(util::bit_kernels::get().popcount(mask_words.data(), n_words));
+    }
+    
+    resize(new_size);
+}
+
+const uint64_t* util::bit_matrix::row_data(uint32_t row) const
+{
+    return m_data.unsafe_get_pointer() + size_t(row) * m_stride;
+}
+
+uint64_t* util::bit_matrix::unsafe_row_data(uint32_t row)
+{
+    return m_data.unsafe_get_pointer() + size_t(row) * m_stride;
+}
+
+//  get_stride: Words per row for rows of `size` bits, rounded up to whole
+//      cache lines.
+
+uint32_t util::bit_matrix::get_stride(uint32_t size)
+{
+    uint32_t n_words = get_n_words(size);
+    
+    return (n_words + LINE_WORDS - 1) / LINE_WORDS * LINE_WORDS;
+}
+
+uint32_t util::bit_matrix::get_n_words(uint32_t size)
+{
+    return uint32_t((uint64_t(size) + 63u) / 64u);
+}
+
+uint32_t util::bit_matrix::get_data_size(uint32_t n_rows, uint32_t stride)
+{
+    uint64_t n_words = uint64_t(n_rows) * stride;
+    
+    if (n_words > uint64_t(~uint32_t(0)))
+    {
+        throw std::runtime_error("Matrix dimensions exceed the maximum size.");
+    }
+    
+    return uint32_t(n_words);
+}
+
+//  clear_past_size: Zero the bits past size() in each row, after the rows
+//      have been shortened in place.
+
+void util::bit_matrix::clear_past_size()
+{
+    if (m_stride == 0)
+    {
+        return;
+    }
+    
+    uint32_t n_words = get_n_words(m_size);
+    
+    for (uint32_t i = 0; i < m_n_rows; i++)
+    {
+        uint64_t* data = unsafe_row_data(i);
+        
+        std::memset(data + n_words, 0, (m_stride - n_words) * sizeof(uint64_t));
+        
+        if (m_size % 64u != 0)
+        {
+            data[n_words-1] &= (uint64_t(1) << (m_size % 64u)) - 1u;
+        }
+    }
+}
@@ -0,0 +1,109 @@
+//
+//  bit_matrix.hpp
+//  locator
+//
+
+#pragma once
+
+#include "bit_array.hpp"
+#include "dynamic_array.hpp"
+#include "bit_kernels.hpp"
+#include <cstdint>
+#include <cstddef>
+
+namespace util {
+    class bit_matrix;
+}
+
+//  bit_matrix: Rows of bits, all of the same size, held one after another
+//      in a single cache-line aligned slab.
+//
+//      Each row spans stride() words, a whole number of cache lines, so
+//      every row starts on a line of its own and neighboring rows are
+//      adjacent in memory. Copying the matrix is one allocation and one
+//      copy, and adding or removing rows at the end is one reallocation.
+//      Bits past size() in each row are always zero.
+
+class util::bit_matrix
+{
+public:
+    bit_matrix();
+    explicit bit_matrix(uint32_t n_rows, uint32_t size);
+    
+    bool operator ==(const bit_matrix& other) const;
+    bool operator !=(const bit_matrix& other) const;
+    
+    uint32_t n_rows() const;
+    //  size: Bits per row.
+    uint32_t size() const;
+    //  stride: Words per row, padding included.
+    uint32_t stride() const;
+    //  bytes: Approximate heap + object size.
+    size_t bytes() const;
+    
+    bool at(uint32_t row, uint32_t index) const;
+    uint32_t row_sum(uint32_t row) const;
+    bool row_any(uint32_t row) const;
+    
+    void unchecked_place(bool value, uint32_t row, uint32_t index);
+    void fill(bool value);
+    void fill_row(uint32_t row, bool value);
+    
+    //  set_row: Copy `a`, which must have size() bits, into `row`.
+    void set_row(uint32_t row, const util::bit_array& a);
+    util::bit_array to_bit_array(uint32_t row) const;
+    
+    //  resize_rows: Add rows without set bits, or remove rows from the end.
+    void resize_rows(uint32_t to_rows);
+    //  resize: Set the bits per row. Rows are moved only if the stride
+    //      changes; added bits are false.
+    void resize(uint32_t to_size);
+    
+    //  unchecked_keep / unchecked_compress: As in bit_array, applied to
+    //      every row.
+    void unchecked_keep(const util::dynamic_array<uint32_t>& at_indices, int32_t index_offset = 0);
+    void unchecked_compress(const util::bit_array& mask);
+    
+    const uint64_t* row_data(uint32_t row) const;
+    uint64_t* unsafe_row_data(uint32_t row);
+    
+    //  for_each_set_bit: Call `func(index)` for each set bit of `row`, in
+    //      ascending order.
+    template<typename F>
+    static void for_each_set_bit(const bit_matrix& m, uint32_t row, F&& func);
+    
+    static constexpr uint32_t LINE_WORDS = 8u;
+private:
+    util::dynamic_array<uint64_t> m_data;
+    uint32_t m_n_rows;
+    uint32_t m_size;
+    uint32_t m_stride;
+    
+    static uint32_t get_stride(uint32_t size);
+    static uint32_t get_n_words(uint32_t size);
+    static uint32_t get_data_size(uint32_t n_rows, uint32_t stride);
+    
+    void clear_past_size();
+};
+
+//
+//  impl
+//
+
+template<typename F>
+void util::bit_matrix::for_each_set_bit(const bit_matrix& m, uint32_t row, F&& func)
+{
+    const uint64_t* data = m.row_data(row);
+    uint32_t n_words = get_n_words(m.m_size);
+    
+    for (uint32_t i = 0; i < n_words; i++)
+    {
+        uint64_t word = data[i];
+        
+        while (word != 0)
+        {
+            func(i * 64u + util::bit_kernels::ctz64(word));
+            word &= word - 1;
+        }
+    }
+}
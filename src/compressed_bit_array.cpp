@@ -0,0 +1,1403 @@
+//
+//  compressed_bit_array.cpp
+//  locator
+//
+
+#include "compressed_bit_array.hpp"
+#include "bit_kernels.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <iterator>
+
+constexpr uint32_t util::compressed_bit_array::CHUNK_SIZE;
+constexpr uint32_t util::compressed_bit_array::CHUNK_WORDS;
+constexpr uint32_t util::compressed_bit_array::ARRAY_MAX;
+
+util::compressed_bit_array::compressed_bit_array()
+{
+    m_size = 0;
+}
+
+util::compressed_bit_array::compressed_bit_array(uint32_t size)
+{
+    m_size = size;
+}
+
+util::compressed_bit_array::compressed_bit_array(const util::bit_array& dense)
+{
+    m_size = dense.size();
+    
+    uint32_t n_chunks = get_n_chunks();
+    std::vector<uint64_t> words(CHUNK_WORDS);
+    
+    for (uint32_t i = 0; i < n_chunks; i++)
+    {
+        dense_chunk(dense, i, words.data());
+        
+        container c = from_words(words.data());
+        
+        if (c.cardinality > 0)
+        {
+            m_keys.push_back(uint16_t(i));
+            m_containers.push_back(std::move(c));
+        }
+    }
+}
+
+util::compressed_bit_array::compressed_bit_array(uint32_t size, const uint32_t* indices, uint32_t n_indices)
+{
+    m_size = size;
+    
+    std::vector<uint16_t> values;
+    uint32_t i = 0;
+    
+    while (i < n_indices)
+    {
+        uint16_t key = uint16_t(indices[i] >> 16);
+        
+        values.clear();
+        
+        for (; i < n_indices && (indices[i] >> 16) == key; i++)
+        {
+            values.push_back(uint16_t(indices[i] & 0xffffu));
+        }
+        
+        m_keys.push_back(key);
+        m_containers.push_back(from_values(values.data(), uint32_t(values.size())));
+    }
+}
+
+bool util::compressed_bit_array::operator ==(const util::compressed_bit_array& other) const
+{
+    if (m_size != other.m_size || m_keys != other.m_keys)
+    {
+        return false;
+    }
+    
+    std::vector<uint64_t> a_words(CHUNK_WORDS);
+    std::vector<uint64_t> b_words(CHUNK_WORDS);
+    
+    for (uint32_t i = 0; i < m_containers.size(); i++)
+    {
+        const container& a = m_containers[i];
+        const container& b = other.m_containers[i];
+        
+        if (a.cardinality != b.cardinality)
+        {
+            return false;
+        }
+        
+        if (a.type == b.type && a.type != container_type::BITMAP)
+        {
+            if (a.values != b.values)
+            {
+                return false;
+            }
+            
+            continue;
+        }
+        
+        to_words(a, a_words.data());
+        to_words(b, b_words.data());
+        
+        if (a_words != b_words)
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool util::compressed_bit_array::operator !=(const util::compressed_bit_array& other) const
+{
+    return !(*this == other);
+}
+
+uint32_t util::compressed_bit_array::size() const
+{
+    return m_size;
+}
+
+uint32_t util::compressed_bit_array::sum() const
+{
+    uint32_t total = 0;
+    
+    for (const container& c : m_containers)
+    {
+        total += c.cardinality;
+    }
+    
+    return total;
+}
+
+bool util::compressed_bit_array::any() const
+{
+    return !m_containers.empty();
+}
+
+bool util::compressed_bit_array::at(uint32_t index) const
+{
+    bool was_found;
+    uint32_t idx = find_key(index >> 16, &was_found);
+    
+    if (!was_found)
+    {
+        return false;
+    }
+    
+    return contains(m_containers[idx], uint16_t(index & 0xffffu));
+}
+
+size_t util::compressed_bit_array::bytes() const
+{
+    size_t total = sizeof(*this) + m_keys.capacity() * sizeof(uint16_t);
+    
+    for (const container& c : m_containers)
+    {
+        total += sizeof(container);
+        total += c.values.capacity() * sizeof(uint16_t);
+        total += c.words.capacity() * sizeof(uint64_t);
+    }
+    
+    return total;
+}
+
+void util::compressed_bit_array::place(bool value, uint32_t at_index)
+{
+    if (at_index >= m_size)
+    {
+        throw std::runtime_error("Index exceeds array dimensions.");
+    }
+    
+    unchecked_place(value, at_index);
+}
+
+void util::compressed_bit_array::unchecked_place(bool value, uint32_t at_index)
+{
+    uint32_t key = at_index >> 16;
+    uint16_t offset = uint16_t(at_index & 0xffffu);
+    
+    bool was_found;
+    uint32_t idx = find_key(key, &was_found);
+    
+    if (!was_found)
+    {
+        if (value)
+        {
+            m_keys.insert(m_keys.begin() + idx, uint16_t(key));
+            m_containers.insert(m_containers.begin() + idx, from_values(&offset, 1));
+        }
+        
+        return;
+    }
+    
+    container& c = m_containers[idx];
+    
+    if (contains(c, offset) == value)
+    {
+        return;
+    }
+    
+    if (c.type == container_type::ARRAY && (!value || c.cardinality < ARRAY_MAX))
+    {
+        auto it = std::lower_bound(c.values.begin(), c.values.end(), offset);
+        
+        if (value)
+        {
+            c.values.insert(it, offset);
+            c.cardinality++;
+        }
+        else
+        {
+            c.values.erase(it);
+            c.cardinality--;
+        }
+    }
+    else if (c.type == container_type::BITMAP)
+    {
+        uint64_t bit = uint64_t(1) << (offset & 63u);
+        
+        if (value)
+        {
+            c.words[offset >> 6] |= bit;
+            c.cardinality++;
+        }
+        else
+        {
+            c.words[offset >> 6] &= ~bit;
+            c.cardinality--;
+        }
+    }
+    else
+    {
+        //  runs, or an array that would exceed ARRAY_MAX
+        std::vector<uint64_t> words(CHUNK_WORDS);
+        to_words(c, words.data());
+        
+        uint64_t bit = uint64_t(1) << (offset & 63u);
+        words[offset >> 6] = value ? (words[offset >> 6] | bit) : (words[offset >> 6] & ~bit);
+        
+        c = from_words(words.data());
+    }
+    
+    if (c.cardinality == 0)
+    {
+        m_keys.erase(m_keys.begin() + idx);
+        m_containers.erase(m_containers.begin() + idx);
+    }
+}
+
+void util::compressed_bit_array::fill(bool value)
+{
+    m_keys.clear();
+    m_containers.clear();
+    
+    if (!value)
+    {
+        return;
+    }
+    
+    uint32_t n_chunks = get_n_chunks();
+    
+    for (uint32_t i = 0; i < n_chunks; i++)
+    {
+        uint32_t n_in_chunk = std::min(m_size - i * CHUNK_SIZE, CHUNK_SIZE);
+        
+        container c;
+        c.type = container_type::RUN;
+        c.cardinality = n_in_chunk;
+        c.values = { 0u, uint16_t(n_in_chunk - 1) };
+        
+        m_keys.push_back(uint16_t(i));
+        m_containers.push_back(std::move(c));
+    }
+}
+
+void util::compressed_bit_array::empty()
+{
+    m_keys.clear();
+    m_containers.clear();
+    m_size = 0;
+}
+
+void util::compressed_bit_array::resize(uint32_t to_size)
+{
+    if (to_size >= m_size)
+    {
+        m_size = to_size;
+        return;
+    }
+    
+    m_size = to_size;
+    
+    uint32_t n_chunks = get_n_chunks();
+    
+    while (!m_keys.empty() && m_keys.back() >= n_chunks)
+    {
+        m_keys.pop_back();
+        m_containers.pop_back();
+    }
+    
+    uint32_t n_in_last = to_size % CHUNK_SIZE;
+    
+    if (n_in_last == 0 || m_keys.empty() || m_keys.back() != n_chunks - 1)
+    {
+        return;
+    }
+    
+    //  clear the bits beyond the new size in the final chunk
+    std::vector<uint64_t> words(CHUNK_WORDS);
+    to_words(m_containers.back(), words.data());
+    
+    uint32_t n_full_words = n_in_last / 64;
+    uint32_t n_rem = n_in_last % 64;
+    
+    if (n_rem > 0)
+    {
+        words[n_full_words] &= (uint64_t(1) << n_rem) - 1u;
+        n_full_words++;
+    }
+    
+    std::fill(words.begin() + n_full_words, words.end(), 0u);
+    
+    container c = from_words(words.data());
+    
+    if (c.cardinality == 0)
+    {
+        m_keys.pop_back();
+        m_containers.pop_back();
+    }
+    else
+    {
+        m_containers.back() = std::move(c);
+    }
+}
+
+void util::compressed_bit_array::append(const util::compressed_bit_array& other)
+{
+    uint32_t offset = m_size;
+    
+    m_size += other.m_size;
+    
+    //  chunk-aligned: containers are copied as-is
+    if (offset % CHUNK_SIZE == 0)
+    {
+        uint32_t key_offset = offset / CHUNK_SIZE;
+        
+        for (uint32_t i = 0; i < other.m_keys.size(); i++)
+        {
+            m_keys.push_back(uint16_t(other.m_keys[i] + key_offset));
+            m_containers.push_back(other.m_containers[i]);
+        }
+        
+        return;
+    }
+    
+    uint32_t first_changed = uint32_t(m_containers.size());
+    
+    if (!m_keys.empty() && m_keys.back() == offset / CHUNK_SIZE)
+    {
+        first_changed--;
+    }
+    
+    util::dynamic_array<uint32_t> indices = find(other, offset);
+    uint32_t* indices_ptr = indices.unsafe_get_pointer();
+    uint32_t n_indices = indices.tail();
+    
+    for (uint32_t i = 0; i < n_indices; i++)
+    {
+        unchecked_push_back(indices_ptr[i]);
+    }
+    
+    shrink_containers(first_changed);
+}
+
+void util::compressed_bit_array::unchecked_keep(const util::dynamic_array<uint32_t>& at_indices, int32_t index_offset)
+{
+    uint32_t new_size = at_indices.tail();
+    uint32_t* at_indices_ptr = at_indices.unsafe_get_pointer();
+    
+    compressed_bit_array result(new_size);
+    
+    for (uint32_t i = 0; i < new_size; i++)
+    {
+        if (at(at_indices_ptr[i] + index_offset))
+        {
+            result.unchecked_push_back(i);
+        }
+    }
+    
+    result.shrink_containers(0);
+    
+    *this = std::move(result);
+}
+
+void util::compressed_bit_array::unchecked_compress(const util::bit_array& mask)
+{
+    const util::bit_kernels::table_t& kernels = util::bit_kernels::get();
+    const util::bit_array::word_t* mask_data = mask.m_data.unsafe_get_pointer();
+    
+    compressed_bit_array result(mask.sum());
+    std::vector<uint32_t> indices(CHUNK_SIZE + util::bit_kernels::EXTRACT_SLACK);
+    
+    //  rank is the number of mask bits set in words [0, n_counted).
+    uint32_t n_counted = 0;
+    uint32_t rank = 0;
+    
+    for (uint32_t i = 0; i < m_keys.size(); i++)
+    {
+        uint32_t base = uint32_t(m_keys[i]) * CHUNK_SIZE;
+        uint32_t n_indices = extract(m_containers[i], indices.data(), base);
+        
+        for (uint32_t j = 0; j < n_indices; j++)
+        {
+            uint32_t word = indices[j] / 64u;
+            uint32_t bit = indices[j] % 64u;
+            
+            if (word > n_counted)
+            {
+                rank += uint32_t(kernels.popcount(mask_data + n_counted, word - n_counted));
+                n_counted = word;
+            }
+            
+            uint64_t m = mask_data[word];
+            
+            if ((m >> bit) & 1u)
+            {
+                uint64_t below = m & ((uint64_t(1) << bit) - 1u);
+                result.unchecked_push_back(rank + util::bit_kernels::popcount64(below));
+            }
+        }
+    }
+    
+    result.shrink_containers(0);
+    
+    *this = std::move(result);
+}
+
+util::bit_array util::compressed_bit_array::to_bit_array() const
+{
+    util::bit_array result(m_size, false);
+    
+    unchecked_or_into(result);
+    
+    return result;
+}
+
+void util::compressed_bit_array::unchecked_or(const util::bit_array& b)
+{
+    unchecked_or(b, 0, m_size);
+}
+
+void util::compressed_bit_array::unchecked_and_not(const util::bit_array& b)
+{
+    unchecked_and_not(b, 0, m_size);
+}
+
+void util::compressed_bit_array::unchecked_or(const util::bit_array& b, uint32_t start, uint32_t stop)
+{
+    uint32_t first_chunk;
+    uint32_t stop_chunk;
+    uint32_t own_idx;
+    uint32_t own_stop;
+    
+    get_chunk_range(start, stop, &first_chunk, &stop_chunk, &own_idx, &own_stop);
+    
+    std::vector<uint16_t> keys;
+    std::vector<container> containers;
+    std::vector<uint64_t> words(CHUNK_WORDS);
+    std::vector<uint64_t> own_words(CHUNK_WORDS);
+    
+    uint32_t first_idx = own_idx;
+    
+    for (uint32_t i = first_chunk; i < stop_chunk; i++)
+    {
+        bool has_own = own_idx < own_stop && m_keys[own_idx] == i;
+        
+        dense_chunk(b, i, words.data());
+        
+        if (has_own)
+        {
+            to_words(m_containers[own_idx], own_words.data());
+            
+            for (uint32_t j = 0; j < CHUNK_WORDS; j++)
+            {
+                words[j] |= own_words[j];
+            }
+            
+            own_idx++;
+        }
+        
+        container c = from_words(words.data());
+        
+        if (c.cardinality > 0)
+        {
+            keys.push_back(uint16_t(i));
+            containers.push_back(std::move(c));
+        }
+    }
+    
+    splice(first_idx, own_stop, keys, containers);
+}
+
+void util::compressed_bit_array::unchecked_and_not(const util::bit_array& b, uint32_t start, uint32_t stop)
+{
+    uint32_t first_chunk;
+    uint32_t stop_chunk;
+    uint32_t first_idx;
+    uint32_t stop_idx;
+    
+    get_chunk_range(start, stop, &first_chunk, &stop_chunk, &first_idx, &stop_idx);
+    
+    std::vector<uint16_t> keys;
+    std::vector<container> containers;
+    std::vector<uint64_t> words(CHUNK_WORDS);
+    std::vector<uint64_t> own_words(CHUNK_WORDS);
+    std::vector<uint16_t> values;
+    
+    for (uint32_t i = first_idx; i < stop_idx; i++)
+    {
+        uint32_t key = m_keys[i];
+        const container& own = m_containers[i];
+        container c;
+        
+        dense_chunk(b, key, words.data());
+        
+        if (own.type == container_type::ARRAY)
+        {
+            values.clear();
+            
+            for (uint16_t offset : own.values)
+            {
+                if (!(words[offset >> 6] & (uint64_t(1) << (offset & 63u))))
+                {
+                    values.push_back(offset);
+                }
+            }
+            
+            c = from_values(values.data(), uint32_t(values.size()));
+        }
+        else
+        {
+            to_words(own, own_words.data());
+            
+            for (uint32_t j = 0; j < CHUNK_WORDS; j++)
+            {
+                own_words[j] &= ~words[j];
+            }
+            
+            c = from_words(own_words.data());
+        }
+        
+        if (c.cardinality > 0)
+        {
+            keys.push_back(uint16_t(key));
+            containers.push_back(std::move(c));
+        }
+    }
+    
+    splice(first_idx, stop_idx, keys, containers);
+}
+
+void util::compressed_bit_array::unchecked_or_into(util::bit_array& out) const
+{
+    out.m_version++;
+    
+    util::bit_array::word_t* out_data = out.m_data.unsafe_get_pointer();
+    
+    for (uint32_t i = 0; i < m_keys.size(); i++)
+    {
+        const container& c = m_containers[i];
+        uint64_t* dest = out_data + size_t(m_keys[i]) * CHUNK_WORDS;
+        
+        if (c.type == container_type::ARRAY)
+        {
+            for (uint16_t offset : c.values)
+            {
+                dest[offset >> 6] |= uint64_t(1) << (offset & 63u);
+            }
+        }
+        else if (c.type == container_type::RUN)
+        {
+            for (size_t j = 0; j < c.values.size(); j += 2)
+            {
+                uint32_t start = c.values[j];
+                uint32_t stop = start + c.values[j+1] + 1;
+                
+                for (uint32_t k = start; k < stop; k++)
+                {
+                    dest[k >> 6] |= uint64_t(1) << (k & 63u);
+                }
+            }
+        }
+        else
+        {
+            uint32_t n_words = std::min(CHUNK_WORDS, out.get_data_size(m_size) - m_keys[i] * CHUNK_WORDS);
+            
+            for (uint32_t j = 0; j < n_words; j++)
+            {
+                dest[j] |= c.words[j];
+            }
+        }
+    }
+}
+
+void util::compressed_bit_array::unchecked_and_into(util::bit_array& out) const
+{
+    out.m_version++;
+    
+    util::bit_array::word_t* out_data = out.m_data.unsafe_get_pointer();
+    
+    uint32_t data_size = out.get_data_size(m_size);
+    uint32_t n_chunks = get_n_chunks();
+    uint32_t own_idx = 0;
+    
+    std::vector<uint64_t> words(CHUNK_WORDS);
+    
+    for (uint32_t i = 0; i < n_chunks; i++)
+    {
+        uint64_t* dest = out_data + size_t(i) * CHUNK_WORDS;
+        uint32_t n_words = std::min(CHUNK_WORDS, data_size - i * CHUNK_WORDS);
+        
+        if (own_idx < m_keys.size() && m_keys[own_idx] == i)
+        {
+            to_words(m_containers[own_idx], words.data());
+            
+            for (uint32_t j = 0; j < n_words; j++)
+            {
+                dest[j] &= words[j];
+            }
+            
+            own_idx++;
+        }
+        else
+        {
+            std::memset(dest, 0, n_words * sizeof(uint64_t));
+        }
+    }
+}
+
+void util::compressed_bit_array::unchecked_or(const uint32_t* indices, uint32_t n_indices)
+{
+    std::vector<uint16_t> values;
+    std::vector<uint32_t> own;
+    uint32_t i = 0;
+    
+    while (i < n_indices)
+    {
+        uint16_t key = uint16_t(indices[i] >> 16);
+        uint32_t stop = i;
+        
+        while (stop < n_indices && (indices[stop] >> 16) == key)
+        {
+            stop++;
+        }
+        
+        bool was_found;
+        uint32_t idx = find_key(key, &was_found);
+        uint32_t n_own = 0;
+        
+        if (was_found)
+        {
+            own.resize(m_containers[idx].cardinality + util::bit_kernels::EXTRACT_SLACK);
+            n_own = extract(m_containers[idx], own.data(), 0u);
+        }
+        
+        //  merge the offsets held with those given
+        values.clear();
+        
+        uint32_t j = 0;
+        
+        for (; i < stop; i++)
+        {
+            uint32_t offset = indices[i] & 0xffffu;
+            
+            for (; j < n_own && own[j] < offset; j++)
+            {
+                values.push_back(uint16_t(own[j]));
+            }
+            
+            j += j < n_own && own[j] == offset ? 1u : 0u;
+            values.push_back(uint16_t(offset));
+        }
+        
+        for (; j < n_own; j++)
+        {
+            values.push_back(uint16_t(own[j]));
+        }
+        
+        container c = from_values(values.data(), uint32_t(values.size()));
+        
+        if (was_found)
+        {
+            m_containers[idx] = std::move(c);
+        }
+        else
+        {
+            m_keys.insert(m_keys.begin() + idx, key);
+            m_containers.insert(m_containers.begin() + idx, std::move(c));
+        }
+    }
+}
+
+bool util::compressed_bit_array::unchecked_intersects(const util::bit_array& b) const
+{
+    std::vector<uint64_t> words(CHUNK_WORDS);
+    std::vector<uint64_t> own_words(CHUNK_WORDS);
+    
+    for (uint32_t i = 0; i < m_keys.size(); i++)
+    {
+        uint32_t key = m_keys[i];
+        const container& own = m_containers[i];
+        
+        if (own.type == container_type::ARRAY)
+        {
+            uint32_t base = key * CHUNK_SIZE;
+            
+            for (uint16_t offset : own.values)
+            {
+                if (b.at(base + offset))
+                {
+                    return true;
+                }
+            }
+            
+            continue;
+        }
+        
+        dense_chunk(b, key, words.data());
+        
+        const uint64_t* own_data = own.words.data();
+        
+        if (own.type == container_type::RUN)
+        {
+            to_words(own, own_words.data());
+            own_data = own_words.data();
+        }
+        
+        for (uint32_t j = 0; j < CHUNK_WORDS; j++)
+        {
+            if (own_data[j] & words[j])
+            {
+                return true;
+            }
+        }
+    }
+    
+    return false;
+}
+
+void util::compressed_bit_array::dot_or(util::compressed_bit_array& out,
+                                        const util::compressed_bit_array& a,
+                                        const util::compressed_bit_array& b)
+{
+    if (a.m_size != b.m_size)
+    {
+        throw std::runtime_error("Dimension mismatch.");
+    }
+    
+    std::vector<uint16_t> keys;
+    std::vector<container> containers;
+    std::vector<uint64_t> a_words(CHUNK_WORDS);
+    std::vector<uint64_t> b_words(CHUNK_WORDS);
+    std::vector<uint16_t> values;
+    
+    uint32_t i = 0;
+    uint32_t j = 0;
+    
+    while (i < a.m_keys.size() || j < b.m_keys.size())
+    {
+        bool take_a = j == b.m_keys.size() || (i < a.m_keys.size() && a.m_keys[i] < b.m_keys[j]);
+        bool take_b = i == a.m_keys.size() || (j < b.m_keys.size() && b.m_keys[j] < a.m_keys[i]);
+        
+        if (take_a)
+        {
+            keys.push_back(a.m_keys[i]);
+            containers.push_back(a.m_containers[i++]);
+            continue;
+        }
+        
+        if (take_b)
+        {
+            keys.push_back(b.m_keys[j]);
+            containers.push_back(b.m_containers[j++]);
+            continue;
+        }
+        
+        const container& ca = a.m_containers[i];
+        const container& cb = b.m_containers[j];
+        
+        keys.push_back(a.m_keys[i]);
+        
+        if (ca.type == container_type::ARRAY && cb.type == container_type::ARRAY &&
+            ca.cardinality + cb.cardinality <= ARRAY_MAX)
+        {
+            values.clear();
+            std::set_union(ca.values.begin(), ca.values.end(), cb.values.begin(), cb.values.end(),
+                           std::back_inserter(values));
+            containers.push_back(from_values(values.data(), uint32_t(values.size())));
+        }
+        else
+        {
+            to_words(ca, a_words.data());
+            to_words(cb, b_words.data());
+            
+            for (uint32_t k = 0; k < CHUNK_WORDS; k++)
+            {
+                a_words[k] |= b_words[k];
+            }
+            
+            containers.push_back(from_words(a_words.data()));
+        }
+        
+        i++;
+        j++;
+    }
+    
+    out.m_keys = std::move(keys);
+    out.m_containers = std::move(containers);
+    out.m_size = a.m_size;
+}
+
+void util::compressed_bit_array::dot_and(util::compressed_bit_array& out,
+                                         const util::compressed_bit_array& a,
+                                         const util::compressed_bit_array& b)
+{
+    if (a.m_size != b.m_size)
+    {
+        throw std::runtime_error("Dimension mismatch.");
+    }
+    
+    std::vector<uint16_t> keys;
+    std::vector<container> containers;
+    std::vector<uint64_t> a_words(CHUNK_WORDS);
+    std::vector<uint64_t> b_words(CHUNK_WORDS);
+    std::vector<uint16_t> values;
+    
+    uint32_t i = 0;
+    uint32_t j = 0;
+    
+    while (i < a.m_keys.size() && j < b.m_keys.size())
+    {
+        if (a.m_keys[i] < b.m_keys[j])
+        {
+            i++;
+            continue;
+        }
+        
+        if (b.m_keys[j] < a.m_keys[i])
+        {
+            j++;
+            continue;
+        }
+        
+        const container& ca = a.m_containers[i];
+        const container& cb = b.m_containers[j];
+        container c;
+        
+        //  filter the smaller array through the other container
+        if (ca.type == container_type::ARRAY || cb.type == container_type::ARRAY)
+        {
+            bool a_is_array = ca.type == container_type::ARRAY &&
+                (cb.type != container_type::ARRAY || ca.cardinality <= cb.cardinality);
+            
+            const container& small = a_is_array ? ca : cb;
+            const container& large = a_is_array ? cb : ca;
+            
+            values.clear();
+            
+            for (uint16_t offset : small.values)
+            {
+                if (contains(large, offset))
+                {
+                    values.push_back(offset);
+                }
+            }
+            
+            c = from_values(values.data(), uint32_t(values.size()));
+        }
+        else
+        {
+            to_words(ca, a_words.data());
+            to_words(cb, b_words.data());
+            
+            for (uint32_t k = 0; k < CHUNK_WORDS; k++)
+            {
+                a_words[k] &= b_words[k];
+            }
+            
+            c = from_words(a_words.data());
+        }
+        
+        if (c.cardinality > 0)
+        {
+            keys.push_back(a.m_keys[i]);
+            containers.push_back(std::move(c));
+        }
+        
+        i++;
+        j++;
+    }
+    
+    out.m_keys = std::move(keys);
+    out.m_containers = std::move(containers);
+    out.m_size = a.m_size;
+}
+
+void util::compressed_bit_array::dot_and_not(util::compressed_bit_array& out,
+                                             const util::compressed_bit_array& a,
+                                             const util::compressed_bit_array& b)
+{
+    if (a.m_size != b.m_size)
+    {
+        throw std::runtime_error("Dimension mismatch.");
+    }
+    
+    std::vector<uint16_t> keys;
+    std::vector<container> containers;
+    std::vector<uint64_t> a_words(CHUNK_WORDS);
+    std::vector<uint64_t> b_words(CHUNK_WORDS);
+    std::vector<uint16_t> values;
+    
+    uint32_t j = 0;
+    
+    for (uint32_t i = 0; i < a.m_keys.size(); i++)
+    {
+        while (j < b.m_keys.size() && b.m_keys[j] < a.m_keys[i])
+        {
+            j++;
+        }
+        
+        const container& ca = a.m_containers[i];
+        
+        if (j == b.m_keys.size() || b.m_keys[j] != a.m_keys[i])
+        {
+            keys.push_back(a.m_keys[i]);
+            containers.push_back(ca);
+            continue;
+        }
+        
+        const container& cb = b.m_containers[j];
+        container c;
+        
+        if (ca.type == container_type::ARRAY)
+        {
+            values.clear();
+            
+            for (uint16_t offset : ca.values)
+            {
+                if (!contains(cb, offset))
+                {
+                    values.push_back(offset);
+                }
+            }
+            
+            c = from_values(values.data(), uint32_t(values.size()));
+        }
+        else
+        {
+            to_words(ca, a_words.data());
+            to_words(cb, b_words.data());
+            
+            for (uint32_t k = 0; k < CHUNK_WORDS; k++)
+            {
+                a_words[k] &= ~b_words[k];
+            }
+            
+            c = from_words(a_words.data());
+        }
+        
+        if (c.cardinality > 0)
+        {
+            keys.push_back(a.m_keys[i]);
+            containers.push_back(std::move(c));
+        }
+    }
+    
+    out.m_keys = std::move(keys);
+    out.m_containers = std::move(containers);
+    out.m_size = a.m_size;
+}
+
+util::dynamic_array<uint32_t> util::compressed_bit_array::find(const util::compressed_bit_array& a,
+                                                               uint32_t index_offset)
+{
+    uint32_t n_true = a.sum();
+    
+    if (n_true == 0)
+    {
+        return util::dynamic_array<uint32_t>();
+    }
+    
+    util::dynamic_array<uint32_t> result(n_true + util::bit_kernels::EXTRACT_SLACK);
+    uint32_t* result_ptr = result.unsafe_get_pointer();
+    uint32_t n_found = 0;
+    
+    for (uint32_t i = 0; i < a.m_keys.size(); i++)
+    {
+        uint32_t base = uint32_t(a.m_keys[i]) * CHUNK_SIZE + index_offset;
+        n_found += extract(a.m_containers[i], result_ptr + n_found, base);
+    }
+    
+    result.resize(n_found);
+    result.seek_tail_to_end();
+    
+    return result;
+}
+
+//  private
+
+uint32_t util::compressed_bit_array::find_key(uint32_t key, bool* was_found) const
+{
+    auto it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+    
+    *was_found = it != m_keys.end() && *it == key;
+    
+    return uint32_t(it - m_keys.begin());
+}
+
+uint32_t util::compressed_bit_array::get_n_chunks() const
+{
+    return uint32_t((uint64_t(m_size) + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+//  get_chunk_range: Chunks [first_chunk, stop_chunk) spanning bits
+//      [start, stop), and the containers [first_idx, stop_idx) held for them.
+
+void util::compressed_bit_array::get_chunk_range(uint32_t start, uint32_t stop, uint32_t* first_chunk, uint32_t* stop_chunk,
+                                                 uint32_t* first_idx, uint32_t* stop_idx) const
+{
+    *first_chunk = start / CHUNK_SIZE;
+    *stop_chunk = stop <= start ? *first_chunk : (stop - 1) / CHUNK_SIZE + 1;
+    
+    auto first = std::lower_bound(m_keys.begin(), m_keys.end(), *first_chunk);
+    auto last = std::lower_bound(first, m_keys.end(), *stop_chunk);
+    
+    *first_idx = uint32_t(first - m_keys.begin());
+    *stop_idx = uint32_t(last - m_keys.begin());
+}
+
+//  splice: Replace containers [first_idx, stop_idx) with `containers`, whose
+//      keys fall between those of the containers kept on either side.
+
+void util::compressed_bit_array::splice(uint32_t first_idx, uint32_t stop_idx,
+                                        std::vector<uint16_t>& keys, std::vector<container>& containers)
+{
+    if (first_idx == 0 && stop_idx == m_keys.size())
+    {
+        m_keys = std::move(keys);
+        m_containers = std::move(containers);
+        return;
+    }
+    
+    m_keys.erase(m_keys.begin() + first_idx, m_keys.begin() + stop_idx);
+    m_keys.insert(m_keys.begin() + first_idx, keys.begin(), keys.end());
+    
+    m_containers.erase(m_containers.begin() + first_idx, m_containers.begin() + stop_idx);
+    m_containers.insert(m_containers.begin() + first_idx,
+                        std::make_move_iterator(containers.begin()), std::make_move_iterator(containers.end()));
+}
+
+//  unchecked_push_back: Set `index`, which must be greater than any index
+//      already set. Containers are left as arrays or bitmaps; call
+//      shrink_containers() after a sequence of pushes.
+
+void util::compressed_bit_array::unchecked_push_back(uint32_t index)
+{
+    uint16_t key = uint16_t(index >> 16);
+    uint16_t offset = uint16_t(index & 0xffffu);
+    
+    if (m_keys.empty() || m_keys.back() != key)
+    {
+        m_keys.push_back(key);
+        m_containers.push_back(from_values(&offset, 1));
+        return;
+    }
+    
+    container& c = m_containers.back();
+    
+    if (c.type == container_type::RUN || (c.type == container_type::ARRAY && c.cardinality == ARRAY_MAX))
+    {
+        std::vector<uint64_t> words(CHUNK_WORDS);
+        to_words(c, words.data());
+        
+        c.type = container_type::BITMAP;
+        c.words = std::move(words);
+        c.values = std::vector<uint16_t>();
+    }
+    
+    if (c.type == container_type::ARRAY)
+    {
+        c.values.push_back(offset);
+    }
+    else
+    {
+        c.words[offset >> 6] |= uint64_t(1) << (offset & 63u);
+    }
+    
+    c.cardinality++;
+}
+
+//  shrink_containers: Re-encode containers [first, end) in their
+//      smallest form.
+
+void util::compressed_bit_array::shrink_containers(uint32_t first)
+{
+    std::vector<uint64_t> words(CHUNK_WORDS);
+    
+    for (uint32_t i = first; i < m_containers.size(); i++)
+    {
+        to_words(m_containers[i], words.data());
+        m_containers[i] = from_words(words.data());
+    }
+}
+
+//  dense_chunk: Copy chunk `key` of `b` into `words`, zero-padded, with
+//      the bits beyond `b.size()` cleared.
+
+void util::compressed_bit_array::dense_chunk(const util::bit_array& b, uint32_t key, uint64_t* words) const
+{
+    uint32_t data_size = b.get_data_size(b.size());
+    uint32_t first_word = key * CHUNK_WORDS;
+    uint32_t n_words = first_word < data_size ? std::min(CHUNK_WORDS, data_size - first_word) : 0u;
+    
+    const util::bit_array::word_t* data = b.m_data.unsafe_get_pointer();
+    
+    std::memset(words, 0, CHUNK_WORDS * sizeof(uint64_t));
+    
+    if (n_words == 0)
+    {
+        return;
+    }
+    
+    std::memcpy(words, data + first_word, n_words * sizeof(uint64_t));
+    
+    if (first_word + n_words == data_size)
+    {
+        words[n_words-1] = b.get_final_bin_with_zeros();
+    }
+}
+
+bool util::compressed_bit_array::contains(const container& c, uint16_t offset)
+{
+    if (c.type == container_type::ARRAY)
+    {
+        return std::binary_search(c.values.begin(), c.values.end(), offset);
+    }
+    
+    if (c.type == container_type::BITMAP)
+    {
+        return (c.words[offset >> 6] >> (offset & 63u)) & 1u;
+    }
+    
+    //  last run starting at or before `offset`
+    uint32_t lo = 0;
+    uint32_t hi = uint32_t(c.values.size() / 2);
+    
+    while (lo < hi)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        
+        if (c.values[mid * 2] <= offset)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    
+    if (lo == 0)
+    {
+        return false;
+    }
+    
+    uint32_t start = c.values[(lo-1) * 2];
+    uint32_t length = c.values[(lo-1) * 2 + 1];
+    
+    return offset <= start + length;
+}
+
+void util::compressed_bit_array::to_words(const container& c, uint64_t* words)
+{
+    if (c.type == container_type::BITMAP)
+    {
+        std::memcpy(words, c.words.data(), CHUNK_WORDS * sizeof(uint64_t));
+        return;
+    }
+    
+    std::memset(words, 0, CHUNK_WORDS * sizeof(uint64_t));
+    
+    if (c.type == container_type::ARRAY)
+    {
+        for (uint16_t offset : c.values)
+        {
+            words[offset >> 6] |= uint64_t(1) << (offset & 63u);
+        }
+        
+        return;
+    }
+    
+    for (size_t i = 0; i < c.values.size(); i += 2)
+    {
+        uint32_t start = c.values[i];
+        uint32_t stop = start + c.values[i+1] + 1;
+        
+        while (start < stop)
+        {
+            uint32_t bit = start & 63u;
+            uint32_t n = std::min(64u - bit, stop - start);
+            uint64_t mask = n == 64u ? ~uint64_t(0) : ((uint64_t(1) << n) - 1u) << bit;
+            
+            words[start >> 6] |= mask;
+            start += n;
+        }
+    }
+}
+
+//  from_words: Smallest of the array, bitmap and run encodings of
+//      `words`.
+
+util::compressed_bit_array::container util::compressed_bit_array::from_words(const uint64_t* words)
+{
+    container c;
+    
+    c.cardinality = uint32_t(util::bit_kernels::get().popcount(words, CHUNK_WORDS));
+    
+    if (c.cardinality == 0)
+    {
+        c.type = container_type::ARRAY;
+        return c;
+    }
+    
+    uint32_t n_runs = count_runs(words);
+    
+    size_t array_bytes = c.cardinality * sizeof(uint16_t);
+    size_t bitmap_bytes = CHUNK_WORDS * sizeof(uint64_t);
+    size_t run_bytes = n_runs * 2 * sizeof(uint16_t);
+    
+    if (run_bytes < bitmap_bytes && run_bytes < array_bytes)
+    {
+        c.type = container_type::RUN;
+        c.values.resize(n_runs * 2);
+        
+        uint32_t n_starts = 0;
+        uint32_t n_stops = 0;
+        uint64_t carry = 0;
+        
+        //  the start of run k is always recorded before its last bit
+        for (uint32_t i = 0; i < CHUNK_WORDS; i++)
+        {
+            uint64_t word = words[i];
+            uint64_t next_low = i + 1 < CHUNK_WORDS ? (words[i+1] & 1u) : 0u;
+            uint64_t starts = word & ~((word << 1) | carry);
+            uint64_t lasts = word & ~((word >> 1) | (next_low << 63));
+            
+            carry = word >> 63;
+            
+            while (starts != 0u)
+            {
+                c.values[n_starts++ * 2] = uint16_t(i * 64 + util::bit_kernels::ctz64(starts));
+                starts &= starts - 1u;
+            }
+            
+            while (lasts != 0u)
+            {
+                uint32_t last = i * 64 + util::bit_kernels::ctz64(lasts);
+                c.values[n_stops * 2 + 1] = uint16_t(last - c.values[n_stops * 2]);
+                n_stops++;
+                lasts &= lasts - 1u;
+            }
+        }
+        
+        return c;
+    }
+    
+    if (c.cardinality <= ARRAY_MAX)
+    {
+        c.type = container_type::ARRAY;
+        c.values.resize(c.cardinality);
+        
+        std::vector<uint32_t> offsets(c.cardinality + util::bit_kernels::EXTRACT_SLACK);
+        util::bit_kernels::get().extract(offsets.data(), words, CHUNK_WORDS, 0u);
+        
+        for (uint32_t i = 0; i < c.cardinality; i++)
+        {
+            c.values[i] = uint16_t(offsets[i]);
+        }
+        
+        return c;
+    }
+    
+    c.type = container_type::BITMAP;
+    c.words.assign(words, words + CHUNK_WORDS);
+    
+    return c;
+}
+
+//  from_values: Container holding the sorted, unique `values`.
+
+util::compressed_bit_array::container util::compressed_bit_array::from_values(const uint16_t* values, uint32_t n_values)
+{
+    if (n_values > ARRAY_MAX)
+    {
+        std::vector<uint64_t> words(CHUNK_WORDS, 0u);
+        
+        for (uint32_t i = 0; i < n_values; i++)
+        {
+            words[values[i] >> 6] |= uint64_t(1) << (values[i] & 63u);
+        }
+        
+        return from_words(words.data());
+    }
+    
+    container c;
+    c.type = container_type::ARRAY;
+    c.cardinality = n_values;
+    
+    uint32_t n_runs = n_values > 0 ? 1u : 0u;
+    
+    for (uint32_t i = 1; i < n_values; i++)
+    {
+        n_runs += values[i] != values[i-1] + 1 ? 1u : 0u;
+    }
+    
+    if (n_runs * 2 < n_values)
+    {
+        c.type = container_type::RUN;
+        c.values.reserve(n_runs * 2);
+        
+        uint32_t start = 0;
+        
+        for (uint32_t i = 1; i <= n_values; i++)
+        {
+            if (i == n_values || values[i] != values[i-1] + 1)
+            {
+                c.values.push_back(values[start]);
+                c.values.push_back(uint16_t(i - start - 1));
+                start = i;
+            }
+        }
+        
+        return c;
+    }
+    
+    c.values.assign(values, values + n_values);
+    
+    return c;
+}
+
+uint32_t util::compressed_bit_array::extract(const container& c, uint32_t* out, uint32_t base)
+{
+    if (c.type == container_type::BITMAP)
+    {
+        return util::bit_kernels::get().extract(out, c.words.data(), CHUNK_WORDS, base);
+    }
+    
+    if (c.type == container_type::ARRAY)
+    {
+        for (uint32_t i = 0; i < c.cardinality; i++)
+        {
+            out[i] = base + c.values[i];
+        }
+        
+        return c.cardinality;
+    }
+    
+    uint32_t n = 0;
+    
+    for (size_t i = 0; i < c.values.size(); i += 2)
+    {
+        uint32_t start = base + c.values[i];
+        uint32_t length = uint32_t(c.values[i+1]) + 1u;
+        
+        for (uint32_t j = 0; j < length; j++)
+        {
+            out[n++] = start + j;
+        }
+    }
+    
+    return n;
+}
+
+//  count_runs: Number of maximal runs of set bits.
+
+uint32_t util::compressed_bit_array::count_runs(const uint64_t* words)
+{
+    uint32_t n_runs = 0;
+    uint64_t carry = 0;
+    
+    for (uint32_t i = 0; i < CHUNK_WORDS; i++)
+    {
+        uint64_t word = words[i];
+        uint64_t starts = word & ~((word << 1) | carry);
+        
+        n_runs += util::bit_kernels::popcount64(starts);
+        carry = word >> 63;
+    }
+    
+    return n_runs;
+}
@@ -0,0 +1,299 @@
+//
+//  compressed_bit_array.hpp
+//  locator
+//
+
+#pragma once
+
+#include "bit_array.hpp"
+#include "dynamic_array.hpp"
+#include "bit_kernels.hpp"
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace util {
+    class compressed_bit_array;
+}
+
+//  compressed_bit_array: Roaring-style bitmap.
+//
+//      Bits are grouped into chunks of 2^16. Each chunk with at least one
+//      set bit is stored as a sorted array of offsets, a 2^16-bit bitmap,
+//      or a list of runs, whichever is smallest. Chunks without set bits
+//      are not stored.
+
+class util::compressed_bit_array
+{
+public:
+    compressed_bit_array();
+    explicit compressed_bit_array(uint32_t size);
+    explicit compressed_bit_array(const util::bit_array& dense);
+    //  Set at `indices`, which must be ascending and distinct.
+    compressed_bit_array(uint32_t size, const uint32_t* indices, uint32_t n_indices);
+    
+    bool operator ==(const compressed_bit_array& other) const;
+    bool operator !=(const compressed_bit_array& other) const;
+    
+    uint32_t size() const;
+    uint32_t sum() const;
+    
+    bool at(uint32_t index) const;
+    bool any() const;
+    
+    //  bytes: Approximate heap + object size.
+    size_t bytes() const;
+    
+    void place(bool value, uint32_t at_index);
+    void unchecked_place(bool value, uint32_t at_index);
+    void fill(bool value);
+    void empty();
+    void resize(uint32_t to_size);
+    void append(const compressed_bit_array& other);
+    void unchecked_keep(const util::dynamic_array<uint32_t>& at_indices, int32_t index_offset = 0);
+    //  unchecked_compress: Keep the elements at which `mask`, a dense array
+    //      of the same size, is true.
+    void unchecked_compress(const util::bit_array& mask);
+    
+    util::bit_array to_bit_array() const;
+    
+    //  or / and / and-not with a dense array of the same size.
+    void unchecked_or(const util::bit_array& b);
+    void unchecked_and_not(const util::bit_array& b);
+    void unchecked_or_into(util::bit_array& out) const;
+    void unchecked_and_into(util::bit_array& out) const;
+    //  Only chunks spanning bits [start, stop) are visited; `b` must have
+    //  no set bits outside them.
+    void unchecked_or(const util::bit_array& b, uint32_t start, uint32_t stop);
+    void unchecked_and_not(const util::bit_array& b, uint32_t start, uint32_t stop);
+    //  unchecked_intersects: Whether any bit is set in both this array and
+    //      `b`; stops at the first such chunk.
+    bool unchecked_intersects(const util::bit_array& b) const;
+    //  unchecked_or: Set at `indices`, ascending and distinct; only the
+    //      chunks they fall in are re-encoded.
+    void unchecked_or(const uint32_t* indices, uint32_t n_indices);
+    
+    static void dot_or(compressed_bit_array& out, const compressed_bit_array& a, const compressed_bit_array& b);
+    static void dot_and(compressed_bit_array& out, const compressed_bit_array& a, const compressed_bit_array& b);
+    static void dot_and_not(compressed_bit_array& out, const compressed_bit_array& a, const compressed_bit_array& b);
+    
+    static util::dynamic_array<uint32_t> find(const compressed_bit_array& a, uint32_t index_offset = 0u);
+    
+    //  for_each_set_bit: Call `func(index)` for each set bit, in ascending
+    //      order.
+    template<typename F>
+    static void for_each_set_bit(const compressed_bit_array& a, F&& func);
+    //  Only set bits at indices [start, stop).
+    template<typename F>
+    static void for_each_set_bit(const compressed_bit_array& a, uint32_t start, uint32_t stop, F&& func);
+    //  any_set_bit: Whether `pred(index)` is true for any set bit, tested
+    //      in ascending order and stopping at the first for which it is.
+    template<typename F>
+    static bool any_set_bit(const compressed_bit_array& a, F&& pred);
+    
+    static constexpr uint32_t CHUNK_SIZE = 1u << 16;
+    static constexpr uint32_t CHUNK_WORDS = CHUNK_SIZE / 64u;
+    static constexpr uint32_t ARRAY_MAX = 4096u;
+private:
+    struct container_type {
+        static constexpr uint32_t ARRAY = 0u;
+        static constexpr uint32_t BITMAP = 1u;
+        static constexpr uint32_t RUN = 2u;
+    };
+    
+    //  array: sorted offsets; bitmap: CHUNK_WORDS words; run: pairs of
+    //  (start, length - 1).
+    struct container
+    {
+        uint32_t type;
+        uint32_t cardinality;
+        std::vector<uint16_t> values;
+        std::vector<uint64_t> words;
+    };
+    
+    std::vector<uint16_t> m_keys;
+    std::vector<container> m_containers;
+    uint32_t m_size;
+    
+    uint32_t find_key(uint32_t key, bool* was_found) const;
+    uint32_t get_n_chunks() const;
+    void get_chunk_range(uint32_t start, uint32_t stop, uint32_t* first_chunk, uint32_t* stop_chunk,
+                         uint32_t* first_idx, uint32_t* stop_idx) const;
+    void splice(uint32_t first_idx, uint32_t stop_idx, std::vector<uint16_t>& keys, std::vector<container>& containers);
+    
+    void unchecked_push_back(uint32_t index);
+    void shrink_containers(uint32_t first);
+    
+    void dense_chunk(const util::bit_array& b, uint32_t key, uint64_t* words) const;
+    
+    static bool contains(const container& c, uint16_t offset);
+    static void to_words(const container& c, uint64_t* words);
+    static container from_words(const uint64_t* words);
+    static container from_values(const uint16_t* values, uint32_t n_values);
+    static uint32_t extract(const container& c, uint32_t* out, uint32_t base);
+    static uint32_t count_runs(const uint64_t* words);
+    
+    template<typename F>
+    static void for_each_in_container(const container& c, uint32_t base, F&& func);
+    template<typename F>
+    static bool any_in_container(const container& c, uint32_t base, F&& pred);
+};
+
+//
+//  impl
+//
+
+template<typename F>
+void util::compressed_bit_array::for_each_set_bit(const compressed_bit_array& a, F&& func)
+{
+    for (uint32_t i = 0; i < a.m_keys.size(); i++)
+    {
+        for_each_in_container(a.m_containers[i], uint32_t(a.m_keys[i]) * CHUNK_SIZE, func);
+    }
+}
+
+template<typename F>
+void util::compressed_bit_array::for_each_set_bit(const compressed_bit_array& a, uint32_t start, uint32_t stop, F&& func)
+{
+    if (start >= stop)
+    {
+        return;
+    }
+    
+    auto first = std::lower_bound(a.m_keys.begin(), a.m_keys.end(), start / CHUNK_SIZE);
+    
+    //  chunks that straddle `start` or `stop` are filtered bit by bit
+    auto in_range = [start, stop, &func] (uint32_t index) -> void {
+        if (index >= start && index < stop)
+        {
+            func(index);
+        }
+    };
+    
+    for (size_t i = first - a.m_keys.begin(); i < a.m_keys.size(); i++)
+    {
+        uint32_t base = uint32_t(a.m_keys[i]) * CHUNK_SIZE;
+        
+        if (base >= stop)
+        {
+            break;
+        }
+        
+        if (base >= start && stop - base >= CHUNK_SIZE)
+        {
+            for_each_in_container(a.m_containers[i], base, func);
+        }
+        else
+        {
+            for_each_in_container(a.m_containers[i], base, in_range);
+        }
+    }
+}
+
+template<typename F>
+bool util::compressed_bit_array::any_set_bit(const compressed_bit_array& a, F&& pred)
+{
+    for (uint32_t i = 0; i < a.m_keys.size(); i++)
+    {
+        if (any_in_container(a.m_containers[i], uint32_t(a.m_keys[i]) * CHUNK_SIZE, pred))
+        {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+//  for_each_in_container: Call `func(base + offset)` for each offset set in
+//      `c`, in ascending order.
+
+template<typename F>
+void util::compressed_bit_array::for_each_in_container(const container& c, uint32_t base, F&& func)
+{
+    if (c.type == container_type::ARRAY)
+    {
+        for (uint32_t j = 0; j < c.cardinality; j++)
+        {
+            func(base + c.values[j]);
+        }
+    }
+    else if (c.type == container_type::BITMAP)
+    {
+        for (uint32_t j = 0; j < CHUNK_WORDS; j++)
+        {
+            uint64_t word = c.words[j];
+            
+            while (word != 0)
+            {
+                func(base + j * 64u + util::bit_kernels::ctz64(word));
+                word &= word - 1;
+            }
+        }
+    }
+    else
+    {
+        for (size_t j = 0; j < c.values.size(); j += 2)
+        {
+            uint32_t start = base + c.values[j];
+            uint32_t stop = start + uint32_t(c.values[j+1]) + 1u;
+            
+            for (uint32_t k = start; k < stop; k++)
+            {
+                func(k);
+            }
+        }
+    }
+}
+
+//  any_in_container: Whether `pred(base + offset)` is true for any offset
+//      set in `c`, in ascending order.
+
+template<typename F>
+bool util::compressed_bit_array::any_in_container(const container& c, uint32_t base, F&& pred)
+{
+    if (c.type == container_type::ARRAY)
+    {
+        for (uint32_t j = 0; j < c.cardinality; j++)
+        {
+            if (pred(base + c.values[j]))
+            {
+                return true;
+            }
+        }
+    }
+    else if (c.type == container_type::BITMAP)
+    {
+        for (uint32_t j = 0; j < CHUNK_WORDS; j++)
+        {
+            uint64_t word = c.words[j];
+            
+            while (word != 0)
+            {
+                if (pred(base + j * 64u + util::bit_kernels::ctz64(word)))
+                {
+                    return true;
+                }
+                
+                word &= word - 1;
+            }
+        }
+    }
+    else
+    {
+        for (size_t j = 0; j < c.values.size(); j += 2)
+        {
+            uint32_t start = base + c.values[j];
+            uint32_t stop = start + uint32_t(c.values[j+1]) + 1u;
+            
+            for (uint32_t k = start; k < stop; k++)
+            {
+                if (pred(k))
+                {
+                    return true;
+                }
+            }
+        }
+    }
+    
+    return false;
+}
@@ -16,7 +16,8 @@
 
 namespace util
 {
-    template<typename T, typename A = util::trivial_allocator<T>>
+    //  storage is cache-line aligned by default; see aligned_allocator.
+    template<typename T, typename A = util::aligned_allocator<T>>
     class dynamic_array;
 }
 
@@ -182,11 +183,9 @@ void util::dynamic_array<T, A>::clear()
 template<typename T, typename A>
 void util::dynamic_array<T, A>::resize(uint32_t to_size)
 {
-    size_t dest_size = to_size * sizeof(T);
-    
     if (m_elements != nullptr)
     {
-        m_elements = A::resize(m_elements, dest_size, m_size);
+        m_elements = A::resize(m_elements, to_size, m_size);
     }
     else
     {
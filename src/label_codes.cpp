@@ -0,0 +1,505 @@
+//
+//  label_codes.cpp
+//  locator
+//
+
+#include "label_codes.hpp"
+#include <algorithm>
+
+constexpr uint32_t util::category_storage::INDICES;
+constexpr uint32_t util::category_storage::CODES;
+constexpr uint32_t util::label_codes::NO_CODE;
+constexpr uint32_t util::label_codes::NO_LABEL;
+constexpr uint32_t util::label_codes::NARROW_CODES;
+
+util::label_codes::label_codes()
+{
+    m_is_wide = false;
+    m_size = 0;
+}
+
+util::label_codes::label_codes(uint32_t size) :
+    m_narrow(size, uint16_t(NARROW_CODES))
+{
+    m_is_wide = false;
+    m_size = size;
+}
+
+//  copy-construct
+util::label_codes::label_codes(const util::label_codes& other) :
+    m_narrow(other.m_narrow),
+    m_wide(other.m_wide),
+    m_labels(other.m_labels),
+    m_counts(other.m_counts),
+    m_free(other.m_free),
+    m_codes(other.m_codes)
+{
+    m_is_wide = other.m_is_wide;
+    m_size = other.m_size;
+}
+
+//  copy-assign
+util::label_codes& util::label_codes::operator=(const util::label_codes& other)
+{
+    util::label_codes tmp(other);
+    *this = std::move(tmp);
+    return *this;
+}
+
+//  move-construct
+util::label_codes::label_codes(util::label_codes&& rhs) noexcept :
+    m_narrow(std::move(rhs.m_narrow)),
+    m_wide(std::move(rhs.m_wide)),
+    m_labels(std::move(rhs.m_labels)),
+    m_counts(std::move(rhs.m_counts)),
+    m_free(std::move(rhs.m_free)),
+    m_codes(std::move(rhs.m_codes))
+{
+    m_is_wide = rhs.m_is_wide;
+    m_size = rhs.m_size;
+    rhs.m_size = 0;
+}
+
+//  move-assign
+util::label_codes& util::label_codes::operator=(util::label_codes&& rhs) noexcept
+{
+    m_narrow = std::move(rhs.m_narrow);
+    m_wide = std::move(rhs.m_wide);
+    m_labels = std::move(rhs.m_labels);
+    m_counts = std::move(rhs.m_counts);
+    m_free = std::move(rhs.m_free);
+    m_codes = std::move(rhs.m_codes);
+    m_is_wide = rhs.m_is_wide;
+    m_size = rhs.m_size;
+    
+    rhs.m_size = 0;
+    
+    return *this;
+}
+
+uint32_t util::label_codes::size() const
+{
+    return m_size;
+}
+
+size_t util::label_codes::bytes() const
+{
+    return sizeof(*this) +
+        m_narrow.capacity() * sizeof(uint16_t) +
+        m_wide.capacity() * sizeof(uint32_t) +
+        (m_labels.capacity() + m_counts.capacity() + m_free.capacity()) * sizeof(uint32_t) +
+        m_codes.size() * (2 * sizeof(uint32_t) + sizeof(void*));
+}
+
+bool util::label_codes::is_wide() const
+{
+    return m_is_wide;
+}
+
+bool util::label_codes::has_label(uint32_t label) const
+{
+    return m_codes.find(label) != m_codes.end();
+}
+
+uint32_t util::label_codes::count(uint32_t label) const
+{
+    uint32_t code = code_of(label);
+    
+    return code == NO_CODE ? 0u : m_counts[code];
+}
+
+uint32_t util::label_codes::at(uint32_t index) const
+{
+    uint32_t code = get(index);
+    
+    return code == NO_CODE ? NO_LABEL : m_labels[code];
+}
+
+uint32_t util::label_codes::code_of(uint32_t label) const
+{
+    auto it = m_codes.find(label);
+    
+    return it == m_codes.end() ? NO_CODE : it->second;
+}
+
+uint32_t util::label_codes::label_of(uint32_t code) const
+{
+    return m_labels[code];
+}
+
+void util::label_codes::unchecked_assign(uint32_t label, const util::bit_array& index,
+                                         std::vector<uint32_t>* emptied)
+{
+    uint32_t code = require_code(label);
+    
+    auto func = [this, code, emptied] (uint32_t idx) -> void {
+        uint32_t current = get(idx);
+        
+        if (current == code)
+        {
+            return;
+        }
+        
+        if (current != NO_CODE && --m_counts[current] == 0 && emptied)
+        {
+            emptied->push_back(m_labels[current]);
+        }
+        
+        set(idx, code);
+        m_counts[code]++;
+    };
+    
+    util::bit_array::for_each_set_bit(index, func);
+}
+
+void util::label_codes::unchecked_place(uint32_t label, uint32_t at_index)
+{
+    uint32_t code = require_code(label);
+    uint32_t current = get(at_index);
+    
+    if (current != NO_CODE)
+    {
+        m_counts[current]--;
+    }
+    
+    set(at_index, code);
+    m_counts[code]++;
+}
+
+void util::label_codes::remove(uint32_t label)
+{
+    auto it = m_codes.find(label);
+    
+    if (it == m_codes.end())
+    {
+        return;
+    }
+    
+    uint32_t code = it->second;
+    
+    if (m_counts[code] > 0)
+    {
+        for (uint32_t i = 0; i < m_size; i++)
+        {
+            if (get(i) == code)
+            {
+                set(i, NO_CODE);
+            }
+        }
+    }
+    
+    m_codes.erase(it);
+    m_labels[code] = NO_LABEL;
+    m_counts[code] = 0;
+    m_free.push_back(code);
+}
+
+void util::label_codes::rename(uint32_t from, uint32_t to)
+{
+    auto it = m_codes.find(from);
+    
+    if (it == m_codes.end())
+    {
+        return;
+    }
+    
+    uint32_t code = it->second;
+    
+    m_codes.erase(it);
+    m_codes[to] = code;
+    m_labels[code] = to;
+}
+
+void util::label_codes::clear()
+{
+    *this = util::label_codes();
+}
+
+void util::label_codes::resize(uint32_t to_size)
+{
+    bool is_shrinking = to_size < m_size;
+    
+    if (m_is_wide)
+    {
+        m_wide.resize(to_size, NO_CODE);
+    }
+    else
+    {
+        m_narrow.resize(to_size, uint16_t(NARROW_CODES));
+    }
+    
+    m_size = to_size;
+    
+    //  growing adds rows without a label only
+    if (is_shrinking)
+    {
+        recount();
+    }
+}
+
+void util::label_codes::append(const util::label_codes& other)
+{
+    //  own code of each of other's codes
+    std::vector<uint32_t> own_codes(other.m_labels.size(), NO_CODE);
+    
+    for (uint32_t i = 0; i < other.m_labels.size(); i++)
+    {
+        if (other.m_labels[i] != NO_LABEL && other.m_counts[i] > 0)
+        {
+            own_codes[i] = require_code(other.m_labels[i]);
+        }
+    }
+    
+    uint32_t original_sz = m_size;
+    
+    resize(original_sz + other.m_size);
+    
+    auto func = [this, original_sz, &own_codes] (uint32_t idx, uint32_t code) -> void {
+        if (code != NO_CODE)
+        {
+            uint32_t own_code = own_codes[code];
+            
+            set(original_sz + idx, own_code);
+            m_counts[own_code]++;
+        }
+    };
+    
+    for_each_code(other, 0, other.m_size, func);
+}
+
+void util::label_codes::unchecked_keep(const util::dynamic_array<uint32_t>& at_indices, int32_t index_offset)
+{
+    uint32_t new_size = at_indices.tail();
+    uint32_t* at_indices_ptr = at_indices.unsafe_get_pointer();
+    
+    if (m_is_wide)
+    {
+        std::vector<uint32_t> kept(new_size);
+        
+        for (uint32_t i = 0; i < new_size; i++)
+        {
+            kept[i] = m_wide[at_indices_ptr[i] + index_offset];
+        }
+        
+        m_wide = std::move(kept);
+    }
+    else
+    {
+        std::vector<uint16_t> kept(new_size);
+        
+        for (uint32_t i = 0; i < new_size; i++)
+        {
+            kept[i] = m_narrow[at_indices_ptr[i] + index_offset];
+        }
+        
+        m_narrow = std::move(kept);
+    }
+    
+    m_size = new_size;
+    
+    recount();
+}
+
+void util::label_codes::unchecked_compress(const util::bit_array& mask)
+{
+    uint32_t n_kept = 0;
+    
+    auto func = [this, &n_kept] (uint32_t idx) -> void {
+        if (m_is_wide)
+        {
+            m_wide[n_kept++] = m_wide[idx];
+        }
+        else
+        {
+            m_narrow[n_kept++] = m_narrow[idx];
+        }
+    };
+    
+    util::bit_array::for_each_set_bit(mask, func);
+    
+    //  kept rows were moved toward the front, in order
+    resize(n_kept);
+}
+
+util::bit_array util::label_codes::to_bit_array(uint32_t label) const
+{
+    util::bit_array result(m_size, false);
+    uint32_t code = code_of(label);
+    
+    if (code == NO_CODE || m_counts[code] == 0)
+    {
+        return result;
+    }
+    
+    auto func = [&result, code] (uint32_t idx, uint32_t c) -> void {
+        if (c == code)
+        {
+            result.unchecked_place(true, idx);
+        }
+    };
+    
+    for_each_code(*this, 0, m_size, func);
+    
+    return result;
+}
+
+util::label_index util::label_codes::index(uint32_t label, uint32_t policy) const
+{
+    util::label_index result(to_bit_array(label));
+    result.apply_policy(policy);
+    
+    return result;
+}
+
+bool util::label_codes::eq_contents(const util::label_codes& other) const
+{
+    if (m_size != other.m_size)
+    {
+        return false;
+    }
+    
+    for (uint32_t i = 0; i < m_size; i++)
+    {
+        if (at(i) != other.at(i))
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool util::label_codes::matches(uint32_t label, const util::label_index& index) const
+{
+    if (index.size() != m_size || index.sum() != count(label))
+    {
+        return false;
+    }
+    
+    uint32_t code = code_of(label);
+    bool all = true;
+    
+    auto func = [this, code, &all] (uint32_t idx) -> void {
+        all = all && get(idx) == code;
+    };
+    
+    util::label_index::for_each_set_bit(index, func);
+    
+    return all;
+}
+
+util::dynamic_array<uint32_t> util::label_codes::find(const util::label_codes& a, uint32_t label, uint32_t index_offset)
+{
+    uint32_t n_rows = a.count(label);
+    uint32_t code = a.code_of(label);
+    
+    util::dynamic_array<uint32_t> result(n_rows);
+    uint32_t* result_ptr = result.unsafe_get_pointer();
+    uint32_t n_found = 0;
+    
+    if (n_rows > 0)
+    {
+        auto func = [result_ptr, &n_found, code, index_offset] (uint32_t idx, uint32_t c) -> void {
+            if (c == code)
+            {
+                result_ptr[n_found++] = idx + index_offset;
+            }
+        };
+        
+        for_each_code(a, 0, a.m_size, func);
+    }
+    
+    result.seek_tail_to_end();
+    
+    return result;
+}
+
+//  get: Code of row `index`, or NO_CODE.
+
+uint32_t util::label_codes::get(uint32_t index) const
+{
+    if (m_is_wide)
+    {
+        return m_wide[index];
+    }
+    
+    uint16_t code = m_narrow[index];
+    
+    return code == NARROW_CODES ? NO_CODE : uint32_t(code);
+}
+
+void util::label_codes::set(uint32_t index, uint32_t code)
+{
+    if (m_is_wide)
+    {
+        m_wide[index] = code;
+    }
+    else
+    {
+        m_narrow[index] = code == NO_CODE ? uint16_t(NARROW_CODES) : uint16_t(code);
+    }
+}
+
+//  require_code: Code of `label`, added if it has none. Codes are widened
+//      once the next code no longer fits in 16 bits.
+
+uint32_t util::label_codes::require_code(uint32_t label)
+{
+    auto it = m_codes.find(label);
+    
+    if (it != m_codes.end())
+    {
+        return it->second;
+    }
+    
+    uint32_t code;
+    
+    if (!m_free.empty())
+    {
+        code = m_free.back();
+        m_free.pop_back();
+        m_labels[code] = label;
+    }
+    else
+    {
+        code = uint32_t(m_labels.size());
+        m_labels.push_back(label);
+        m_counts.push_back(0u);
+    }
+    
+    if (!m_is_wide && code >= NARROW_CODES)
+    {
+        widen();
+    }
+    
+    m_codes[label] = code;
+    
+    return code;
+}
+
+void util::label_codes::widen()
+{
+    m_wide.resize(m_size);
+    
+    for (uint32_t i = 0; i < m_size; i++)
+    {
+        m_wide[i] = m_narrow[i] == NARROW_CODES ? NO_CODE : uint32_t(m_narrow[i]);
+    }
+    
+    m_narrow = std::vector<uint16_t>();
+    m_is_wide = true;
+}
+
+void util::label_codes::recount()
+{
+    std::fill(m_counts.begin(), m_counts.end(), 0u);
+    
+    auto func = [this] (uint32_t, uint32_t code) -> void {
+        if (code != NO_CODE)
+        {
+            m_counts[code]++;
+        }
+    };
+    
+    for_each_code(*this, 0, m_size, func);
+}
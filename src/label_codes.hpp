@@ -0,0 +1,142 @@
+//
+//  label_codes.hpp
+//  locator
+//
+
+#pragma once
+
+#include "bit_array.hpp"
+#include "label_index.hpp"
+#include "dynamic_array.hpp"
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+namespace util {
+    class label_codes;
+    
+    struct category_storage {
+        static constexpr uint32_t INDICES = 0u;
+        static constexpr uint32_t CODES = 1u;
+    };
+}
+
+//  label_codes: Rows of every label of a single category, held as one code
+//      per row rather than one index per label.
+//
+//      Codes are 16 bits wide until the category needs more than
+//      NARROW_CODES of them, and 32 bits wide after; the widest code marks
+//      a row without a label. A label's index is built from the codes each
+//      time it is asked for and is not kept, so memory does not grow with
+//      the number of labels queried.
+
+class util::label_codes
+{
+public:
+    label_codes();
+    explicit label_codes(uint32_t size);
+    
+    label_codes(const label_codes& other);
+    label_codes& operator=(const label_codes& other);
+    label_codes(label_codes&& rhs) noexcept;
+    label_codes& operator=(label_codes&& rhs) noexcept;
+    
+    uint32_t size() const;
+    //  bytes: Approximate heap + object size.
+    size_t bytes() const;
+    bool is_wide() const;
+    
+    bool has_label(uint32_t label) const;
+    uint32_t count(uint32_t label) const;
+    //  at: Label of row `index`, or NO_LABEL.
+    uint32_t at(uint32_t index) const;
+    
+    //  code_of: Code of `label`, or NO_CODE; label_of: label of `code`.
+    uint32_t code_of(uint32_t label) const;
+    uint32_t label_of(uint32_t code) const;
+    
+    //  unchecked_assign: Give the rows set in `index`, a dense array of the
+    //      same size, label `label` in place of their current labels. Labels
+    //      left without rows are added to `emptied`, if given; their codes
+    //      are kept until they are removed.
+    void unchecked_assign(uint32_t label, const util::bit_array& index,
+                          std::vector<uint32_t>* emptied = nullptr);
+    void unchecked_place(uint32_t label, uint32_t at_index);
+    //  remove: Unset the rows of `label`, and free its code.
+    void remove(uint32_t label);
+    void rename(uint32_t from, uint32_t to);
+    void clear();
+    
+    void resize(uint32_t to_size);
+    void append(const label_codes& other);
+    void unchecked_keep(const util::dynamic_array<uint32_t>& at_indices, int32_t index_offset = 0);
+    void unchecked_compress(const util::bit_array& mask);
+    
+    util::bit_array to_bit_array(uint32_t label) const;
+    //  index: Rows of `label`, stored as chosen by `policy`, one of
+    //      `index_policy`. Built in one pass over the codes.
+    util::label_index index(uint32_t label, uint32_t policy) const;
+    
+    //  eq_contents: Whether every row has the same label in both, whatever
+    //      their codes.
+    bool eq_contents(const label_codes& other) const;
+    //  matches: Whether the rows of `label` are exactly those of `index`.
+    bool matches(uint32_t label, const util::label_index& index) const;
+    
+    static util::dynamic_array<uint32_t> find(const label_codes& a, uint32_t label, uint32_t index_offset = 0u);
+    
+    //  for_each_code: Call `func(index, code)` for each row at indices
+    //      [start, stop), in ascending order; `code` is NO_CODE for rows
+    //      without a label.
+    template<typename F>
+    static void for_each_code(const label_codes& a, uint32_t start, uint32_t stop, F&& func);
+    
+    static constexpr uint32_t NO_CODE = ~uint32_t(0);
+    static constexpr uint32_t NO_LABEL = ~uint32_t(0);
+    static constexpr uint32_t NARROW_CODES = 0xffffu;
+private:
+    std::vector<uint16_t> m_narrow;
+    std::vector<uint32_t> m_wide;
+    bool m_is_wide;
+    uint32_t m_size;
+    
+    //  label and number of rows of each code; freed codes hold NO_LABEL,
+    //  and are reused first.
+    std::vector<uint32_t> m_labels;
+    std::vector<uint32_t> m_counts;
+    std::vector<uint32_t> m_free;
+    std::unordered_map<uint32_t, uint32_t> m_codes;
+    
+    uint32_t get(uint32_t index) const;
+    void set(uint32_t index, uint32_t code);
+    uint32_t require_code(uint32_t label);
+    void widen();
+    void recount();
+};
+
+//
+//  impl
+//
+
+template<typename F>
+void util::label_codes::for_each_code(const label_codes& a, uint32_t start, uint32_t stop, F&& func)
+{
+    if (a.m_is_wide)
+    {
+        const uint32_t* codes = a.m_wide.data();
+        
+        for (uint32_t i = start; i < stop; i++)
+        {
+            func(i, codes[i]);
+        }
+    }
+    else
+    {
+        const uint16_t* codes = a.m_narrow.data();
+        
+        for (uint32_t i = start; i < stop; i++)
+        {
+            func(i, codes[i] == NARROW_CODES ? NO_CODE : uint32_t(codes[i]));
+        }
+    }
+}
@@ -0,0 +1,526 @@
+//
+//  label_index.cpp
+//  locator
+//
+
+#include "label_index.hpp"
+#include <stdexcept>
+
+util::label_index::label_index()
+{
+    m_is_compressed = false;
+    m_sum = 0;
+}
+
+util::label_index::label_index(const util::bit_array& index) :
+    m_dense(index)
+{
+    m_is_compressed = false;
+    m_sum = index.sum();
+}
+
+util::label_index::label_index(util::bit_array&& index) :
+    m_dense(std::move(index))
+{
+    m_is_compressed = false;
+    m_sum = m_dense.sum();
+}
+
+util::label_index::label_index(util::compressed_bit_array&& index) :
+    m_compressed(std::move(index))
+{
+    m_is_compressed = true;
+    m_sum = m_compressed.sum();
+}
+
+util::label_index::label_index(uint32_t size, bool is_compressed)
+{
+    m_is_compressed = is_compressed;
+    m_sum = 0;
+    
+    if (is_compressed)
+    {
+        m_compressed = util::compressed_bit_array(size);
+    }
+    else
+    {
+        m_dense = util::bit_array(size, false);
+    }
+}
+
+bool util::label_index::operator ==(const util::label_index& other) const
+{
+    if (size() != other.size() || sum() != other.sum())
+    {
+        return false;
+    }
+    
+    if (m_is_compressed && other.m_is_compressed)
+    {
+        return m_compressed == other.m_compressed;
+    }
+    
+    if (!m_is_compressed && !other.m_is_compressed)
+    {
+        uint32_t sz = size();
+        
+        if (sz == 0)
+        {
+            return true;
+        }
+        
+        util::bit_array eq(sz, false);
+        
+        util::bit_array::parallel_dot_eq(eq, m_dense, other.m_dense);
+        
+        return eq.parallel_sum() == sz;
+    }
+    
+    return find(*this).eq_contents(find(other));
+}
+
+bool util::label_index::operator !=(const util::label_index& other) const
+{
+    return !(*this == other);
+}
+
+bool util::label_index::is_compressed() const
+{
+    return m_is_compressed;
+}
+
+uint32_t util::label_index::size() const
+{
+    return m_is_compressed ? m_compressed.size() : m_dense.size();
+}
+
+uint32_t util::label_index::sum() const
+{
+    return m_sum;
+}
+
+size_t util::label_index::bytes() const
+{
+    if (m_is_compressed)
+    {
+        return sizeof(*this) - sizeof(m_compressed) + m_compressed.bytes();
+    }
+    
+    size_t n_words = (size_t(m_dense.size()) + 63) / 64;
+    
+    return sizeof(*this) + n_words * sizeof(util::bit_array::word_t);
+}
+
+bool util::label_index::at(uint32_t index) const
+{
+    return m_is_compressed ? m_compressed.at(index) : m_dense.at(index);
+}
+
+bool util::label_index::any() const
+{
+    return m_is_compressed ? m_compressed.any() : m_dense.any();
+}
+
+void util::label_index::place(bool value, uint32_t at_index)
+{
+    bool was_set = at_index < size() && at(at_index);
+    
+    if (m_is_compressed)
+    {
+        m_compressed.place(value, at_index);
+    }
+    else
+    {
+        m_dense.place(value, at_index);
+    }
+    
+    if (value != was_set)
+    {
+        m_sum = value ? m_sum + 1 : m_sum - 1;
+    }
+}
+
+void util::label_index::fill(bool value)
+{
+    if (m_is_compressed)
+    {
+        m_compressed.fill(value);
+    }
+    else
+    {
+        m_dense.fill(value);
+    }
+    
+    m_sum = value ? size() : 0;
+}
+
+void util::label_index::resize(uint32_t to_size)
+{
+    bool is_shrinking = to_size < size();
+    
+    if (m_is_compressed)
+    {
+        m_compressed.resize(to_size);
+    }
+    else
+    {
+        m_dense.resize(to_size);
+    }
+    
+    //  growing adds unset rows only
+    if (is_shrinking)
+    {
+        recount();
+    }
+}
+
+void util::label_index::append(const util::label_index& other)
+{
+    if (m_is_compressed)
+    {
+        if (other.m_is_compressed)
+        {
+            m_compressed.append(other.m_compressed);
+        }
+        else
+        {
+            m_compressed.append(util::compressed_bit_array(other.m_dense));
+        }
+    }
+    else
+    {
+        if (other.m_is_compressed)
+        {
+            m_dense.append(other.m_compressed.to_bit_array());
+        }
+        else
+        {
+            m_dense.append(other.m_dense);
+        }
+    }
+    
+    m_sum += other.m_sum;
+}
+
+void util::label_index::unchecked_keep(const util::dynamic_array<uint32_t>& at_indices, int32_t index_offset)
+{
+    if (m_is_compressed)
+    {
+        m_compressed.unchecked_keep(at_indices, index_offset);
+    }
+    else
+    {
+        m_dense.unchecked_keep(at_indices, index_offset);
+    }
+    
+    recount();
+}
+
+void util::label_index::unchecked_compress(const util::bit_array& mask)
+{
+    if (m_is_compressed)
+    {
+        m_compressed.unchecked_compress(mask);
+    }
+    else
+    {
+        m_dense.unchecked_compress(mask);
+    }
+    
+    recount();
+}
+
+void util::label_index::unchecked_or(const util::bit_array& index)
+{
+    if (m_is_compressed)
+    {
+        m_compressed.unchecked_or(index);
+    }
+    else
+    {
+        util::bit_array::unchecked_dot_or(m_dense, m_dense, index, 0, m_dense.size());
+    }
+    
+    recount();
+}
+
+void util::label_index::unchecked_and_not(const util::bit_array& index)
+{
+    if (m_is_compressed)
+    {
+        m_compressed.unchecked_and_not(index);
+    }
+    else
+    {
+        util::bit_array::unchecked_dot_and_not(m_dense, m_dense, index, 0, m_dense.size());
+    }
+    
+    recount();
+}
+
+void util::label_index::unchecked_or(const util::bit_array& index, const std::vector<util::bit_array::span>& spans)
+{
+    if (spans.empty())
+    {
+        return;
+    }
+    
+    if (m_is_compressed)
+    {
+        m_compressed.unchecked_or(index, spans.front().start, spans.back().stop);
+        recount();
+        return;
+    }
+    
+    //  the sum grows by the rows newly set, counted over the same spans
+    for (const util::bit_array::span& span : spans)
+    {
+        m_sum += util::bit_array::unchecked_and_not_count(index, m_dense, span.start, span.stop);
+        util::bit_array::unchecked_dot_or(m_dense, m_dense, index, span.start, span.stop);
+    }
+}
+
+uint32_t util::label_index::unchecked_and_not(const util::bit_array& index, const std::vector<util::bit_array::span>& spans)
+{
+    if (spans.empty())
+    {
+        return 0;
+    }
+    
+    uint32_t orig_sum = m_sum;
+    
+    if (m_is_compressed)
+    {
+        m_compressed.unchecked_and_not(index, spans.front().start, spans.back().stop);
+        recount();
+        
+        return orig_sum - m_sum;
+    }
+    
+    //  spans without a row in common are only read
+    for (const util::bit_array::span& span : spans)
+    {
+        uint32_t n_unset = util::bit_array::unchecked_and_count(m_dense, index, span.start, span.stop);
+        
+        if (n_unset > 0)
+        {
+            util::bit_array::unchecked_dot_and_not(m_dense, m_dense, index, span.start, span.stop);
+            m_sum -= n_unset;
+        }
+    }
+    
+    return orig_sum - m_sum;
+}
+
+void util::label_index::unchecked_or(const uint32_t* rows, uint32_t n_rows)
+{
+    if (m_is_compressed)
+    {
+        m_compressed.unchecked_or(rows, n_rows);
+        recount();
+        return;
+    }
+    
+    for (uint32_t i = 0; i < n_rows; i++)
+    {
+        if (!m_dense.at(rows[i]))
+        {
+            m_dense.unchecked_place(true, rows[i]);
+            m_sum++;
+        }
+    }
+}
+
+void util::label_index::unchecked_or_into(util::bit_array& out) const
+{
+    if (m_is_compressed)
+    {
+        m_compressed.unchecked_or_into(out);
+    }
+    else
+    {
+        util::bit_array::unchecked_dot_or(out, out, m_dense, 0, m_dense.size());
+    }
+}
+
+void util::label_index::unchecked_and_into(util::bit_array& out) const
+{
+    if (m_is_compressed)
+    {
+        m_compressed.unchecked_and_into(out);
+    }
+    else
+    {
+        util::bit_array::unchecked_dot_and(out, out, m_dense, 0, m_dense.size());
+    }
+}
+
+bool util::label_index::unchecked_intersects(const util::bit_array& index) const
+{
+    if (m_is_compressed)
+    {
+        return m_compressed.unchecked_intersects(index);
+    }
+    
+    return util::bit_array::unchecked_intersects(m_dense, index);
+}
+
+const util::bit_array& util::label_index::dense() const
+{
+    if (m_is_compressed)
+    {
+        throw std::runtime_error("Index is compressed.");
+    }
+    
+    return m_dense;
+}
+
+const util::compressed_bit_array& util::label_index::compressed() const
+{
+    if (!m_is_compressed)
+    {
+        throw std::runtime_error("Index is not compressed.");
+    }
+    
+    return m_compressed;
+}
+
+util::bit_array util::label_index::to_bit_array() const
+{
+    return m_is_compressed ? m_compressed.to_bit_array() : m_dense;
+}
+
+void util::label_index::apply_policy(uint32_t policy)
+{
+    if (policy == util::index_policy::DENSE)
+    {
+        expand();
+        return;
+    }
+    
+    if (policy == util::index_policy::COMPRESSED)
+    {
+        compress();
+        return;
+    }
+    
+    uint64_t sz = size();
+    uint64_t n_true = sum();
+    
+    if (sz < MIN_COMPRESSED_SIZE)
+    {
+        expand();
+    }
+    else if (!m_is_compressed && compresses(policy, uint32_t(sz), uint32_t(n_true)))
+    {
+        compress();
+    }
+    else if (m_is_compressed && n_true * EXPAND_ABOVE > sz)
+    {
+        expand();
+    }
+}
+
+bool util::label_index::compresses(uint32_t policy, uint32_t size, uint32_t n_true)
+{
+    if (policy != util::index_policy::BY_DENSITY)
+    {
+        return policy == util::index_policy::COMPRESSED;
+    }
+    
+    return size >= MIN_COMPRESSED_SIZE && uint64_t(n_true) * COMPRESS_BELOW < size;
+}
+
+util::dynamic_array<uint32_t> util::label_index::find(const util::label_index& a, uint32_t index_offset)
+{
+    if (a.m_is_compressed)
+    {
+        return util::compressed_bit_array::find(a.m_compressed, index_offset);
+    }
+    
+    return util::bit_array::find(a.m_dense, index_offset);
+}
+
+void util::label_index::concat(util::label_index& out, const std::vector<const util::label_index*>& parts)
+{
+    bool all_compressed = true;
+    uint32_t total_sum = 0;
+    
+    for (const util::label_index* part : parts)
+    {
+        all_compressed = all_compressed && part->m_is_compressed;
+        total_sum += part->m_sum;
+    }
+    
+    if (all_compressed)
+    {
+        util::compressed_bit_array result;
+        
+        for (const util::label_index* part : parts)
+        {
+            result.append(part->m_compressed);
+        }
+        
+        out.m_compressed = std::move(result);
+        out.m_dense = util::bit_array();
+        out.m_is_compressed = true;
+        out.m_sum = total_sum;
+        
+        return;
+    }
+    
+    std::vector<util::bit_array> expanded;
+    std::vector<const util::bit_array*> dense_parts;
+    
+    expanded.reserve(parts.size());
+    
+    for (const util::label_index* part : parts)
+    {
+        if (part->m_is_compressed)
+        {
+            expanded.push_back(part->m_compressed.to_bit_array());
+            dense_parts.push_back(&expanded.back());
+        }
+        else
+        {
+            dense_parts.push_back(&part->m_dense);
+        }
+    }
+    
+    util::bit_array result;
+    util::bit_array::concat(result, dense_parts);
+    
+    out.m_dense = std::move(result);
+    out.m_compressed = util::compressed_bit_array();
+    out.m_is_compressed = false;
+    out.m_sum = total_sum;
+}
+
+void util::label_index::compress()
+{
+    if (m_is_compressed)
+    {
+        return;
+    }
+    
+    m_compressed = util::compressed_bit_array(m_dense);
+    m_dense = util::bit_array();
+    m_is_compressed = true;
+}
+
+void util::label_index::expand()
+{
+    if (!m_is_compressed)
+    {
+        return;
+    }
+    
+    m_dense = m_compressed.to_bit_array();
+    m_compressed = util::compressed_bit_array();
+    m_is_compressed = false;
+}
+
+void util::label_index::recount()
+{
+    m_sum = m_is_compressed ? m_compressed.sum() : m_dense.sum();
+}
@@ -0,0 +1,141 @@
+//
+//  label_index.hpp
+//  locator
+//
+
+#pragma once
+
+#include "bit_array.hpp"
+#include "compressed_bit_array.hpp"
+#include "dynamic_array.hpp"
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+namespace util {
+    class label_index;
+    
+    struct index_policy {
+        static constexpr uint32_t DENSE = 0u;
+        static constexpr uint32_t COMPRESSED = 1u;
+        static constexpr uint32_t BY_DENSITY = 2u;
+    };
+}
+
+//  label_index: Rows occupied by a single label, held either as a
+//      bit_array or as a compressed_bit_array.
+
+class util::label_index
+{
+public:
+    label_index();
+    explicit label_index(const util::bit_array& index);
+    explicit label_index(util::bit_array&& index);
+    explicit label_index(util::compressed_bit_array&& index);
+    explicit label_index(uint32_t size, bool is_compressed);
+    
+    bool operator ==(const util::label_index& other) const;
+    bool operator !=(const util::label_index& other) const;
+    
+    bool is_compressed() const;
+    
+    uint32_t size() const;
+    //  sum: Number of rows set. The count is kept up to date by each
+    //      operation, so reading it is constant time.
+    uint32_t sum() const;
+    size_t bytes() const;
+    
+    bool at(uint32_t index) const;
+    bool any() const;
+    
+    void place(bool value, uint32_t at_index);
+    void fill(bool value);
+    void resize(uint32_t to_size);
+    void append(const util::label_index& other);
+    void unchecked_keep(const util::dynamic_array<uint32_t>& at_indices, int32_t index_offset = 0);
+    void unchecked_compress(const util::bit_array& mask);
+    
+    void unchecked_or(const util::bit_array& index);
+    void unchecked_and_not(const util::bit_array& index);
+    //  Versions restricted to `spans` of `index`, which must hold all of
+    //  its set bits, as given by bit_array::occupied_spans. Rows outside
+    //  them are not read. unchecked_and_not returns the number of rows
+    //  unset.
+    void unchecked_or(const util::bit_array& index, const std::vector<util::bit_array::span>& spans);
+    uint32_t unchecked_and_not(const util::bit_array& index, const std::vector<util::bit_array::span>& spans);
+    //  Set `rows`, which must be ascending and distinct.
+    void unchecked_or(const uint32_t* rows, uint32_t n_rows);
+    void unchecked_or_into(util::bit_array& out) const;
+    void unchecked_and_into(util::bit_array& out) const;
+    //  unchecked_intersects: Whether any row is set both here and in
+    //      `index`, a dense array of the same size.
+    bool unchecked_intersects(const util::bit_array& index) const;
+    
+    const util::bit_array& dense() const;
+    const util::compressed_bit_array& compressed() const;
+    util::bit_array to_bit_array() const;
+    
+    //  apply_policy: Convert to the representation chosen by `policy`, one
+    //      of `index_policy`.
+    void apply_policy(uint32_t policy);
+    //  compresses: Whether apply_policy(policy) compresses a dense index of
+    //      `size` rows with `n_true` set.
+    static bool compresses(uint32_t policy, uint32_t size, uint32_t n_true);
+    
+    static util::dynamic_array<uint32_t> find(const util::label_index& a, uint32_t index_offset = 0u);
+    
+    template<typename F>
+    static void for_each_set_bit(const util::label_index& a, F&& func);
+    template<typename F>
+    static void for_each_set_bit(const util::label_index& a, uint32_t start, uint32_t stop, F&& func);
+    
+    //  concat: Join `parts` end to end. The result is compressed only if
+    //      every part is; compressed parts of a dense result are expanded.
+    static void concat(util::label_index& out, const std::vector<const util::label_index*>& parts);
+    
+    //  under BY_DENSITY, labels spanning at least MIN_COMPRESSED_SIZE rows
+    //  are compressed below 1 / COMPRESS_BELOW density, and expanded again
+    //  above 1 / EXPAND_ABOVE.
+    static constexpr uint32_t MIN_COMPRESSED_SIZE = 1u << 16;
+    static constexpr uint32_t COMPRESS_BELOW = 32u;
+    static constexpr uint32_t EXPAND_ABOVE = 16u;
+private:
+    util::bit_array m_dense;
+    util::compressed_bit_array m_compressed;
+    bool m_is_compressed;
+    uint32_t m_sum;
+    
+    void compress();
+    void expand();
+    void recount();
+};
+
+//
+//  impl
+//
+
+template<typename F>
+void util::label_index::for_each_set_bit(const util::label_index& a, F&& func)
+{
+    if (a.m_is_compressed)
+    {
+        util::compressed_bit_array::for_each_set_bit(a.m_compressed, std::forward<F>(func));
+    }
+    else
+    {
+        util::bit_array::for_each_set_bit(a.m_dense, std::forward<F>(func));
+    }
+}
+
+template<typename F>
+void util::label_index::for_each_set_bit(const util::label_index& a, uint32_t start, uint32_t stop, F&& func)
+{
+    if (a.m_is_compressed)
+    {
+        util::compressed_bit_array::for_each_set_bit(a.m_compressed, start, stop, std::forward<F>(func));
+    }
+    else
+    {
+        util::bit_array::for_each_set_bit(a.m_dense, start, stop, std::forward<F>(func));
+    }
+}
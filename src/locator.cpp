@@ -7,18 +7,26 @@
 
 #include "locator.hpp"
 #include "utilities.hpp"
+#include "thread_pool.hpp"
+#include "bit_matrix.hpp"
 #include <algorithm>
 #include <iostream>
 #include <chrono>
 #include <cassert>
 #include <string>
 
+namespace {
+    //  scratch index of find(), per thread so that concurrent finds do not
+    //  share it. It is reallocated whenever the size searched changes.
+    thread_local util::bit_array find_scratch;
+}
+
 #define LOC_COMB_FULL_CAT
 #define LOC_FIND_ALL_ONE_CAT_ARRAY
 
 uint32_t util::get_random_id(std::function<bool(uint32_t)> exists_func)
 {
-    static std::mt19937 random_engine = std::mt19937(std::random_device()());
+    static thread_local std::mt19937 random_engine = std::mt19937(std::random_device()());
     
     uint32_t int_max = ~(uint32_t(0));
     std::uniform_int_distribution<uint32_t> uniform_dist(0, int_max);
@@ -36,14 +44,20 @@ uint32_t util::get_random_id(std::function<bool(uint32_t)> exists_func)
 util::locator::locator()
 {
     m_n_labels = 0;
+    m_index_policy = util::index_policy::BY_DENSITY;
 }
 
 util::locator::locator(uint32_t n_labels_hint)
 {
     m_n_labels = 0;
+    m_index_policy = util::index_policy::BY_DENSITY;
     
     m_labels.resize(n_labels_hint);
     m_labels.seek_tail_to_start();
+    
+    m_label_slots.reserve(n_labels_hint);
+    m_label_categories.reserve(n_labels_hint);
+    m_label_indices.reserve(n_labels_hint);
 }
 
 util::locator::~locator() noexcept
@@ -55,12 +69,16 @@ util::locator::~locator() noexcept
 util::locator::locator(const util::locator& other) :
     m_labels(other.m_labels),
     m_categories(other.m_categories),
-    m_in_category(other.m_in_category),
-    m_by_category(other.m_by_category),
-    m_indices(other.m_indices),
-    m_tmp_index(other.m_tmp_index)
+    m_label_slots(other.m_label_slots),
+    m_label_categories(other.m_label_categories),
+    m_label_indices(other.m_label_indices),
+    m_category_slots(other.m_category_slots),
+    m_category_labels(other.m_category_labels),
+    m_category_storage(other.m_category_storage),
+    m_category_codes(other.m_category_codes)
 {
     m_n_labels = other.m_n_labels;
+    m_index_policy = other.m_index_policy;
 }
 
 //  copy-assign
@@ -75,12 +93,16 @@ util::locator& util::locator::operator=(const util::locator& other)
 util::locator::locator(util::locator&& rhs) noexcept :
     m_labels(std::move(rhs.m_labels)),
     m_categories(std::move(rhs.m_categories)),
-    m_in_category(std::move(rhs.m_in_category)),
-    m_by_category(std::move(rhs.m_by_category)),
-    m_indices(std::move(rhs.m_indices)),
-    m_tmp_index(std::move(rhs.m_tmp_index))
+    m_label_slots(std::move(rhs.m_label_slots)),
+    m_label_categories(std::move(rhs.m_label_categories)),
+    m_label_indices(std::move(rhs.m_label_indices)),
+    m_category_slots(std::move(rhs.m_category_slots)),
+    m_category_labels(std::move(rhs.m_category_labels)),
+    m_category_storage(std::move(rhs.m_category_storage)),
+    m_category_codes(std::move(rhs.m_category_codes))
 {
     m_n_labels = rhs.m_n_labels;
+    m_index_policy = rhs.m_index_policy;
     rhs.m_n_labels = 0;
 }
 
@@ -89,11 +111,15 @@ util::locator& util::locator::operator=(util::locator&& rhs) noexcept
 {
     m_labels = std::move(rhs.m_labels);
     m_categories = std::move(rhs.m_categories);
-    m_in_category = std::move(rhs.m_in_category);
-    m_by_category = std::move(rhs.m_by_category);
-    m_indices = std::move(rhs.m_indices);
-    m_tmp_index = std::move(rhs.m_tmp_index);
+    m_label_slots = std::move(rhs.m_label_slots);
+    m_label_categories = std::move(rhs.m_label_categories);
+    m_label_indices = std::move(rhs.m_label_indices);
+    m_category_slots = std::move(rhs.m_category_slots);
+    m_category_labels = std::move(rhs.m_category_labels);
+    m_category_storage = std::move(rhs.m_category_storage);
+    m_category_codes = std::move(rhs.m_category_codes);
     m_n_labels = rhs.m_n_labels;
+    m_index_policy = rhs.m_index_policy;
     
     rhs.m_n_labels = 0;
     
@@ -149,26 +175,44 @@ bool util::locator::operator ==(const util::locator &other) const
         return false;
     }
     
+    //  coded categories with the same labels in both are compared row by
+    //  row, in one pass each
+    std::vector<bool> compared(m_category_slots.n_slots(), false);
+    
+    for (uint32_t i = 0; i < m_category_slots.n_slots(); i++)
+    {
+        if (!m_category_slots.is_used(i) || m_category_storage[i] != util::category_storage::CODES)
+        {
+            continue;
+        }
+        
+        uint32_t category = m_category_slots.key_of(i);
+        const util::label_codes* other_codes = other.find_codes(category);
+        
+        if (!other_codes || !other.find_labels(category)->eq_contents(m_category_labels[i]))
+        {
+            continue;
+        }
+        
+        if (!m_category_codes[i].eq_contents(*other_codes))
+        {
+            return false;
+        }
+        
+        compared[i] = true;
+    }
+    
     //  otherwise, we have to loop through all the indices to compare
     uint32_t* lab_ptr = m_labels.unsafe_get_pointer();
     
-    util::bit_array self_copy(sz, false);
-    
     for (uint32_t i = 0; i < m_n_labels; i++)
     {
         uint32_t label = lab_ptr[i];
         
-        const util::bit_array& self_ref = m_indices.at(label);
-        const util::bit_array& other_ref = other.m_indices.at(label);
-        
-        util::bit_array::unchecked_dot_eq(self_copy, self_ref, other_ref, 0, sz);
-        
-        if (!self_copy.all())
+        if (!compared[m_label_categories[m_label_slots.find(label)]] && !label_matches(label, other))
         {
             return false;
         }
-        
-        self_copy.fill(false);
     }
     
     return true;
@@ -178,9 +222,7 @@ uint32_t util::locator::which_category(uint32_t label, bool *exists) const
 {
     uint32_t category = 0u;
     
-    auto it = m_in_category.find(label);
-    
-    if (it == m_in_category.end())
+    if (!has_label(label))
     {
         *exists = false;
         return category;
@@ -188,14 +230,14 @@ uint32_t util::locator::which_category(uint32_t label, bool *exists) const
     
     *exists = true;
     
-    return it->second;
+    return category_of(label);
 }
 
 util::types::entries_t util::locator::all_in_category(uint32_t category, bool *exists) const
 {
-    auto it = m_by_category.find(category);
+    const types::entries_t* labs = find_labels(category);
     
-    if (it == m_by_category.end())
+    if (!labs)
     {
         *exists = false;
         return util::types::entries_t();
@@ -203,7 +245,7 @@ util::types::entries_t util::locator::all_in_category(uint32_t category, bool *e
     
     *exists = true;
     
-    return it->second;
+    return *labs;
 }
 
 util::types::entries_t util::locator::full_category(uint32_t category, bool *exists) const
@@ -213,9 +255,9 @@ util::types::entries_t util::locator::full_category(uint32_t category, bool *exi
 
 util::types::entries_t util::locator::full_category(uint32_t category, uint32_t set_empty_labels, bool *exists) const
 {
-    auto it = m_by_category.find(category);
+    const types::entries_t* labs_found = find_labels(category);
     
-    if (it == m_by_category.end())
+    if (!labs_found)
     {
         *exists = false;
         return util::types::entries_t();
@@ -223,7 +265,7 @@ util::types::entries_t util::locator::full_category(uint32_t category, uint32_t
     
     *exists = true;
     
-    const util::types::entries_t& labs = it->second;
+    const util::types::entries_t& labs = *labs_found;
     
     uint32_t n_in_cat = labs.tail();
     
@@ -239,20 +281,31 @@ util::types::entries_t util::locator::full_category(uint32_t category, uint32_t
     util::types::entries_t result(sz);
     uint32_t* result_ptr = result.unsafe_get_pointer();
     
+    const util::label_codes* codes = find_codes(category);
+    
+    //  a coded category is a straight gather
+    if (codes)
+    {
+        auto func = [result_ptr, codes, set_empty_labels] (uint32_t idx, uint32_t code) -> void {
+            result_ptr[idx] = code == util::label_codes::NO_CODE ? set_empty_labels : codes->label_of(code);
+        };
+        
+        util::label_codes::for_each_code(*codes, 0, sz, func);
+        
+        return result;
+    }
+    
     std::memset(result_ptr, set_empty_labels, sz * sizeof(uint32_t));
     
     for (uint32_t i = 0; i < n_in_cat; i++)
     {
         uint32_t lab = labs_ptr[i];
-        auto inds = util::bit_array::find(m_indices.at(lab));
-        uint32_t* inds_ptr = inds.unsafe_get_pointer();
         
-        uint32_t n_inds = inds.tail();
+        auto func = [result_ptr, lab] (uint32_t idx) -> void {
+            result_ptr[idx] = lab;
+        };
         
-        for (uint32_t j = 0; j < n_inds; j++)
-        {
-            result_ptr[inds_ptr[j]] = lab;
-        }
+        util::label_index::for_each_set_bit(get_index(lab), func);
     }
     
     return result;
@@ -260,12 +313,53 @@ util::types::entries_t util::locator::full_category(uint32_t category, uint32_t
 
 util::types::find_all_return_t util::locator::find_all(const types::entries_t& categories,
                                                        bool* exist, uint32_t index_offset) const
+{
+    return from_csr(find_all_csr(categories, exist, index_offset));
+}
+
+util::types::find_all_csr_t util::locator::find_all_csr(const types::entries_t& categories,
+                                                       bool* exist, uint32_t index_offset) const
+{
+    return group_rows(categories, exist, index_offset, true);
+}
+
+util::types::count_all_return_t util::locator::count_all(const types::entries_t& categories, bool* exist) const
+{
+    types::find_all_csr_t csr = group_rows(categories, exist, 0u, false);
+    types::count_all_return_t result;
+    
+    uint32_t n_combs = csr.offsets.tail() == 0 ? 0 : csr.offsets.tail() - 1;
+    
+    result.combinations = std::move(csr.combinations);
+    result.counts = types::entries_t(n_combs);
+    result.counts.seek_tail_to_end();
+    
+    uint32_t* offsets_ptr = csr.offsets.unsafe_get_pointer();
+    uint32_t* counts_ptr = result.counts.unsafe_get_pointer();
+    
+    for (uint32_t i = 0; i < n_combs; i++)
+    {
+        counts_ptr[i] = offsets_ptr[i+1] - offsets_ptr[i];
+    }
+    
+    return result;
+}
+
+//  group_rows: Group rows either by intersecting label indices or by
+//      coding each row, whichever use_find_all_bitmaps() expects to be
+//      cheaper. Both give the same result. Without `with_indices`, only the
+//      offsets of each combination are filled, and no per-row output is
+//      allocated.
+
+util::types::find_all_csr_t util::locator::group_rows(const types::entries_t& categories, bool* exist,
+                                                     uint32_t index_offset, bool with_indices) const
 {
     using namespace util;
     
-    types::find_all_return_t result;
+    types::find_all_csr_t result;
     
     uint32_t n_cats_in = categories.tail();
+    uint32_t* cat_ptr = categories.unsafe_get_pointer();
     
     *exist = true;
     
@@ -274,818 +368,2534 @@ util::types::find_all_return_t util::locator::find_all(const types::entries_t& c
         return result;
     }
     
-    uint32_t* cat_ptr = categories.unsafe_get_pointer();
-    
-    types::arr_entries_t full_categories(n_cats_in);
-    types::entries_t* full_categories_ptr = full_categories.unsafe_get_pointer();
-    
-    //  fill empty spaces in categories with this label
-    uint32_t undf_lab = util::locator::UNDEFINED_LABEL;
+    std::vector<const types::entries_t*> cat_labels(n_cats_in);
     
     for (uint32_t i = 0; i < n_cats_in; i++)
     {
-        full_categories_ptr[i] = full_category(cat_ptr[i], undf_lab, exist);
+        const types::entries_t* labs = find_labels(cat_ptr[i]);
         
-        if (!(*exist))
+        if (!labs)
         {
+            *exist = false;
             return result;
         }
         
-        //  if there are no labels in the category, no
-        //  combinations can possibly exist
-        
-        if (full_categories_ptr[i].tail() == 0)
+        //  if there are no labels in the category, no combinations can
+        //  possibly exist
+        if (labs->tail() == 0)
         {
             return result;
         }
+        
+        cat_labels[i] = labs;
     }
     
-    uint32_t sz = size();
+    //  the indices of coded categories would have to be built first
+    bool any_coded = false;
     
-    //  hash based on the sequence of bits formed by
-    //  labels in a given category
-    size_t size_int = sizeof(uint32_t);
-    std::string hash_code(n_cats_in * size_int, 'a');
-    char* hash_code_ptr = &hash_code[0];
+    for (uint32_t i = 0; i < n_cats_in; i++)
+    {
+        any_coded = any_coded || find_codes(cat_ptr[i]) != nullptr;
+    }
     
-    std::unordered_map<std::string, uint32_t> combination_exists;
-    uint32_t next_id = 0;
+    if (!any_coded && use_find_all_bitmaps(cat_labels))
+    {
+        return find_all_bitmaps(cat_labels, index_offset, with_indices);
+    }
     
-    //  start with room for 2048 combinations (just a guess)
-    result.combinations.resize(2048);
-    result.combinations.seek_tail_to_start();
-    result.indices.resize(2048);
-    result.indices.seek_tail_to_start();
+    //  rows are coded in parallel only if the codes fit in 64 bits
+    uint64_t code_range = 1;
+    bool fits = true;
     
-    for (uint32_t i = 0; i < sz; i++)
+    for (const types::entries_t* labs : cat_labels)
     {
-        for (uint32_t j = 0; j < n_cats_in; j++)
-        {
-            uint32_t* full_cat = full_categories_ptr[j].unsafe_get_pointer();
-            //  copy bits to string
-            std::memcpy(hash_code_ptr + j * size_int, &full_cat[i], size_int);
-        }
+        uint64_t radix = uint64_t(labs->tail()) + 1;
         
-        auto c_it = combination_exists.find(hash_code);
-        bool c_exists = c_it != combination_exists.end();
-        uint32_t comb_idx;
+        fits = fits && code_range <= ~uint64_t(0) / radix;
+        code_range = fits ? code_range * radix : code_range;
+    }
+    
+    uint32_t sz = size();
+    util::thread_pool& pool = util::thread_pool::shared();
+    
+    if (fits && pool.size() > 1 && sz >= util::thread_pool::get_parallel_threshold())
+    {
+        return find_all_rows_parallel(cat_labels, code_range, index_offset, with_indices);
+    }
+    
+    return find_all_rows(cat_labels, index_offset, with_indices);
+}
+
+//  use_find_all_bitmaps: Whether intersecting label indices is expected to
+//      be cheaper than coding each row. Intersection costs about
+//      FIND_ALL_BITMAP_PASSES passes over the rows, in words, for each label
+//      of each non-empty combination of the categories before it; the
+//      number of those combinations is bounded by the product of the label
+//      counts and by the number of rows. Coding rows costs about
+//      FIND_ALL_ROW_COST words per row and category.
+
+bool util::locator::use_find_all_bitmaps(const std::vector<const types::entries_t*>& cat_labels) const
+{
+    uint64_t sz = size();
+    uint64_t n_words = (sz + 63) / 64;
+    uint64_t n_cats = cat_labels.size();
+    
+    uint64_t row_cost = sz * n_cats * FIND_ALL_ROW_COST;
+    uint64_t bitmap_cost = 0;
+    uint64_t n_parents = 1;
+    
+    for (uint32_t i = 0; i < n_cats; i++)
+    {
+        const types::entries_t& labs = *cat_labels[i];
+        uint64_t n_labs = labs.tail();
+        uint64_t n_covered = 0;
         
-        if (!c_exists)
+        for (uint32_t j = 0; j < n_labs; j++)
         {
-            for (uint32_t j = 0; j < n_cats_in; j++)
-            {
-                uint32_t* full_cat = full_categories_ptr[j].unsafe_get_pointer();
-                result.combinations.push(full_cat[i]);
-            }
-            
-            combination_exists[hash_code] = next_id;
-            
-            comb_idx = next_id;
+            const util::label_index& index = get_index(labs.at(j));
             
-            next_id++;
-            
-            result.indices.push(util::types::entries_t());
+            n_covered += index.sum();
+            bitmap_cost += index.is_compressed() ? n_words : 0;
         }
-        else
+        
+        //  rows without a label in the category form one more branch
+        uint64_t n_branches = n_covered == sz ? n_labs : n_labs + 1;
+        
+        bitmap_cost += n_parents * n_branches * n_words * FIND_ALL_BITMAP_PASSES;
+        n_parents = std::min(n_parents * n_branches, sz);
+        
+        if (bitmap_cost >= row_cost)
         {
-            comb_idx = c_it->second;
+            return false;
         }
-        
-        types::entries_t* inds_ptr = result.indices.unsafe_get_pointer();
-        inds_ptr[comb_idx].push(i + index_offset);
     }
     
-    return result;
+    //  each combination's rows are extracted with one more pass
+    bitmap_cost += n_parents * n_words;
+    
+    return bitmap_cost < row_cost;
 }
 
-//  keep_each: Keep one row for each subset of label combinations.
+//  find_all_bitmaps: Visit the combinations of `cat_labels` depth first,
+//      intersecting the rows of a combination with each label of the next
+//      category. A combination with no rows is not visited further, and
+//      the labels of a category stop being tried once their rows cover
+//      those of the combination.
 
-util::types::find_all_return_t util::locator::keep_each(const types::entries_t& categories, bool *exist, uint32_t index_offset)
+util::types::find_all_csr_t util::locator::find_all_bitmaps(const std::vector<const types::entries_t*>& cat_labels,
+                                                            uint32_t index_offset, bool with_indices) const
 {
-    util::types::find_all_return_t res = find_all(categories, exist, index_offset);
+    using util::bit_array;
     
-    if (!exist)
-    {
-        return res;
-    }
+    types::find_all_csr_t result;
     
-    uint32_t n_indices = res.indices.tail();
-    uint32_t total_sz = n_indices;
-    uint32_t n_cats_in = categories.tail();
-    uint32_t* in_cat_ptr = categories.unsafe_get_pointer();
+    uint32_t sz = size();
+    uint32_t n_cats = uint32_t(cat_labels.size());
     
-    types::entries_t remaining_categories = m_categories;
+    //  label indices as dense arrays, expanding compressed ones
+    std::vector<std::vector<const bit_array*>> dense_labels(n_cats);
+    std::vector<bit_array> expanded;
+    uint32_t n_compressed = 0;
     
-    //  determine which additional categories we'll have to draw labels from
-    for (uint32_t i = 0; i < n_cats_in; i++)
+    for (uint32_t i = 0; i < n_cats; i++)
     {
-        uint32_t* remaining_cats_ptr = remaining_categories.unsafe_get_pointer();
-        
-        uint32_t idx_in_remaining_cats;
-        util::unchecked_binary_search(remaining_cats_ptr, remaining_categories.tail(), in_cat_ptr[i], &idx_in_remaining_cats);
+        const types::entries_t& labs = *cat_labels[i];
         
-        remaining_categories.erase(idx_in_remaining_cats);
+        for (uint32_t j = 0; j < labs.tail(); j++)
+        {
+            n_compressed += get_index(labs.at(j)).is_compressed() ? 1 : 0;
+        }
     }
     
-    uint32_t n_remaining_cats = remaining_categories.tail();
-    uint32_t* remaining_cats_ptr = remaining_categories.unsafe_get_pointer();
-    
-    types::entries_t* raw_inds = res.indices.unsafe_get_pointer();
-    uint32_t* raw_combs = res.combinations.unsafe_get_pointer();
-    
-    util::locator copy = *this;
+    expanded.reserve(n_compressed);
     
-    //  resize indices to total size
-    for (auto& it : copy.m_indices)
+    for (uint32_t i = 0; i < n_cats; i++)
     {
-        it.second.resize(total_sz);
-        it.second.fill(false);
+        const types::entries_t& labs = *cat_labels[i];
+        
+        for (uint32_t j = 0; j < labs.tail(); j++)
+        {
+            const util::label_index& index = get_index(labs.at(j));
+            
+            if (index.is_compressed())
+            {
+                expanded.push_back(index.to_bit_array());
+                dense_labels[i].push_back(&expanded.back());
+            }
+            else
+            {
+                dense_labels[i].push_back(&index.dense());
+            }
+        }
     }
     
-    copy.m_tmp_index.resize(total_sz);
+    //  nodes[i] holds the n_rows[i] rows of the combination being visited
+    //  over the first i categories; rests[i] those of its rows not yet
+    //  matched to a label of category i, of which there are n_rest[i].
+    std::vector<bit_array> nodes(n_cats + 1, bit_array(sz, false));
+    std::vector<bit_array> rests(n_cats, bit_array(sz, false));
+    std::vector<uint32_t> n_rows(n_cats + 1);
+    std::vector<uint32_t> n_rest(n_cats + 1);
+    std::vector<uint32_t> next_label(n_cats + 1, 0u);
+    std::vector<uint32_t> combination(n_cats);
     
-    //  mapping category to collapsed id.
-    std::unordered_map<uint32_t, uint32_t> collapsed_labels;
+    std::vector<uint32_t> leaf_labels;
+    std::vector<uint32_t> leaf_first;
+    std::vector<uint32_t> leaf_counts;
+    std::vector<types::numeric_indices_t> leaf_rows;
     
-    for (uint32_t i = 0; i < n_indices; i++)
+    nodes[0].fill(true);
+    n_rows[0] = sz;
+    n_rest[0] = sz;
+    
+    uint32_t level = 0;
+    
+    while (true)
     {
-        //  for the inputted categories, we can just copy the
-        //  combinations
-        uint32_t* c_indices = raw_inds[i].unsafe_get_pointer();
-        uint32_t c_n_indices = raw_inds[i].tail();
-        
-        for (uint32_t j = 0; j < n_cats_in; j++)
-        {
-            uint32_t lab = raw_combs[i * n_cats_in + j];
-            
-            copy.m_indices[lab].place(true, i);
-        }
-        
-        //  for the other categories, we have to see which label
-        //  to use for each index
-        for (uint32_t j = 0; j < n_remaining_cats; j++)
+        if (level == n_cats)
         {
+            leaf_labels.insert(leaf_labels.end(), combination.begin(), combination.end());
+            leaf_first.push_back(*nodes[n_cats].set_bits().begin());
+            leaf_counts.push_back(n_rows[n_cats]);
             
-            uint32_t c_cat = remaining_cats_ptr[j];
-            
-            //  other labels in the current category
-            const types::entries_t& other_labs = copy.m_by_category[c_cat];
-            
-            uint32_t n_other_labs = other_labs.tail();
-            
-            if (n_other_labs == 0)
+            if (with_indices)
             {
-                continue;
+                leaf_rows.push_back(bit_array::find(nodes[n_cats], index_offset, n_rows[n_cats]));
             }
             
-            if (n_other_labs == 1)
+            level--;
+            continue;
+        }
+        
+        uint32_t n_labs = uint32_t(dense_labels[level].size());
+        uint32_t j = next_label[level]++;
+        
+        //  until a label has matched some of the combination's rows, they
+        //  are all unmatched
+        const bit_array& rest = n_rest[level] == n_rows[level] ? nodes[level] : rests[level];
+        
+        if (j > n_labs || n_rest[level] == 0)
+        {
+            if (level == 0)
             {
-                util::bit_array& other_idx = copy.m_indices[other_labs.at(0)];
-                
-                other_idx.place(true, i);
-                
-                continue;
+                break;
             }
             
-            //  otherwise, we have to determine whether to collapse the
-            //  labels at these indices
-            
-            uint32_t* other_labs_ptr = other_labs.unsafe_get_pointer();
-            
-            // find the label at the first index
-            
-            uint32_t first_lab = util::locator::UNDEFINED_LABEL;
-            
-            for (uint32_t k = 0; k < n_other_labs; k++)
-            {
-                uint32_t c_lab = other_labs_ptr[k];
-                
-                const util::bit_array& lab_idx = m_indices.at(c_lab);
-                
-                if (lab_idx.at(c_indices[0] - index_offset))
-                {
-                    first_lab = c_lab;
-                    break;
-                }
-            }
+            level--;
+            continue;
+        }
+        
+        uint32_t n_child;
+        
+        if (j == n_labs)
+        {
+            nodes[level+1] = rest;
+            n_child = n_rest[level];
+            n_rest[level] = 0;
+            combination[level] = util::locator::UNDEFINED_LABEL;
+        }
+        else
+        {
+            const bit_array& label = *dense_labels[level][j];
             
-            bool proceed = true;
-            bool need_collapse = false;
-            uint32_t k = 1;
-            const util::bit_array& lab_idx = m_indices.at(first_lab);
+            n_child = bit_array::unchecked_and_count(rest, label, 0, sz);
             
-            while (proceed && k < c_n_indices)
+            if (n_child == 0)
             {
-                if (!lab_idx.at(c_indices[k] - index_offset))
-                {
-                    need_collapse = true;
-                    proceed = false;
-                }
-                
-                k++;
+                continue;
             }
             
-            uint32_t set_lab;
+            bit_array::unchecked_dot_and(nodes[level+1], rest, label, 0, sz);
             
-            if (need_collapse)
-            {
-                auto collapsed_it = collapsed_labels.find(c_cat);
-                
-                uint32_t collapsed_lab;
-                
-                //  we need to insert a new collapsed label
-                if (collapsed_it == collapsed_labels.end())
-                {
-                    collapsed_lab = copy.get_random_label_id();
-                    collapsed_labels[c_cat] = collapsed_lab;
-                    
-                    copy.m_labels.push(collapsed_lab);
-                    copy.m_in_category[collapsed_lab] = c_cat;
-                    copy.m_indices[collapsed_lab] = util::bit_array(total_sz, false);
-                    
-                    util::types::entries_t& by_cat = copy.m_by_category[c_cat];
-                    
-                    by_cat.push(collapsed_lab);
-                    
-                    copy.m_n_labels++;
-                    
-                    by_cat.sort();
-                    copy.m_labels.sort();
-                }
-                else
-                {
-                    collapsed_lab = collapsed_it->second;
-                }
-                
-                set_lab = collapsed_lab;
-            }
-            else
+            if (n_child < n_rest[level])
             {
-                set_lab = first_lab;
+                bit_array::unchecked_dot_and_not(rests[level], rest, label, 0, sz);
             }
-        
-            util::bit_array& c_idx = copy.m_indices.at(set_lab);
             
-            c_idx.place(true, i);
+            n_rest[level] -= n_child;
+            combination[level] = cat_labels[level]->at(j);
         }
+        
+        level++;
+        n_rows[level] = n_child;
+        n_rest[level] = n_child;
+        next_label[level] = 0;
     }
     
-    copy.prune();
+    //  number combinations in order of their first row
+    uint32_t n_combs = uint32_t(leaf_first.size());
+    std::vector<uint32_t> order(n_combs);
     
-    *this = std::move(copy);
-    
-    return res;
-}
-
-uint32_t util::locator::add_category(uint32_t category)
-{
-    if (has_category(category))
+    for (uint32_t i = 0; i < n_combs; i++)
     {
-        return util::locator_status::CATEGORY_EXISTS;
+        order[i] = i;
     }
     
-    unchecked_add_category(category);
+    std::sort(order.begin(), order.end(), [&leaf_first] (uint32_t a, uint32_t b) -> bool {
+        return leaf_first[a] < leaf_first[b];
+    });
     
-    return util::locator_status::OK;
-}
-
-uint32_t util::locator::require_category(uint32_t category)
-{
-    if (!has_category(category))
+    result.offsets = types::entries_t(n_combs + 1);
+    result.offsets.seek_tail_to_end();
+    result.indices = types::entries_t(with_indices ? sz : 0u);
+    result.indices.seek_tail_to_end();
+    result.combinations = types::entries_t(n_combs * n_cats);
+    result.combinations.seek_tail_to_end();
+    
+    uint32_t* offsets_ptr = result.offsets.unsafe_get_pointer();
+    uint32_t* indices_ptr = result.indices.unsafe_get_pointer();
+    uint32_t* combs_ptr = result.combinations.unsafe_get_pointer();
+    
+    offsets_ptr[0] = 0;
+    
+    for (uint32_t i = 0; i < n_combs; i++)
     {
-        unchecked_add_category(category);
+        uint32_t n_leaf_rows = leaf_counts[order[i]];
+        
+        if (with_indices)
+        {
+            std::memcpy(indices_ptr + offsets_ptr[i], leaf_rows[order[i]].unsafe_get_pointer(),
+                        n_leaf_rows * sizeof(uint32_t));
+        }
+        
+        std::memcpy(combs_ptr + i * n_cats, leaf_labels.data() + order[i] * n_cats, n_cats * sizeof(uint32_t));
+        
+        offsets_ptr[i+1] = offsets_ptr[i] + n_leaf_rows;
     }
     
-    return util::locator_status::OK;
+    return result;
 }
 
-uint32_t util::locator::collapse_category(uint32_t category)
+//  find_all_rows: Each row's combination is coded as an integer, in mixed
+//      radix with one digit per category: 0 for no label, or 1 plus the
+//      position of the row's label in the category. When the next digit
+//      would overflow 64 bits, the codes so far are replaced by dense ids,
+//      and coding continues from those. The final codes are numbered in
+//      order of first appearance, and rows are bucketed by number.
+
+util::types::find_all_csr_t util::locator::find_all_rows(const std::vector<const types::entries_t*>& cat_labels,
+                                                         uint32_t index_offset, bool with_indices) const
 {
-    if (!has_category(category))
+    types::find_all_csr_t result;
+    
+    uint32_t n_cats_in = uint32_t(cat_labels.size());
+    uint32_t sz = size();
+    
+    std::vector<uint64_t> codes(sz, 0u);
+    uint64_t* codes_ptr = codes.data();
+    uint64_t code_range = 1;
+    
+    //  for each renumbering, the first category it covers and the code of
+    //  each new number
+    std::vector<uint32_t> stage_first_cat(1, 0u);
+    std::vector<std::vector<uint64_t>> stage_codes;
+    
+    for (uint32_t i = 0; i < n_cats_in; i++)
     {
-        return util::locator_status::CATEGORY_DOES_NOT_EXIST;
+        const types::entries_t& labs = *cat_labels[i];
+        uint64_t radix = uint64_t(labs.tail()) + 1;
+        
+        if (code_range > ~uint64_t(0) / radix)
+        {
+            stage_codes.emplace_back();
+            code_range = number_codes(codes_ptr, sz, code_range, stage_codes.back());
+            stage_first_cat.push_back(i);
+        }
+        
+        if (code_range > 1)
+        {
+            for (uint32_t j = 0; j < sz; j++)
+            {
+                codes_ptr[j] *= radix;
+            }
+        }
+        
+        add_digits(labs, code_digits(labs), codes_ptr, 0, sz);
+        
+        code_range *= radix;
     }
     
-    const types::entries_t& by_category = m_by_category.at(category);
-    const uint32_t n_in_cat = by_category.tail();
+    stage_codes.emplace_back();
     
-    //  category is already collapsed
-    if (n_in_cat == 0 || n_in_cat == 1)
+    uint32_t n_combs = number_codes(codes_ptr, sz, code_range, stage_codes.back());
+    
+    //  rows of each combination, in ascending order
+    result.offsets = types::entries_t(n_combs + 1);
+    result.offsets.seek_tail_to_end();
+    result.indices = types::entries_t(with_indices ? sz : 0u);
+    result.indices.seek_tail_to_end();
+    
+    uint32_t* offsets_ptr = result.offsets.unsafe_get_pointer();
+    uint32_t* indices_ptr = result.indices.unsafe_get_pointer();
+    
+    std::memset(offsets_ptr, 0, (n_combs + 1) * sizeof(uint32_t));
+    
+    for (uint32_t i = 0; i < sz; i++)
     {
-        return util::locator_status::OK;
+        offsets_ptr[codes_ptr[i] + 1]++;
     }
     
-    uint32_t next_lab_id = get_random_label_id();
+    for (uint32_t i = 0; i < n_combs; i++)
+    {
+        offsets_ptr[i+1] += offsets_ptr[i];
+    }
     
-    bool is_present = false;
-    bool create_tmp = false;
-    util::bit_array index(size(), true);
+    if (with_indices)
+    {
+        std::vector<uint32_t> next(offsets_ptr, offsets_ptr + n_combs);
+        
+        for (uint32_t i = 0; i < sz; i++)
+        {
+            indices_ptr[next[codes_ptr[i]]++] = i + index_offset;
+        }
+    }
     
-    unchecked_set_category(category, next_lab_id, is_present, create_tmp, index);
+    decode_combinations(cat_labels, stage_first_cat, stage_codes, result.combinations);
     
-    return util::locator_status::OK;
+    return result;
 }
 
-void util::locator::unchecked_add_category(uint32_t category)
+//  find_all_rows_parallel: find_all_rows, with the rows split into
+//      blocks of whole compressed chunks that are coded and numbered on the
+//      shared thread_pool. Each block's combinations are then numbered
+//      again, block by block, so that the numbers and the order of rows
+//      are those of the serial version. Rows are placed in parallel, each
+//      block from its own offset within each combination. The codes must
+//      fit in 64 bits.
+
+util::types::find_all_csr_t util::locator::find_all_rows_parallel(const std::vector<const types::entries_t*>& cat_labels,
+                                                                  uint64_t code_range, uint32_t index_offset,
+                                                                  bool with_indices) const
 {
-    m_categories.push(category);
-    m_by_category[category] = util::types::entries_t();
-    
-    m_categories.unchecked_sort(m_categories.tail());
-}
-
-uint32_t util::locator::rm_category(uint32_t category)
-{
-    if (!has_category(category))
-    {
-        return util::locator_status::CATEGORY_DOES_NOT_EXIST;
-    }
-    
-    util::types::entries_t& by_category = m_by_category[category];
-    
-    uint32_t n_in_cat = by_category.tail();
-    uint32_t* by_category_ptr = by_category.unsafe_get_pointer();
-    
-    for (uint32_t i = 0; i < n_in_cat; i++)
-    {
-        uint32_t lab = by_category_ptr[i];
-        m_indices[lab].fill(false);
-    }
+    types::find_all_csr_t result;
     
-    prune();
-    
-    m_by_category.erase(category);
+    util::thread_pool& pool = util::thread_pool::shared();
     
-    uint32_t in_cat_idx = find_category(category);
+    uint32_t n_cats = uint32_t(cat_labels.size());
+    uint32_t sz = size();
+    uint32_t chunk_size = util::compressed_bit_array::CHUNK_SIZE;
+    uint32_t n_chunks = (sz + chunk_size - 1) / chunk_size;
+    uint32_t n_target = pool.size() * FIND_ALL_BLOCKS_PER_THREAD;
+    uint32_t block_chunks = std::max(1u, (n_chunks + n_target - 1) / n_target);
+    uint32_t block_size = block_chunks * chunk_size;
+    uint32_t n_blocks = (n_chunks + block_chunks - 1) / block_chunks;
     
-    m_categories.erase(in_cat_idx);
+    std::vector<uint64_t> codes(sz, 0u);
+    uint64_t* codes_ptr = codes.data();
     
-    return util::locator_status::OK;
-}
-
-uint32_t util::locator::set_category(uint32_t category, uint32_t label, const util::bit_array& index)
-{
-    if (!has_category(category))
-    {
-        return util::locator_status::CATEGORY_DOES_NOT_EXIST;
-    }
+    std::vector<std::vector<uint32_t>> digits(n_cats);
     
-    if (label == locator::UNDEFINED_LABEL)
+    for (uint32_t i = 0; i < n_cats; i++)
     {
-        return util::locator_status::IS_UNDEFINED_LABEL;
+        digits[i] = code_digits(*cat_labels[i]);
     }
     
-    bool is_present = has_label(label);
+    //  code of each of a block's numbers, and its count of rows
+    std::vector<std::vector<uint64_t>> block_codes(n_blocks);
+    std::vector<std::vector<uint32_t>> block_counts(n_blocks);
     
-    //  make sure we're not trying to add a label
-    //  that already exists in another category
-    if (is_present)
-    {
-        uint32_t c_in_category = m_in_category[label];
+    auto code_block = [&] (uint32_t block) -> void {
+        uint32_t start = block * block_size;
+        uint32_t stop = uint32_t(std::min(uint64_t(start) + block_size, uint64_t(sz)));
         
-        if (c_in_category != category)
+        for (uint32_t i = 0; i < n_cats; i++)
         {
-            return util::locator_status::LABEL_EXISTS_IN_OTHER_CATEGORY;
+            const types::entries_t& labs = *cat_labels[i];
+            uint64_t radix = uint64_t(labs.tail()) + 1;
+            
+            for (uint32_t j = start; j < stop; j++)
+            {
+                codes_ptr[j] *= radix;
+            }
+            
+            add_digits(labs, digits[i], codes_ptr, start, stop);
         }
-    }
+        
+        uint32_t n_local = number_codes(codes_ptr + start, stop - start, code_range, block_codes[block]);
+        std::vector<uint32_t>& counts = block_counts[block];
+        
+        counts.assign(n_local, 0u);
+        
+        for (uint32_t j = start; j < stop; j++)
+        {
+            counts[codes_ptr[j]]++;
+        }
+    };
     
-    uint32_t c_size = size();
-    uint32_t index_size_m = index.size();
+    pool.run(n_blocks, code_block);
     
-    bool c_is_empty = is_empty();
+    //  numbering the blocks' codes in block order numbers combinations by
+    //  their first row
+    std::vector<uint64_t> numbers;
+    std::vector<uint32_t> block_first(n_blocks + 1, 0u);
     
-    //  size of incoming index must match current size, unless
-    //  locator is empty.
-    if (!c_is_empty && index_size_m != c_size)
+    for (uint32_t i = 0; i < n_blocks; i++)
     {
-        return util::locator_status::WRONG_INDEX_SIZE;
+        numbers.insert(numbers.end(), block_codes[i].begin(), block_codes[i].end());
+        block_first[i+1] = uint32_t(numbers.size());
     }
     
-    //  if no elements are true, we can just return early
-    if (!index.any())
-    {
-        return util::locator_status::OK;
-    }
+    std::vector<uint32_t> stage_first_cat(1, 0u);
+    std::vector<std::vector<uint64_t>> stage_codes(1);
     
-    unchecked_set_category(category, label, is_present, c_is_empty, index);
+    uint32_t n_combs = number_codes(numbers.data(), uint32_t(numbers.size()), code_range, stage_codes[0]);
     
-    return util::locator_status::OK;
-}
-
-uint32_t util::locator::set_category(uint32_t category, const util::types::entries_t& labels, const util::bit_array& index)
-{
-    if (!has_category(category))
-    {
-        return util::locator_status::CATEGORY_DOES_NOT_EXIST;
-    }
+    result.offsets = types::entries_t(n_combs + 1);
+    result.offsets.seek_tail_to_end();
+    result.indices = types::entries_t(with_indices ? sz : 0u);
+    result.indices.seek_tail_to_end();
     
-    uint32_t c_size = size();
-    uint32_t index_size_m = index.size();
+    uint32_t* offsets_ptr = result.offsets.unsafe_get_pointer();
+    uint32_t* indices_ptr = result.indices.unsafe_get_pointer();
     
-    bool c_is_empty = is_empty();
+    std::memset(offsets_ptr, 0, (n_combs + 1) * sizeof(uint32_t));
     
-    //  size of incoming index must match current size, unless
-    //  locator is empty.
-    if (!c_is_empty && index_size_m != c_size)
+    for (uint32_t i = 0; i < n_blocks; i++)
     {
-        return util::locator_status::WRONG_INDEX_SIZE;
+        for (uint32_t j = 0; j < block_counts[i].size(); j++)
+        {
+            offsets_ptr[numbers[block_first[i] + j] + 1] += block_counts[i][j];
+        }
     }
     
-    //  sum of elements in the index must match the number of labels
-    //  to assign
-    if (labels.tail() != index.sum())
+    for (uint32_t i = 0; i < n_combs; i++)
     {
-        return util::locator_status::WRONG_NUMBER_OF_INDICES;
+        offsets_ptr[i+1] += offsets_ptr[i];
     }
     
-    if (!index.any())
+    if (!with_indices)
     {
-        return util::locator_status::OK;
+        decode_combinations(cat_labels, stage_first_cat, stage_codes, result.combinations);
+        
+        return result;
     }
     
-    uint32_t n_labels_in = labels.tail();
-    uint32_t* in_labels_ptr = labels.unsafe_get_pointer();
-    
-    types::entries_t in_labels_copy = labels;
-    
-    uint32_t* in_labels_copy_ptr = in_labels_copy.unsafe_get_pointer();
-    uint32_t* unique_tail = std::unique(in_labels_copy_ptr, in_labels_copy_ptr + n_labels_in);
-    uint32_t n_unique = unique_tail - in_labels_copy_ptr;
+    //  each block's counts become the positions at which it places its
+    //  rows of each combination
+    std::vector<uint32_t> next(offsets_ptr, offsets_ptr + n_combs);
     
-    util::dynamic_array<bool> lab_exists(n_unique);
-    bool* lab_exists_ptr = lab_exists.unsafe_get_pointer();
-    
-    for (uint32_t i = 0; i < n_unique; i++)
+    for (uint32_t i = 0; i < n_blocks; i++)
     {
-        auto it = m_in_category.find(in_labels_copy_ptr[i]);
-        
-        if (it == m_in_category.end())
+        for (uint32_t j = 0; j < block_counts[i].size(); j++)
         {
-            lab_exists_ptr[i] = false;
-            continue;
+            uint32_t& position = next[numbers[block_first[i] + j]];
+            uint32_t count = block_counts[i][j];
+            
+            block_counts[i][j] = position;
+            position += count;
         }
-
-        if (it->second != category)
+    }
+    
+    auto place_block = [&] (uint32_t block) -> void {
+        uint32_t start = block * block_size;
+        uint32_t stop = uint32_t(std::min(uint64_t(start) + block_size, uint64_t(sz)));
+        uint32_t* positions = block_counts[block].data();
+        
+        for (uint32_t j = start; j < stop; j++)
         {
-            return util::locator_status::LABEL_EXISTS_IN_OTHER_CATEGORY;
+            indices_ptr[positions[codes_ptr[j]]++] = j + index_offset;
         }
-        
-        lab_exists_ptr[i] = true;
-    }
+    };
     
-    uint32_t index_sz;
+    pool.run(n_blocks, place_block);
     
-    if (c_is_empty)
-    {
-        index_sz = n_labels_in;
-    }
-    else
+    decode_combinations(cat_labels, stage_first_cat, stage_codes, result.combinations);
+    
+    return result;
+}
+
+//  code_digits: For a coded category, the digit of each code: 1 plus the
+//      position of its label in `labs`, or 0 for no label. Empty for a
+//      category with label indices.
+
+std::vector<uint32_t> util::locator::code_digits(const types::entries_t& labs) const
+{
+    std::vector<uint32_t> digits;
+    const util::label_codes* codes = find_label_codes(labs.at(0));
+    
+    if (!codes)
     {
-        index_sz = c_size;
+        return digits;
     }
     
-    util::bit_array tmp_index(index_sz, false);
-    types::entries_t offsets = bit_array::find(index);
-    uint32_t* offset_ptr = offsets.unsafe_get_pointer();
-    
-    for (uint32_t i = 0; i < n_unique; i++)
+    for (uint32_t i = 0; i < labs.tail(); i++)
     {
-        uint32_t c_label = in_labels_copy_ptr[i];
+        uint32_t code = codes->code_of(labs.at(i));
         
-        for (uint32_t j = 0; j < n_labels_in; j++)
+        if (code >= digits.size())
         {
-            if (in_labels_ptr[j] == c_label)
-            {
-                uint32_t offset = offset_ptr[j];
-                tmp_index.unchecked_place(true, offset);
-            }
+            digits.resize(code + 1, 0u);
         }
         
-        unchecked_set_category(category, c_label, lab_exists_ptr[i], is_empty(), tmp_index);
-        
-        tmp_index.fill(false);
+        digits[code] = i + 1;
     }
     
-    return util::locator_status::OK;
+    return digits;
 }
 
-void util::locator::unchecked_set_category(uint32_t category, uint32_t label, bool is_present, bool create_tmp, const util::bit_array& index)
+//  add_digits: Add the digit of each row's label in `labs` to its code,
+//      for rows [start, stop). Coded categories are gathered row by row
+//      through `digits`; otherwise each label's rows are visited.
+
+void util::locator::add_digits(const types::entries_t& labs, const std::vector<uint32_t>& digits,
+                               uint64_t* codes_ptr, uint32_t start, uint32_t stop) const
 {
-    util::types::entries_t& by_category = m_by_category[category];
-    
-    uint32_t* by_category_ptr = by_category.unsafe_get_pointer();
-    uint32_t n_by_category = by_category.tail();
-    uint32_t c_sz = size();
+    const util::label_codes* codes = find_label_codes(labs.at(0));
     
-    //  set false at rows of other indices
-    for (uint32_t i = 0; i < n_by_category; i++)
+    if (codes)
     {
-        uint32_t lab = by_category_ptr[i];
+        const uint32_t* digits_ptr = digits.data();
         
-        //  if updating a pre-existing label, set true to elements
-        //  that are currently false
-        if (lab == label)
-        {
-            util::bit_array& c_index = m_indices[lab];
-            util::bit_array::unchecked_dot_or(c_index, c_index, index, 0, c_sz);
-            continue;
-        }
+        auto func = [codes_ptr, digits_ptr] (uint32_t idx, uint32_t code) -> void {
+            codes_ptr[idx] += code == util::label_codes::NO_CODE ? 0u : digits_ptr[code];
+        };
         
-        util::bit_array& lab_index = m_indices[lab];
+        util::label_codes::for_each_code(*codes, start, stop, func);
         
-        util::bit_array::unchecked_dot_and_not(lab_index, lab_index, index, 0, c_sz);
+        return;
     }
     
-    if (!is_present)
+    for (uint32_t j = 0; j < labs.tail(); j++)
     {
-        m_labels.push(label);
-        m_in_category[label] = category;
-        m_indices[label] = index;
-        by_category.push(label);
+        uint64_t digit = j + 1;
         
-        m_n_labels++;
+        auto func = [codes_ptr, digit] (uint32_t idx) -> void {
+            codes_ptr[idx] += digit;
+        };
         
-        by_category.sort();
-        m_labels.sort();
+        util::label_index::for_each_set_bit(get_index(labs.at(j)), start, stop, func);
     }
+}
+
+//  decode_combinations: Labels of each combination, from its code at each
+//      renumbering stage, last category first. Digit 0 of a code is no
+//      label.
+
+void util::locator::decode_combinations(const std::vector<const types::entries_t*>& cat_labels,
+                                        const std::vector<uint32_t>& stage_first_cat,
+                                        const std::vector<std::vector<uint64_t>>& stage_codes,
+                                        types::entries_t& combinations)
+{
+    uint32_t n_cats = uint32_t(cat_labels.size());
+    uint32_t n_stages = uint32_t(stage_codes.size());
+    uint32_t n_combs = uint32_t(stage_codes.back().size());
     
-    if (create_tmp)
-    {
-        m_tmp_index = util::bit_array(index.size(), false);
-    }
+    combinations = types::entries_t(n_combs * n_cats);
+    combinations.seek_tail_to_end();
     
-    if (m_n_labels > 1)
+    uint32_t* combs_ptr = combinations.unsafe_get_pointer();
+    
+    for (uint32_t i = 0; i < n_combs; i++)
     {
-        prune();
+        uint64_t number = i;
+        
+        for (uint32_t j = n_stages; j-- > 0; )
+        {
+            uint64_t code = stage_codes[j][number];
+            uint32_t stop_cat = j + 1 < n_stages ? stage_first_cat[j+1] : n_cats;
+            
+            for (uint32_t k = stop_cat; k-- > stage_first_cat[j]; )
+            {
+                const types::entries_t& labs = *cat_labels[k];
+                uint64_t radix = uint64_t(labs.tail()) + 1;
+                uint64_t digit = code % radix;
+                
+                combs_ptr[i * n_cats + k] = digit == 0 ? util::locator::UNDEFINED_LABEL : labs.at(uint32_t(digit - 1));
+                code /= radix;
+            }
+            
+            number = code;
+        }
     }
 }
 
-void util::locator::prune()
+//  number_codes: Replace each of `n_codes` codes, in [0, code_range), with the
+//      number of its first appearance, and store the code of each number in
+//      `number_code`. Small ranges are numbered through a direct table, and
+//      others through an open-addressing hash table. Returns the count of
+//      distinct codes.
+
+uint32_t util::locator::number_codes(uint64_t* codes_ptr, uint32_t n_codes, uint64_t code_range,
+                                     std::vector<uint64_t>& number_code)
 {
-    auto it = m_indices.begin();
+    const uint32_t EMPTY = ~uint32_t(0);
     
-    while (it != m_indices.end())
+    number_code.clear();
+    
+    if (code_range <= uint64_t(n_codes) * 4 + 1024)
     {
-        if (it->second.any())
+        std::vector<uint32_t> numbers(code_range, EMPTY);
+        
+        for (uint32_t i = 0; i < n_codes; i++)
         {
-            it++;
-            continue;
+            uint32_t& number = numbers[codes_ptr[i]];
+            
+            if (number == EMPTY)
+            {
+                number = uint32_t(number_code.size());
+                number_code.push_back(codes_ptr[i]);
+            }
+            
+            codes_ptr[i] = number;
         }
         
-        uint32_t lab = it->first;
-        uint32_t cat = m_in_category[lab];
-        
-        util::types::entries_t& by_category = m_by_category[cat];
-        uint32_t* by_category_ptr = by_category.unsafe_get_pointer();
+        return uint32_t(number_code.size());
+    }
+    
+    //  linear probing, kept at most half full
+    uint32_t n_bits = 10;
+    std::vector<uint64_t> slot_codes(size_t(1) << n_bits);
+    std::vector<uint32_t> slot_numbers(size_t(1) << n_bits, EMPTY);
+    
+    for (uint32_t i = 0; i < n_codes; i++)
+    {
+        uint64_t code = codes_ptr[i];
+        uint64_t mask = (uint64_t(1) << n_bits) - 1;
+        uint64_t slot = (code * 0x9E3779B97F4A7C15ull) >> (64 - n_bits);
         
-        uint32_t idx_in_by_category;
+        while (slot_numbers[slot] != EMPTY && slot_codes[slot] != code)
+        {
+            slot = (slot + 1) & mask;
+        }
         
-        util::unchecked_binary_search(by_category_ptr, by_category.tail(), lab, &idx_in_by_category);
+        uint32_t number = slot_numbers[slot];
         
-        by_category.erase(idx_in_by_category);
-        m_labels.erase(find_label(lab));
-        m_in_category.erase(lab);
-        it = m_indices.erase(it);
+        if (number == EMPTY)
+        {
+            number = uint32_t(number_code.size());
+            slot_codes[slot] = code;
+            slot_numbers[slot] = number;
+            number_code.push_back(code);
+            
+            if (number_code.size() * 2 > slot_numbers.size())
+            {
+                n_bits++;
+                
+                std::vector<uint64_t> grown_codes(size_t(1) << n_bits);
+                std::vector<uint32_t> grown_numbers(size_t(1) << n_bits, EMPTY);
+                uint64_t grown_mask = (uint64_t(1) << n_bits) - 1;
+                
+                for (uint32_t j = 0; j < number_code.size(); j++)
+                {
+                    uint64_t grown_slot = (number_code[j] * 0x9E3779B97F4A7C15ull) >> (64 - n_bits);
+                    
+                    while (grown_numbers[grown_slot] != EMPTY)
+                    {
+                        grown_slot = (grown_slot + 1) & grown_mask;
+                    }
+                    
+                    grown_codes[grown_slot] = number_code[j];
+                    grown_numbers[grown_slot] = j;
+                }
+                
+                slot_codes = std::move(grown_codes);
+                slot_numbers = std::move(grown_numbers);
+            }
+        }
         
-        m_n_labels--;
+        codes_ptr[i] = number;
     }
+    
+    return uint32_t(number_code.size());
 }
 
-uint32_t util::locator::keep(const util::types::entries_t& at_indices)
+util::types::find_all_return_t util::locator::from_csr(types::find_all_csr_t&& csr)
 {
-    if (is_empty())
-    {
-        return util::locator_status::OK;
-    }
+    types::find_all_return_t result;
     
-    uint32_t n_indices = at_indices.tail();
+    uint32_t n_combs = csr.offsets.tail() == 0 ? 0 : csr.offsets.tail() - 1;
     
-    if (n_indices == 0)
-    {
-        empty();
-        return util::locator_status::OK;
-    }
+    result.combinations = std::move(csr.combinations);
+    result.indices = types::arr_entries_t(n_combs);
+    result.indices.seek_tail_to_end();
     
-    uint32_t sz = size();
-    uint32_t* at_indices_ptr = at_indices.unsafe_get_pointer();
+    uint32_t* offsets_ptr = csr.offsets.unsafe_get_pointer();
+    uint32_t* indices_ptr = csr.indices.unsafe_get_pointer();
+    types::entries_t* result_ptr = result.indices.unsafe_get_pointer();
     
-    for (uint32_t i = 0; i < n_indices; i++)
+    for (uint32_t i = 0; i < n_combs; i++)
     {
-        if (at_indices_ptr[i] >= sz)
-        {
-            return util::locator_status::INDEX_OUT_OF_BOUNDS;
-        }
+        uint32_t n_rows = offsets_ptr[i+1] - offsets_ptr[i];
+        types::entries_t rows(n_rows);
+        
+        std::memcpy(rows.unsafe_get_pointer(), indices_ptr + offsets_ptr[i], n_rows * sizeof(uint32_t));
+        rows.seek_tail_to_end();
+        
+        result_ptr[i] = std::move(rows);
     }
     
-    unchecked_keep(at_indices);
-    
-    return util::locator_status::OK;
+    return result;
 }
 
-void util::locator::unchecked_keep(const util::types::entries_t& at_indices, int32_t index_offset)
+//  keep_each: Keep one row for each subset of label combinations.
+
+util::types::find_all_return_t util::locator::keep_each(const types::entries_t& categories, bool *exist, uint32_t index_offset)
 {
-    for (auto& it : m_indices)
+    util::types::find_all_csr_t res = find_all_csr(categories, exist, index_offset);
+    
+    if (!(*exist))
     {
-        it.second.unchecked_keep(at_indices, index_offset);
+        return from_csr(std::move(res));
     }
     
-    m_tmp_index.unchecked_keep(at_indices, index_offset);
+    uint32_t n_combs = res.offsets.tail() == 0 ? 0 : res.offsets.tail() - 1;
+    uint32_t n_cats_in = categories.tail();
+    uint32_t* in_cat_ptr = categories.unsafe_get_pointer();
     
-    prune();
-}
-
-uint32_t util::locator::append(const util::locator &other)
-{
-    if (!categories_match(other))
-    {
-        return util::locator_status::CATEGORIES_DO_NOT_MATCH;
-    }
+    types::entries_t remaining_categories = m_categories;
     
-    if (other.is_empty())
+    //  determine which additional categories we'll have to draw labels from
+    for (uint32_t i = 0; i < n_cats_in; i++)
     {
-        return util::locator_status::OK;
+        uint32_t* remaining_cats_ptr = remaining_categories.unsafe_get_pointer();
+        
+        uint32_t idx_in_remaining_cats;
+        util::unchecked_binary_search(remaining_cats_ptr, remaining_categories.tail(), in_cat_ptr[i], &idx_in_remaining_cats);
+        
+        remaining_categories.erase(idx_in_remaining_cats);
     }
     
-    if (is_empty())
-    {
-        *this = other;
-        return util::locator_status::OK;
-    }
+    uint32_t n_remaining_cats = remaining_categories.tail();
+    uint32_t* remaining_cats_ptr = remaining_categories.unsafe_get_pointer();
     
-    util::types::entries_t other_labels = other.m_labels;
-    uint32_t* own_label_ptr = m_labels.unsafe_get_pointer();
+    uint32_t* raw_offsets = res.offsets.unsafe_get_pointer();
+    uint32_t* raw_inds = res.indices.unsafe_get_pointer();
+    uint32_t* raw_combs = res.combinations.unsafe_get_pointer();
     
-    uint32_t original_sz = size();
-    uint32_t other_sz = other.size();
+    //  combination of each row. Rows are filled a block at a time, so that
+    //  the writes of every combination stay within the block.
+    uint32_t sz = n_combs == 0 ? 0 : size();
+    std::vector<uint32_t> row_combs(sz);
+    std::vector<uint32_t> next_ind(raw_offsets, raw_offsets + n_combs);
+    uint32_t* row_combs_ptr = row_combs.data();
     
-    uint32_t int_max = ~(uint32_t(0));
-    
-    if (int_max - original_sz < other_sz)
+    for (uint64_t stop = KEEP_EACH_BLOCK_ROWS; stop < uint64_t(sz) + KEEP_EACH_BLOCK_ROWS; stop += KEEP_EACH_BLOCK_ROWS)
     {
-        return util::locator_status::LOC_OVERFLOW;
+        uint64_t block_stop = std::min(stop, uint64_t(sz)) + index_offset;
+        
+        for (uint32_t i = 0; i < n_combs; i++)
+        {
+            uint32_t j = next_ind[i];
+            uint32_t last = raw_offsets[i+1];
+            
+            for (; j < last && raw_inds[j] < block_stop; j++)
+            {
+                row_combs_ptr[raw_inds[j] - index_offset] = i;
+            }
+            
+            next_ind[i] = j;
+        }
     }
     
-    for (uint32_t i = 0; i < m_n_labels; i++)
+    //  each label's index is replaced by one with a row per combination as
+    //  soon as it is built, so that the old and new locators are never
+    //  held in full at once. For the inputted categories, the labels are
+    //  those of the combinations.
+    for (uint32_t i = 0; i < n_cats_in; i++)
     {
-        uint32_t own_label = own_label_ptr[i];
+        const types::entries_t& labs = labels_in(in_cat_ptr[i]);
+        util::label_codes* codes = find_codes(in_cat_ptr[i]);
         
-        if (other.has_label(own_label))
+        if (codes)
         {
-            m_indices[own_label].append(other.m_indices.at(own_label));
+            util::label_codes kept_codes(n_combs);
             
-            uint32_t index_in_other_labels;
-            uint32_t* other_label_ptr = other_labels.unsafe_get_pointer();
-            util::unchecked_binary_search(other_label_ptr, other_labels.tail(), own_label, &index_in_other_labels);
+            for (uint32_t j = 0; j < n_combs; j++)
+            {
+                uint32_t lab = raw_combs[j * n_cats_in + i];
+                
+                if (lab != util::locator::UNDEFINED_LABEL)
+                {
+                    kept_codes.unchecked_place(lab, j);
+                }
+            }
             
-            other_labels.erase(index_in_other_labels);
+            *codes = std::move(kept_codes);
             
             continue;
         }
         
-        m_indices[own_label].resize(original_sz + other_sz);
+        //  rows of every label, in a single slab
+        util::bit_matrix kept(labs.tail(), n_combs);
+        
+        for (uint32_t j = 0; j < n_combs; j++)
+        {
+            uint32_t lab = raw_combs[j * n_cats_in + i];
+            
+            if (lab == util::locator::UNDEFINED_LABEL)
+            {
+                continue;
+            }
+            
+            uint32_t idx_in_labs;
+            util::unchecked_binary_search(labs.unsafe_get_pointer(), labs.tail(), lab, &idx_in_labs);
+            
+            kept.unchecked_place(true, idx_in_labs, j);
+        }
+        
+        for (uint32_t j = 0; j < labs.tail(); j++)
+        {
+            index_of(labs.at(j)) = util::label_index(kept.to_bit_array(j));
+        }
     }
     
-    uint32_t remaining_labels = other_labels.tail();
-    uint32_t* other_label_ptr = other_labels.unsafe_get_pointer();
+    const uint32_t NO_LABEL = ~uint32_t(0);
+    const uint32_t MIXED_LABELS = NO_LABEL - 1;
     
-    for (uint32_t i = 0; i < remaining_labels; i++)
+    //  for the other categories, a combination keeps a label if all of its
+    //  rows have that label, and otherwise is given a collapsed label.
+    //  Each label's rows are streamed once, counting the rows of each
+    //  combination that have a label.
+    for (uint32_t i = 0; i < n_remaining_cats; i++)
     {
-        uint32_t other_lab = other_label_ptr[i];
-        uint32_t in_cat = other.m_in_category.at(other_lab);
+        uint32_t c_cat = remaining_cats_ptr[i];
         
-        util::bit_array own_index(original_sz, false);
+        const types::entries_t& labs = labels_in(c_cat);
+        uint32_t n_labs = labs.tail();
         
-        own_index.append(other.m_indices.at(other_lab));
+        //  position in `labs` of the label of each combination
+        std::vector<uint32_t> comb_labels(n_combs, NO_LABEL);
+        std::vector<uint32_t> n_labeled(n_combs, 0u);
+        uint32_t* comb_labels_ptr = comb_labels.data();
+        uint32_t* n_labeled_ptr = n_labeled.data();
         
-        m_indices[other_lab] = std::move(own_index);
-        m_labels.push(other_lab);
-        m_in_category[other_lab] = in_cat;
+        util::label_codes* codes = find_codes(c_cat);
+        
+        //  a coded category's rows are visited in order
+        if (codes && n_labs > 0)
+        {
+            std::vector<uint32_t> digits = code_digits(labs);
+            const uint32_t* digits_ptr = digits.data();
+            
+            auto func = [comb_labels_ptr, n_labeled_ptr, row_combs_ptr, digits_ptr] (uint32_t row, uint32_t code) -> void {
+                if (code == util::label_codes::NO_CODE)
+                {
+                    return;
+                }
+                
+                uint32_t j = digits_ptr[code] - 1;
+                uint32_t comb = row_combs_ptr[row];
+                uint32_t comb_label = comb_labels_ptr[comb];
+                
+                comb_labels_ptr[comb] = comb_label == NO_LABEL || comb_label == j ? j : MIXED_LABELS;
+                n_labeled_ptr[comb]++;
+            };
+            
+            util::label_codes::for_each_code(*codes, 0, sz, func);
+        }
+        
+        //  as above, labels are visited a block of rows at a time
+        for (uint64_t start = 0; start < sz && !codes; start += KEEP_EACH_BLOCK_ROWS)
+        {
+            uint32_t stop = uint32_t(std::min(start + KEEP_EACH_BLOCK_ROWS, uint64_t(sz)));
+            
+            for (uint32_t j = 0; j < n_labs; j++)
+            {
+                auto func = [comb_labels_ptr, n_labeled_ptr, row_combs_ptr, j] (uint32_t row) -> void {
+                    uint32_t comb = row_combs_ptr[row];
+                    uint32_t comb_label = comb_labels_ptr[comb];
+                    
+                    comb_labels_ptr[comb] = comb_label == NO_LABEL || comb_label == j ? j : MIXED_LABELS;
+                    n_labeled_ptr[comb]++;
+                };
+                
+                util::label_index::for_each_set_bit(get_index(labs.at(j)), uint32_t(start), stop, func);
+            }
+        }
         
-        util::types::entries_t& by_category = m_by_category.at(in_cat);
+        bool is_coded = codes != nullptr;
         
-        by_category.push(other_lab);
-        by_category.unchecked_sort(by_category.tail());
+        util::bit_matrix kept(is_coded ? 0 : n_labs, n_combs);
+        util::label_codes kept_codes(is_coded ? n_combs : 0u);
+        util::bit_array collapsed(n_combs, false);
+        bool any_collapsed = false;
         
-        m_n_labels++;
+        for (uint32_t j = 0; j < n_combs; j++)
+        {
+            if (n_labeled[j] == 0)
+            {
+                continue;
+            }
+            
+            //  rows with different labels, or with and without a label
+            if (comb_labels[j] == MIXED_LABELS || n_labeled[j] != raw_offsets[j+1] - raw_offsets[j])
+            {
+                collapsed.unchecked_place(true, j);
+                any_collapsed = true;
+            }
+            else if (is_coded)
+            {
+                kept_codes.unchecked_place(labs.at(comb_labels[j]), j);
+            }
+            else
+            {
+                kept.unchecked_place(true, comb_labels[j], j);
+            }
+        }
+        
+        for (uint32_t j = 0; j < kept.n_rows(); j++)
+        {
+            index_of(labs.at(j)) = util::label_index(kept.to_bit_array(j));
+        }
+        
+        if (any_collapsed)
+        {
+            //  we need to insert a new collapsed label
+            uint32_t collapsed_lab = get_random_label_id();
+            
+            uint32_t collapsed_slot = insert_label(collapsed_lab, c_cat);
+            
+            m_labels.push(collapsed_lab);
+            
+            if (is_coded)
+            {
+                kept_codes.unchecked_assign(collapsed_lab, collapsed);
+            }
+            else
+            {
+                m_label_indices[collapsed_slot] = util::label_index(collapsed);
+            }
+            
+            util::types::entries_t& by_cat = labels_in(c_cat);
+            
+            by_cat.push(collapsed_lab);
+            
+            m_n_labels++;
+            
+            by_cat.sort();
+            m_labels.sort();
+        }
+        
+        //  labels left without rows are pruned below
+        if (is_coded)
+        {
+            *codes = std::move(kept_codes);
+        }
     }
     
-    m_labels.unchecked_sort(m_n_labels);
+    prune();
+    apply_index_policy();
     
-    m_tmp_index.append(other.m_tmp_index);
+    return from_csr(std::move(res));
+}
+
+uint32_t util::locator::add_category(uint32_t category)
+{
+    return add_category(category, util::category_storage::INDICES);
+}
+
+uint32_t util::locator::add_category(uint32_t category, uint32_t storage)
+{
+    if (has_category(category))
+    {
+        return util::locator_status::CATEGORY_EXISTS;
+    }
+    
+    unchecked_add_category(category, storage);
     
     return util::locator_status::OK;
 }
 
-void util::locator::clear()
+uint32_t util::locator::require_category(uint32_t category)
 {
-    m_labels.clear();
-    m_in_category.clear();
-    m_categories.clear();
-    m_indices.clear();
-    m_by_category.clear();
-    m_tmp_index.empty();
+    if (!has_category(category))
+    {
+        unchecked_add_category(category);
+    }
     
-    m_n_labels = 0;
+    return util::locator_status::OK;
 }
 
-void util::locator::empty()
+uint32_t util::locator::collapse_category(uint32_t category)
 {
-    m_labels.clear();
-    m_in_category.clear();
-    m_indices.clear();
-    m_tmp_index.empty();
+    if (!has_category(category))
+    {
+        return util::locator_status::CATEGORY_DOES_NOT_EXIST;
+    }
+    
+    const types::entries_t& by_category = labels_in(category);
+    const uint32_t n_in_cat = by_category.tail();
+    
+    //  category is already collapsed
+    if (n_in_cat == 0 || n_in_cat == 1)
+    {
+        return util::locator_status::OK;
+    }
+    
+    uint32_t next_lab_id = get_random_label_id();
+    
+    bool is_present = false;
+    util::bit_array index(size(), true);
+    
+    unchecked_set_category(category, next_lab_id, is_present, index);
+    
+    return util::locator_status::OK;
+}
+
+void util::locator::unchecked_add_category(uint32_t category, uint32_t storage)
+{
+    m_categories.push(category);
+    
+    insert_category(category, storage);
+    
+    m_categories.unchecked_sort(m_categories.tail());
+}
+
+uint32_t util::locator::rm_category(uint32_t category)
+{
+    if (!has_category(category))
+    {
+        return util::locator_status::CATEGORY_DOES_NOT_EXIST;
+    }
+    
+    util::types::entries_t& by_category = labels_in(category);
+    
+    uint32_t n_in_cat = by_category.tail();
+    uint32_t* by_category_ptr = by_category.unsafe_get_pointer();
+    
+    util::label_codes* codes = find_codes(category);
+    
+    if (codes)
+    {
+        codes->resize(0);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < n_in_cat; i++)
+        {
+            uint32_t lab = by_category_ptr[i];
+            index_of(lab).fill(false);
+        }
+    }
+    
+    prune();
+    
+    uint32_t slot = m_category_slots.erase(category);
+    
+    m_category_labels[slot] = util::types::entries_t();
+    m_category_storage[slot] = util::category_storage::INDICES;
+    m_category_codes[slot] = util::label_codes();
+    
+    uint32_t in_cat_idx = find_category(category);
+    
+    m_categories.erase(in_cat_idx);
+    
+    return util::locator_status::OK;
+}
+
+uint32_t util::locator::set_category(uint32_t category, uint32_t label, const util::bit_array& index)
+{
+    if (!has_category(category))
+    {
+        return util::locator_status::CATEGORY_DOES_NOT_EXIST;
+    }
+    
+    if (label == locator::UNDEFINED_LABEL)
+    {
+        return util::locator_status::IS_UNDEFINED_LABEL;
+    }
     
-    for (auto& it : m_by_category)
+    bool is_present = has_label(label);
+    
+    //  make sure we're not trying to add a label
+    //  that already exists in another category
+    if (is_present)
+    {
+        uint32_t c_in_category = category_of(label);
+        
+        if (c_in_category != category)
+        {
+            return util::locator_status::LABEL_EXISTS_IN_OTHER_CATEGORY;
+        }
+    }
+    
+    uint32_t c_size = size();
+    uint32_t index_size_m = index.size();
+    
+    bool c_is_empty = is_empty();
+    
+    //  size of incoming index must match current size, unless
+    //  locator is empty.
+    if (!c_is_empty && index_size_m != c_size)
+    {
+        return util::locator_status::WRONG_INDEX_SIZE;
+    }
+    
+    //  if no elements are true, we can just return early
+    if (!index.any())
+    {
+        return util::locator_status::OK;
+    }
+    
+    unchecked_set_category(category, label, is_present, index);
+    
+    return util::locator_status::OK;
+}
+
+uint32_t util::locator::set_category(uint32_t category, const util::types::entries_t& labels, const util::bit_array& index)
+{
+    if (!has_category(category))
+    {
+        return util::locator_status::CATEGORY_DOES_NOT_EXIST;
+    }
+    
+    uint32_t c_size = size();
+    uint32_t index_size_m = index.size();
+    
+    bool c_is_empty = is_empty();
+    
+    //  size of incoming index must match current size, unless
+    //  locator is empty.
+    if (!c_is_empty && index_size_m != c_size)
+    {
+        return util::locator_status::WRONG_INDEX_SIZE;
+    }
+    
+    //  sum of elements in the index must match the number of labels
+    //  to assign
+    if (labels.tail() != index.sum())
+    {
+        return util::locator_status::WRONG_NUMBER_OF_INDICES;
+    }
+    
+    if (!index.any())
     {
-        it.second.clear();
+        return util::locator_status::OK;
+    }
+    
+    uint32_t n_labels_in = labels.tail();
+    uint32_t* in_labels_ptr = labels.unsafe_get_pointer();
+    
+    //  dense ids of the incoming labels, in order of first appearance
+    util::slot_table ids;
+    types::entries_t label_ids(n_labels_in);
+    uint32_t* label_ids_ptr = label_ids.unsafe_get_pointer();
+    
+    for (uint32_t i = 0; i < n_labels_in; i++)
+    {
+        bool was_inserted;
+        label_ids_ptr[i] = ids.insert(in_labels_ptr[i], &was_inserted);
+    }
+    
+    uint32_t n_unique = ids.size();
+    std::vector<bool> lab_exists(n_unique, false);
+    
+    for (uint32_t i = 0; i < n_unique; i++)
+    {
+        uint32_t lab = ids.key_of(i);
+        
+        if (!has_label(lab))
+        {
+            continue;
+        }
+        
+        if (category_of(lab) != category)
+        {
+            return util::locator_status::LABEL_EXISTS_IN_OTHER_CATEGORY;
+        }
+        
+        lab_exists[i] = true;
+    }
+    
+    unchecked_set_category(category, ids, label_ids, lab_exists, index);
+    
+    return util::locator_status::OK;
+}
+
+void util::locator::unchecked_set_category(uint32_t category, uint32_t label, bool is_present, const util::bit_array& index)
+{
+    util::types::entries_t& by_category = labels_in(category);
+    
+    uint32_t* by_category_ptr = by_category.unsafe_get_pointer();
+    uint32_t n_by_category = by_category.tail();
+    
+    //  the first rows set give every category's codes their size
+    if (is_empty())
+    {
+        resize_codes(index.size());
+    }
+    
+    util::label_codes* codes = find_codes(category);
+    std::vector<uint32_t> emptied;
+    
+    //  only the labels left without rows are pruned
+    if (codes)
+    {
+        codes->unchecked_assign(label, index, &emptied);
+        n_by_category = 0;
+    }
+    
+    //  label indices are updated only at the cache lines holding rows of
+    //  `index`, so that the cost follows the number of rows set rather than
+    //  the size of the locator
+    std::vector<util::bit_array::span> spans;
+    
+    if (n_by_category > 0)
+    {
+        spans = util::bit_array::occupied_spans(index);
+    }
+    
+    //  set false at rows of other indices
+    for (uint32_t i = 0; i < n_by_category; i++)
+    {
+        uint32_t lab = by_category_ptr[i];
+        util::label_index& lab_index = index_of(lab);
+        
+        //  if updating a pre-existing label, set true to elements
+        //  that are currently false
+        if (lab == label)
+        {
+            lab_index.unchecked_or(index, spans);
+        }
+        else if (lab_index.unchecked_and_not(index, spans) > 0 && lab_index.sum() == 0)
+        {
+            emptied.push_back(lab);
+        }
+    }
+    
+    if (!is_present)
+    {
+        uint32_t slot = insert_label(label, category);
+        
+        m_labels.push(label);
+        by_category.push(label);
+        
+        if (!codes)
+        {
+            m_label_indices[slot] = util::label_index(index);
+        }
+        
+        m_n_labels++;
+        
+        by_category.sort();
+        m_labels.sort();
+    }
+    
+    for (uint32_t lab : emptied)
+    {
+        rm_label(lab);
+    }
+    
+    apply_index_policy(category);
+}
+
+//  unchecked_set_category: Give row i of those set in `index` the label
+//      of id `label_ids[i]` in `ids`, for all labels at once. Rows are
+//      grouped by label in one pass, each label's index is built once, and
+//      labels are sorted and pruned once.
+
+void util::locator::unchecked_set_category(uint32_t category, const util::slot_table& ids, const types::entries_t& label_ids,
+                                           const std::vector<bool>& is_present, const util::bit_array& index)
+{
+    uint32_t n_unique = ids.size();
+    uint32_t n_rows_in = label_ids.tail();
+    uint32_t* label_ids_ptr = label_ids.unsafe_get_pointer();
+    uint32_t index_sz = index.size();
+    
+    //  the first rows set give every category's codes their size
+    if (is_empty())
+    {
+        resize_codes(index_sz);
+    }
+    
+    types::entries_t offsets = util::bit_array::find(index);
+    uint32_t* offset_ptr = offsets.unsafe_get_pointer();
+    
+    util::types::entries_t& by_category = labels_in(category);
+    uint32_t n_by_category = by_category.tail();
+    uint32_t* by_category_ptr = by_category.unsafe_get_pointer();
+    
+    util::label_codes* codes = find_codes(category);
+    std::vector<uint32_t> emptied;
+    
+    //  rows of each label, ascending, at [starts[id], starts[id+1])
+    std::vector<uint32_t> starts;
+    std::vector<uint32_t> grouped;
+    
+    if (codes)
+    {
+        for (uint32_t i = 0; i < n_rows_in; i++)
+        {
+            codes->unchecked_place(ids.key_of(label_ids_ptr[i]), offset_ptr[i]);
+        }
+        
+        for (uint32_t i = 0; i < n_by_category; i++)
+        {
+            if (codes->count(by_category_ptr[i]) == 0)
+            {
+                emptied.push_back(by_category_ptr[i]);
+            }
+        }
+    }
+    else
+    {
+        //  every row set is relabeled, so it is first unset in each label of
+        //  the category; labels given rows below are not left empty
+        std::vector<util::bit_array::span> spans = util::bit_array::occupied_spans(index);
+        
+        for (uint32_t i = 0; i < n_by_category; i++)
+        {
+            uint32_t lab = by_category_ptr[i];
+            util::label_index& lab_index = index_of(lab);
+            
+            if (lab_index.unchecked_and_not(index, spans) > 0 && lab_index.sum() == 0 &&
+                ids.find(lab) == util::slot_table::NO_SLOT)
+            {
+                emptied.push_back(lab);
+            }
+        }
+        
+        //  counting sort by id keeps the rows of each label in order
+        starts.resize(n_unique + 1, 0u);
+        grouped.resize(n_rows_in);
+        
+        for (uint32_t i = 0; i < n_rows_in; i++)
+        {
+            starts[label_ids_ptr[i] + 1]++;
+        }
+        
+        for (uint32_t i = 0; i < n_unique; i++)
+        {
+            starts[i + 1] += starts[i];
+        }
+        
+        std::vector<uint32_t> next(starts.begin(), starts.end() - 1);
+        
+        for (uint32_t i = 0; i < n_rows_in; i++)
+        {
+            grouped[next[label_ids_ptr[i]]++] = offset_ptr[i];
+        }
+    }
+    
+    for (uint32_t i = 0; i < n_unique; i++)
+    {
+        uint32_t lab = ids.key_of(i);
+        const uint32_t* lab_rows = codes ? nullptr : grouped.data() + starts[i];
+        uint32_t n_lab_rows = codes ? 0u : starts[i + 1] - starts[i];
+        
+        if (is_present[i])
+        {
+            if (!codes)
+            {
+                index_of(lab).unchecked_or(lab_rows, n_lab_rows);
+            }
+            
+            continue;
+        }
+        
+        uint32_t slot = insert_label(lab, category);
+        
+        //  new labels are built in the form the policy would give them
+        if (!codes && util::label_index::compresses(m_index_policy, index_sz, n_lab_rows))
+        {
+            m_label_indices[slot] = util::label_index(util::compressed_bit_array(index_sz, lab_rows, n_lab_rows));
+        }
+        else if (!codes)
+        {
+            util::bit_array lab_index(index_sz, false);
+            
+            for (uint32_t j = 0; j < n_lab_rows; j++)
+            {
+                lab_index.unchecked_place(true, lab_rows[j]);
+            }
+            
+            m_label_indices[slot] = util::label_index(std::move(lab_index));
+        }
+        
+        m_labels.push(lab);
+        by_category.push(lab);
+        m_n_labels++;
+    }
+    
+    by_category.sort();
+    m_labels.sort();
+    
+    for (uint32_t lab : emptied)
+    {
+        rm_label(lab);
+    }
+    
+    apply_index_policy(category);
+}
+
+void util::locator::prune()
+{
+    //  labels without rows, whether in label indices or in codes
+    std::vector<uint32_t> unused;
+    
+    for (uint32_t i = 0; i < m_label_slots.n_slots(); i++)
+    {
+        if (!m_label_slots.is_used(i))
+        {
+            continue;
+        }
+        
+        uint32_t lab = m_label_slots.key_of(i);
+        uint32_t cat_slot = m_label_categories[i];
+        
+        bool any = m_category_storage[cat_slot] == util::category_storage::CODES ?
+            m_category_codes[cat_slot].count(lab) > 0 : m_label_indices[i].any();
+        
+        if (!any)
+        {
+            unused.push_back(lab);
+        }
+    }
+    
+    for (uint32_t lab : unused)
+    {
+        rm_label(lab);
+    }
+    
+    if (m_n_labels == 0)
+    {
+        resize_codes(0);
+    }
+}
+
+uint32_t util::locator::keep(const util::types::entries_t& at_indices)
+{
+    if (is_empty())
+    {
+        return util::locator_status::OK;
+    }
+    
+    uint32_t n_indices = at_indices.tail();
+    
+    if (n_indices == 0)
+    {
+        empty();
+        return util::locator_status::OK;
+    }
+    
+    uint32_t sz = size();
+    uint32_t* at_indices_ptr = at_indices.unsafe_get_pointer();
+    
+    for (uint32_t i = 0; i < n_indices; i++)
+    {
+        if (at_indices_ptr[i] >= sz)
+        {
+            return util::locator_status::INDEX_OUT_OF_BOUNDS;
+        }
+    }
+    
+    unchecked_keep(at_indices);
+    
+    return util::locator_status::OK;
+}
+
+void util::locator::unchecked_keep(const util::types::entries_t& at_indices, int32_t index_offset)
+{
+    for (uint32_t i = 0; i < m_label_slots.n_slots(); i++)
+    {
+        if (is_indexed(i))
+        {
+            m_label_indices[i].unchecked_keep(at_indices, index_offset);
+        }
+    }
+    
+    for (uint32_t i = 0; i < m_category_slots.n_slots(); i++)
+    {
+        if (m_category_storage[i] == util::category_storage::CODES)
+        {
+            m_category_codes[i].unchecked_keep(at_indices, index_offset);
+        }
+    }
+    
+    prune();
+    apply_index_policy();
+}
+
+uint32_t util::locator::keep_mask(const util::bit_array& mask)
+{
+    if (is_empty())
+    {
+        return util::locator_status::OK;
+    }
+    
+    if (mask.size() != size())
+    {
+        return util::locator_status::WRONG_INDEX_SIZE;
+    }
+    
+    if (!mask.any())
+    {
+        empty();
+        return util::locator_status::OK;
+    }
+    
+    unchecked_keep_mask(mask);
+    
+    return util::locator_status::OK;
+}
+
+void util::locator::unchecked_keep_mask(const util::bit_array& mask)
+{
+    for (uint32_t i = 0; i < m_label_slots.n_slots(); i++)
+    {
+        if (is_indexed(i))
+        {
+            m_label_indices[i].unchecked_compress(mask);
+        }
+    }
+    
+    for (uint32_t i = 0; i < m_category_slots.n_slots(); i++)
+    {
+        if (m_category_storage[i] == util::category_storage::CODES)
+        {
+            m_category_codes[i].unchecked_compress(mask);
+        }
+    }
+    
+    prune();
+    apply_index_policy();
+}
+
+uint32_t util::locator::append(const util::locator &other)
+{
+    if (!categories_match(other))
+    {
+        return util::locator_status::CATEGORIES_DO_NOT_MATCH;
+    }
+    
+    if (other.is_empty())
+    {
+        return util::locator_status::OK;
+    }
+    
+    if (is_empty())
+    {
+        //  categories keep their own storage. Both locators have the same
+        //  categories, in the same order.
+        std::vector<uint32_t> storage(m_categories.tail());
+        
+        for (uint32_t i = 0; i < m_categories.tail(); i++)
+        {
+            bool is_coded = find_codes(m_categories.at(i)) != nullptr;
+            
+            storage[i] = is_coded ? util::category_storage::CODES : util::category_storage::INDICES;
+        }
+        
+        *this = other;
+        
+        for (uint32_t i = 0; i < m_categories.tail(); i++)
+        {
+            unchecked_set_storage(m_categories.at(i), storage[i]);
+        }
+        
+        return util::locator_status::OK;
+    }
+    
+    if (&other == this)
+    {
+        util::locator copy(other);
+        return append(copy);
+    }
+    
+    util::types::entries_t other_labels = other.m_labels;
+    uint32_t* own_label_ptr = m_labels.unsafe_get_pointer();
+    
+    uint32_t original_sz = size();
+    uint32_t other_sz = other.size();
+    
+    uint32_t int_max = ~(uint32_t(0));
+    
+    if (int_max - original_sz < other_sz)
+    {
+        return util::locator_status::LOC_OVERFLOW;
+    }
+    
+    //  codes are appended a category at a time
+    for (uint32_t i = 0; i < m_category_slots.n_slots(); i++)
+    {
+        if (m_category_storage[i] != util::category_storage::CODES)
+        {
+            continue;
+        }
+        
+        uint32_t category = m_category_slots.key_of(i);
+        const util::label_codes* other_codes = other.find_codes(category);
+        
+        if (other_codes)
+        {
+            m_category_codes[i].append(*other_codes);
+        }
+        else
+        {
+            m_category_codes[i].append(other.to_codes(category));
+        }
+    }
+    
+    for (uint32_t i = 0; i < m_n_labels; i++)
+    {
+        uint32_t own_label = own_label_ptr[i];
+        bool is_coded = find_label_codes(own_label) != nullptr;
+        
+        if (other.has_label(own_label))
+        {
+            if (!is_coded)
+            {
+                util::label_index built;
+                index_of(own_label).append(other.get_index(own_label, built));
+            }
+            
+            uint32_t index_in_other_labels;
+            uint32_t* other_label_ptr = other_labels.unsafe_get_pointer();
+            util::unchecked_binary_search(other_label_ptr, other_labels.tail(), own_label, &index_in_other_labels);
+            
+            other_labels.erase(index_in_other_labels);
+            
+            continue;
+        }
+        
+        if (!is_coded)
+        {
+            index_of(own_label).resize(original_sz + other_sz);
+        }
+    }
+    
+    uint32_t remaining_labels = other_labels.tail();
+    uint32_t* other_label_ptr = other_labels.unsafe_get_pointer();
+    
+    for (uint32_t i = 0; i < remaining_labels; i++)
+    {
+        uint32_t other_lab = other_label_ptr[i];
+        uint32_t in_cat = other.category_of(other_lab);
+        uint32_t slot = insert_label(other_lab, in_cat);
+        
+        if (!find_codes(in_cat))
+        {
+            util::label_index own_index(original_sz, true);
+            util::label_index built;
+            
+            own_index.append(other.get_index(other_lab, built));
+            
+            m_label_indices[slot] = std::move(own_index);
+        }
+        
+        m_labels.push(other_lab);
+        
+        util::types::entries_t& by_category = labels_in(in_cat);
+        
+        by_category.push(other_lab);
+        by_category.unchecked_sort(by_category.tail());
+        
+        m_n_labels++;
+    }
+    
+    m_labels.unchecked_sort(m_n_labels);
+    
+    apply_index_policy();
+    
+    return util::locator_status::OK;
+}
+
+uint32_t util::locator::append(const std::vector<const util::locator*>& others)
+{
+    uint64_t total_sz = size();
+    
+    for (const util::locator* other : others)
+    {
+        if (!categories_match(*other))
+        {
+            return util::locator_status::CATEGORIES_DO_NOT_MATCH;
+        }
+        
+        total_sz += other->size();
+    }
+    
+    if (total_sz > uint64_t(~(uint32_t(0))))
+    {
+        return util::locator_status::LOC_OVERFLOW;
+    }
+    
+    //  a single locator is appended in place
+    if (others.size() == 1)
+    {
+        return append(*others[0]);
+    }
+    
+    std::vector<const util::locator*> parts;
+    
+    if (!is_empty())
+    {
+        parts.push_back(this);
+    }
+    
+    for (const util::locator* other : others)
+    {
+        if (!other->is_empty())
+        {
+            parts.push_back(other);
+        }
+    }
+    
+    if (parts.empty())
+    {
+        return util::locator_status::OK;
+    }
+    
+    if (parts.size() == 1)
+    {
+        if (parts[0] != this)
+        {
+            *this = *parts[0];
+        }
+        
+        return util::locator_status::OK;
+    }
+    
+    //  union of labels, in the order first seen, and their categories
+    util::types::entries_t labels;
+    std::vector<uint32_t> in_category;
+    util::slot_table seen;
+    
+    for (const util::locator* part : parts)
+    {
+        uint32_t* part_labels = part->m_labels.unsafe_get_pointer();
+        
+        for (uint32_t i = 0; i < part->m_n_labels; i++)
+        {
+            uint32_t lab = part_labels[i];
+            bool was_inserted;
+            
+            seen.insert(lab, &was_inserted);
+            
+            if (was_inserted)
+            {
+                in_category.push_back(part->category_of(lab));
+                labels.push(lab);
+            }
+        }
+    }
+    
+    //  stand-ins for labels absent from a part
+    std::vector<util::label_index> absent;
+    absent.reserve(parts.size());
+    
+    for (const util::locator* part : parts)
+    {
+        absent.emplace_back(part->size(), true);
+    }
+    
+    uint32_t n_labels = labels.tail();
+    uint32_t* labels_ptr = labels.unsafe_get_pointer();
+    
+    //  coded categories are joined part by part, by category slot
+    std::vector<util::label_codes> codes(m_category_slots.n_slots());
+    
+    for (uint32_t i = 0; i < m_category_slots.n_slots(); i++)
+    {
+        if (m_category_storage[i] != util::category_storage::CODES)
+        {
+            continue;
+        }
+        
+        uint32_t category = m_category_slots.key_of(i);
+        
+        for (const util::locator* part : parts)
+        {
+            const util::label_codes* part_codes = part->find_codes(category);
+            
+            if (part_codes)
+            {
+                codes[i].append(*part_codes);
+            }
+            else
+            {
+                codes[i].append(part->to_codes(category));
+            }
+        }
+    }
+    
+    //  indices of the labels, in the order first seen
+    std::vector<util::label_index> indices(n_labels);
+    std::vector<const util::label_index*> label_parts(parts.size());
+    //  indices of labels coded in a part, built a label at a time
+    std::vector<util::label_index> built(parts.size());
+    
+    for (uint32_t i = 0; i < n_labels; i++)
+    {
+        uint32_t lab = labels_ptr[i];
+        
+        if (find_codes(in_category[i]))
+        {
+            continue;
+        }
+        
+        for (uint32_t j = 0; j < parts.size(); j++)
+        {
+            label_parts[j] = parts[j]->has_label(lab) ? &parts[j]->get_index(lab, built[j]) : &absent[j];
+        }
+        
+        util::label_index::concat(indices[i], label_parts);
+    }
+    
+    m_label_slots.clear();
+    m_label_categories.clear();
+    m_label_indices.clear();
+    m_label_slots.reserve(n_labels);
+    
+    for (uint32_t i = 0; i < n_labels; i++)
+    {
+        uint32_t slot = insert_label(labels_ptr[i], in_category[i]);
+        
+        m_label_indices[slot] = std::move(indices[i]);
+    }
+    
+    for (uint32_t i = 0; i < m_category_slots.n_slots(); i++)
+    {
+        m_category_labels[i].clear();
+        m_category_codes[i] = std::move(codes[i]);
+    }
+    
+    labels.unchecked_sort(n_labels);
+    
+    for (uint32_t i = 0; i < n_labels; i++)
+    {
+        labels_in(category_of(labels_ptr[i])).push(labels_ptr[i]);
+    }
+    
+    m_labels = std::move(labels);
+    m_n_labels = n_labels;
+    
+    apply_index_policy();
+    
+    return util::locator_status::OK;
+}
+
+void util::locator::clear()
+{
+    m_labels.clear();
+    m_categories.clear();
+    
+    m_label_slots.clear();
+    m_label_categories.clear();
+    m_label_indices.clear();
+    
+    m_category_slots.clear();
+    m_category_labels.clear();
+    m_category_storage.clear();
+    m_category_codes.clear();
+    
+    m_n_labels = 0;
+}
+
+void util::locator::empty()
+{
+    m_labels.clear();
+    
+    m_label_slots.clear();
+    m_label_categories.clear();
+    m_label_indices.clear();
+    
+    for (uint32_t i = 0; i < m_category_slots.n_slots(); i++)
+    {
+        m_category_labels[i].clear();
+        m_category_codes[i].clear();
+    }
+    
+    m_n_labels = 0;
+}
+
+void util::locator::resize(uint32_t to_size)
+{
+    uint32_t orig_size = size();
+    
+    for (uint32_t i = 0; i < m_label_slots.n_slots(); i++)
+    {
+        if (is_indexed(i))
+        {
+            m_label_indices[i].resize(to_size);
+        }
+    }
+    
+    if (!is_empty())
+    {
+        resize_codes(to_size);
+    }
+    
+    if (to_size < orig_size)
+    {
+        prune();
+    }
+    
+    apply_index_policy();
+}
+
+util::types::numeric_indices_t util::locator::find(const uint32_t label, uint32_t index_offset) const
+{
+    util::types::numeric_indices_t empty_result;
+    
+    if (!has_label(label))
+    {
+        return empty_result;
+    }
+    
+    const util::label_codes* codes = find_label_codes(label);
+    
+    if (codes)
+    {
+        return util::label_codes::find(*codes, label, index_offset);
+    }
+    
+    return util::label_index::find(get_index(label), index_offset);
+}
+
+util::types::numeric_indices_t util::locator::find(const util::types::entries_t& labels, uint32_t index_offset) const
+{
+    return find(labels, find_scratch, index_offset);
+}
+
+util::types::numeric_indices_t util::locator::find(const util::types::entries_t& labels,
+                                                   util::bit_array& scratch, uint32_t index_offset) const
+{
+    using util::bit_array;
+    
+    util::types::numeric_indices_t empty_result;
+    
+    uint32_t c_size = size();
+    
+    if (m_n_labels == 0 || c_size == 0)
+    {
+        return empty_result;
+    }
+    
+    std::vector<std::vector<const util::label_index*>> groups;
+    std::vector<uint64_t> counts;
+    std::deque<util::label_index> built;
+    
+    if (!plan_find(labels, groups, counts, built))
+    {
+        return empty_result;
+    }
+    
+    uint32_t n_groups = uint32_t(groups.size());
+    
+    //  every category named covers every row
+    if (n_groups == 0)
+    {
+        util::types::numeric_indices_t result(c_size);
+        uint32_t* result_ptr = result.unsafe_get_pointer();
+        
+        for (uint32_t i = 0; i < c_size; i++)
+        {
+            result_ptr[i] = i + index_offset;
+        }
+        
+        result.seek_tail_to_end();
+        
+        return result;
+    }
+    
+    if (n_groups == 1 && groups[0].size() == 1)
+    {
+        return util::label_index::find(*groups[0][0], index_offset);
+    }
+    
+    //  probing the candidate rows of the most selective category costs
+    //  about FIND_PROBE_COST per label of the other categories; the dense
+    //  intersection streams every word of every label, and expands the
+    //  compressed ones first.
+    uint64_t n_words = (uint64_t(c_size) + 63) / 64;
+    uint64_t dense_cost = 0;
+    uint64_t bound_cost = 0;
+    uint64_t n_probed = 0;
+    
+    for (uint32_t i = 0; i < n_groups; i++)
+    {
+        for (const util::label_index* index : groups[i])
+        {
+            uint64_t index_cost = index->is_compressed() ? 2 * n_words : n_words;
+            
+            dense_cost += index_cost;
+            bound_cost += i == 0 ? (index->is_compressed() ? index->sum() : n_words) : 0;
+            n_probed += i == 0 ? 0 : 1;
+        }
+    }
+    
+    uint64_t probe_cost = bound_cost + counts[0] * n_probed * FIND_PROBE_COST;
+    
+    if (probe_cost < dense_cost)
+    {
+        return find_sparse(groups, 0, index_offset);
+    }
+    
+    //  otherwise, intersect densely. The labels of a category that holds
+    //  compressed ones are or-ed into a single dense operand.
+    std::vector<util::bit_array> merged;
+    std::vector<std::vector<const util::bit_array*>> dense_groups(n_groups);
+    
+    merged.reserve(n_groups);
+    
+    for (uint32_t i = 0; i < n_groups; i++)
+    {
+        bool any_compressed = false;
+        
+        for (const util::label_index* index : groups[i])
+        {
+            any_compressed = any_compressed || index->is_compressed();
+        }
+        
+        if (!any_compressed)
+        {
+            for (const util::label_index* index : groups[i])
+            {
+                dense_groups[i].push_back(&index->dense());
+            }
+            
+            continue;
+        }
+        
+        merged.emplace_back(c_size, false);
+        
+        for (const util::label_index* index : groups[i])
+        {
+            index->unchecked_or_into(merged.back());
+        }
+        
+        dense_groups[i].push_back(&merged.back());
+    }
+    
+    if (scratch.size() != c_size)
+    {
+        //  every word is written by the intersection
+        scratch = util::bit_array(c_size);
+    }
+    
+    bit_array::parallel_and_of_or_many(scratch, dense_groups);
+    
+    return bit_array::parallel_find(scratch, index_offset);
+}
+
+//  plan_find: Group `labels` by category, ordered from the category with
+//      the fewest rows to the one with the most. Rows have at most one
+//      label per category, so a category's count is the sum of its labels'
+//      counts; categories whose labels cover every row are left out, since
+//      they do not restrict the result. False if a label does not exist or
+//      a category has no rows, in which case nothing matches. The indices of
+//      coded labels are built into `built`, which must outlive `groups`.
+
+bool util::locator::plan_find(const util::types::entries_t& labels,
+                              std::vector<std::vector<const util::label_index*>>& groups,
+                              std::vector<uint64_t>& counts, std::deque<util::label_index>& built) const
+{
+    std::vector<uint32_t> group_categories;
+    std::vector<std::vector<const util::label_index*>> by_category;
+    std::vector<uint64_t> category_counts;
+    
+    uint32_t* search_label_ptr = labels.unsafe_get_pointer();
+    uint32_t search_size = labels.tail();
+    
+    for (uint32_t i = 0; i < search_size; i++)
+    {
+        uint32_t slot = m_label_slots.find(search_label_ptr[i]);
+        
+        if (slot == util::slot_table::NO_SLOT)
+        {
+            return false;
+        }
+        
+        //  repeated labels are counted once
+        if (std::find(search_label_ptr, search_label_ptr + i, search_label_ptr[i]) != search_label_ptr + i)
+        {
+            continue;
+        }
+        
+        //  labels are grouped by the slot of their category
+        uint32_t category_slot = m_label_categories[slot];
+        const util::label_index* index = &m_label_indices[slot];
+        
+        if (m_category_storage[category_slot] == util::category_storage::CODES)
+        {
+            built.push_back(m_category_codes[category_slot].index(search_label_ptr[i], m_index_policy));
+            index = &built.back();
+        }
+        
+        auto group_it = std::find(group_categories.begin(), group_categories.end(), category_slot);
+        uint32_t group = uint32_t(group_it - group_categories.begin());
+        
+        if (group_it == group_categories.end())
+        {
+            group_categories.push_back(category_slot);
+            by_category.push_back({ index });
+            category_counts.push_back(index->sum());
+        }
+        else
+        {
+            by_category[group].push_back(index);
+            category_counts[group] += index->sum();
+        }
+    }
+    
+    uint32_t n_categories = uint32_t(by_category.size());
+    std::vector<uint32_t> order(n_categories);
+    
+    for (uint32_t i = 0; i < n_categories; i++)
+    {
+        if (category_counts[i] == 0)
+        {
+            return false;
+        }
+        
+        order[i] = i;
+    }
+    
+    std::stable_sort(order.begin(), order.end(), [&category_counts] (uint32_t a, uint32_t b) -> bool {
+        return category_counts[a] < category_counts[b];
+    });
+    
+    groups.clear();
+    counts.clear();
+    
+    uint64_t c_size = size();
+    
+    for (uint32_t i : order)
+    {
+        if (category_counts[i] < c_size)
+        {
+            groups.push_back(std::move(by_category[i]));
+            counts.push_back(category_counts[i]);
+        }
+    }
+    
+    return true;
+}
+
+bool util::locator::has_combination(const util::types::entries_t& labels) const
+{
+    uint32_t c_size = size();
+    
+    if (m_n_labels == 0 || c_size == 0)
+    {
+        return false;
+    }
+    
+    //  labels are grouped by the slot of their category, as in plan_find.
+    //  A row matches if it has one of the labels of each group. The labels
+    //  of coded categories are tested against the codes, rather than
+    //  through indices built from them.
+    std::vector<uint32_t> group_categories;
+    std::vector<std::vector<const util::label_index*>> indices;
+    std::vector<std::vector<uint32_t>> coded_labels;
+    std::vector<uint64_t> counts;
+    
+    uint32_t* search_label_ptr = labels.unsafe_get_pointer();
+    uint32_t search_size = labels.tail();
+    
+    for (uint32_t i = 0; i < search_size; i++)
+    {
+        uint32_t lab = search_label_ptr[i];
+        uint32_t slot = m_label_slots.find(lab);
+        
+        if (slot == util::slot_table::NO_SLOT)
+        {
+            return false;
+        }
+        
+        if (std::find(search_label_ptr, search_label_ptr + i, lab) != search_label_ptr + i)
+        {
+            continue;
+        }
+        
+        uint32_t category_slot = m_label_categories[slot];
+        auto group_it = std::find(group_categories.begin(), group_categories.end(), category_slot);
+        uint32_t group = uint32_t(group_it - group_categories.begin());
+        
+        if (group_it == group_categories.end())
+        {
+            group_categories.push_back(category_slot);
+            indices.emplace_back();
+            coded_labels.emplace_back();
+            counts.push_back(0);
+        }
+        
+        if (m_category_storage[category_slot] == util::category_storage::CODES)
+        {
+            coded_labels[group].push_back(lab);
+            counts[group] += m_category_codes[category_slot].count(lab);
+        }
+        else
+        {
+            indices[group].push_back(&m_label_indices[slot]);
+            counts[group] += m_label_indices[slot].sum();
+        }
+    }
+    
+    //  each group that restricts the result is tested in one of three ways.
+    //  The sparsest group of compressed labels, if any, bounds the rows
+    //  tested against the others. Otherwise, the groups of dense labels are
+    //  and-ed word by word, those mixing dense and compressed labels or-ed
+    //  into a dense operand first, and coded groups are tested at the rows
+    //  that remain. With only coded groups, the rows of the rarest coded
+    //  label are tested.
+    std::vector<uint32_t> restricting;
+    std::vector<uint32_t> coded;
+    std::vector<uint32_t> mixed;
+    std::vector<std::vector<const util::bit_array*>> dense;
+    uint32_t n_groups = uint32_t(counts.size());
+    uint32_t bound = n_groups;
+    
+    for (uint32_t i = 0; i < n_groups; i++)
+    {
+        if (counts[i] == 0)
+        {
+            return false;
+        }
+        
+        //  categories whose labels cover every row do not restrict the result
+        if (counts[i] == c_size)
+        {
+            continue;
+        }
+        
+        restricting.push_back(i);
+        
+        if (!coded_labels[i].empty())
+        {
+            coded.push_back(i);
+            continue;
+        }
+        
+        uint32_t n_compressed = 0;
+        
+        for (const util::label_index* index : indices[i])
+        {
+            n_compressed += index->is_compressed() ? 1u : 0u;
+        }
+        
+        if (n_compressed == indices[i].size())
+        {
+            bound = bound == n_groups || counts[i] < counts[bound] ? i : bound;
+        }
+        else if (n_compressed == 0)
+        {
+            dense.emplace_back();
+            
+            for (const util::label_index* index : indices[i])
+            {
+                dense.back().push_back(&index->dense());
+            }
+        }
+        else
+        {
+            mixed.push_back(i);
+        }
+    }
+    
+    if (restricting.empty())
+    {
+        return true;
+    }
+    
+    auto in_group = [this, &indices, &coded_labels, &group_categories] (uint32_t group, uint32_t row) -> bool {
+        if (!coded_labels[group].empty())
+        {
+            const std::vector<uint32_t>& group_labels = coded_labels[group];
+            uint32_t lab = m_category_codes[group_categories[group]].at(row);
+            
+            return std::find(group_labels.begin(), group_labels.end(), lab) != group_labels.end();
+        }
+        
+        for (const util::label_index* index : indices[group])
+        {
+            if (index->at(row))
+            {
+                return true;
+            }
+        }
+        
+        return false;
+    };
+    
+    auto in_all = [&in_group] (const std::vector<uint32_t>& groups, uint32_t skip, uint32_t row) -> bool {
+        for (uint32_t group : groups)
+        {
+            if (group != skip && !in_group(group, row))
+            {
+                return false;
+            }
+        }
+        
+        return true;
+    };
+    
+    //  the labels of a category have no row in common, so the rows of a
+    //  group are visited a label at a time
+    if (bound != n_groups)
+    {
+        auto is_match = [&in_all, &restricting, bound] (uint32_t row) -> bool {
+            return in_all(restricting, bound, row);
+        };
+        
+        for (const util::label_index* index : indices[bound])
+        {
+            if (util::compressed_bit_array::any_set_bit(index->compressed(), is_match))
+            {
+                return true;
+            }
+        }
+        
+        return false;
+    }
+    
+    std::vector<util::bit_array> merged;
+    
+    merged.reserve(mixed.size());
+    
+    for (uint32_t group : mixed)
+    {
+        merged.emplace_back(c_size, false);
+        
+        for (const util::label_index* index : indices[group])
+        {
+            index->unchecked_or_into(merged.back());
+        }
+        
+        dense.push_back({ &merged.back() });
+    }
+    
+    if (!dense.empty())
+    {
+        //  each coded group masks a word of the and by the codes at its set
+        //  bits, so that only rows in every dense group are read
+        std::vector<std::vector<uint32_t>> group_codes;
+        
+        for (uint32_t group : coded)
+        {
+            const util::label_codes& codes = m_category_codes[group_categories[group]];
+            
+            group_codes.emplace_back();
+            
+            for (uint32_t lab : coded_labels[group])
+            {
+                group_codes.back().push_back(codes.code_of(lab));
+            }
+        }
+        
+        auto is_match = [this, &coded, &group_codes, &group_categories] (uint32_t bin, uint64_t word) -> bool {
+            uint32_t start = bin * util::bit_array::BITS;
+            
+            for (uint32_t j = 0; j < coded.size() && word != 0; j++)
+            {
+                const util::label_codes& codes = m_category_codes[group_categories[coded[j]]];
+                uint64_t mask = 0;
+                
+                auto func = [start, &group_codes, j, &mask] (uint32_t row, uint32_t code) -> void {
+                    for (uint32_t group_code : group_codes[j])
+                    {
+                        mask |= uint64_t(code == group_code) << (row - start);
+                    }
+                };
+                
+                for (uint64_t bits = word; bits != 0; bits &= bits - 1)
+                {
+                    uint32_t row = start + util::bit_kernels::ctz64(bits);
+                    util::label_codes::for_each_code(codes, row, row + 1, func);
+                }
+                
+                word &= mask;
+            }
+            
+            return word != 0;
+        };
+        
+        return util::bit_array::any_word_of_and_of_or_many(dense, is_match);
     }
     
-    m_n_labels = 0;
-}
-
-void util::locator::resize(uint32_t to_size)
-{
-    uint32_t orig_size = size();
-    
-    for (auto& it : m_indices)
-    {
-        it.second.resize(to_size);
-    }
+    uint32_t rarest = coded[0];
     
-    if (to_size < orig_size)
+    for (uint32_t group : coded)
     {
-        prune();
+        rarest = counts[group] < counts[rarest] ? group : rarest;
     }
     
-    if (orig_size > 0)
-    {
-        m_tmp_index.resize(to_size);
-    }
-}
-
-util::types::numeric_indices_t util::locator::find(const uint32_t label, uint32_t index_offset) const
-{
-    util::types::numeric_indices_t empty_result;
+    const util::label_codes& rarest_codes = m_category_codes[group_categories[rarest]];
     
-    if (!has_label(label))
+    for (uint32_t lab : coded_labels[rarest])
     {
-        return empty_result;
+        util::types::numeric_indices_t rows = util::label_codes::find(rarest_codes, lab);
+        uint32_t* rows_ptr = rows.unsafe_get_pointer();
+        
+        for (uint32_t i = 0; i < rows.tail(); i++)
+        {
+            if (in_all(coded, rarest, rows_ptr[i]))
+            {
+                return true;
+            }
+        }
     }
     
-    const util::bit_array& index = m_indices.at(label);
-    
-    return util::bit_array::find(index, index_offset);
+    return false;
 }
 
-util::types::numeric_indices_t util::locator::find(const util::types::entries_t& labels, uint32_t index_offset)
+//  find_sparse: Rows of `groups[sparse_group]` that are also set in at
+//      least one label of every other group, tested row by row in group
+//      order.
+
+util::types::numeric_indices_t util::locator::find_sparse(const std::vector<std::vector<const util::label_index*>>& groups,
+                                                          uint32_t sparse_group, uint32_t index_offset) const
 {
-    using util::bit_array;
+    const std::vector<const util::label_index*>& bound = groups[sparse_group];
     
-    util::types::numeric_indices_t empty_result;
-    
-    uint32_t c_size = size();
+    util::types::numeric_indices_t rows;
     
-    if (m_n_labels == 0 || c_size == 0)
+    if (bound.size() == 1)
     {
-        return empty_result;
+        rows = util::label_index::find(*bound[0]);
     }
-    
-    std::unordered_map<uint32_t, util::bit_array> index_map;
-    
-    uint32_t* search_label_ptr = labels.unsafe_get_pointer();
-    uint32_t search_size = labels.tail();
-    
-    for (uint32_t i = 0; i < search_size; i++)
+    else
     {
-        uint32_t label = search_label_ptr[i];
+        util::bit_array candidates(size(), false);
         
-        if (!has_label(label))
+        for (const util::label_index* index : bound)
         {
-            return empty_result;
+            index->unchecked_or_into(candidates);
         }
         
-        const uint32_t category = m_in_category[label];
-        const util::bit_array& label_index = m_indices[label];
+        rows = util::bit_array::find(candidates);
+    }
+    
+    uint32_t* rows_ptr = rows.unsafe_get_pointer();
+    uint32_t n_rows = rows.tail();
+    uint32_t n_kept = 0;
+    
+    for (uint32_t i = 0; i < n_rows; i++)
+    {
+        uint32_t row = rows_ptr[i];
+        bool keep = true;
         
-        if (index_map.find(category) == index_map.end())
+        for (uint32_t j = 0; j < groups.size() && keep; j++)
         {
-            index_map[category] = label_index;
+            if (j == sparse_group)
+            {
+                continue;
+            }
+            
+            bool any = false;
+            
+            for (const util::label_index* index : groups[j])
+            {
+                if (index->at(row))
+                {
+                    any = true;
+                    break;
+                }
+            }
+            
+            keep = any;
         }
-        else
+        
+        if (keep)
         {
-            bit_array& current = index_map[category];
-            bit_array::unchecked_dot_or(current, current, label_index, 0, c_size);
+            rows_ptr[n_kept++] = row + index_offset;
         }
     }
     
-    m_tmp_index.fill(true);
-    
-    for (const auto& it : index_map)
-    {
-        bit_array::unchecked_dot_and(m_tmp_index, m_tmp_index, it.second, 0, c_size);
-    }
+    rows.resize(n_kept);
+    rows.seek_tail_to_end();
     
-    return bit_array::find(m_tmp_index, index_offset);
+    return rows;
 }
 
 bool util::locator::is_empty() const
@@ -1095,7 +2905,21 @@ bool util::locator::is_empty() const
 
 uint32_t util::locator::size() const
 {
-    return is_empty() ? 0 : m_indices.begin()->second.size();
+    if (is_empty())
+    {
+        return 0;
+    }
+    
+    //  every label index and every category's codes have one element per
+    //  row
+    uint32_t slot = m_label_slots.find(m_labels.at(0));
+    
+    if (is_indexed(slot))
+    {
+        return m_label_indices[slot].size();
+    }
+    
+    return m_category_codes[m_label_categories[slot]].size();
 }
 
 uint32_t util::locator::n_categories() const
@@ -1110,31 +2934,87 @@ uint32_t util::locator::n_labels() const
 
 uint32_t util::locator::count(uint32_t label) const
 {
-    auto it = m_indices.find(label);
+    uint32_t slot = m_label_slots.find(label);
     
-    if (it == m_indices.end())
+    if (slot == util::slot_table::NO_SLOT)
     {
         return 0u;
     }
     
-    return it->second.sum();
+    if (is_indexed(slot))
+    {
+        return m_label_indices[slot].sum();
+    }
+    
+    return m_category_codes[m_label_categories[slot]].count(label);
+}
+
+void util::locator::set_index_policy(uint32_t policy)
+{
+    m_index_policy = policy;
+    
+    apply_index_policy();
+}
+
+uint32_t util::locator::get_index_policy() const
+{
+    return m_index_policy;
+}
+
+bool util::locator::is_compressed_label(uint32_t label) const
+{
+    uint32_t slot = m_label_slots.find(label);
+    
+    return slot != util::slot_table::NO_SLOT && is_indexed(slot) && m_label_indices[slot].is_compressed();
+}
+
+//  apply_index_policy: Convert each label index to the representation
+//      chosen by `m_index_policy`.
+
+void util::locator::apply_index_policy()
+{
+    for (uint32_t i = 0; i < m_label_slots.n_slots(); i++)
+    {
+        if (is_indexed(i))
+        {
+            m_label_indices[i].apply_policy(m_index_policy);
+        }
+    }
+}
+
+void util::locator::apply_index_policy(uint32_t category)
+{
+    if (find_codes(category))
+    {
+        return;
+    }
+    
+    const types::entries_t& by_category = labels_in(category);
+    
+    uint32_t n_in_cat = by_category.tail();
+    uint32_t* by_category_ptr = by_category.unsafe_get_pointer();
+    
+    for (uint32_t i = 0; i < n_in_cat; i++)
+    {
+        index_of(by_category_ptr[i]).apply_policy(m_index_policy);
+    }
 }
 
 bool util::locator::has_label(uint32_t label) const
 {
-    return m_in_category.find(label) != m_in_category.end();
+    return m_label_slots.find(label) != util::slot_table::NO_SLOT;
 }
 
 bool util::locator::has_category(uint32_t category) const
 {
-    return m_by_category.find(category) != m_by_category.end();
+    return m_category_slots.find(category) != util::slot_table::NO_SLOT;
 }
 
 bool util::locator::is_full_category(uint32_t category, bool *exists) const
 {
-    auto it = m_by_category.find(category);
+    const types::entries_t* labs_found = find_labels(category);
     
-    if (it == m_by_category.end())
+    if (!labs_found)
     {
         *exists = false;
         return false;
@@ -1142,7 +3022,7 @@ bool util::locator::is_full_category(uint32_t category, bool *exists) const
     
     *exists = true;
     
-    const util::types::entries_t& labs = it->second;
+    const util::types::entries_t& labs = *labs_found;
     
     uint32_t n_labs = labs.tail();
     uint32_t* labs_ptr = labs.unsafe_get_pointer();
@@ -1151,12 +3031,19 @@ bool util::locator::is_full_category(uint32_t category, bool *exists) const
     
     for (uint32_t i = 0; i < n_labs; i++)
     {
-        sum += m_indices.at(labs_ptr[i]).sum();
+        sum += count(labs_ptr[i]);
     }
     
     return sum == c_size;
 }
 
+bool util::locator::is_coded_category(uint32_t category, bool *exists) const
+{
+    *exists = has_category(category);
+    
+    return find_codes(category) != nullptr;
+}
+
 uint32_t util::locator::swap_label(uint32_t from, uint32_t to)
 {
     if (!has_label(from))
@@ -1169,13 +3056,10 @@ uint32_t util::locator::swap_label(uint32_t from, uint32_t to)
         return locator_status::LABEL_EXISTS;
     }
     
-    //  update in category
-    uint32_t category = m_in_category.at(from);
-    m_in_category[to] = category;
-    m_in_category.erase(from);
+    uint32_t category = category_of(from);
     
     //  update by category
-    types::entries_t& by_cat = m_by_category.at(category);
+    types::entries_t& by_cat = labels_in(category);
     
     uint32_t idx_in_by_cat;
     util::unchecked_binary_search(by_cat.unsafe_get_pointer(), by_cat.tail(), from, &idx_in_by_cat);
@@ -1184,9 +3068,15 @@ uint32_t util::locator::swap_label(uint32_t from, uint32_t to)
     by_cat.push(to);
     by_cat.unchecked_sort(by_cat.tail());
     
-    //  update indices
-    m_indices[to] = std::move(m_indices.at(from));
-    m_indices.erase(from);
+    //  update codes; the label keeps its slot, and so its index
+    util::label_codes* codes = find_codes(category);
+    
+    if (codes)
+    {
+        codes->rename(from, to);
+    }
+    
+    m_label_slots.rename(from, to);
     
     //  update labels
     uint32_t idx_in_labs;
@@ -1210,18 +3100,8 @@ uint32_t util::locator::swap_category(uint32_t from, uint32_t to)
         return locator_status::CATEGORY_EXISTS;
     }
     
-    const types::entries_t& by_cat = m_by_category.at(from);
-    
-    uint32_t n_in_cat = by_cat.tail();
-    uint32_t* by_cat_ptr = by_cat.unsafe_get_pointer();
-    
-    for (uint32_t i = 0; i < n_in_cat; i++)
-    {
-        m_in_category[by_cat_ptr[i]] = to;
-    }
-    
-    m_by_category[to] = std::move(by_cat);
-    m_by_category.erase(from);
+    //  the category keeps its slot, and so its labels and codes
+    m_category_slots.rename(from, to);
     
     uint32_t idx_in_categories;
     util::unchecked_binary_search(m_categories.unsafe_get_pointer(), m_categories.tail(), from, &idx_in_categories);
@@ -1239,16 +3119,25 @@ uint32_t util::locator::swap_category(uint32_t from, uint32_t to)
 
 void util::locator::rm_label(uint32_t lab)
 {
-    size_t n_erased = m_indices.erase(lab);
+    uint32_t slot = m_label_slots.find(lab);
     
-    if (n_erased == 0)
+    if (slot == util::slot_table::NO_SLOT)
     {
         return;
     }
     
-    uint32_t cat = m_in_category[lab];
+    uint32_t cat_slot = m_label_categories[slot];
+    
+    if (m_category_storage[cat_slot] == util::category_storage::CODES)
+    {
+        m_category_codes[cat_slot].remove(lab);
+    }
+    else
+    {
+        m_label_indices[slot] = util::label_index();
+    }
     
-    util::types::entries_t& by_category = m_by_category[cat];
+    util::types::entries_t& by_category = m_category_labels[cat_slot];
     uint32_t* by_category_ptr = by_category.unsafe_get_pointer();
     
     uint32_t idx_in_by_category;
@@ -1257,11 +3146,237 @@ void util::locator::rm_label(uint32_t lab)
     
     by_category.erase(idx_in_by_category);
     m_labels.erase(find_label(lab));
-    m_in_category.erase(lab);
+    m_label_slots.erase(lab);
     
     m_n_labels--;
 }
 
+//  insert_label: Slot of `label`, given one in `category`, which must
+//      exist. The index of a new slot is empty.
+
+uint32_t util::locator::insert_label(uint32_t label, uint32_t category)
+{
+    bool was_inserted;
+    uint32_t slot = m_label_slots.insert(label, &was_inserted);
+    
+    if (slot == m_label_categories.size())
+    {
+        m_label_categories.push_back(0u);
+        m_label_indices.emplace_back();
+    }
+    
+    m_label_categories[slot] = m_category_slots.find(category);
+    
+    return slot;
+}
+
+uint32_t util::locator::insert_category(uint32_t category, uint32_t storage)
+{
+    bool was_inserted;
+    uint32_t slot = m_category_slots.insert(category, &was_inserted);
+    
+    if (slot == m_category_labels.size())
+    {
+        m_category_labels.emplace_back();
+        m_category_storage.push_back(util::category_storage::INDICES);
+        m_category_codes.emplace_back();
+    }
+    
+    m_category_labels[slot] = util::types::entries_t();
+    m_category_storage[slot] = storage;
+    
+    if (storage == util::category_storage::CODES)
+    {
+        m_category_codes[slot] = util::label_codes(size());
+    }
+    
+    return slot;
+}
+
+//  is_indexed: Whether the label at `label_slot` is held in a label index,
+//      rather than in its category's codes.
+
+bool util::locator::is_indexed(uint32_t label_slot) const
+{
+    if (!m_label_slots.is_used(label_slot))
+    {
+        return false;
+    }
+    
+    return m_category_storage[m_label_categories[label_slot]] == util::category_storage::INDICES;
+}
+
+uint32_t util::locator::category_of(uint32_t label) const
+{
+    return m_category_slots.key_of(m_label_categories[m_label_slots.find(label)]);
+}
+
+//  find_labels: Labels of `category`, or null if it does not exist.
+
+const util::types::entries_t* util::locator::find_labels(uint32_t category) const
+{
+    uint32_t slot = m_category_slots.find(category);
+    
+    return slot == util::slot_table::NO_SLOT ? nullptr : &m_category_labels[slot];
+}
+
+util::types::entries_t& util::locator::labels_in(uint32_t category)
+{
+    return m_category_labels[m_category_slots.find(category)];
+}
+
+const util::label_index& util::locator::get_index(uint32_t label) const
+{
+    return m_label_indices[m_label_slots.find(label)];
+}
+
+const util::label_index& util::locator::get_index(uint32_t label, util::label_index& built) const
+{
+    uint32_t slot = m_label_slots.find(label);
+    uint32_t cat_slot = m_label_categories[slot];
+    
+    if (m_category_storage[cat_slot] == util::category_storage::CODES)
+    {
+        built = m_category_codes[cat_slot].index(label, m_index_policy);
+        return built;
+    }
+    
+    return m_label_indices[slot];
+}
+
+//  label_matches: Whether `label`, which must exist in both, has the same
+//      rows here and in `other`. A coded label is checked against the codes
+//      of its category; an index is built only if it is coded in both.
+
+bool util::locator::label_matches(uint32_t label, const util::locator& other) const
+{
+    const util::label_codes* codes = find_label_codes(label);
+    const util::label_codes* other_codes = other.find_label_codes(label);
+    
+    if (codes)
+    {
+        util::label_index built;
+        
+        return codes->matches(label, other.get_index(label, built));
+    }
+    
+    if (other_codes)
+    {
+        return other_codes->matches(label, get_index(label));
+    }
+    
+    return get_index(label) == other.get_index(label);
+}
+
+util::label_index& util::locator::index_of(uint32_t label)
+{
+    return m_label_indices[m_label_slots.find(label)];
+}
+
+//  find_codes: Codes of `category`, or null if the category does not exist
+//      or has label indices.
+
+const util::label_codes* util::locator::find_codes(uint32_t category) const
+{
+    uint32_t slot = m_category_slots.find(category);
+    
+    if (slot == util::slot_table::NO_SLOT || m_category_storage[slot] != util::category_storage::CODES)
+    {
+        return nullptr;
+    }
+    
+    return &m_category_codes[slot];
+}
+
+util::label_codes* util::locator::find_codes(uint32_t category)
+{
+    const util::locator* self = this;
+    
+    return const_cast<util::label_codes*>(self->find_codes(category));
+}
+
+//  find_label_codes: Codes of the category of `label`, which must exist, or
+//      null if the category has label indices.
+
+const util::label_codes* util::locator::find_label_codes(uint32_t label) const
+{
+    uint32_t cat_slot = m_label_categories[m_label_slots.find(label)];
+    
+    if (m_category_storage[cat_slot] != util::category_storage::CODES)
+    {
+        return nullptr;
+    }
+    
+    return &m_category_codes[cat_slot];
+}
+
+void util::locator::resize_codes(uint32_t to_size)
+{
+    for (uint32_t i = 0; i < m_category_slots.n_slots(); i++)
+    {
+        if (m_category_storage[i] == util::category_storage::CODES)
+        {
+            m_category_codes[i].resize(to_size);
+        }
+    }
+}
+
+//  unchecked_set_storage: Move the labels of `category` to label indices,
+//      or to codes, as chosen by `storage`.
+
+void util::locator::unchecked_set_storage(uint32_t category, uint32_t storage)
+{
+    bool is_coded = find_codes(category) != nullptr;
+    bool as_codes = storage == util::category_storage::CODES;
+    
+    if (is_coded == as_codes)
+    {
+        return;
+    }
+    
+    uint32_t slot = m_category_slots.find(category);
+    const types::entries_t& labs = m_category_labels[slot];
+    util::label_codes& codes = m_category_codes[slot];
+    
+    if (as_codes)
+    {
+        codes = to_codes(category);
+        m_category_storage[slot] = util::category_storage::CODES;
+        
+        for (uint32_t i = 0; i < labs.tail(); i++)
+        {
+            index_of(labs.at(i)) = util::label_index();
+        }
+        
+        return;
+    }
+    
+    for (uint32_t i = 0; i < labs.tail(); i++)
+    {
+        index_of(labs.at(i)) = util::label_index(codes.to_bit_array(labs.at(i)));
+    }
+    
+    codes = util::label_codes();
+    m_category_storage[slot] = util::category_storage::INDICES;
+    
+    apply_index_policy(category);
+}
+
+//  to_codes: Labels of `category`, which has label indices, as codes.
+
+util::label_codes util::locator::to_codes(uint32_t category) const
+{
+    const types::entries_t& labs = *find_labels(category);
+    util::label_codes codes(size());
+    
+    for (uint32_t i = 0; i < labs.tail(); i++)
+    {
+        codes.unchecked_assign(labs.at(i), get_index(labs.at(i)).to_bit_array());
+    }
+    
+    return codes;
+}
+
 uint32_t util::locator::find_label(uint32_t label, bool *was_found) const
 {
     uint32_t idx;
@@ -1321,3 +3436,8 @@ uint32_t util::locator::get_random_label_id(const util::locator &a, const util::
     
     return util::get_random_id(func);
 }
+
+void util::locator::release_find_scratch()
+{
+    find_scratch = util::bit_array();
+}
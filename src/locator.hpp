@@ -9,9 +9,12 @@
 
 #include "dynamic_array.hpp"
 #include "bit_array.hpp"
+#include "label_index.hpp"
+#include "label_codes.hpp"
+#include "slot_table.hpp"
 #include <cstdint>
 #include <vector>
-#include <unordered_map>
+#include <deque>
 #include <functional>
 #include <random>
 
@@ -27,6 +30,22 @@ namespace util {
             entries_t combinations;
             arr_entries_t indices;
         };
+        
+        //  find_all_csr_t: Combination i has labels combinations[i*n + j] of
+        //      the n categories searched, and rows indices[offsets[i]] up to
+        //      indices[offsets[i+1]].
+        struct find_all_csr_t {
+            entries_t combinations;
+            entries_t offsets;
+            entries_t indices;
+        };
+        
+        //  count_all_return_t: Combination i has labels combinations[i*n + j]
+        //      of the n categories searched, and counts[i] rows.
+        struct count_all_return_t {
+            entries_t combinations;
+            entries_t counts;
+        };
     }
     
     struct locator_status {
@@ -47,6 +66,20 @@ namespace util {
     uint32_t get_random_id(std::function<bool(uint32_t)> exists_func);
 }
 
+//  locator: Rows labeled with at most one label per category; the rows of
+//      each label are held in a label_index, or, for a category added with
+//      category_storage::CODES, the rows of all its labels are held in a
+//      single label_codes.
+//
+//      Const methods do not modify the locator, so any number of threads
+//      may call them at once, provided no thread calls a non-const method
+//      at the same time. find() uses a scratch index per thread for this.
+//      It is sized to the locator last searched on that thread, and is
+//      kept, after that locator is destroyed, until the thread exits or
+//      calls release_find_scratch().
+//      Bulk operations in find() share util::thread_pool::shared(); a call
+//      that finds the pool busy with another thread's loop runs serially.
+
 class util::locator
 {
     
@@ -67,6 +100,11 @@ public:
     void unchecked_keep(const util::types::entries_t& at_indices, int32_t index_offset = 0);
     uint32_t keep(const util::types::entries_t& at_indices);
     
+    //  keep_mask: Keep the rows at which `mask` is true. Equivalent to
+    //      keep(find(mask)), without materializing the indices.
+    void unchecked_keep_mask(const util::bit_array& mask);
+    uint32_t keep_mask(const util::bit_array& mask);
+    
     types::find_all_return_t keep_each(const types::entries_t& categories,
                                         bool* exist, uint32_t index_offset = 0u);
     
@@ -75,6 +113,11 @@ public:
     void resize(uint32_t to_size);
     
     uint32_t add_category(uint32_t category);
+    //  add_category: Add `category`, with labels stored as `storage`, one
+    //      of `category_storage`. CODES suits categories with many labels
+    //      of few rows each: it costs one code per row, however many
+    //      labels the category has.
+    uint32_t add_category(uint32_t category, uint32_t storage);
     uint32_t set_category(uint32_t category, uint32_t label, const util::bit_array& index);
     uint32_t set_category(uint32_t category, const types::entries_t& labels, const util::bit_array& index);
     uint32_t rm_category(uint32_t category);
@@ -87,6 +130,7 @@ public:
     bool has_label(uint32_t label) const;
     bool has_category(uint32_t category) const;
     bool is_full_category(uint32_t category, bool* exists) const;
+    bool is_coded_category(uint32_t category, bool* exists) const;
     
     uint32_t swap_label(uint32_t from, uint32_t to);
     uint32_t swap_category(uint32_t from, uint32_t to);
@@ -102,31 +146,85 @@ public:
     
     uint32_t count(uint32_t label) const;
     
+    //  set_index_policy: Choose how label indices are stored; one of
+    //      `index_policy`. The default, BY_DENSITY, compresses sparse labels.
+    void set_index_policy(uint32_t policy);
+    uint32_t get_index_policy() const;
+    bool is_compressed_label(uint32_t label) const;
+    
     bool categories_match(const util::locator& other) const;
     bool labels_match(const util::locator& other) const;
     
     uint32_t append(const util::locator& other);
+    //  append: Append each of `others`, in order; each label index is
+    //      allocated and copied once.
+    uint32_t append(const std::vector<const util::locator*>& others);
     
-    types::numeric_indices_t find(const types::entries_t& labels, uint32_t index_offset = 0u);
+    //  find: Rows with at least one of `labels` in each category that
+    //      `labels` name. Intermediate results are built in a scratch index
+    //      kept per thread, or in `scratch` if given, which is resized as
+    //      needed.
+    types::numeric_indices_t find(const types::entries_t& labels, uint32_t index_offset = 0u) const;
+    types::numeric_indices_t find(const types::entries_t& labels, util::bit_array& scratch,
+                                  uint32_t index_offset = 0u) const;
     types::numeric_indices_t find(const uint32_t label, uint32_t index_offset = 0u) const;
     types::find_all_return_t find_all(const types::entries_t& categories,
                                       bool* exist, uint32_t index_offset = 0u) const;
+    //  find_all_csr: find_all, with the rows of all combinations in a single
+    //      array. Combinations are numbered in order of their first row.
+    types::find_all_csr_t find_all_csr(const types::entries_t& categories,
+                                       bool* exist, uint32_t index_offset = 0u) const;
+    //  count_all: The combinations of find_all, in the same order, with the
+    //      number of rows of each instead of the rows themselves.
+    types::count_all_return_t count_all(const types::entries_t& categories, bool* exist) const;
+    
+    //  has_combination: Whether find(labels) has any row, without
+    //      materializing the matching rows: some row has at least one of
+    //      `labels` in each category that `labels` name.
+    bool has_combination(const types::entries_t& labels) const;
     
     uint32_t get_random_label_id() const;
     
     static uint32_t get_random_label_id(const locator& a, const locator& b);
     
+    //  release_find_scratch: Free the calling thread's scratch index of
+    //      find(); the next find() on the thread allocates it again.
+    static void release_find_scratch();
+    
     static constexpr uint32_t UNDEFINED_LABEL = ~(uint32_t(0));
 private:
+    //  relative cost, in streamed words, of testing one row of one label.
+    static constexpr uint64_t FIND_PROBE_COST = 4u;
+    //  relative costs, in streamed words, of the two find_all engines: the
+    //  passes made per label and combination when intersecting indices,
+    //  and the cost of coding one row of one category.
+    static constexpr uint64_t FIND_ALL_BITMAP_PASSES = 3u;
+    static constexpr uint64_t FIND_ALL_ROW_COST = 2u;
+    //  blocks of rows per pool thread when coding rows in parallel.
+    static constexpr uint32_t FIND_ALL_BLOCKS_PER_THREAD = 4u;
+    //  rows visited at a time by keep_each, so that the map from row to
+    //  combination is written and read a cache-sized block at a time.
+    static constexpr uint32_t KEEP_EACH_BLOCK_ROWS = 1u << 16;
+    
     types::entries_t m_labels;
     types::entries_t m_categories;
-    std::unordered_map<uint32_t, uint32_t> m_in_category;
-    std::unordered_map<uint32_t, types::entries_t> m_by_category;
-    std::unordered_map<uint32_t, util::bit_array> m_indices;
-    util::bit_array m_tmp_index;
+    //  slot of each label, and by slot, the slot of its category and its
+    //  rows. Labels of coded categories, and free slots, have empty indices.
+    util::slot_table m_label_slots;
+    std::vector<uint32_t> m_label_categories;
+    std::vector<util::label_index> m_label_indices;
+    //  slot of each category, and by slot, its sorted labels, its storage,
+    //  and its codes, which are empty unless it is coded.
+    util::slot_table m_category_slots;
+    std::vector<types::entries_t> m_category_labels;
+    std::vector<uint32_t> m_category_storage;
+    std::vector<util::label_codes> m_category_codes;
     uint32_t m_n_labels;
+    uint32_t m_index_policy;
     
     void prune();
+    void apply_index_policy();
+    void apply_index_policy(uint32_t category);
     
     uint32_t find_category(uint32_t category, bool* was_found) const;
     uint32_t find_category(uint32_t category) const;
@@ -137,6 +235,56 @@ private:
     
     void rm_label(uint32_t label);
     
-    void unchecked_add_category(uint32_t category);
-    void unchecked_set_category(uint32_t category, uint32_t label, bool is_present, bool create_tmp, const util::bit_array& index);
+    uint32_t insert_label(uint32_t label, uint32_t category);
+    uint32_t insert_category(uint32_t category, uint32_t storage);
+    bool is_indexed(uint32_t label_slot) const;
+    uint32_t category_of(uint32_t label) const;
+    const types::entries_t* find_labels(uint32_t category) const;
+    types::entries_t& labels_in(uint32_t category);
+    
+    //  get_index: Index of `label`, whose category must have label indices.
+    //      With `built`, the label may be coded, in which case its index is
+    //      built from the codes into `built`, and is not kept.
+    const util::label_index& get_index(uint32_t label) const;
+    const util::label_index& get_index(uint32_t label, util::label_index& built) const;
+    bool label_matches(uint32_t label, const util::locator& other) const;
+    util::label_index& index_of(uint32_t label);
+    const util::label_codes* find_codes(uint32_t category) const;
+    util::label_codes* find_codes(uint32_t category);
+    const util::label_codes* find_label_codes(uint32_t label) const;
+    void resize_codes(uint32_t to_size);
+    void unchecked_set_storage(uint32_t category, uint32_t storage);
+    util::label_codes to_codes(uint32_t category) const;
+    
+    types::find_all_csr_t group_rows(const types::entries_t& categories, bool* exist,
+                                     uint32_t index_offset, bool with_indices) const;
+    bool use_find_all_bitmaps(const std::vector<const types::entries_t*>& cat_labels) const;
+    types::find_all_csr_t find_all_bitmaps(const std::vector<const types::entries_t*>& cat_labels,
+                                           uint32_t index_offset, bool with_indices) const;
+    types::find_all_csr_t find_all_rows(const std::vector<const types::entries_t*>& cat_labels,
+                                        uint32_t index_offset, bool with_indices) const;
+    types::find_all_csr_t find_all_rows_parallel(const std::vector<const types::entries_t*>& cat_labels,
+                                                 uint64_t code_range, uint32_t index_offset,
+                                                 bool with_indices) const;
+    std::vector<uint32_t> code_digits(const types::entries_t& labs) const;
+    void add_digits(const types::entries_t& labs, const std::vector<uint32_t>& digits,
+                    uint64_t* codes_ptr, uint32_t start, uint32_t stop) const;
+    static types::find_all_return_t from_csr(types::find_all_csr_t&& csr);
+    static uint32_t number_codes(uint64_t* codes_ptr, uint32_t n_codes, uint64_t code_range,
+                                 std::vector<uint64_t>& number_code);
+    static void decode_combinations(const std::vector<const types::entries_t*>& cat_labels,
+                                    const std::vector<uint32_t>& stage_first_cat,
+                                    const std::vector<std::vector<uint64_t>>& stage_codes,
+                                    types::entries_t& combinations);
+    
+    void unchecked_add_category(uint32_t category, uint32_t storage = category_storage::INDICES);
+    void unchecked_set_category(uint32_t category, uint32_t label, bool is_present, const util::bit_array& index);
+    void unchecked_set_category(uint32_t category, const util::slot_table& ids, const types::entries_t& label_ids,
+                                const std::vector<bool>& is_present, const util::bit_array& index);
+    
+    bool plan_find(const types::entries_t& labels,
+                   std::vector<std::vector<const util::label_index*>>& groups,
+                   std::vector<uint64_t>& counts, std::deque<util::label_index>& built) const;
+    types::numeric_indices_t find_sparse(const std::vector<std::vector<const util::label_index*>>& groups,
+                                         uint32_t sparse_group, uint32_t index_offset) const;
 };
@@ -0,0 +1,204 @@
+//
+//  rank_select.cpp
+//  locator
+//
+
+#include "rank_select.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+constexpr uint32_t util::rank_select::BLOCK_WORDS;
+constexpr uint32_t util::rank_select::SUPERBLOCK_BLOCKS;
+constexpr uint32_t util::rank_select::SELECT_SAMPLE;
+
+util::rank_select::rank_select(const util::bit_array& array) : m_array(&array)
+{
+    m_sum = 0;
+    m_version = 0;
+    m_is_built = false;
+}
+
+uint32_t util::rank_select::size() const
+{
+    return m_array->size();
+}
+
+uint32_t util::rank_select::sum() const
+{
+    build();
+    
+    return m_sum;
+}
+
+size_t util::rank_select::bytes() const
+{
+    return sizeof(util::rank_select) +
+        m_superblocks.capacity() * sizeof(uint32_t) +
+        m_blocks.capacity() * sizeof(uint16_t) +
+        m_samples.capacity() * sizeof(uint32_t);
+}
+
+uint32_t util::rank_select::rank(uint32_t index) const
+{
+    if (index > m_array->size())
+    {
+        throw std::runtime_error("Index exceeds array dimensions.");
+    }
+    
+    return unchecked_rank(index);
+}
+
+uint32_t util::rank_select::unchecked_rank(uint32_t index) const
+{
+    build();
+    
+    if (index == m_array->m_size)
+    {
+        return m_sum;
+    }
+    
+    const uint64_t* data = m_array->m_data.unsafe_get_pointer();
+    
+    uint32_t word = index >> 6u;
+    uint32_t block = word / BLOCK_WORDS;
+    uint32_t bit = index & 63u;
+    
+    uint32_t result = block_rank(block);
+    
+    for (uint32_t i = block * BLOCK_WORDS; i < word; i++)
+    {
+        result += util::bit_kernels::popcount64(data[i]);
+    }
+    
+    if (bit != 0)
+    {
+        result += util::bit_kernels::popcount64(data[word] & ((uint64_t(1) << bit) - 1u));
+    }
+    
+    return result;
+}
+
+uint32_t util::rank_select::select(uint32_t k) const
+{
+    if (k >= sum())
+    {
+        throw std::runtime_error("Rank exceeds number of set bits.");
+    }
+    
+    return unchecked_select(k);
+}
+
+uint32_t util::rank_select::unchecked_select(uint32_t k) const
+{
+    build();
+    
+    uint32_t n_blocks = uint32_t(m_blocks.size());
+    uint32_t sample = k / SELECT_SAMPLE;
+    
+    //  the last block whose rank is <= k lies between this sample's block
+    //  and the next's
+    uint32_t lo = m_samples[sample];
+    uint32_t hi = sample + 1 < m_samples.size() ? m_samples[sample+1] : n_blocks - 1;
+    
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo + 1) / 2;
+        
+        if (block_rank(mid) <= k)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    
+    const uint64_t* data = m_array->m_data.unsafe_get_pointer();
+    uint32_t n_words = m_array->get_data_size(m_array->m_size);
+    uint32_t remaining = k - block_rank(lo);
+    uint32_t word = lo * BLOCK_WORDS;
+    uint64_t value = get_word(data, n_words, word);
+    uint32_t count = util::bit_kernels::popcount64(value);
+    
+    while (remaining >= count)
+    {
+        remaining -= count;
+        value = get_word(data, n_words, ++word);
+        count = util::bit_kernels::popcount64(value);
+    }
+    
+    for (uint32_t i = 0; i < remaining; i++)
+    {
+        value &= value - 1;
+    }
+    
+    return word * 64u + util::bit_kernels::ctz64(value);
+}
+
+void util::rank_select::build() const
+{
+    if (!m_is_built || m_version != m_array->m_version)
+    {
+        rebuild();
+    }
+}
+
+void util::rank_select::rebuild() const
+{
+    const uint64_t* data = m_array->m_data.unsafe_get_pointer();
+    uint32_t n_words = m_array->get_data_size(m_array->m_size);
+    uint32_t n_blocks = (n_words + BLOCK_WORDS - 1) / BLOCK_WORDS;
+    uint32_t n_superblocks = (n_blocks + SUPERBLOCK_BLOCKS - 1) / SUPERBLOCK_BLOCKS;
+    
+    m_superblocks.resize(n_superblocks);
+    m_blocks.resize(n_blocks);
+    m_samples.clear();
+    
+    uint32_t total = 0;
+    uint32_t superblock_total = 0;
+    uint64_t next_sample = 0;
+    
+    for (uint32_t i = 0; i < n_blocks; i++)
+    {
+        if (i % SUPERBLOCK_BLOCKS == 0)
+        {
+            m_superblocks[i / SUPERBLOCK_BLOCKS] = total;
+            superblock_total = total;
+        }
+        
+        m_blocks[i] = uint16_t(total - superblock_total);
+        
+        uint32_t first = i * BLOCK_WORDS;
+        uint32_t stop = std::min(first + BLOCK_WORDS, n_words);
+        
+        for (uint32_t j = first; j < stop; j++)
+        {
+            total += util::bit_kernels::popcount64(get_word(data, n_words, j));
+        }
+        
+        //  block i holds each sampled set bit with rank in [prior total, total)
+        while (next_sample < total)
+        {
+            m_samples.push_back(i);
+            next_sample += SELECT_SAMPLE;
+        }
+    }
+    
+    m_sum = total;
+    m_version = m_array->m_version;
+    m_is_built = true;
+}
+
+uint32_t util::rank_select::block_rank(uint32_t block) const
+{
+    return m_superblocks[block / SUPERBLOCK_BLOCKS] + m_blocks[block];
+}
+
+//  get_word: Word `word` of the array, with bits past the end of the array
+//      zeroed.
+
+uint64_t util::rank_select::get_word(const uint64_t* data, uint32_t n_words, uint32_t word) const
+{
+    return word + 1 == n_words ? m_array->get_final_bin_with_zeros() : data[word];
+}
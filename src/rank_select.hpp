@@ -0,0 +1,71 @@
+//
+//  rank_select.hpp
+//  locator
+//
+
+#pragma once
+
+#include "bit_array.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace util {
+    class rank_select;
+}
+
+//  rank_select: Rank / select directory over a bit_array.
+//
+//      The number of set bits before each superblock of 2^16 bits is stored
+//      in full, and before each block of 512 bits relative to its
+//      superblock, so that rank() reads two counts and at most 8 words.
+//      select() starts from the block holding every SELECT_SAMPLE-th set
+//      bit and binary-searches the blocks up to the next sample.
+//
+//      The directory refers to, but does not own, the array. It is rebuilt
+//      on the first query after the array is modified; writes made through
+//      bit_array::iterator are not detected. Queries are const, but a query
+//      that rebuilds the directory writes to it: call build() first before
+//      sharing a directory between threads.
+
+class util::rank_select
+{
+public:
+    explicit rank_select(const util::bit_array& array);
+    
+    uint32_t size() const;
+    uint32_t sum() const;
+    
+    //  rank: Number of set bits at indices [0, index); `index` may equal
+    //      size().
+    uint32_t rank(uint32_t index) const;
+    uint32_t unchecked_rank(uint32_t index) const;
+    
+    //  select: Index of the set bit with rank `k`, i.e., of the (k+1)-th set
+    //      bit; `k` must be less than sum().
+    uint32_t select(uint32_t k) const;
+    uint32_t unchecked_select(uint32_t k) const;
+    
+    //  build: Rebuild the directory if the array has been modified since it
+    //      was last built.
+    void build() const;
+    
+    //  bytes: Approximate heap + object size.
+    size_t bytes() const;
+    
+    static constexpr uint32_t BLOCK_WORDS = 8u;
+    static constexpr uint32_t SUPERBLOCK_BLOCKS = 128u;
+    static constexpr uint32_t SELECT_SAMPLE = 8192u;
+private:
+    const util::bit_array* m_array;
+    
+    mutable std::vector<uint32_t> m_superblocks;
+    mutable std::vector<uint16_t> m_blocks;
+    mutable std::vector<uint32_t> m_samples;
+    mutable uint32_t m_sum;
+    mutable uint32_t m_version;
+    mutable bool m_is_built;
+    
+    void rebuild() const;
+    uint32_t block_rank(uint32_t block) const;
+    uint64_t get_word(const uint64_t* data, uint32_t n_words, uint32_t word) const;
+};
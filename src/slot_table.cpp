@@ -0,0 +1,217 @@
+//
+//  slot_table.cpp
+//  locator
+//
+
+#include "slot_table.hpp"
+#include <algorithm>
+
+constexpr uint32_t util::slot_table::NO_SLOT;
+constexpr uint32_t util::slot_table::MIN_BUCKETS;
+
+util::slot_table::slot_table()
+{
+    m_shift = 32;
+    m_size = 0;
+}
+
+uint32_t util::slot_table::size() const
+{
+    return m_size;
+}
+
+uint32_t util::slot_table::n_slots() const
+{
+    return uint32_t(m_keys.size());
+}
+
+size_t util::slot_table::bytes() const
+{
+    return sizeof(*this) +
+        m_buckets.capacity() * sizeof(bucket) +
+        (m_keys.capacity() + m_free.capacity()) * sizeof(uint32_t) +
+        m_is_used.capacity() / 8;
+}
+
+uint32_t util::slot_table::find(uint32_t key) const
+{
+    if (m_size == 0)
+    {
+        return NO_SLOT;
+    }
+    
+    return m_buckets[find_bucket(key)].slot;
+}
+
+bool util::slot_table::is_used(uint32_t slot) const
+{
+    return m_is_used[slot];
+}
+
+uint32_t util::slot_table::key_of(uint32_t slot) const
+{
+    return m_keys[slot];
+}
+
+uint32_t util::slot_table::insert(uint32_t key, bool* was_inserted)
+{
+    //  at most half of the buckets are full
+    if (2 * (uint64_t(m_size) + 1) > m_buckets.size())
+    {
+        rehash(std::max(MIN_BUCKETS, uint32_t(m_buckets.size()) * 2));
+    }
+    
+    bucket& b = m_buckets[find_bucket(key)];
+    
+    if (b.slot != NO_SLOT)
+    {
+        *was_inserted = false;
+        return b.slot;
+    }
+    
+    uint32_t slot;
+    
+    if (!m_free.empty())
+    {
+        slot = m_free.back();
+        m_free.pop_back();
+        m_keys[slot] = key;
+        m_is_used[slot] = true;
+    }
+    else
+    {
+        slot = uint32_t(m_keys.size());
+        m_keys.push_back(key);
+        m_is_used.push_back(true);
+    }
+    
+    b.key = key;
+    b.slot = slot;
+    m_size++;
+    
+    *was_inserted = true;
+    
+    return slot;
+}
+
+uint32_t util::slot_table::erase(uint32_t key)
+{
+    if (m_size == 0)
+    {
+        return NO_SLOT;
+    }
+    
+    uint32_t mask = uint32_t(m_buckets.size()) - 1;
+    uint32_t i = find_bucket(key);
+    uint32_t slot = m_buckets[i].slot;
+    
+    if (slot == NO_SLOT)
+    {
+        return NO_SLOT;
+    }
+    
+    //  shift back each later bucket of the run that may occupy bucket i,
+    //  i.e., whose home is not in (i, j]
+    uint32_t j = (i + 1) & mask;
+    
+    while (m_buckets[j].slot != NO_SLOT)
+    {
+        uint32_t h = home(m_buckets[j].key);
+        
+        if (((j - h) & mask) >= ((j - i) & mask))
+        {
+            m_buckets[i] = m_buckets[j];
+            i = j;
+        }
+        
+        j = (j + 1) & mask;
+    }
+    
+    m_buckets[i].slot = NO_SLOT;
+    
+    m_is_used[slot] = false;
+    m_free.push_back(slot);
+    m_size--;
+    
+    return slot;
+}
+
+void util::slot_table::rename(uint32_t from, uint32_t to)
+{
+    uint32_t slot = erase(from);
+    
+    if (slot == NO_SLOT)
+    {
+        return;
+    }
+    
+    //  the freed slot is the first reused
+    bool was_inserted;
+    insert(to, &was_inserted);
+}
+
+void util::slot_table::reserve(uint32_t n_keys)
+{
+    uint32_t n_buckets = MIN_BUCKETS;
+    
+    while (n_buckets < 2 * uint64_t(n_keys))
+    {
+        n_buckets *= 2;
+    }
+    
+    if (n_buckets > m_buckets.size())
+    {
+        rehash(n_buckets);
+    }
+    
+    m_keys.reserve(n_keys);
+}
+
+void util::slot_table::clear()
+{
+    *this = util::slot_table();
+}
+
+//  home: Bucket of `key` before probing. Fibonacci hashing: the top bits
+//      of the product depend on every bit of `key` below them.
+
+uint32_t util::slot_table::home(uint32_t key) const
+{
+    return uint32_t(key * 0x9e3779b9u) >> m_shift;
+}
+
+//  find_bucket: Bucket holding `key`, or the empty bucket ending its run.
+
+uint32_t util::slot_table::find_bucket(uint32_t key) const
+{
+    uint32_t mask = uint32_t(m_buckets.size()) - 1;
+    uint32_t i = home(key);
+    
+    while (m_buckets[i].slot != NO_SLOT && m_buckets[i].key != key)
+    {
+        i = (i + 1) & mask;
+    }
+    
+    return i;
+}
+
+void util::slot_table::rehash(uint32_t n_buckets)
+{
+    std::vector<bucket> old = std::move(m_buckets);
+    
+    m_buckets = std::vector<bucket>(n_buckets, bucket{ 0u, NO_SLOT });
+    m_shift = 32;
+    
+    for (uint32_t n = n_buckets; n > 1; n /= 2)
+    {
+        m_shift--;
+    }
+    
+    for (const bucket& b : old)
+    {
+        if (b.slot != NO_SLOT)
+        {
+            m_buckets[find_bucket(b.key)] = b;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+//
+//  slot_table.hpp
+//  locator
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace util {
+    class slot_table;
+}
+
+//  slot_table: Map from 32-bit ids to dense slots, 0 up to n_slots(), so
+//      that data about each id can be held in plain arrays indexed by slot.
+//
+//      Ids are hashed into a single flat array of (id, slot) pairs, probed
+//      linearly and kept at most half full; erasing shifts later pairs back
+//      rather than leaving tombstones. The slot of an erased id is reused
+//      by the next id inserted, so n_slots() grows only with the largest
+//      number of ids held at once.
+
+class util::slot_table
+{
+public:
+    slot_table();
+    
+    uint32_t size() const;
+    //  n_slots: Number of slots given out so far, used or free.
+    uint32_t n_slots() const;
+    //  bytes: Approximate heap + object size.
+    size_t bytes() const;
+    
+    //  find: Slot of `key`, or NO_SLOT.
+    uint32_t find(uint32_t key) const;
+    bool is_used(uint32_t slot) const;
+    uint32_t key_of(uint32_t slot) const;
+    
+    //  insert: Slot of `key`, which is given a slot if it has none.
+    uint32_t insert(uint32_t key, bool* was_inserted);
+    //  erase: Free the slot of `key`, and return it; NO_SLOT if `key` does
+    //      not exist.
+    uint32_t erase(uint32_t key);
+    //  rename: Give the slot of `from` to `to`, which must not exist.
+    void rename(uint32_t from, uint32_t to);
+    void reserve(uint32_t n_keys);
+    void clear();
+    
+    static constexpr uint32_t NO_SLOT = ~uint32_t(0);
+    static constexpr uint32_t MIN_BUCKETS = 16u;
+private:
+    //  an empty bucket has slot NO_SLOT
+    struct bucket
+    {
+        uint32_t key;
+        uint32_t slot;
+    };
+    
+    std::vector<bucket> m_buckets;
+    uint32_t m_shift;
+    uint32_t m_size;
+    
+    std::vector<uint32_t> m_keys;
+    std::vector<bool> m_is_used;
+    std::vector<uint32_t> m_free;
+    
+    uint32_t home(uint32_t key) const;
+    uint32_t find_bucket(uint32_t key) const;
+    void rehash(uint32_t n_buckets);
+};
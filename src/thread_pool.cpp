@@ -0,0 +1,247 @@
+//
+//  thread_pool.cpp
+//  locator
+//
+
+#include "thread_pool.hpp"
+#include <memory>
+#include <algorithm>
+
+namespace {
+    //  whether the current thread is executing a pool task
+    thread_local bool in_task = false;
+    
+    //  the shared pool is read without the lock once created; the lock
+    //  serializes its creation and replacement
+    std::mutex shared_mutex;
+    std::unique_ptr<util::thread_pool> shared_pool;
+    std::atomic<util::thread_pool*> shared_pool_ptr(nullptr);
+    
+    //  marks the current thread as executing a pool task for its lifetime,
+    //  restoring the previous state however it ends
+    class task_scope
+    {
+    public:
+        task_scope() : m_was_in_task(in_task)
+        {
+            in_task = true;
+        }
+        
+        ~task_scope()
+        {
+            in_task = m_was_in_task;
+        }
+    private:
+        bool m_was_in_task;
+    };
+}
+
+constexpr uint32_t util::thread_pool::DEFAULT_PARALLEL_THRESHOLD;
+
+std::atomic<uint32_t> util::thread_pool::parallel_threshold(util::thread_pool::DEFAULT_PARALLEL_THRESHOLD);
+
+util::thread_pool::thread_pool(uint32_t n_threads)
+{
+    m_task = nullptr;
+    m_n_tasks = 0;
+    m_next = 0;
+    m_generation = 0;
+    m_n_busy = 0;
+    m_stop = false;
+    
+    //  the caller of run() is the remaining thread
+    for (uint32_t i = 1; i < n_threads; i++)
+    {
+        m_workers.emplace_back(&util::thread_pool::worker, this);
+    }
+}
+
+util::thread_pool::~thread_pool() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    
+    m_wake.notify_all();
+    
+    for (auto& thread : m_workers)
+    {
+        thread.join();
+    }
+}
+
+uint32_t util::thread_pool::size() const
+{
+    return uint32_t(m_workers.size()) + 1u;
+}
+
+void util::thread_pool::run(uint32_t n_tasks, const std::function<void(uint32_t)>& task)
+{
+    if (n_tasks == 0)
+    {
+        return;
+    }
+    
+    std::unique_lock<std::mutex> run_lock(m_run_mutex, std::defer_lock);
+    
+    //  run on the caller from inside a task, or while another thread's loop
+    //  holds the workers rather than wait for it
+    if (m_workers.empty() || n_tasks == 1 || in_task || !run_lock.try_lock())
+    {
+        for (uint32_t i = 0; i < n_tasks; i++)
+        {
+            task(i);
+        }
+        
+        return;
+    }
+    
+    std::unique_lock<std::mutex> lock(m_mutex);
+    
+    //  a worker that woke late for the previous loop may still hold it
+    m_done.wait(lock, [this] () -> bool { return m_n_busy == 0; });
+    
+    m_task = &task;
+    m_n_tasks = n_tasks;
+    m_next = 0;
+    m_generation++;
+    
+    lock.unlock();
+    m_wake.notify_all();
+    
+    work(task, n_tasks);
+    
+    //  every task has been claimed; wait for those still running
+    lock.lock();
+    m_done.wait(lock, [this] () -> bool { return m_n_busy == 0; });
+    
+    m_task = nullptr;
+    
+    std::exception_ptr error = m_error;
+    m_error = nullptr;
+    
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+//  worker: Wait for a loop, help execute it, repeat.
+
+void util::thread_pool::worker()
+{
+    uint64_t seen_generation = 0;
+    
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        
+        m_wake.wait(lock, [this, &seen_generation] () -> bool {
+            return m_stop || m_generation != seen_generation;
+        });
+        
+        if (m_stop)
+        {
+            return;
+        }
+        
+        seen_generation = m_generation;
+        
+        if (m_task == nullptr)
+        {
+            continue;
+        }
+        
+        const std::function<void(uint32_t)>& task = *m_task;
+        uint32_t n_tasks = m_n_tasks;
+        
+        m_n_busy++;
+        lock.unlock();
+        
+        work(task, n_tasks);
+        
+        lock.lock();
+        
+        if (--m_n_busy == 0)
+        {
+            m_done.notify_all();
+        }
+    }
+}
+
+//  work: Claim and execute tasks until none remain. An exception thrown by
+//      a task is kept for run() to rethrow, and the tasks not yet claimed
+//      are skipped.
+
+void util::thread_pool::work(const std::function<void(uint32_t)>& task, uint32_t n_tasks)
+{
+    task_scope scope;
+    
+    uint32_t i = m_next.fetch_add(1u);
+    
+    while (i < n_tasks)
+    {
+        try
+        {
+            task(i);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            
+            if (!m_error)
+            {
+                m_error = std::current_exception();
+            }
+            
+            m_next = n_tasks;
+            
+            return;
+        }
+        
+        i = m_next.fetch_add(1u);
+    }
+}
+
+util::thread_pool& util::thread_pool::shared()
+{
+    util::thread_pool* pool = shared_pool_ptr.load(std::memory_order_acquire);
+    
+    if (pool)
+    {
+        return *pool;
+    }
+    
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    
+    if (!shared_pool)
+    {
+        uint32_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+        shared_pool.reset(new util::thread_pool(n_threads));
+        shared_pool_ptr.store(shared_pool.get(), std::memory_order_release);
+    }
+    
+    return *shared_pool;
+}
+
+void util::thread_pool::set_shared_size(uint32_t n_threads)
+{
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    
+    //  the previous pool is destroyed once the new one is published
+    std::unique_ptr<util::thread_pool> pool(new util::thread_pool(std::max(1u, n_threads)));
+    
+    shared_pool_ptr.store(pool.get(), std::memory_order_release);
+    shared_pool.swap(pool);
+}
+
+uint32_t util::thread_pool::get_parallel_threshold()
+{
+    return parallel_threshold.load();
+}
+
+void util::thread_pool::set_parallel_threshold(uint32_t n_elements)
+{
+    parallel_threshold = n_elements;
+}
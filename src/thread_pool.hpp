@@ -0,0 +1,81 @@
+//
+//  thread_pool.hpp
+//  locator
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+namespace util {
+    class thread_pool;
+}
+
+//  thread_pool: Fixed set of worker threads for data-parallel loops.
+//
+//      One loop runs on the workers at a time; a call to run() made while
+//      another thread's loop is running executes serially on its caller.
+
+class util::thread_pool
+{
+public:
+    explicit thread_pool(uint32_t n_threads);
+    ~thread_pool() noexcept;
+    
+    thread_pool(const thread_pool& other) = delete;
+    thread_pool& operator=(const thread_pool& other) = delete;
+    
+    //  size: Number of threads that execute tasks, counting the caller of
+    //      run().
+    uint32_t size() const;
+    
+    //  run: Call `task(i)` for each i in [0, n_tasks), and return once every
+    //      call has completed. The calling thread executes tasks as well.
+    //      Calls made from inside a task, or while another thread's loop is
+    //      running, run serially on the caller. If a task throws, tasks not
+    //      yet started are skipped, and the first exception is rethrown once
+    //      those running have completed.
+    void run(uint32_t n_tasks, const std::function<void(uint32_t)>& task);
+    
+    //  shared: Pool used by the parallel_ operations of bit_array. It is
+    //      sized to the hardware concurrency on first use.
+    static util::thread_pool& shared();
+    //  set_shared_size: Replace the shared pool. Must not be called while
+    //      the shared pool is running a loop.
+    static void set_shared_size(uint32_t n_threads);
+    
+    //  parallel_threshold: Arrays with fewer elements than this are
+    //      processed serially by the parallel_ operations.
+    static uint32_t get_parallel_threshold();
+    static void set_parallel_threshold(uint32_t n_elements);
+    
+    static constexpr uint32_t DEFAULT_PARALLEL_THRESHOLD = 1u << 20;
+private:
+    std::vector<std::thread> m_workers;
+    
+    std::mutex m_run_mutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    
+    const std::function<void(uint32_t)>* m_task;
+    uint32_t m_n_tasks;
+    std::atomic<uint32_t> m_next;
+    uint64_t m_generation;
+    uint32_t m_n_busy;
+    bool m_stop;
+    //  first exception thrown by a task of the current loop
+    std::exception_ptr m_error;
+    
+    void worker();
+    void work(const std::function<void(uint32_t)>& task, uint32_t n_tasks);
+    
+    static std::atomic<uint32_t> parallel_threshold;
+};
@@ -1,10 +1,15 @@
 #include "bit_array.hpp"
+#include "bit_kernels.hpp"
+#include "thread_pool.hpp"
+#include "rank_select.hpp"
+#include "bit_matrix.hpp"
 #include <iostream>
 #include <assert.h>
 #include <chrono>
 #include <cmath>
 #include <vector>
 #include <thread>
+#include <atomic>
 #include "utilities.hpp"
 
 void test_iterator();
@@ -33,11 +38,37 @@ void test_any_all();
 void test_assign_true();
 double test_profile_append(uint32_t sz);
 double test_profile_resize(uint32_t sz);
+void test_dot_kernels();
+void test_count_kernels();
+void test_find_extract();
+void test_and_or_many();
+void test_compress();
+void test_concat();
+void test_set_bit_iterators();
+void test_word_sizes();
+void test_parallel();
+void test_intersects();
+void test_occupied_spans();
+void test_rank_select();
+void test_bit_matrix();
 
 int main(int argc, char* argv[])
 {
     std::cout << "BEGIN BIT_ARRAY" << std::endl;
     test_iterator();
+    test_dot_kernels();
+    test_count_kernels();
+    test_find_extract();
+    test_and_or_many();
+    test_compress();
+    test_concat();
+    test_set_bit_iterators();
+    test_word_sizes();
+    test_parallel();
+    test_intersects();
+    test_occupied_spans();
+    test_rank_select();
+    test_bit_matrix();
     test_resize();
     test_append_one();
     test_any_all();
@@ -90,6 +121,1148 @@ double test_profile_resize(uint32_t sz = 1e3)
     return profile::ellapsed_time_s(t1, t2);
 }
 
+void test_dot_kernels()
+{
+    using namespace util;
+    
+    const bit_kernels::table_t& scalar = bit_kernels::get(simd_level::SCALAR);
+    
+    for (uint32_t level = 0; level < simd_level::N_LEVELS; level++)
+    {
+        if (!bit_kernels::is_supported(level))
+        {
+            continue;
+        }
+        
+        const bit_kernels::table_t& kernels = bit_kernels::get(level);
+        
+        bit_kernels::binary_op_t ops[4] = {
+            kernels.dot_or, kernels.dot_and, kernels.dot_and_not, kernels.dot_eq
+        };
+        bit_kernels::binary_op_t scalar_ops[4] = {
+            scalar.dot_or, scalar.dot_and, scalar.dot_and_not, scalar.dot_eq
+        };
+        
+        for (uint32_t n_words = 0; n_words < 67; n_words++)
+        {
+            std::vector<uint64_t> a(n_words);
+            std::vector<uint64_t> b(n_words);
+            std::vector<uint64_t> expect(n_words + 1, 0u);
+            std::vector<uint64_t> out(n_words + 1, 0u);
+            
+            for (uint32_t i = 0; i < n_words; i++)
+            {
+                a[i] = (uint64_t(rand()) << 32) | uint64_t(rand());
+                b[i] = (uint64_t(rand()) << 32) | uint64_t(rand());
+            }
+            
+            for (uint32_t j = 0; j < 4; j++)
+            {
+                scalar_ops[j](expect.data(), a.data(), b.data(), n_words);
+                ops[j](out.data(), a.data(), b.data(), n_words);
+                
+                for (uint32_t i = 0; i < n_words + 1; i++)
+                {
+                    assert(out[i] == expect[i]);
+                }
+            }
+        }
+    }
+    
+    //  unaligned bit ranges through bit_array
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        uint32_t sz = 1 + rand() % 2000;
+        uint32_t start = rand() % sz;
+        uint32_t stop = start + rand() % (sz - start + 1);
+        
+        bit_array a(sz, false);
+        bit_array b(sz, false);
+        bit_array out(sz, true);
+        
+        for (uint32_t j = 0; j < sz / 3; j++)
+        {
+            a.place(true, rand() % sz);
+            b.place(true, rand() % sz);
+        }
+        
+        bit_array::unchecked_dot_and(out, a, b, start, stop);
+        
+        for (uint32_t j = start; j < stop; j++)
+        {
+            assert(out.at(j) == (a.at(j) && b.at(j)));
+        }
+        
+        //  words past the range are untouched, and allocation padding
+        //  written by whole-array kernels is not counted
+        uint32_t first_untouched = stop == start ? sz : ((stop - 1) / 64 + 1) * 64;
+        
+        for (uint32_t j = first_untouched; j < sz; j++)
+        {
+            assert(out.at(j));
+        }
+        
+        uint32_t n_eq = 0;
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            n_eq += a.at(j) == b.at(j);
+        }
+        
+        bit_array::unchecked_dot_eq(out, a, b, 0, sz);
+        
+        assert(out.sum() == n_eq);
+    }
+    
+    std::cout << "OK - test_dot_kernels() [" << bit_kernels::get().name << "]" << std::endl;
+}
+
+void test_count_kernels()
+{
+    using namespace util;
+    
+    for (uint32_t level = 0; level < simd_level::N_LEVELS; level++)
+    {
+        if (!bit_kernels::is_supported(level))
+        {
+            continue;
+        }
+        
+        const bit_kernels::table_t& kernels = bit_kernels::get(level);
+        
+        for (uint32_t n_words = 0; n_words < 300; n_words += 1 + rand() % 7)
+        {
+            std::vector<uint64_t> a(n_words);
+            std::vector<uint64_t> b(n_words);
+            
+            for (uint32_t i = 0; i < n_words; i++)
+            {
+                a[i] = (uint64_t(rand()) << 33) ^ (uint64_t(rand()) << 11) ^ uint64_t(rand());
+                b[i] = (uint64_t(rand()) << 33) ^ (uint64_t(rand()) << 11) ^ uint64_t(rand());
+            }
+            
+            uint64_t expect_count = 0;
+            uint64_t expect_and = 0;
+            uint64_t expect_and_not = 0;
+            
+            for (uint32_t i = 0; i < n_words; i++)
+            {
+                for (uint32_t j = 0; j < 64; j++)
+                {
+                    uint64_t bit = uint64_t(1) << j;
+                    expect_count += (a[i] & bit) ? 1 : 0;
+                    expect_and += (a[i] & b[i] & bit) ? 1 : 0;
+                    expect_and_not += (a[i] & ~b[i] & bit) ? 1 : 0;
+                }
+            }
+            
+            assert(kernels.popcount(a.data(), n_words) == expect_count);
+            assert(kernels.and_count(a.data(), b.data(), n_words) == expect_and);
+            assert(kernels.and_not_count(a.data(), b.data(), n_words) == expect_and_not);
+        }
+    }
+    
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        uint32_t sz = 1 + rand() % 5000;
+        uint32_t start = rand() % sz;
+        uint32_t stop = start + rand() % (sz - start + 1);
+        
+        bit_array a(sz, false);
+        bit_array b(sz, false);
+        
+        for (uint32_t j = 0; j < sz / 2; j++)
+        {
+            a.place(true, rand() % sz);
+            b.place(true, rand() % sz);
+        }
+        
+        uint32_t expect_and = 0;
+        uint32_t expect_and_not = 0;
+        uint32_t expect_sum = 0;
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            expect_sum += a.at(j);
+            
+            if (j >= start && j < stop)
+            {
+                expect_and += a.at(j) && b.at(j);
+                expect_and_not += a.at(j) && !b.at(j);
+            }
+        }
+        
+        assert(a.sum() == expect_sum);
+        assert(bit_array::unchecked_and_count(a, b, start, stop) == expect_and);
+        assert(bit_array::unchecked_and_not_count(a, b, start, stop) == expect_and_not);
+        
+        bit_array out(sz, false);
+        bit_array::dot_and(out, a, b);
+        
+        assert(bit_array::and_count(a, b) == out.sum());
+    }
+    
+    std::cout << "OK - test_count_kernels()" << std::endl;
+}
+
+void test_find_extract()
+{
+    using namespace util;
+    
+    //  extract kernels against a bit-by-bit reference, sparse to dense
+    for (uint32_t level = 0; level < simd_level::N_LEVELS; level++)
+    {
+        if (!bit_kernels::is_supported(level))
+        {
+            continue;
+        }
+        
+        const bit_kernels::table_t& kernels = bit_kernels::get(level);
+        
+        for (uint32_t i = 0; i < 200; i++)
+        {
+            uint32_t n_words = rand() % 40;
+            uint32_t density = rand() % 65;
+            uint32_t base = rand() % 1000;
+            
+            std::vector<uint64_t> a(n_words, 0u);
+            std::vector<uint32_t> expect;
+            
+            for (uint32_t j = 0; j < n_words * 64; j++)
+            {
+                if (uint32_t(rand() % 64) < density)
+                {
+                    a[j / 64] |= uint64_t(1) << (j % 64);
+                    expect.push_back(j + base);
+                }
+            }
+            
+            std::vector<uint32_t> out(expect.size() + bit_kernels::EXTRACT_SLACK);
+            uint32_t n_out = kernels.extract(out.data(), a.data(), n_words, base);
+            
+            assert(n_out == expect.size());
+            
+            for (uint32_t j = 0; j < n_out; j++)
+            {
+                assert(out[j] == expect[j]);
+            }
+        }
+    }
+    
+    //  find with missing, exact, small and large size hints
+    for (uint32_t i = 0; i < 500; i++)
+    {
+        uint32_t sz = rand() % 20000;
+        uint32_t density = rand() % 101;
+        uint32_t offset = rand() % 10;
+        
+        bit_array barray(sz, false);
+        std::vector<uint32_t> expect;
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            if (uint32_t(rand() % 100) < density)
+            {
+                barray.place(true, j);
+                expect.push_back(j + offset);
+            }
+        }
+        
+        uint32_t n_expect = uint32_t(expect.size());
+        uint32_t hints[4] = { 0, n_expect, n_expect / 3 + 1, sz + 100 };
+        
+        for (uint32_t j = 0; j < 4; j++)
+        {
+            dynamic_array<uint32_t> inds = bit_array::find(barray, offset, hints[j]);
+            
+            assert(inds.size() == n_expect && inds.tail() == n_expect);
+            
+            for (uint32_t k = 0; k < n_expect; k++)
+            {
+                assert(inds.at(k) == expect[k]);
+            }
+        }
+    }
+    
+    //  bits beyond the size are ignored
+    bit_array barray(130, true);
+    barray.resize(70);
+    barray.resize(65);
+    
+    assert(bit_array::find(barray).size() == 65);
+    
+    std::cout << "OK - test_find_extract()" << std::endl;
+}
+
+void test_compress()
+{
+    using namespace util;
+    
+    //  compress kernels against a bit-by-bit reference, in and out of place
+    for (uint32_t level = 0; level < simd_level::N_LEVELS; level++)
+    {
+        if (!bit_kernels::is_supported(level))
+        {
+            continue;
+        }
+        
+        const bit_kernels::table_t& kernels = bit_kernels::get(level);
+        
+        for (uint32_t i = 0; i < 200; i++)
+        {
+            uint32_t n_words = rand() % 40;
+            
+            std::vector<uint64_t> a(n_words, 0u);
+            std::vector<uint64_t> mask(n_words, 0u);
+            std::vector<bool> expect;
+            
+            for (uint32_t j = 0; j < n_words; j++)
+            {
+                uint32_t kind = rand() % 4;
+                
+                for (uint32_t k = 0; k < 64; k++)
+                {
+                    bool in_mask = kind == 0 ? false : kind == 1 ? true : rand() % (kind * 2) == 0;
+                    bool value = rand() % 2 == 0;
+                    
+                    if (in_mask)
+                    {
+                        mask[j] |= uint64_t(1) << k;
+                        expect.push_back(value);
+                    }
+                    
+                    if (value)
+                    {
+                        a[j] |= uint64_t(1) << k;
+                    }
+                }
+            }
+            
+            std::vector<uint64_t> out(n_words, 0u);
+            uint64_t n_out = kernels.compress(out.data(), a.data(), mask.data(), n_words);
+            uint64_t n_in_place = kernels.compress(a.data(), a.data(), mask.data(), n_words);
+            
+            assert(n_out == expect.size() && n_in_place == expect.size());
+            
+            for (uint32_t j = 0; j < n_out; j++)
+            {
+                bool value = (out[j / 64] >> (j % 64)) & 1u;
+                bool value_in_place = (a[j / 64] >> (j % 64)) & 1u;
+                
+                assert(value == expect[j] && value_in_place == expect[j]);
+            }
+        }
+    }
+    
+    //  compress against keep(find(mask))
+    for (uint32_t i = 0; i < 500; i++)
+    {
+        uint32_t sz = rand() % 20000;
+        uint32_t density = rand() % 101;
+        
+        bit_array barray(sz, false);
+        bit_array mask(sz, false);
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            barray.place(rand() % 2 == 0, j);
+            mask.place(uint32_t(rand() % 100) < density, j);
+        }
+        
+        bit_array expect = barray;
+        expect.keep(bit_array::find(mask));
+        
+        barray.compress(mask);
+        
+        assert(barray.size() == expect.size() && barray.size() == mask.sum());
+        assert(bit_array::find(barray).eq_contents(bit_array::find(expect)));
+    }
+    
+    //  bits of the mask beyond its size are ignored
+    bit_array mask(70, false);
+    mask.flip();
+    
+    bit_array barray(70, true);
+    barray.compress(mask);
+    
+    assert(barray.size() == 70 && barray.all());
+    
+    bool threw = false;
+    
+    try
+    {
+        barray.compress(bit_array(10, true));
+    }
+    catch (const std::runtime_error& e)
+    {
+        threw = true;
+    }
+    
+    assert(threw);
+    
+    std::cout << "OK - test_compress()" << std::endl;
+}
+
+void test_concat()
+{
+    using namespace util;
+    
+    //  funnel shift kernels against a scalar reference
+    for (uint32_t level = 0; level < simd_level::N_LEVELS; level++)
+    {
+        if (!bit_kernels::is_supported(level))
+        {
+            continue;
+        }
+        
+        const bit_kernels::table_t& kernels = bit_kernels::get(level);
+        
+        for (uint32_t i = 0; i < 200; i++)
+        {
+            uint32_t n_words = 1 + rand() % 40;
+            uint32_t shift = 1 + rand() % 63;
+            
+            std::vector<uint64_t> a(n_words);
+            
+            for (uint32_t j = 0; j < n_words; j++)
+            {
+                a[j] = (uint64_t(rand()) << 40) ^ (uint64_t(rand()) << 20) ^ uint64_t(rand());
+            }
+            
+            uint64_t first = uint64_t(rand()) & ((uint64_t(1) << shift) - 1u);
+            std::vector<uint64_t> out(n_words, 0u);
+            out[0] = first;
+            
+            uint64_t carry = kernels.funnel_shift(out.data(), a.data(), n_words, shift);
+            
+            assert(out[0] == (first | (a[0] << shift)));
+            assert(carry == a[n_words-1] >> (64 - shift));
+            
+            for (uint32_t j = 1; j < n_words; j++)
+            {
+                assert(out[j] == ((a[j] << shift) | (a[j-1] >> (64 - shift))));
+            }
+        }
+    }
+    
+    //  concat and append against element-wise copies
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        uint32_t n_arrays = rand() % 10;
+        
+        std::vector<bit_array> arrays;
+        std::vector<bool> expect;
+        
+        for (uint32_t j = 0; j < n_arrays; j++)
+        {
+            uint32_t sz = rand() % 3 == 0 ? rand() % 70 : rand() % 2000;
+            bit_array arr(sz, false);
+            
+            for (uint32_t k = 0; k < sz; k++)
+            {
+                bool value = rand() % 2 == 0;
+                arr.place(value, k);
+                expect.push_back(value);
+            }
+            
+            //  junk past the end of the final word
+            arr.resize(sz + 7);
+            arr.fill(true);
+            arr.resize(sz);
+            
+            for (uint32_t k = 0; k < sz; k++)
+            {
+                arr.place(expect[expect.size() - sz + k], k);
+            }
+            
+            arrays.push_back(arr);
+        }
+        
+        std::vector<const bit_array*> ptrs;
+        bit_array appended;
+        
+        for (const bit_array& arr : arrays)
+        {
+            ptrs.push_back(&arr);
+            appended.append(arr);
+        }
+        
+        bit_array result(5, true);
+        bit_array::concat(result, ptrs);
+        
+        assert(result.size() == expect.size() && appended.size() == expect.size());
+        
+        for (uint32_t j = 0; j < expect.size(); j++)
+        {
+            assert(result.at(j) == expect[j] && appended.at(j) == expect[j]);
+        }
+        
+        assert(result.sum() == appended.sum());
+    }
+    
+    //  append to self
+    bit_array barray(100, false);
+    barray.place(true, 3);
+    barray.place(true, 99);
+    barray.append(barray);
+    
+    assert(barray.size() == 200 && barray.sum() == 4);
+    assert(barray.at(3) && barray.at(99) && barray.at(103) && barray.at(199));
+    
+    std::cout << "OK - test_concat()" << std::endl;
+}
+
+void test_set_bit_iterators()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 500; i++)
+    {
+        uint32_t sz = rand() % 3 == 0 ? rand() % 130 : rand() % 5000;
+        uint32_t density = 1 + rand() % 50;
+        bit_array barray(sz + 11, true);
+        
+        //  junk past the end of the final word
+        barray.resize(sz);
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            barray.place(rand() % density == 0, j);
+        }
+        
+        dynamic_array<uint32_t> expect = bit_array::find(barray);
+        uint32_t n_expect = expect.tail();
+        
+        std::vector<uint32_t> visited;
+        
+        auto func = [&visited] (uint32_t idx) -> void {
+            visited.push_back(idx);
+        };
+        
+        bit_array::for_each_set_bit(barray, func);
+        
+        std::vector<uint32_t> iterated;
+        
+        for (uint32_t idx : barray.set_bits())
+        {
+            iterated.push_back(idx);
+        }
+        
+        assert(visited.size() == n_expect && iterated.size() == n_expect);
+        
+        for (uint32_t j = 0; j < n_expect; j++)
+        {
+            assert(visited[j] == expect.at(j) && iterated[j] == expect.at(j));
+        }
+        
+        uint32_t n_words = 0;
+        uint32_t word_sum = 0;
+        
+        for (auto it = barray.words().begin(); it != barray.words().end(); ++it)
+        {
+            assert(it.bin() == n_words);
+            
+            word_sum += bit_kernels::popcount64(*it);
+            n_words++;
+        }
+        
+        assert(n_words == (sz + 63) / 64);
+        assert(word_sum == n_expect);
+    }
+    
+    std::cout << "OK - test_set_bit_iterators()" << std::endl;
+}
+
+void test_word_sizes()
+{
+    using namespace util;
+    
+    typedef basic_bit_array<uint32_t> bit_array32;
+    
+    auto matches = [] (const bit_array32& a, const bit_array& b) -> bool {
+        if (a.size() != b.size() || a.sum() != b.sum() || a.any() != b.any() || a.all() != b.all())
+        {
+            return false;
+        }
+        
+        return bit_array32::find(a, 1u).eq_contents(bit_array::find(b, 1u));
+    };
+    
+    for (uint32_t i = 0; i < 300; i++)
+    {
+        uint32_t sz = rand() % 3 == 0 ? rand() % 100 : rand() % 5000;
+        uint32_t density = 1 + rand() % 4;
+        
+        bit_array32 a32(sz, false);
+        bit_array32 b32(sz, false);
+        bit_array a64(sz, false);
+        bit_array b64(sz, false);
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            bool a_value = rand() % density == 0;
+            bool b_value = rand() % 2 == 0;
+            
+            a32.place(a_value, j);
+            a64.place(a_value, j);
+            b32.place(b_value, j);
+            b64.place(b_value, j);
+        }
+        
+        assert(matches(a32, a64) && matches(b32, b64));
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            assert(a32.at(j) == a64.at(j));
+        }
+        
+        bit_array32 out32(sz, false);
+        bit_array out64(sz, false);
+        
+        bit_array32::dot_or(out32, a32, b32);
+        bit_array::dot_or(out64, a64, b64);
+        assert(matches(out32, out64));
+        
+        bit_array32::dot_and(out32, a32, b32);
+        bit_array::dot_and(out64, a64, b64);
+        assert(matches(out32, out64));
+        
+        bit_array32::unchecked_dot_eq(out32, a32, b32, 0, sz);
+        bit_array::unchecked_dot_eq(out64, a64, b64, 0, sz);
+        assert(matches(out32, out64));
+        
+        uint32_t start = sz == 0 ? 0 : rand() % sz;
+        uint32_t stop = start + (sz == start ? 0 : rand() % (sz - start));
+        
+        assert(bit_array32::unchecked_and_count(a32, b32, start, stop) ==
+               bit_array::unchecked_and_count(a64, b64, start, stop));
+        assert(bit_array32::unchecked_and_not_count(a32, b32, start, stop) ==
+               bit_array::unchecked_and_not_count(a64, b64, start, stop));
+        
+        //  append and concat, aligned or not
+        bit_array32 cat32;
+        bit_array cat64;
+        
+        bit_array32::concat(cat32, {&a32, &b32, &a32});
+        bit_array::concat(cat64, {&a64, &b64, &a64});
+        assert(matches(cat32, cat64));
+        
+        a32.append(b32);
+        a64.append(b64);
+        assert(matches(a32, a64));
+        
+        //  compress and keep
+        a32.compress(a32);
+        a64.compress(a64);
+        assert(matches(a32, a64) && a32.all() == (a32.size() > 0));
+        
+        b32.compress(bit_array32(b32.size(), true));
+        assert(matches(b32, b64));
+        
+        dynamic_array<uint32_t> at_indices = bit_array::find(b64);
+        
+        b32.keep(at_indices);
+        b64.keep(at_indices);
+        assert(matches(b32, b64));
+        
+        uint32_t to_size = rand() % 6000;
+        
+        b32.resize(to_size);
+        b64.resize(to_size);
+        assert(matches(b32, b64));
+    }
+    
+    std::cout << "OK - test_word_sizes()" << std::endl;
+}
+
+void test_parallel()
+{
+    using namespace util;
+    
+    thread_pool::set_shared_size(4);
+    thread_pool::set_parallel_threshold(1);
+    
+    //  every task runs once, including from nested loops
+    thread_pool& pool = thread_pool::shared();
+    std::vector<uint32_t> counts(1000, 0u);
+    
+    auto nested = [&counts] (uint32_t i) -> void {
+        counts[i]++;
+    };
+    
+    auto outer = [&pool, &nested] (uint32_t i) -> void {
+        pool.run(100, [&nested, i] (uint32_t j) -> void { nested(i * 100 + j); });
+    };
+    
+    pool.run(10, outer);
+    pool.run(1000, nested);
+    
+    for (uint32_t count : counts)
+    {
+        assert(count == 2);
+    }
+    
+    //  an exception thrown by a task, on the caller or a worker, is rethrown
+    //  by run() once the tasks running have completed; the pool remains
+    //  usable
+    for (uint32_t thrower : { 0u, 500u, 999u })
+    {
+        std::atomic<uint32_t> n_run(0);
+        bool caught = false;
+        
+        try
+        {
+            pool.run(1000, [&n_run, thrower] (uint32_t i) -> void {
+                n_run++;
+                
+                if (i == thrower)
+                {
+                    throw std::runtime_error("Task failed.");
+                }
+            });
+        }
+        catch (const std::runtime_error& e)
+        {
+            caught = true;
+        }
+        
+        assert(caught && n_run > 0 && n_run <= 1000);
+    }
+    
+    pool.run(10, outer);
+    
+    for (uint32_t count : counts)
+    {
+        assert(count == 3);
+    }
+    
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        uint32_t sz = rand() % 4 == 0 ? rand() % 200 : rand() % 200000;
+        uint32_t density = 1 + rand() % 100;
+        
+        bit_array a(sz + 7, true);
+        bit_array b(sz, false);
+        
+        //  junk past the end of the final word
+        a.resize(sz);
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            a.place(rand() % density == 0, j);
+            b.place(rand() % 2 == 0, j);
+        }
+        
+        assert(a.parallel_sum() == a.sum());
+        assert(bit_array::parallel_find(a, 3u).eq_contents(bit_array::find(a, 3u)));
+        
+        bit_array out(sz, false);
+        bit_array expect(sz, false);
+        
+        bit_array::parallel_dot_or(out, a, b);
+        bit_array::dot_or(expect, a, b);
+        assert(bit_array::find(out).eq_contents(bit_array::find(expect)));
+        
+        bit_array::parallel_dot_and(out, a, b);
+        bit_array::dot_and(expect, a, b);
+        assert(bit_array::find(out).eq_contents(bit_array::find(expect)));
+        
+        bit_array::parallel_dot_and_not(out, a, b);
+        bit_array::unchecked_dot_and_not(expect, a, b, 0, sz);
+        assert(bit_array::find(out).eq_contents(bit_array::find(expect)));
+        
+        bit_array::parallel_dot_eq(out, a, b);
+        bit_array::unchecked_dot_eq(expect, a, b, 0, sz);
+        assert(out.parallel_sum() == expect.sum());
+        
+        bit_array c = out;
+        std::vector<std::vector<const bit_array*>> groups = { {&a, &b}, {&b}, {&a, &c} };
+        
+        bit_array::parallel_and_of_or_many(out, groups);
+        bit_array::and_of_or_many(expect, groups);
+        assert(bit_array::parallel_find(out).eq_contents(bit_array::find(expect)));
+        
+        out.parallel_fill(true);
+        assert(out.all() || sz == 0);
+        
+        out.parallel_fill(false);
+        assert(!out.any());
+    }
+    
+    bool threw = false;
+    
+    try
+    {
+        bit_array out(10, false);
+        bit_array::parallel_dot_or(out, bit_array(10, false), bit_array(11, false));
+    }
+    catch (const std::runtime_error& e)
+    {
+        threw = true;
+    }
+    
+    assert(threw);
+    
+    thread_pool::set_parallel_threshold(thread_pool::DEFAULT_PARALLEL_THRESHOLD);
+    
+    std::cout << "OK - test_parallel()" << std::endl;
+}
+
+void test_intersects()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 500; i++)
+    {
+        uint32_t sz = 1 + rand() % 20000;
+        uint32_t n_operands = rand() % 5;
+        
+        std::vector<bit_array> arrays;
+        std::vector<const bit_array*> operands;
+        
+        //  few set bits, so that and-results are often empty
+        for (uint32_t j = 0; j < n_operands; j++)
+        {
+            bit_array operand(sz, false);
+            uint32_t n_set = rand() % (sz / 8 + 2);
+            
+            for (uint32_t k = 0; k < n_set; k++)
+            {
+                operand.place(true, rand() % sz);
+            }
+            
+            arrays.push_back(std::move(operand));
+        }
+        
+        for (uint32_t j = 0; j < n_operands; j++)
+        {
+            operands.push_back(&arrays[j]);
+        }
+        
+        bit_array out(sz, false);
+        
+        if (n_operands >= 2)
+        {
+            const bit_array& a = arrays[0];
+            const bit_array& b = arrays[1];
+            
+            assert(bit_array::intersects(a, b) == (bit_array::and_count(a, b) > 0));
+            assert(bit_array::intersects_not(a, b) == (bit_array::and_not_count(a, b) > 0));
+            
+            bit_array::unchecked_dot_and_not(out, a, b, 0, sz);
+            assert(!bit_array::intersects(out, b));
+            assert(bit_array::intersects_not(a, out) == bit_array::intersects(a, b));
+        }
+        
+        if (n_operands > 0)
+        {
+            bit_array::and_many(out, operands);
+            assert(bit_array::intersects_many(operands) == out.any());
+        }
+        else
+        {
+            assert(!bit_array::intersects_many(operands));
+        }
+    }
+    
+    //  a set bit in the final element is found
+    bit_array a(130, false);
+    bit_array b(130, false);
+    
+    a.place(true, 129);
+    assert(!bit_array::intersects(a, b));
+    assert(bit_array::intersects_not(a, b));
+    
+    b.place(true, 129);
+    assert(bit_array::intersects(a, b));
+    assert(!bit_array::intersects_not(a, b));
+    assert(bit_array::intersects_many({ &a, &b, &a }));
+    
+    bool threw = false;
+    
+    try
+    {
+        bit_array::intersects(bit_array(10, true), bit_array(11, true));
+    }
+    catch (const std::runtime_error& e)
+    {
+        threw = true;
+    }
+    
+    assert(threw);
+    
+    std::cout << "OK - test_intersects()" << std::endl;
+}
+
+void test_occupied_spans()
+{
+    using namespace util;
+    
+    const uint32_t line_bits = 512;
+    
+    for (uint32_t i = 0; i < 500; i++)
+    {
+        uint32_t sz = rand() % 20000;
+        
+        //  shrinking a full array leaves set bits past the end of the final
+        //  word, which must be ignored
+        bit_array a(sz + rand() % 64, true);
+        a.resize(sz);
+        a.fill(false);
+        
+        uint32_t n_set = sz == 0 ? 0 : rand() % (sz / 256 + 2);
+        
+        for (uint32_t j = 0; j < n_set; j++)
+        {
+            a.place(true, rand() % sz);
+        }
+        
+        if (sz > 0 && rand() % 4 == 0)
+        {
+            a.place(true, sz-1);
+        }
+        
+        std::vector<bit_array::span> spans = bit_array::occupied_spans(a);
+        uint32_t n_in_spans = 0;
+        
+        for (uint32_t j = 0; j < spans.size(); j++)
+        {
+            const bit_array::span& span = spans[j];
+            
+            assert(span.start % line_bits == 0 && span.start < span.stop && span.stop <= sz);
+            assert(span.stop == sz || span.stop % line_bits == 0);
+            //  adjacent runs are joined
+            assert(j == 0 || spans[j-1].stop < span.start);
+            
+            for (uint32_t k = span.start; k < span.stop; k += line_bits)
+            {
+                uint32_t stop = std::min(span.stop, k + line_bits);
+                assert(bit_array::unchecked_and_count(a, a, k, stop) > 0);
+            }
+            
+            n_in_spans += bit_array::unchecked_and_count(a, a, span.start, span.stop);
+        }
+        
+        assert(n_in_spans == a.sum());
+    }
+    
+    assert(bit_array::occupied_spans(bit_array()).empty());
+    
+    std::cout << "OK - test_occupied_spans()" << std::endl;
+}
+
+void test_rank_select()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        uint32_t sz = rand() % 3 == 0 ? rand() % 1000 : rand() % 300000;
+        uint32_t density = 1 + rand() % 100;
+        bit_array barray(sz + 11, true);
+        
+        //  junk past the end of the final word
+        barray.resize(sz);
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            barray.unchecked_place(rand() % density == 0, j);
+        }
+        
+        rank_select directory(barray);
+        dynamic_array<uint32_t> expect = bit_array::find(barray);
+        uint32_t n_expect = expect.tail();
+        
+        assert(directory.sum() == n_expect);
+        assert(directory.rank(sz) == n_expect);
+        
+        //  rank counts the set bits before each index
+        uint32_t prior = 0;
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            assert(directory.unchecked_rank(j) == prior);
+            prior += barray.at(j);
+        }
+        
+        for (uint32_t j = 0; j < n_expect; j++)
+        {
+            assert(directory.select(j) == expect.at(j));
+        }
+        
+        //  the directory is rebuilt after the array is modified
+        if (sz > 0)
+        {
+            uint32_t idx = rand() % sz;
+            bool was_set = barray.at(idx);
+            
+            barray.place(!was_set, idx);
+            
+            assert(directory.sum() == (was_set ? n_expect - 1 : n_expect + 1));
+            assert(directory.rank(sz) == directory.sum());
+        }
+        
+        barray.append(bit_array(100, true));
+        assert(directory.size() == sz + 100);
+        assert(directory.select(directory.sum() - 1) == sz + 99);
+    }
+    
+    bit_array barray(100, false);
+    rank_select directory(barray);
+    
+    bool threw_rank = false;
+    bool threw_select = false;
+    
+    try
+    {
+        directory.rank(101);
+    }
+    catch (const std::runtime_error& e)
+    {
+        threw_rank = true;
+    }
+    
+    try
+    {
+        directory.select(0);
+    }
+    catch (const std::runtime_error& e)
+    {
+        threw_select = true;
+    }
+    
+    assert(threw_rank && threw_select);
+    
+    std::cout << "OK - test_rank_select()" << std::endl;
+}
+
+void test_and_or_many()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        uint32_t sz = 1 + rand() % 50000;
+        uint32_t n_groups = rand() % 5;
+        
+        std::vector<std::vector<bit_array>> arrays(n_groups);
+        std::vector<std::vector<const bit_array*>> groups(n_groups);
+        
+        for (uint32_t j = 0; j < n_groups; j++)
+        {
+            uint32_t n_operands = 1 + rand() % 4;
+            
+            //  sparse operands, so that blocks often and to zero early
+            for (uint32_t k = 0; k < n_operands; k++)
+            {
+                bit_array operand(sz, false);
+                uint32_t n_set = rand() % (sz + 1);
+                
+                for (uint32_t m = 0; m < n_set; m++)
+                {
+                    operand.place(true, rand() % sz);
+                }
+                
+                arrays[j].push_back(std::move(operand));
+            }
+            
+            for (uint32_t k = 0; k < n_operands; k++)
+            {
+                groups[j].push_back(&arrays[j][k]);
+            }
+        }
+        
+        bit_array expect(sz, true);
+        
+        for (uint32_t j = 0; j < n_groups; j++)
+        {
+            bit_array any(sz, false);
+            
+            for (uint32_t k = 0; k < groups[j].size(); k++)
+            {
+                bit_array::dot_or(any, any, *groups[j][k]);
+            }
+            
+            bit_array::dot_and(expect, expect, any);
+        }
+        
+        bit_array result(sz, false);
+        bit_array::and_of_or_many(result, groups);
+        
+        assert(bit_array::find(result).eq_contents(bit_array::find(expect)));
+        
+        //  the same and, tested a word at a time up to the first word with a
+        //  bit past a threshold
+        uint32_t threshold = rand() % sz;
+        std::vector<uint32_t> visited;
+        
+        bool found = bit_array::any_word_of_and_of_or_many(groups, [&visited, threshold] (uint32_t bin, uint64_t word) -> bool {
+            for (uint32_t k = 0; k < 64; k++)
+            {
+                if (word & (uint64_t(1) << k))
+                {
+                    visited.push_back(bin * 64 + k);
+                }
+            }
+            
+            return visited.back() >= threshold;
+        });
+        
+        std::vector<uint32_t> expect_visited;
+        
+        for (uint32_t j = 0; j < expect.size() && n_groups > 0; j++)
+        {
+            if (expect.at(j))
+            {
+                expect_visited.push_back(j);
+            }
+            
+            if (!expect_visited.empty() && expect_visited.back() >= threshold && (j + 1) % 64 == 0)
+            {
+                break;
+            }
+        }
+        
+        assert(visited == expect_visited);
+        assert(found == (!visited.empty() && visited.back() >= threshold));
+        
+        if (n_groups > 0)
+        {
+            bit_array expect_or(sz, false);
+            bit_array expect_and(sz, true);
+            
+            for (uint32_t k = 0; k < groups[0].size(); k++)
+            {
+                bit_array::dot_or(expect_or, expect_or, *groups[0][k]);
+                bit_array::dot_and(expect_and, expect_and, *groups[0][k]);
+            }
+            
+            bit_array::or_many(result, groups[0]);
+            assert(bit_array::find(result).eq_contents(bit_array::find(expect_or)));
+            
+            bit_array::and_many(result, groups[0]);
+            assert(bit_array::find(result).eq_contents(bit_array::find(expect_and)));
+        }
+    }
+    
+    bit_array a(10, true);
+    bit_array b(11, true);
+    bool threw = false;
+    
+    try
+    {
+        bit_array::and_many(a, { &a, &b });
+    }
+    catch (const std::runtime_error& e)
+    {
+        threw = true;
+    }
+    
+    assert(threw);
+    
+    std::cout << "OK - test_and_or_many()" << std::endl;
+}
+
 void test_iterator()
 {
     using namespace util;
@@ -1084,3 +2257,148 @@ void test_bit_array()
 //    assert(!bit_array::all(barray6));
     
 }
+
+void test_bit_matrix()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        uint32_t n_rows = rand() % 20;
+        uint32_t sz = rand() % 2 == 0 ? rand() % 200 : rand() % 5000;
+        
+        //  reference rows, the first few with junk past the end
+        std::vector<bit_array> rows;
+        bit_matrix m(n_rows, sz);
+        
+        assert(m.n_rows() == n_rows && m.size() == sz);
+        assert(m.stride() % bit_matrix::LINE_WORDS == 0 && m.stride() * 64 >= sz);
+        
+        for (uint32_t j = 0; j < n_rows; j++)
+        {
+            bit_array row(sz + 7, true);
+            row.resize(sz);
+            
+            for (uint32_t k = 0; k < sz; k++)
+            {
+                row.unchecked_place(rand() % (j + 2) == 0, k);
+            }
+            
+            assert(!m.row_any(j));
+            
+            if (j % 2 == 0)
+            {
+                m.set_row(j, row);
+            }
+            else
+            {
+                for (uint32_t k : row.set_bits())
+                {
+                    m.unchecked_place(true, j, k);
+                }
+            }
+            
+            rows.push_back(row);
+        }
+        
+        auto check = [&m, &rows] () -> void {
+            assert(m.n_rows() == rows.size());
+            
+            for (uint32_t j = 0; j < rows.size(); j++)
+            {
+                bit_array row = m.to_bit_array(j);
+                
+                assert(row.size() == rows[j].size());
+                
+                for (uint32_t k = 0; k < row.size(); k++)
+                {
+                    assert(row.at(k) == rows[j].at(k) && m.at(j, k) == row.at(k));
+                }
+                
+                assert(m.row_sum(j) == rows[j].sum());
+                assert(m.row_any(j) == rows[j].any());
+                
+                uint32_t n_visited = 0;
+                
+                bit_matrix::for_each_set_bit(m, j, [&] (uint32_t idx) -> void {
+                    assert(rows[j].at(idx));
+                    n_visited++;
+                });
+                
+                assert(n_visited == rows[j].sum());
+            }
+        };
+        
+        check();
+        
+        bit_matrix copy = m;
+        
+        assert(copy == m);
+        
+        //  keep, compress and resize act on every row
+        uint32_t n_keep = sz == 0 ? 0 : rand() % sz;
+        dynamic_array<uint32_t> at_indices(n_keep);
+        
+        for (uint32_t j = 0; j < n_keep; j++)
+        {
+            at_indices.place(rand() % sz, j);
+        }
+        
+        m.unchecked_keep(at_indices);
+        
+        for (auto& row : rows)
+        {
+            row.unchecked_keep(at_indices);
+        }
+        
+        check();
+        
+        bit_array mask(m.size(), false);
+        
+        for (uint32_t j = 0; j < m.size(); j++)
+        {
+            mask.unchecked_place(rand() % 3 != 0, j);
+        }
+        
+        m.unchecked_compress(mask);
+        
+        for (auto& row : rows)
+        {
+            row.unchecked_compress(mask);
+            row.resize(mask.sum());
+        }
+        
+        check();
+        
+        uint32_t to_size = rand() % 3000;
+        
+        m.resize(to_size);
+        
+        for (auto& row : rows)
+        {
+            row.resize(to_size);
+        }
+        
+        check();
+        
+        uint32_t to_rows = rand() % 30;
+        
+        m.resize_rows(to_rows);
+        rows.resize(std::min<size_t>(rows.size(), to_rows));
+        rows.resize(to_rows, bit_array(to_size, false));
+        
+        check();
+        
+        if (to_rows > 0)
+        {
+            m.fill_row(0, true);
+            rows[0].fill(true);
+        }
+        
+        check();
+        
+        assert(copy.n_rows() == n_rows && copy.size() == sz);
+    }
+    
+    std::cout << "OK - test_bit_matrix()" << std::endl;
+}
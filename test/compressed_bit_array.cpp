@@ -0,0 +1,459 @@
+#include "compressed_bit_array.hpp"
+#include "bit_array.hpp"
+#include <iostream>
+#include <assert.h>
+#include <cstdint>
+#include <vector>
+
+void test_conversion();
+void test_place();
+void test_resize_append();
+void test_keep();
+void test_compress();
+void test_binary_ops();
+void test_dense_ops();
+void test_memory();
+util::bit_array make_random(uint32_t sz);
+bool matches(const util::compressed_bit_array& a, const util::bit_array& b);
+
+int main(int argc, char* argv[])
+{
+    std::cout << "BEGIN COMPRESSED_BIT_ARRAY" << std::endl;
+    
+    test_conversion();
+    test_place();
+    test_resize_append();
+    test_keep();
+    test_compress();
+    test_binary_ops();
+    test_dense_ops();
+    test_memory();
+    
+    std::cout << "END COMPRESSED_BIT_ARRAY" << std::endl;
+    
+    return 0;
+}
+
+//  make_random: Mix of empty, sparse, dense and run-length chunks.
+
+util::bit_array make_random(uint32_t sz)
+{
+    util::bit_array result(sz, false);
+    
+    uint32_t i = 0;
+    
+    while (i < sz)
+    {
+        uint32_t span = 1 + rand() % 30000;
+        uint32_t stop = std::min(sz, i + span);
+        uint32_t kind = rand() % 4;
+        
+        for (uint32_t j = i; j < stop; j++)
+        {
+            bool value = false;
+            
+            switch (kind)
+            {
+                case 1:
+                    value = rand() % 200 == 0;
+                    break;
+                case 2:
+                    value = rand() % 2 == 0;
+                    break;
+                case 3:
+                    value = (j / 37) % 3 != 0;
+                    break;
+            }
+            
+            if (value)
+            {
+                result.unchecked_place(true, j);
+            }
+        }
+        
+        i = stop;
+    }
+    
+    return result;
+}
+
+bool matches(const util::compressed_bit_array& a, const util::bit_array& b)
+{
+    using namespace util;
+    
+    if (a.size() != b.size() || a.sum() != b.sum())
+    {
+        return false;
+    }
+    
+    return compressed_bit_array::find(a).eq_contents(bit_array::find(b));
+}
+
+void test_conversion()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        uint32_t sz = rand() % 300000;
+        bit_array dense = make_random(sz);
+        compressed_bit_array sparse(dense);
+        
+        assert(matches(sparse, dense));
+        assert(sparse.any() == dense.any());
+        
+        bit_array back = sparse.to_bit_array();
+        
+        assert(bit_array::find(back).eq_contents(bit_array::find(dense)));
+        
+        for (uint32_t j = 0; j < 1000 && sz > 0; j++)
+        {
+            uint32_t idx = rand() % sz;
+            assert(sparse.at(idx) == dense.at(idx));
+        }
+        
+        assert(compressed_bit_array(dense) == sparse);
+        
+        dynamic_array<uint32_t> expect = bit_array::find(dense);
+        
+        assert(matches(compressed_bit_array(sz, expect.unsafe_get_pointer(), expect.tail()), dense));
+        
+        uint32_t n_visited = 0;
+        bool visit_matches = true;
+        
+        auto func = [&expect, &n_visited, &visit_matches] (uint32_t idx) -> void {
+            visit_matches = visit_matches && n_visited < expect.tail() && expect.at(n_visited) == idx;
+            n_visited++;
+        };
+        
+        compressed_bit_array::for_each_set_bit(sparse, func);
+        
+        assert(visit_matches && n_visited == expect.tail());
+        
+        //  the same bits, restricted to a range
+        uint32_t start = sz == 0 ? 0 : rand() % sz;
+        uint32_t stop = sz == 0 ? 0 : start + rand() % (sz - start + 1);
+        std::vector<uint32_t> dense_visited;
+        std::vector<uint32_t> sparse_visited;
+        
+        auto dense_func = [&dense_visited] (uint32_t idx) -> void {
+            dense_visited.push_back(idx);
+        };
+        
+        auto sparse_func = [&sparse_visited] (uint32_t idx) -> void {
+            sparse_visited.push_back(idx);
+        };
+        
+        bit_array::for_each_set_bit(dense, start, stop, dense_func);
+        compressed_bit_array::for_each_set_bit(sparse, start, stop, sparse_func);
+        
+        std::vector<uint32_t> expect_range;
+        
+        for (uint32_t j = 0; j < expect.tail(); j++)
+        {
+            if (expect.at(j) >= start && expect.at(j) < stop)
+            {
+                expect_range.push_back(expect.at(j));
+            }
+        }
+        
+        assert(dense_visited == expect_range && sparse_visited == expect_range);
+        
+        sparse.fill(true);
+        dense.fill(true);
+        
+        assert(matches(sparse, dense));
+        
+        sparse.fill(false);
+        
+        assert(sparse.sum() == 0 && !sparse.any());
+    }
+    
+    std::cout << "OK - test_conversion()" << std::endl;
+}
+
+void test_place()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        uint32_t sz = 1 + rand() % 200000;
+        bit_array dense = make_random(sz);
+        compressed_bit_array sparse(dense);
+        
+        for (uint32_t j = 0; j < 5000; j++)
+        {
+            uint32_t idx = rand() % sz;
+            bool value = rand() % 2 == 0;
+            
+            dense.place(value, idx);
+            sparse.place(value, idx);
+        }
+        
+        assert(matches(sparse, dense));
+    }
+    
+    //  grow a single chunk past ARRAY_MAX
+    compressed_bit_array sparse(compressed_bit_array::CHUNK_SIZE);
+    bit_array dense(compressed_bit_array::CHUNK_SIZE, false);
+    
+    for (uint32_t j = 0; j < compressed_bit_array::ARRAY_MAX * 2; j++)
+    {
+        uint32_t idx = rand() % compressed_bit_array::CHUNK_SIZE;
+        
+        dense.place(true, idx);
+        sparse.place(true, idx);
+    }
+    
+    assert(matches(sparse, dense));
+    
+    bool threw = false;
+    
+    try
+    {
+        sparse.place(true, compressed_bit_array::CHUNK_SIZE);
+    }
+    catch (const std::runtime_error& e)
+    {
+        threw = true;
+    }
+    
+    assert(threw);
+    
+    std::cout << "OK - test_place()" << std::endl;
+}
+
+void test_resize_append()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        uint32_t sz = rand() % 200000;
+        bit_array dense = make_random(sz);
+        compressed_bit_array sparse(dense);
+        
+        uint32_t to_size = rand() % 250000;
+        
+        dense.resize(to_size);
+        sparse.resize(to_size);
+        
+        assert(matches(sparse, dense));
+        
+        //  aligned and unaligned appends
+        uint32_t other_sz = rand() % 150000;
+        bit_array other_dense = make_random(other_sz);
+        
+        if (i % 2 == 0)
+        {
+            uint32_t aligned = (to_size / compressed_bit_array::CHUNK_SIZE) * compressed_bit_array::CHUNK_SIZE;
+            
+            dense.resize(aligned);
+            sparse.resize(aligned);
+        }
+        
+        dense.append(other_dense);
+        sparse.append(compressed_bit_array(other_dense));
+        
+        assert(matches(sparse, dense));
+    }
+    
+    std::cout << "OK - test_resize_append()" << std::endl;
+}
+
+void test_keep()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        uint32_t sz = 1 + rand() % 200000;
+        bit_array dense = make_random(sz);
+        compressed_bit_array sparse(dense);
+        
+        uint32_t n_keep = rand() % 100000;
+        dynamic_array<uint32_t> at_indices(n_keep);
+        
+        for (uint32_t j = 0; j < n_keep; j++)
+        {
+            at_indices.place(rand() % sz, j);
+        }
+        
+        dense.unchecked_keep(at_indices);
+        sparse.unchecked_keep(at_indices);
+        
+        assert(matches(sparse, dense));
+    }
+    
+    std::cout << "OK - test_keep()" << std::endl;
+}
+
+void test_compress()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        uint32_t sz = rand() % 300000;
+        bit_array dense = make_random(sz);
+        bit_array mask = make_random(sz);
+        compressed_bit_array sparse(dense);
+        
+        dense.compress(mask);
+        sparse.unchecked_compress(mask);
+        
+        assert(matches(sparse, dense));
+    }
+    
+    std::cout << "OK - test_compress()" << std::endl;
+}
+
+void test_binary_ops()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        uint32_t sz = rand() % 300000;
+        bit_array a = make_random(sz);
+        bit_array b = make_random(sz);
+        bit_array out(sz, false);
+        
+        compressed_bit_array ca(a);
+        compressed_bit_array cb(b);
+        compressed_bit_array c_out;
+        
+        bit_array::dot_or(out, a, b);
+        compressed_bit_array::dot_or(c_out, ca, cb);
+        assert(matches(c_out, out));
+        
+        bit_array::dot_and(out, a, b);
+        compressed_bit_array::dot_and(c_out, ca, cb);
+        assert(matches(c_out, out));
+        
+        bit_array::unchecked_dot_and_not(out, a, b, 0, sz);
+        compressed_bit_array::dot_and_not(c_out, ca, cb);
+        assert(matches(c_out, out));
+        
+        //  output aliases an operand
+        compressed_bit_array::dot_or(ca, ca, cb);
+        bit_array::dot_or(a, a, b);
+        assert(matches(ca, a));
+    }
+    
+    std::cout << "OK - test_binary_ops()" << std::endl;
+}
+
+void test_dense_ops()
+{
+    using namespace util;
+    
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        uint32_t sz = rand() % 300000;
+        bit_array a = make_random(sz);
+        bit_array b = make_random(sz);
+        bit_array out(sz, false);
+        
+        compressed_bit_array ca(a);
+        
+        ca.unchecked_or(b);
+        bit_array::dot_or(out, a, b);
+        assert(matches(ca, out));
+        
+        ca = compressed_bit_array(a);
+        ca.unchecked_and_not(b);
+        bit_array::unchecked_dot_and_not(out, a, b, 0, sz);
+        assert(matches(ca, out));
+        
+        ca = compressed_bit_array(a);
+        
+        bit_array into = b;
+        ca.unchecked_and_into(into);
+        bit_array::dot_and(out, a, b);
+        assert(bit_array::find(into).eq_contents(bit_array::find(out)));
+        
+        into = b;
+        ca.unchecked_or_into(into);
+        bit_array::dot_or(out, a, b);
+        assert(bit_array::find(into).eq_contents(bit_array::find(out)));
+        
+        bit_array::dot_and(out, a, b);
+        assert(ca.unchecked_intersects(b) == out.any());
+        
+        //  any_set_bit stops at the first set bit at or past `first`
+        uint32_t first = sz == 0 ? 0 : rand() % sz;
+        uint32_t n_tested = 0;
+        uint32_t n_before = 0;
+        bool any_after = false;
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            n_before += a.at(j) && j < first;
+            any_after = any_after || (a.at(j) && j >= first);
+        }
+        
+        bool found = compressed_bit_array::any_set_bit(ca, [first, &n_tested] (uint32_t index) -> bool {
+            n_tested++;
+            return index >= first;
+        });
+        
+        assert(found == any_after && n_tested == n_before + uint32_t(found));
+        
+        //  restricted to the chunks spanned by a window of set bits
+        uint32_t start = sz == 0 ? 0 : rand() % sz;
+        uint32_t stop = start + (sz == start ? 0 : rand() % (sz - start + 1));
+        bit_array window(sz, false);
+        
+        for (uint32_t j = start; j < stop; j++)
+        {
+            window.unchecked_place(b.at(j), j);
+        }
+        
+        ca = compressed_bit_array(a);
+        ca.unchecked_or(window, start, stop);
+        bit_array::dot_or(out, a, window);
+        assert(matches(ca, out));
+        
+        ca = compressed_bit_array(a);
+        ca.unchecked_and_not(window, start, stop);
+        bit_array::unchecked_dot_and_not(out, a, window, 0, sz);
+        assert(matches(ca, out));
+        
+        //  or with the indices of the window's set bits
+        dynamic_array<uint32_t> window_indices = bit_array::find(window);
+        
+        ca = compressed_bit_array(a);
+        ca.unchecked_or(window_indices.unsafe_get_pointer(), window_indices.tail());
+        bit_array::dot_or(out, a, window);
+        assert(matches(ca, out));
+        
+        ca = compressed_bit_array(a);
+        
+        bit_array::unchecked_dot_and_not(out, b, a, 0, sz);
+        assert(!ca.unchecked_intersects(out));
+    }
+    
+    std::cout << "OK - test_dense_ops()" << std::endl;
+}
+
+void test_memory()
+{
+    using namespace util;
+    
+    uint32_t sz = 5000000;
+    bit_array dense(sz, false);
+    
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        dense.place(true, rand() % sz);
+    }
+    
+    compressed_bit_array sparse(dense);
+    
+    //  ~625 KB dense vs. a few KB compressed
+    assert(sparse.bytes() * 50 < sz / 8);
+    
+    std::cout << "OK - test_memory()" << std::endl;
+}
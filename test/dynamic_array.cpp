@@ -23,11 +23,13 @@ void test_dynamic_alloc_speed_array_multi();
 void test_dynamic_alloc_speed_vector_multi();
 double ellapsed_time_s(std::chrono::high_resolution_clock::time_point t1, std::chrono::high_resolution_clock::time_point t2);
 void test_erase();
+void test_aligned_allocator();
 
 int main(int argc, char* argv[])
 {
     std::cout << "BEGIN DYNAMIC ARRAY" << std::endl;
     test_simple();
+    test_aligned_allocator();
     test_push();
     test_erase();
     test_array_of_array();
@@ -42,6 +44,58 @@ int main(int argc, char* argv[])
     return 0;
 }
 
+void test_aligned_allocator()
+{
+    using namespace util;
+    typedef aligned_allocator<uint32_t, 64> alloc_t;
+    
+    assert(alloc_t::padded_size(1) == 16 && alloc_t::padded_size(16) == 16 && alloc_t::padded_size(17) == 32);
+    
+    //  blocks stay aligned and zero-padded through growth and shrinkage,
+    //  including sizes large enough to be moved with mremap().
+    uint32_t sizes[8] = { 1, 17, 5, 100000, 3, 1000000, 250000, 33 };
+    
+    dynamic_array<uint32_t, alloc_t> arr;
+    uint32_t prev_size = 0;
+    
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        arr.resize(sizes[i]);
+        
+        uint32_t* data = arr.unsafe_get_pointer();
+        
+        assert(uintptr_t(data) % 64 == 0);
+        
+        for (uint32_t j = 0; j < std::min(prev_size, sizes[i]); j++)
+        {
+            assert(data[j] == j);
+        }
+        
+        for (uint32_t j = sizes[i]; j < alloc_t::padded_size(sizes[i]); j++)
+        {
+            assert(data[j] == 0);
+        }
+        
+        for (uint32_t j = 0; j < sizes[i]; j++)
+        {
+            data[j] = j;
+        }
+        
+        prev_size = sizes[i];
+    }
+    
+    dynamic_array<uint32_t, alloc_t> copy = arr;
+    
+    assert(uintptr_t(copy.unsafe_get_pointer()) % 64 == 0);
+    assert(copy.eq_contents(arr));
+    
+    arr.resize(0);
+    
+    assert(arr.unsafe_get_pointer() == nullptr);
+    
+    std::cout << "OK - test_aligned_allocator()" << std::endl;
+}
+
 void test_simple()
 {
     using namespace util;
@@ -4,6 +4,9 @@
 #include <chrono>
 #include <cstdint>
 #include <functional>
+#include <vector>
+#include <map>
+#include <thread>
 
 void test_keep_each();
 void test_swap_category();
@@ -21,11 +24,22 @@ void test_find_one();
 void test_keep();
 void test_keep2();
 void test_set_category();
+void test_set_category_sparse();
 void test_set_category_mult_labels();
+void test_set_category_bulk();
 void test_set_category_mult_categories();
 void test_set_category_mult_categories2();
 void test_empty_and_clear();
 void test_rm_category();
+void test_index_policy();
+void test_keep_mask();
+void test_append_many();
+void test_has_combination();
+void test_find_plan();
+void test_concurrent_find();
+void test_find_all_csr();
+void test_find_all_parallel();
+void test_coded_category();
 double test_locate_speed(uint32_t sz);
 double test_add_label_speed(uint32_t sz);
 double test_add_label_speed_with_size_hint(uint32_t sz);
@@ -50,6 +64,7 @@ int main(int argc, char* argv[])
     test_combinations();
     test_resize();
     test_set_category_mult_labels();
+    test_set_category_bulk();
     test_collapse();
     test_set_category_mult_categories2();
     test_append();
@@ -62,8 +77,18 @@ int main(int argc, char* argv[])
     test_keep();
     test_rm_category();
     test_set_category();
+    test_set_category_sparse();
     test_empty_and_clear();
     test_locate();
+    test_index_policy();
+    test_keep_mask();
+    test_append_many();
+    test_has_combination();
+    test_find_plan();
+    test_concurrent_find();
+    test_find_all_csr();
+    test_find_all_parallel();
+    test_coded_category();
 
     std::cout << "Profiling ... " << std::endl;
 
@@ -94,6 +119,1076 @@ util::bit_array get_randomly_filled_array(uint32_t sz, uint32_t n_true)
     return arr;
 }
 
+//  test_has_combination: has_combination agrees with find, for dense,
+//      compressed and mixed label indices, with and without a coded
+//      category, when queries name one or more labels of a category.
+
+void test_has_combination()
+{
+    using namespace util;
+    
+    uint32_t sz = 100000;
+    uint32_t policies[3] = { index_policy::DENSE, index_policy::COMPRESSED, index_policy::BY_DENSITY };
+    
+    for (uint32_t p = 0; p < 6; p++)
+    {
+        locator loc;
+        loc.set_index_policy(policies[p % 3]);
+        
+        bool coded = p >= 3;
+        
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            loc.add_category(i, coded && i == 1 ? category_storage::CODES : category_storage::INDICES);
+            
+            //  labels i*10 + 1 ... i*10 + 4 of category i, sparse enough that
+            //  some combinations never co-occur. Label 24 is dense, so that
+            //  under BY_DENSITY category 2 mixes dense and compressed labels.
+            for (uint32_t j = 1; j < 5; j++)
+            {
+                uint32_t n_true = i == 2 && j == 4 ? sz / 4 : 20 * j;
+                
+                loc.set_category(i, i * 10 + j, get_randomly_filled_array(sz, n_true));
+            }
+        }
+        
+        for (uint32_t i = 0; i < 400; i++)
+        {
+            types::entries_t labels;
+            
+            //  one to three labels, possibly repeated, of each of some categories
+            for (uint32_t j = 0; j < 3; j++)
+            {
+                uint32_t n_labels = rand() % 4;
+                
+                for (uint32_t k = 0; k < n_labels; k++)
+                {
+                    labels.push(j * 10 + 1 + rand() % 4);
+                }
+            }
+            
+            assert(loc.has_combination(labels) == (loc.find(labels).tail() > 0));
+        }
+        
+        types::entries_t same_category;
+        same_category.push(11);
+        same_category.push(12);
+        
+        assert(loc.has_combination(same_category));
+        assert(loc.find(same_category).tail() > 0);
+        
+        types::entries_t missing;
+        missing.push(1);
+        missing.push(1000);
+        
+        assert(!loc.has_combination(missing));
+        assert(loc.has_combination(types::entries_t()) == (loc.find(types::entries_t()).tail() > 0));
+    }
+    
+    locator empty;
+    
+    assert(empty.has_combination(types::entries_t()) == (empty.find(types::entries_t()).tail() > 0));
+    
+    std::cout << "OK - test_has_combination()" << std::endl;
+}
+
+//  test_find_plan: find agrees with a row-by-row search when categories
+//      cover every row, some rows, or few rows, with repeated and missing
+//      labels, for each index policy.
+
+void test_find_plan()
+{
+    using namespace util;
+    
+    uint32_t sz = 70000;
+    uint32_t policies[3] = { index_policy::DENSE, index_policy::COMPRESSED, index_policy::BY_DENSITY };
+    
+    //  labels of category i are first_label[i] ... first_label[i] + n_labels[i] - 1;
+    //  rows of category i have no label with probability 1 / n_labels[i]
+    //  unless the category is full.
+    uint32_t first_label[4] = { 1, 11, 21, 100 };
+    uint32_t n_labels[4] = { 2, 5, 40, 1 };
+    bool is_full[4] = { true, false, false, true };
+    
+    for (uint32_t policy : policies)
+    {
+        locator loc;
+        loc.set_index_policy(policy);
+        
+        std::vector<std::vector<uint32_t>> row_labels(4, std::vector<uint32_t>(sz));
+        
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            loc.require_category(i);
+            
+            std::vector<bit_array> indices(n_labels[i], bit_array(sz, false));
+            
+            for (uint32_t j = 0; j < sz; j++)
+            {
+                uint32_t which = rand() % (n_labels[i] + (is_full[i] ? 0 : 1));
+                
+                if (which == n_labels[i])
+                {
+                    row_labels[i][j] = locator::UNDEFINED_LABEL;
+                    continue;
+                }
+                
+                row_labels[i][j] = first_label[i] + which;
+                indices[which].place(true, j);
+            }
+            
+            for (uint32_t j = 0; j < n_labels[i]; j++)
+            {
+                loc.set_category(i, first_label[i] + j, indices[j]);
+            }
+        }
+        
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            types::entries_t labels;
+            uint32_t n_search = rand() % 6;
+            
+            for (uint32_t j = 0; j < n_search; j++)
+            {
+                uint32_t category = rand() % 4;
+                labels.push(first_label[category] + rand() % n_labels[category]);
+            }
+            
+            //  every label of a category
+            if (rand() % 4 == 0)
+            {
+                uint32_t category = rand() % 4;
+                
+                for (uint32_t j = 0; j < n_labels[category]; j++)
+                {
+                    labels.push(first_label[category] + j);
+                }
+            }
+            
+            types::entries_t expect;
+            
+            for (uint32_t row = 0; row < sz; row++)
+            {
+                bool all = true;
+                
+                for (uint32_t category = 0; category < 4 && all; category++)
+                {
+                    bool is_named = false;
+                    bool any = false;
+                    
+                    for (uint32_t j = 0; j < labels.tail(); j++)
+                    {
+                        uint32_t label = labels.at(j);
+                        
+                        if (label >= first_label[category] && label < first_label[category] + n_labels[category])
+                        {
+                            is_named = true;
+                            any = any || row_labels[category][row] == label;
+                        }
+                    }
+                    
+                    all = !is_named || any;
+                }
+                
+                if (all)
+                {
+                    expect.push(row + 1);
+                }
+            }
+            
+            assert(loc.find(labels, 1).eq_contents(expect));
+            
+            labels.push(1000);
+            assert(loc.find(labels).tail() == 0);
+        }
+        
+        //  label counts are kept through keep and append
+        types::entries_t keep_indices;
+        
+        for (uint32_t i = 0; i < sz; i += 3)
+        {
+            keep_indices.push(i);
+        }
+        
+        loc.keep(keep_indices);
+        loc.append(locator(loc));
+        
+        const types::entries_t& all_labels = loc.get_labels();
+        
+        for (uint32_t i = 0; i < all_labels.tail(); i++)
+        {
+            assert(loc.count(all_labels.at(i)) == loc.find(all_labels.at(i)).tail());
+        }
+    }
+    
+    std::cout << "OK - test_find_plan()" << std::endl;
+}
+
+//  test_concurrent_find: Threads querying one const locator at once, with
+//      and without the shared thread pool, get the serial results.
+
+void test_concurrent_find()
+{
+    using namespace util;
+    
+    uint32_t sz = 100000;
+    uint32_t n_queries = 50;
+    uint32_t n_threads = 4;
+    
+    locator loc;
+    
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        loc.require_category(i);
+        
+        for (uint32_t j = 1; j < 6; j++)
+        {
+            loc.set_category(i, i * 10 + j, get_randomly_filled_array(sz, sz / (j * 4)));
+        }
+    }
+    
+    std::vector<types::entries_t> queries(n_queries);
+    std::vector<types::numeric_indices_t> expect(n_queries);
+    
+    for (uint32_t i = 0; i < n_queries; i++)
+    {
+        uint32_t n_labels = 1 + rand() % 4;
+        
+        for (uint32_t j = 0; j < n_labels; j++)
+        {
+            queries[i].push((rand() % 3) * 10 + 1 + rand() % 5);
+        }
+        
+        expect[i] = loc.find(queries[i]);
+        
+        bit_array scratch;
+        assert(loc.find(queries[i], scratch).eq_contents(expect[i]));
+        
+        //  a released scratch is allocated again
+        locator::release_find_scratch();
+        assert(loc.find(queries[i]).eq_contents(expect[i]));
+    }
+    
+    const locator& shared = loc;
+    uint32_t orig_pool_size = thread_pool::shared().size();
+    
+    thread_pool::set_shared_size(n_threads);
+    
+    for (uint32_t threshold : { thread_pool::DEFAULT_PARALLEL_THRESHOLD, 1u })
+    {
+        thread_pool::set_parallel_threshold(threshold);
+        
+        std::vector<std::thread> threads;
+        std::vector<uint32_t> n_matched(n_threads, 0u);
+        
+        for (uint32_t i = 0; i < n_threads; i++)
+        {
+            threads.emplace_back([&, i] () -> void {
+                for (uint32_t j = 0; j < n_queries * 4; j++)
+                {
+                    uint32_t query = (i + j) % n_queries;
+                    n_matched[i] += shared.find(queries[query]).eq_contents(expect[query]);
+                }
+            });
+        }
+        
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        
+        for (uint32_t i = 0; i < n_threads; i++)
+        {
+            assert(n_matched[i] == n_queries * 4);
+        }
+    }
+    
+    thread_pool::set_parallel_threshold(thread_pool::DEFAULT_PARALLEL_THRESHOLD);
+    thread_pool::set_shared_size(orig_pool_size);
+    
+    std::cout << "OK - test_concurrent_find()" << std::endl;
+}
+
+//  test_find_all_csr: find_all, find_all_csr and count_all agree with a
+//      row-by-row grouping, for codes numbered directly, through the hash
+//      table, and in several stages.
+
+void test_find_all_csr()
+{
+    using namespace util;
+    
+    //  (number of rows, number of categories, labels per category, index
+    //  policy). The small shapes are grouped by coding rows, and the large
+    //  ones by intersecting label indices.
+    uint32_t shapes[5][4] = {
+        { 3000, 3, 4, index_policy::DENSE },
+        { 3000, 3, 100, index_policy::DENSE },
+        { 3000, 70, 2, index_policy::DENSE },
+        { 200000, 3, 2, index_policy::DENSE },
+        { 200000, 3, 2, index_policy::COMPRESSED }
+    };
+    
+    for (auto& shape : shapes)
+    {
+        uint32_t sz = shape[0];
+        uint32_t n_cats = shape[1];
+        uint32_t n_labs = shape[2];
+        
+        locator loc;
+        loc.set_index_policy(shape[3]);
+        std::vector<std::vector<uint32_t>> row_labels(sz, std::vector<uint32_t>(n_cats));
+        types::entries_t categories;
+        
+        for (uint32_t i = 0; i < n_cats; i++)
+        {
+            loc.require_category(i);
+            categories.push(i);
+            
+            std::vector<bit_array> indices(n_labs, bit_array(sz, false));
+            
+            //  the last row of each category has no label
+            for (uint32_t j = 0; j < sz; j++)
+            {
+                uint32_t which = rand() % n_labs;
+                
+                if (j + 1 == sz)
+                {
+                    row_labels[j][i] = locator::UNDEFINED_LABEL;
+                    continue;
+                }
+                
+                row_labels[j][i] = i * 1000 + which;
+                indices[which].place(true, j);
+            }
+            
+            for (uint32_t j = 0; j < n_labs; j++)
+            {
+                loc.set_category(i, i * 1000 + j, indices[j]);
+            }
+        }
+        
+        std::map<std::vector<uint32_t>, uint32_t> numbers;
+        std::vector<std::vector<uint32_t>> expect_labels;
+        std::vector<std::vector<uint32_t>> expect_rows;
+        
+        for (uint32_t i = 0; i < sz; i++)
+        {
+            auto it = numbers.find(row_labels[i]);
+            
+            if (it == numbers.end())
+            {
+                it = numbers.emplace(row_labels[i], uint32_t(expect_labels.size())).first;
+                expect_labels.push_back(row_labels[i]);
+                expect_rows.emplace_back();
+            }
+            
+            expect_rows[it->second].push_back(i + 1);
+        }
+        
+        bool exists;
+        types::find_all_csr_t csr = loc.find_all_csr(categories, &exists, 1);
+        types::find_all_return_t res = loc.find_all(categories, &exists, 1);
+        types::count_all_return_t counts = loc.count_all(categories, &exists);
+        
+        uint32_t n_combs = uint32_t(expect_labels.size());
+        
+        assert(exists);
+        assert(csr.offsets.tail() == n_combs + 1 && csr.indices.tail() == sz);
+        assert(res.indices.tail() == n_combs && res.combinations.tail() == n_combs * n_cats);
+        assert(counts.counts.tail() == n_combs && counts.combinations.eq_contents(csr.combinations));
+        
+        for (uint32_t i = 0; i < n_combs; i++)
+        {
+            uint32_t first = csr.offsets.at(i);
+            
+            assert(csr.offsets.at(i+1) - first == expect_rows[i].size());
+            assert(res.indices.at(i).tail() == expect_rows[i].size());
+            assert(counts.counts.at(i) == expect_rows[i].size());
+            
+            for (uint32_t j = 0; j < expect_rows[i].size(); j++)
+            {
+                assert(csr.indices.at(first + j) == expect_rows[i][j]);
+                assert(res.indices.at(i).at(j) == expect_rows[i][j]);
+            }
+            
+            for (uint32_t j = 0; j < n_cats; j++)
+            {
+                assert(csr.combinations.at(i * n_cats + j) == expect_labels[i][j]);
+                assert(res.combinations.at(i * n_cats + j) == expect_labels[i][j]);
+            }
+        }
+        
+        categories.push(n_cats + 1);
+        loc.find_all_csr(categories, &exists);
+        assert(!exists);
+        loc.count_all(categories, &exists);
+        assert(!exists);
+    }
+    
+    std::cout << "OK - test_find_all_csr()" << std::endl;
+}
+
+//  test_find_all_parallel: Coding rows on the thread pool gives the same
+//      result as coding them serially, with dense and compressed labels and
+//      rows without a label.
+
+void test_find_all_parallel()
+{
+    using namespace util;
+    
+    uint32_t sz = 300000;
+    uint32_t n_labs[3] = { 5, 7, 40 };
+    
+    locator loc;
+    types::entries_t categories;
+    
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        loc.require_category(i);
+        categories.push(i);
+        
+        std::vector<bit_array> indices(n_labs[i], bit_array(sz, false));
+        
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            if (rand() % 10 != 0)
+            {
+                indices[rand() % n_labs[i]].place(true, j);
+            }
+        }
+        
+        for (uint32_t j = 0; j < n_labs[i]; j++)
+        {
+            loc.set_category(i, i * 100 + j, indices[j]);
+        }
+    }
+    
+    assert(loc.is_compressed_label(200) && !loc.is_compressed_label(0));
+    
+    bool exists;
+    types::find_all_csr_t expect = loc.find_all_csr(categories, &exists, 1);
+    types::count_all_return_t expect_counts = loc.count_all(categories, &exists);
+    
+    uint32_t orig_pool_size = thread_pool::shared().size();
+    
+    thread_pool::set_shared_size(4);
+    thread_pool::set_parallel_threshold(1);
+    
+    types::find_all_csr_t res = loc.find_all_csr(categories, &exists, 1);
+    types::count_all_return_t counts = loc.count_all(categories, &exists);
+    
+    thread_pool::set_parallel_threshold(thread_pool::DEFAULT_PARALLEL_THRESHOLD);
+    thread_pool::set_shared_size(orig_pool_size);
+    
+    assert(exists);
+    assert(res.offsets.eq_contents(expect.offsets));
+    assert(res.indices.eq_contents(expect.indices));
+    assert(res.combinations.eq_contents(expect.combinations));
+    assert(counts.counts.eq_contents(expect_counts.counts));
+    assert(counts.combinations.eq_contents(expect.combinations));
+    
+    std::cout << "OK - test_find_all_parallel()" << std::endl;
+}
+
+//  test_coded_category: A locator whose categories hold codes gives the
+//      same results as one whose categories hold label indices.
+
+void test_coded_category()
+{
+    using namespace util;
+    
+    uint32_t sz = 8000;
+    uint32_t n_labs[3] = { 4, 1500, 30 };
+    std::vector<std::vector<uint32_t>> row_labels(3, std::vector<uint32_t>(sz));
+    
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        for (uint32_t j = 0; j < sz; j++)
+        {
+            //  category 2 leaves some rows without a label
+            bool unlabeled = i == 2 && rand() % 5 == 0;
+            row_labels[i][j] = unlabeled ? ~uint32_t(0) : i * 100000 + rand() % n_labs[i];
+        }
+    }
+    
+    auto make = [&row_labels, sz] (bool coded) -> locator {
+        locator loc;
+        
+        loc.add_category(0);
+        loc.add_category(1, coded ? category_storage::CODES : category_storage::INDICES);
+        loc.add_category(2, coded ? category_storage::CODES : category_storage::INDICES);
+        
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            std::map<uint32_t, bit_array> indices;
+            
+            for (uint32_t j = 0; j < sz; j++)
+            {
+                if (row_labels[i][j] == ~uint32_t(0))
+                {
+                    continue;
+                }
+                
+                auto it = indices.find(row_labels[i][j]);
+                
+                if (it == indices.end())
+                {
+                    it = indices.emplace(row_labels[i][j], bit_array(sz, false)).first;
+                }
+                
+                it->second.place(true, j);
+            }
+            
+            for (const auto& it : indices)
+            {
+                assert(loc.set_category(i, it.first, it.second) == locator_status::OK);
+            }
+        }
+        
+        return loc;
+    };
+    
+    auto same = [] (const locator& a, const locator& b) -> void {
+        bool exists;
+        
+        assert(a == b && b == a);
+        assert(a.size() == b.size());
+        assert(a.get_labels().eq_contents(b.get_labels()));
+        
+        types::entries_t categories = a.get_categories();
+        
+        for (uint32_t i = 0; i < categories.tail(); i++)
+        {
+            uint32_t category = categories.at(i);
+            
+            types::entries_t expect_labels = a.full_category(category, &exists);
+            types::entries_t labels = b.full_category(category, &exists);
+            
+            //  rows without a label are given a random one
+            for (uint32_t j = 0; j < labels.tail(); j++)
+            {
+                assert(labels.at(j) == expect_labels.at(j) ||
+                       (!a.has_label(labels.at(j)) && !a.has_label(expect_labels.at(j))));
+            }
+            
+            assert(a.is_full_category(category, &exists) == b.is_full_category(category, &exists));
+        }
+        
+        const types::entries_t& labels = a.get_labels();
+        
+        for (uint32_t i = 0; i < labels.tail(); i++)
+        {
+            assert(a.count(labels.at(i)) == b.count(labels.at(i)));
+            assert(a.find(labels.at(i), 1).eq_contents(b.find(labels.at(i), 1)));
+        }
+        
+        types::find_all_csr_t expect = a.find_all_csr(categories, &exists);
+        types::find_all_csr_t res = b.find_all_csr(categories, &exists);
+        
+        assert(res.combinations.eq_contents(expect.combinations));
+        assert(res.offsets.eq_contents(expect.offsets));
+        assert(res.indices.eq_contents(expect.indices));
+        assert(a.count_all(categories, &exists).counts.eq_contents(b.count_all(categories, &exists).counts));
+    };
+    
+    locator indexed = make(false);
+    locator coded = make(true);
+    bool exists;
+    
+    assert(coded.is_coded_category(1, &exists) && exists);
+    assert(!coded.is_coded_category(0, &exists) && exists);
+    assert(!indexed.is_coded_category(1, &exists) && exists);
+    assert(!coded.is_coded_category(3, &exists) && !exists);
+    assert(!coded.is_compressed_label(100000));
+    
+    same(indexed, coded);
+    
+    //  find and has_combination across coded and indexed categories
+    types::entries_t search;
+    search.push(1);
+    search.push(100000 + row_labels[1][7]);
+    search.push(100000 + row_labels[1][8]);
+    search.push(row_labels[2][7]);
+    
+    assert(coded.find(search).eq_contents(indexed.find(search)));
+    assert(coded.has_combination(search) == indexed.has_combination(search));
+    
+    //  relabeling rows empties some labels, which are pruned
+    bit_array overwrite = get_randomly_filled_array(sz, sz / 2);
+    bit_array new_label = get_randomly_filled_array(sz, 10);
+    
+    for (locator* loc : { &indexed, &coded })
+    {
+        assert(loc->set_category(1, 100000, overwrite) == locator_status::OK);
+        assert(loc->set_category(2, 7, new_label) == locator_status::OK);
+    }
+    
+    same(indexed, coded);
+    assert(coded.n_labels() == indexed.n_labels());
+    
+    //  a single relabeled row is told apart, whatever each side's storage
+    types::entries_t in_category = coded.all_in_category(1, &exists);
+    uint32_t changed_row = rand() % sz;
+    uint32_t row_label = coded.full_category(1, &exists).at(changed_row);
+    uint32_t to_label = in_category.at(0) == row_label ? in_category.at(1) : in_category.at(0);
+    
+    bit_array one_row(sz, false);
+    one_row.place(true, changed_row);
+    
+    locator changed_coded = coded;
+    locator changed_indexed = indexed;
+    
+    assert(changed_coded.set_category(1, to_label, one_row) == locator_status::OK);
+    assert(changed_indexed.set_category(1, to_label, one_row) == locator_status::OK);
+    
+    assert(changed_coded != coded && coded != changed_coded);
+    assert(changed_coded != indexed && indexed != changed_coded);
+    assert(changed_indexed != coded && coded != changed_indexed);
+    same(changed_indexed, changed_coded);
+    
+    //  keep, keep_mask and resize
+    types::entries_t kept;
+    
+    for (uint32_t i = 0; i < sz; i += 1 + rand() % 3)
+    {
+        kept.push(i);
+    }
+    
+    bit_array mask = get_randomly_filled_array(kept.tail(), kept.tail() / 2);
+    
+    for (locator* loc : { &indexed, &coded })
+    {
+        assert(loc->keep(kept) == locator_status::OK);
+        assert(loc->keep_mask(mask) == locator_status::OK);
+    }
+    
+    same(indexed, coded);
+    
+    for (locator* loc : { &indexed, &coded })
+    {
+        loc->resize(loc->size() - 100);
+        loc->resize(loc->size() + 50);
+    }
+    
+    same(indexed, coded);
+    
+    //  appending keeps each category's storage, whatever the other's
+    locator appended_indexed = indexed;
+    locator appended_coded = coded;
+    
+    assert(appended_indexed.append(coded) == locator_status::OK);
+    assert(appended_coded.append(indexed) == locator_status::OK);
+    assert(appended_coded.is_coded_category(1, &exists));
+    assert(!appended_indexed.is_coded_category(1, &exists));
+    same(appended_indexed, appended_coded);
+    
+    locator many_coded = make(true);
+    locator many_indexed = make(false);
+    std::vector<const locator*> others = { &indexed, &coded };
+    
+    assert(many_coded.append(others) == locator_status::OK);
+    assert(many_indexed.append(others) == locator_status::OK);
+    same(many_indexed, many_coded);
+    
+    locator empty_coded;
+    empty_coded.add_category(0, category_storage::CODES);
+    empty_coded.add_category(1);
+    empty_coded.add_category(2, category_storage::CODES);
+    
+    assert(empty_coded.append(indexed) == locator_status::OK);
+    assert(empty_coded.is_coded_category(0, &exists) && !empty_coded.is_coded_category(1, &exists));
+    same(indexed, empty_coded);
+    
+    //  keep_each; collapsed labels are random, so only their rows compare
+    locator each_indexed = indexed;
+    locator each_coded = coded;
+    types::entries_t each_categories;
+    each_categories.push(0);
+    
+    types::find_all_return_t each_expect = each_indexed.keep_each(each_categories, &exists);
+    types::find_all_return_t each_res = each_coded.keep_each(each_categories, &exists);
+    
+    assert(each_res.combinations.eq_contents(each_expect.combinations));
+    assert(each_coded.size() == each_indexed.size());
+    assert(each_coded.is_coded_category(1, &exists));
+    
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        types::entries_t expect_labels = each_indexed.full_category(i, &exists);
+        types::entries_t labels = each_coded.full_category(i, &exists);
+        
+        for (uint32_t j = 0; j < labels.tail(); j++)
+        {
+            bool is_collapsed = !indexed.has_label(labels.at(j));
+            
+            assert(labels.at(j) == expect_labels.at(j) ||
+                   (is_collapsed && !indexed.has_label(expect_labels.at(j))));
+        }
+    }
+    
+    //  swapping labels and categories, collapsing and removing
+    for (locator* loc : { &indexed, &coded })
+    {
+        assert(loc->swap_label(100000, 99) == locator_status::OK);
+        assert(loc->swap_category(2, 5) == locator_status::OK);
+    }
+    
+    same(indexed, coded);
+    assert(coded.is_coded_category(5, &exists));
+    
+    for (locator* loc : { &indexed, &coded })
+    {
+        assert(loc->collapse_category(5) == locator_status::OK);
+        assert(loc->rm_category(1) == locator_status::OK);
+    }
+    
+    //  the collapsed label is random
+    types::entries_t collapsed = coded.all_in_category(5, &exists);
+    
+    assert(collapsed.tail() == 1 && coded.count(collapsed.at(0)) == coded.size());
+    assert(coded.get_categories().eq_contents(indexed.get_categories()));
+    assert(coded.n_labels() == indexed.n_labels());
+    
+    for (locator* loc : { &indexed, &coded })
+    {
+        loc->empty();
+        assert(loc->size() == 0 && loc->n_labels() == 0);
+        assert(loc->set_category(5, 1, bit_array(10, true)) == locator_status::OK);
+    }
+    
+    same(indexed, coded);
+    
+    //  codes widen past NARROW_CODES labels
+    uint32_t n_wide = label_codes::NARROW_CODES + 10;
+    label_codes codes(n_wide);
+    bit_array row(n_wide, false);
+    
+    for (uint32_t i = 0; i < n_wide; i++)
+    {
+        codes.unchecked_place(i * 2, i);
+    }
+    
+    assert(codes.is_wide());
+    
+    for (uint32_t i = 0; i < n_wide; i += 997)
+    {
+        assert(codes.at(i) == i * 2 && codes.count(i * 2) == 1);
+    }
+    
+    row.place(true, 3);
+    codes.unchecked_assign(n_wide * 2, row);
+    
+    assert(codes.at(3) == n_wide * 2 && codes.count(6) == 0);
+    assert(codes.index(8, index_policy::DENSE).to_bit_array().sum() == 1);
+    assert(label_codes::find(codes, 8, 1).at(0) == 5);
+    
+    std::cout << "OK - test_coded_category()" << std::endl;
+}
+
+//  test_index_policy: Compressed, dense and density-chosen label indices
+//      give the same results.
+
+void test_index_policy()
+{
+    using namespace util;
+    
+    uint32_t sz = 150000;
+    
+    locator dense_loc;
+    dense_loc.set_index_policy(index_policy::DENSE);
+    
+    dense_loc.require_category(0);
+    dense_loc.require_category(1);
+    dense_loc.require_category(2);
+    
+    dense_loc.set_category(0, 1, bit_array(sz, true));
+    dense_loc.set_category(1, 10, bit_array(sz, true));
+    dense_loc.set_category(2, 20, bit_array(sz, true));
+    
+    for (uint32_t i = 2; i < 7; i++)
+    {
+        dense_loc.set_category(0, i, get_randomly_filled_array(sz, 300));
+    }
+    
+    for (uint32_t i = 11; i < 14; i++)
+    {
+        dense_loc.set_category(1, i, get_randomly_filled_array(sz, 2000));
+    }
+    
+    dense_loc.set_category(2, 21, get_randomly_filled_array(sz, 70000));
+    
+    locator comp_loc = dense_loc;
+    locator auto_loc = dense_loc;
+    
+    comp_loc.set_index_policy(index_policy::COMPRESSED);
+    auto_loc.set_index_policy(index_policy::BY_DENSITY);
+    
+    assert(comp_loc.is_compressed_label(2) && comp_loc.is_compressed_label(21));
+    assert(!dense_loc.is_compressed_label(2));
+    assert(auto_loc.is_compressed_label(2) && !auto_loc.is_compressed_label(21));
+    
+    std::vector<std::vector<uint32_t>> queries = {
+        { 2 }, { 21 }, { 2, 11 }, { 2, 3, 11 }, { 2, 3, 11, 21 }, { 1, 10 }, { 21, 2 }, { 1, 21 }, { 12, 13 }
+    };
+    
+    std::vector<locator*> locs = { &comp_loc, &auto_loc };
+    
+    auto check_same = [&]() -> void {
+        for (locator* loc : locs)
+        {
+            assert(*loc == dense_loc);
+            
+            const types::entries_t& labs = dense_loc.get_labels();
+            
+            for (uint32_t i = 0; i < labs.tail(); i++)
+            {
+                assert(loc->count(labs.at(i)) == dense_loc.count(labs.at(i)));
+                assert(loc->find(labs.at(i), 1).eq_contents(dense_loc.find(labs.at(i), 1)));
+            }
+            
+            for (const auto& query : queries)
+            {
+                types::entries_t search;
+                
+                for (uint32_t lab : query)
+                {
+                    search.push(lab);
+                }
+                
+                assert(loc->find(search, 3).eq_contents(dense_loc.find(search, 3)));
+            }
+            
+            types::entries_t cats;
+            cats.push(0);
+            cats.push(1);
+            
+            bool exists_a;
+            bool exists_b;
+            
+            auto res_a = loc->find_all(cats, &exists_a);
+            auto res_b = dense_loc.find_all(cats, &exists_b);
+            
+            assert(exists_a && exists_b);
+            assert(res_a.combinations.eq_contents(res_b.combinations));
+        }
+    };
+    
+    check_same();
+    
+    //  set
+    bit_array index = get_randomly_filled_array(sz, 500);
+    
+    for (locator* loc : { &dense_loc, &comp_loc, &auto_loc })
+    {
+        loc->set_category(0, 7, index);
+        loc->set_category(0, 2, index);
+    }
+    
+    check_same();
+    
+    //  keep
+    types::entries_t at_indices;
+    
+    for (uint32_t i = 0; i < sz; i++)
+    {
+        if (rand() % 3 != 0)
+        {
+            at_indices.push(i);
+        }
+    }
+    
+    for (locator* loc : { &dense_loc, &comp_loc, &auto_loc })
+    {
+        loc->keep(at_indices);
+    }
+    
+    check_same();
+    
+    //  append
+    locator dense_copy = dense_loc;
+    
+    for (locator* loc : { &dense_loc, &comp_loc, &auto_loc })
+    {
+        assert(loc->append(dense_copy) == locator_status::OK);
+    }
+    
+    check_same();
+    
+    //  resize
+    for (locator* loc : { &dense_loc, &comp_loc, &auto_loc })
+    {
+        loc->resize(loc->size() - 12345);
+    }
+    
+    check_same();
+    
+    std::cout << "OK - test_index_policy()" << std::endl;
+}
+
+void test_keep_mask()
+{
+    using namespace util;
+    
+    uint32_t policies[3] = { index_policy::DENSE, index_policy::COMPRESSED, index_policy::BY_DENSITY };
+    
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        uint32_t sz = 100000 + rand() % 100000;
+        
+        locator loc;
+        loc.set_index_policy(policies[i]);
+        
+        loc.require_category(0);
+        loc.require_category(1);
+        
+        loc.set_category(0, 1, bit_array(sz, true));
+        loc.set_category(1, 10, bit_array(sz, true));
+        
+        for (uint32_t j = 2; j < 8; j++)
+        {
+            loc.set_category(0, j, get_randomly_filled_array(sz, 1 + rand() % 3000));
+        }
+        
+        loc.set_category(1, 11, get_randomly_filled_array(sz, sz / 2));
+        
+        for (uint32_t n_true : { sz / 100, sz / 2, sz - 1, sz })
+        {
+            bit_array mask = get_randomly_filled_array(sz, n_true);
+            
+            locator expect = loc;
+            locator result = loc;
+            
+            assert(expect.keep(bit_array::find(mask)) == locator_status::OK);
+            assert(result.keep_mask(mask) == locator_status::OK);
+            
+            assert(result == expect);
+            assert(result.size() == mask.sum());
+            
+            types::entries_t search;
+            search.push(2);
+            search.push(11);
+            
+            assert(result.find(search).eq_contents(expect.find(search)));
+        }
+        
+        //  wrong size, and an empty mask
+        locator copy = loc;
+        
+        assert(copy.keep_mask(bit_array(sz + 1, true)) == locator_status::WRONG_INDEX_SIZE);
+        assert(copy == loc);
+        
+        assert(copy.keep_mask(bit_array(sz, false)) == locator_status::OK);
+        assert(copy.size() == 0 && copy.is_empty());
+    }
+    
+    std::cout << "OK - test_keep_mask()" << std::endl;
+}
+
+void test_append_many()
+{
+    using namespace util;
+    
+    uint32_t policies[3] = { index_policy::DENSE, index_policy::COMPRESSED, index_policy::BY_DENSITY };
+    
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        std::vector<locator> sessions(8);
+        
+        for (uint32_t j = 0; j < sessions.size(); j++)
+        {
+            locator& session = sessions[j];
+            
+            session.set_index_policy(policies[i]);
+            session.require_category(0);
+            session.require_category(1);
+            
+            //  one session without rows
+            if (j == 3)
+            {
+                continue;
+            }
+            
+            uint32_t sz = 1 + rand() % 70000;
+            
+            session.set_category(0, 1, bit_array(sz, true));
+            session.set_category(1, 10, bit_array(sz, true));
+            
+            for (uint32_t k = 2; k < 7; k++)
+            {
+                if (rand() % 2 == 0)
+                {
+                    session.set_category(0, k, get_randomly_filled_array(sz, 1 + rand() % 500));
+                }
+            }
+            
+            for (uint32_t k = 11; k < 13; k++)
+            {
+                if (rand() % 2 == 0)
+                {
+                    session.set_category(1, k, get_randomly_filled_array(sz, 1 + rand() % sz));
+                }
+            }
+        }
+        
+        locator sequential = sessions[0];
+        locator combined = sessions[0];
+        std::vector<const locator*> others;
+        
+        for (uint32_t j = 1; j < sessions.size(); j++)
+        {
+            assert(sequential.append(sessions[j]) == locator_status::OK);
+            others.push_back(&sessions[j]);
+        }
+        
+        assert(combined.append(others) == locator_status::OK);
+        assert(combined == sequential);
+        
+        //  each label's rows are the union of its rows in each session
+        const types::entries_t& labels = combined.get_labels();
+        
+        for (uint32_t j = 0; j < labels.tail(); j++)
+        {
+            uint32_t lab = labels.at(j);
+            uint32_t offset = 0;
+            types::entries_t expect;
+            
+            for (const locator& session : sessions)
+            {
+                types::entries_t found = session.find(lab, offset);
+                
+                for (uint32_t k = 0; k < found.tail(); k++)
+                {
+                    expect.push(found.at(k));
+                }
+                
+                offset += session.size();
+            }
+            
+            assert(combined.find(lab).eq_contents(expect));
+        }
+        
+        //  into an empty locator, and onto itself
+        locator empty;
+        empty.require_category(0);
+        empty.require_category(1);
+        
+        assert(empty.append(others) == locator_status::OK);
+        
+        locator twice = combined;
+        assert(twice.append(std::vector<const locator*>{ &twice }) == locator_status::OK);
+        assert(twice.size() == combined.size() * 2);
+        assert(twice.count(1) == combined.count(1) * 2);
+        
+        locator other_categories;
+        other_categories.require_category(2);
+        
+        assert(combined.append(std::vector<const locator*>{ &other_categories }) ==
+               locator_status::CATEGORIES_DO_NOT_MATCH);
+    }
+    
+    std::cout << "OK - test_append_many()" << std::endl;
+}
+
 void test_keep_each()
 {
     using namespace util;
@@ -126,6 +1221,132 @@ void test_keep_each()
     
     assert(exists);
     
+    //  a kept row has the labels of its combination, and in each other
+    //  category the label shared by all of the combination's rows, no
+    //  label if none of them has one, or else a collapsed label.
+    const uint32_t NO_LABEL = NO_LABEL;
+    const uint32_t COLLAPSED = NO_LABEL - 1;
+    
+    uint32_t n_rows = 3000;
+    std::vector<std::vector<uint32_t>> row_labels(n_rows, std::vector<uint32_t>(4, NO_LABEL));
+    
+    for (uint32_t i = 0; i < n_rows; i++)
+    {
+        row_labels[i][0] = 1 + rand() % 2;
+        row_labels[i][1] = 3 + rand() % 2;
+        row_labels[i][2] = 5 + rand() % 3;
+        
+        if (row_labels[i][0] == 1)
+        {
+            row_labels[i][3] = 8;
+        }
+        else if (row_labels[i][1] == 4 && rand() % 2 == 0)
+        {
+            row_labels[i][3] = 9;
+        }
+    }
+    
+    locator mixed;
+    
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        mixed.require_category(i);
+        
+        for (uint32_t lab = 1; lab <= 9; lab++)
+        {
+            bit_array index(n_rows, false);
+            
+            for (uint32_t j = 0; j < n_rows; j++)
+            {
+                index.place(row_labels[j][i] == lab, j);
+            }
+            
+            if (index.any())
+            {
+                mixed.set_category(i, lab, index);
+            }
+        }
+    }
+    
+    std::vector<std::vector<uint32_t>> expect_labels;
+    std::vector<std::vector<uint32_t>> expect_rows;
+    
+    for (uint32_t i = 0; i < n_rows; i++)
+    {
+        uint32_t group = 0;
+        
+        while (group < expect_labels.size() &&
+               (expect_labels[group][0] != row_labels[i][0] || expect_labels[group][1] != row_labels[i][1]))
+        {
+            group++;
+        }
+        
+        if (group == expect_labels.size())
+        {
+            expect_labels.push_back(row_labels[i]);
+            expect_rows.emplace_back();
+        }
+        
+        for (uint32_t j = 2; j < 4; j++)
+        {
+            if (expect_labels[group][j] != row_labels[i][j])
+            {
+                expect_labels[group][j] = COLLAPSED;
+            }
+        }
+        
+        expect_rows[group].push_back(i);
+    }
+    
+    types::find_all_return_t res = mixed.keep_each(combs, &exists);
+    uint32_t n_groups = uint32_t(expect_labels.size());
+    
+    assert(exists);
+    assert(mixed.size() == n_groups && res.indices.tail() == n_groups);
+    
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        std::vector<uint32_t> kept_labels(n_groups, NO_LABEL);
+        types::entries_t in_cat = mixed.all_in_category(i, &exists);
+        
+        for (uint32_t j = 0; j < in_cat.tail(); j++)
+        {
+            types::numeric_indices_t rows = mixed.find(in_cat.at(j));
+            
+            for (uint32_t k = 0; k < rows.tail(); k++)
+            {
+                kept_labels[rows.at(k)] = in_cat.at(j);
+            }
+        }
+        
+        uint32_t collapsed_lab = NO_LABEL;
+        
+        for (uint32_t j = 0; j < n_groups; j++)
+        {
+            if (expect_labels[j][i] != COLLAPSED)
+            {
+                assert(kept_labels[j] == expect_labels[j][i]);
+                continue;
+            }
+            
+            //  one collapsed label per category, distinct from the originals
+            assert(kept_labels[j] > 9 && kept_labels[j] != NO_LABEL);
+            assert(collapsed_lab == NO_LABEL || collapsed_lab == kept_labels[j]);
+            
+            collapsed_lab = kept_labels[j];
+        }
+    }
+    
+    for (uint32_t i = 0; i < n_groups; i++)
+    {
+        assert(res.indices.at(i).tail() == expect_rows[i].size());
+        
+        for (uint32_t j = 0; j < expect_rows[i].size(); j++)
+        {
+            assert(res.indices.at(i).at(j) == expect_rows[i][j]);
+        }
+    }
+    
     std::cout << "OK - test_keep_each()" << std::endl;
 }
 
@@ -315,12 +1536,14 @@ void test_resize()
             assert(locb.n_labels() == 1);
         }
         
-        loc_map[i] = std::move(locb);
+        //  keep `loc_map[0]` intact; resizing a locator emptied by a
+        //  previous iteration would not restore its labels.
+        loc_map[i+1] = std::move(locb);
     }
     
     for (uint32_t i = 0; i < n_iters; i++)
     {
-        loc_map.erase(i);
+        loc_map.erase(i+1);
     }
 }
 
@@ -426,6 +1649,97 @@ void test_set_category_mult_labels()
     assert(result == locator_status::OK);
 }
 
+//  test_set_category_bulk: Setting many labels at once, unsorted and
+//      repeated, agrees with a row-by-row reference, for label indices and
+//      codes.
+
+void test_set_category_bulk()
+{
+    using namespace util;
+    
+    const uint32_t no_label = ~uint32_t(0);
+    const uint32_t sz = 70000;
+    const uint32_t n_labels = 30;
+    
+    for (uint32_t coded = 0; coded < 2; coded++)
+    {
+        for (uint32_t policy : { index_policy::DENSE, index_policy::COMPRESSED, index_policy::BY_DENSITY })
+        {
+            locator loc;
+            loc.set_index_policy(policy);
+            
+            loc.add_category(0, coded ? category_storage::CODES : category_storage::INDICES);
+            loc.add_category(1);
+            
+            std::vector<uint32_t> row_labels(sz, no_label);
+            
+            for (uint32_t i = 0; i < 20; i++)
+            {
+                //  the first call sets every row, and gives the locator its size
+                bit_array index(sz, i == 0);
+                uint32_t n_set = i == 0 ? sz : rand() % 3000;
+                
+                for (uint32_t j = 0; j < n_set; j++)
+                {
+                    index.place(true, rand() % sz);
+                }
+                
+                types::entries_t labels;
+                
+                for (uint32_t row : index.set_bits())
+                {
+                    //  labels of the first call are drawn from the first half
+                    uint32_t lab = rand() % (i == 0 ? n_labels / 2 : n_labels);
+                    
+                    labels.push(lab);
+                    row_labels[row] = lab;
+                }
+                
+                assert(loc.set_category(0, labels, index) == locator_status::OK);
+                
+                if (i == 0)
+                {
+                    loc.set_category(1, 500, bit_array(sz, true));
+                }
+            }
+            
+            for (uint32_t lab = 0; lab < n_labels; lab++)
+            {
+                types::entries_t expect;
+                
+                for (uint32_t j = 0; j < sz; j++)
+                {
+                    if (row_labels[j] == lab)
+                    {
+                        expect.push(j);
+                    }
+                }
+                
+                assert(loc.has_label(lab) == (expect.tail() > 0));
+                assert(loc.find(lab).eq_contents(expect));
+            }
+            
+            assert(loc.get_labels().tail() == loc.n_labels());
+            assert(loc.find(500).tail() == sz);
+            
+            //  a label of another category leaves the locator unchanged
+            locator copy = loc;
+            bit_array index(sz, false);
+            types::entries_t labels;
+            
+            index.place(true, 0);
+            index.place(true, 1);
+            labels.push(1);
+            labels.push(500);
+            
+            assert(loc.set_category(0, labels, index) == locator_status::LABEL_EXISTS_IN_OTHER_CATEGORY);
+            assert(loc == copy);
+        }
+    }
+    
+    std::cout << "OK - test_set_category_bulk()" << std::endl;
+}
+
 void test_append_single()
 {
     using namespace util;
@@ -899,6 +2213,75 @@ void test_set_category()
     }
 }
 
+//  test_set_category_sparse: Setting a few rows at a time, scattered or
+//      clustered, agrees with a row-by-row reference, and labels left
+//      without rows are removed.
+
+void test_set_category_sparse()
+{
+    using namespace util;
+    
+    const uint32_t no_label = ~uint32_t(0);
+    const uint32_t sz = 150000;
+    const uint32_t n_labels = 12;
+    
+    std::vector<uint32_t> policies = { index_policy::DENSE, index_policy::COMPRESSED, index_policy::BY_DENSITY };
+    
+    for (uint32_t policy : policies)
+    {
+        locator loc;
+        loc.set_index_policy(policy);
+        
+        loc.require_category(0);
+        loc.require_category(1);
+        loc.set_category(1, 1000, bit_array(sz, true));
+        
+        std::vector<uint32_t> row_labels(sz, no_label);
+        
+        for (uint32_t i = 0; i < 150; i++)
+        {
+            uint32_t lab = rand() % n_labels;
+            bit_array index(sz, false);
+            
+            //  either a block of nearby rows, or rows anywhere; the first
+            //  label covers every row
+            uint32_t n_set = i == 0 ? sz : 1 + rand() % 200;
+            uint32_t first = rand() % sz;
+            bool is_clustered = rand() % 2 == 0;
+            
+            for (uint32_t j = 0; j < n_set; j++)
+            {
+                uint32_t row = i == 0 ? j : is_clustered ? (first + j) % sz : rand() % sz;
+                
+                index.place(true, row);
+                row_labels[row] = lab;
+            }
+            
+            assert(loc.set_category(0, lab, index) == locator_status::OK);
+        }
+        
+        for (uint32_t lab = 0; lab < n_labels; lab++)
+        {
+            types::entries_t expect;
+            
+            for (uint32_t j = 0; j < sz; j++)
+            {
+                if (row_labels[j] == lab)
+                {
+                    expect.push(j);
+                }
+            }
+            
+            assert(loc.has_label(lab) == (expect.tail() > 0));
+            assert(loc.find(lab).eq_contents(expect));
+        }
+        
+        assert(loc.find(1000).tail() == sz);
+    }
+    
+    std::cout << "OK - test_set_category_sparse()" << std::endl;
+}
+
 void test_empty_and_clear()
 {
     using namespace util;
@@ -1,20 +1,24 @@
 #include "utilities.hpp"
 #include "dynamic_array.hpp"
+#include "slot_table.hpp"
 #include <iostream>
 #include <assert.h>
 #include <chrono>
 #include <vector>
 #include <cstdint>
 #include <algorithm>
+#include <unordered_map>
 
 void test_binary_search();
 void test_quick_sort();
+void test_slot_table();
 double ellapsed_time_s(std::chrono::high_resolution_clock::time_point t1, std::chrono::high_resolution_clock::time_point t2);
 
 int main(int argc, char* argv[])
 {
     test_binary_search();
     test_quick_sort();
+    test_slot_table();
 }
 
 double ellapsed_time_s(std::chrono::high_resolution_clock::time_point t1, std::chrono::high_resolution_clock::time_point t2)
@@ -112,3 +116,97 @@ void test_binary_search()
     assert(!res);
     assert(at_index == sz/4);
 }
+
+void test_slot_table()
+{
+    util::slot_table table;
+    std::unordered_map<uint32_t, uint32_t> expect;
+    std::vector<uint32_t> keys;
+    
+    const uint32_t NO_SLOT = util::slot_table::NO_SLOT;
+    
+    assert(table.find(0u) == NO_SLOT);
+    assert(table.erase(0u) == NO_SLOT);
+    
+    srand(21);
+    
+    //  keys that share their low bits, and random ones, including ~0
+    for (uint32_t i = 0; i < 20000; i++)
+    {
+        uint32_t key = i % 2 == 0 ? (i << 16) : uint32_t(rand()) * 2654435761u;
+        key = i == 1 ? ~uint32_t(0) : key;
+        
+        bool was_inserted;
+        uint32_t slot = table.insert(key, &was_inserted);
+        
+        assert(was_inserted == (expect.count(key) == 0));
+        
+        if (was_inserted)
+        {
+            expect[key] = slot;
+            keys.push_back(key);
+        }
+        
+        assert(expect.at(key) == slot);
+        assert(table.key_of(slot) == key);
+    }
+    
+    assert(table.size() == expect.size());
+    assert(table.n_slots() == expect.size());
+    
+    //  erase every third key; their slots are reused before new ones
+    std::vector<uint32_t> freed;
+    
+    for (uint32_t i = 0; i < keys.size(); i += 3)
+    {
+        uint32_t slot = table.erase(keys[i]);
+        
+        assert(slot == expect.at(keys[i]));
+        assert(!table.is_used(slot));
+        assert(table.find(keys[i]) == NO_SLOT);
+        
+        expect.erase(keys[i]);
+        freed.push_back(slot);
+    }
+    
+    for (const auto& it : expect)
+    {
+        assert(table.find(it.first) == it.second);
+        assert(table.is_used(it.second));
+    }
+    
+    uint32_t n_slots = table.n_slots();
+    
+    for (uint32_t i = 0; i < freed.size(); i++)
+    {
+        uint32_t key = 1000000u + i * 7u;
+        bool was_inserted;
+        uint32_t slot = table.insert(key, &was_inserted);
+        
+        assert(was_inserted && slot < n_slots && slot == freed[freed.size() - 1 - i]);
+        
+        expect[key] = slot;
+    }
+    
+    assert(table.n_slots() == n_slots);
+    assert(table.size() == expect.size());
+    
+    //  renamed keys keep their slots
+    uint32_t key = keys[1];
+    uint32_t slot = table.find(key);
+    
+    table.rename(key, 5u);
+    
+    assert(table.find(key) == NO_SLOT);
+    assert(table.find(5u) == slot);
+    assert(table.key_of(slot) == 5u);
+    
+    util::slot_table copy = table;
+    
+    table.clear();
+    
+    assert(table.size() == 0 && table.n_slots() == 0 && table.find(5u) == NO_SLOT);
+    assert(copy.find(5u) == slot);
+    
+    std::cout << "OK - test_slot_table()" << std::endl;
+}